@@ -0,0 +1,124 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+
+#include "span.h"
+
+namespace epee
+{
+  /*!
+    \brief Immutable, reference counted sequence of bytes.
+
+    Copies of a `byte_slice` are explicit (`clone()`) and never copy the
+    bytes; all clones share one allocation that is released when the last
+    clone goes away. Used for network messages so that one serialized payload
+    can be queued on many connections, and split into send chunks, without
+    copying it again.
+   */
+  class byte_slice
+  {
+    std::shared_ptr<const std::string> storage_;
+    span<const std::uint8_t> portion_; // within `storage_`
+
+    byte_slice(const std::shared_ptr<const std::string>& storage, span<const std::uint8_t> portion) noexcept;
+
+  public:
+    using value_type = std::uint8_t;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::uint8_t*;
+    using const_pointer = const std::uint8_t*;
+    using reference = std::uint8_t;
+    using const_reference = std::uint8_t;
+    using iterator = pointer;
+    using const_iterator = const_pointer;
+
+    //! Construct empty slice.
+    byte_slice() noexcept : storage_(nullptr), portion_() {}
+
+    //! Construct empty slice.
+    byte_slice(std::nullptr_t) noexcept : byte_slice() {}
+
+    //! Copy the bytes in `sources` (in order) into a single new allocation.
+    explicit byte_slice(std::initializer_list<span<const std::uint8_t>> sources);
+
+    //! Take ownership of `buffer`; the bytes are not copied.
+    explicit byte_slice(std::string&& buffer);
+
+    byte_slice(byte_slice&& source) noexcept;
+    ~byte_slice() noexcept = default;
+
+    //! \note May be removed in future, `clone()` makes sharing explicit
+    byte_slice& operator=(byte_slice&&) noexcept;
+
+    //! \return A shallow (cheap) copy of the data from `this` slice.
+    byte_slice clone() const { return {storage_, portion_}; }
+
+    iterator begin() const noexcept { return portion_.begin(); }
+    const_iterator cbegin() const noexcept { return portion_.begin(); }
+
+    iterator end() const noexcept { return portion_.end(); }
+    const_iterator cend() const noexcept { return portion_.end(); }
+
+    bool empty() const noexcept { return portion_.empty(); }
+    const std::uint8_t* data() const noexcept { return portion_.data(); }
+    std::size_t size() const noexcept { return portion_.size(); }
+
+    //! \return Number of slices currently sharing the allocation, 0 if empty.
+    long use_count() const noexcept { return storage_.use_count(); }
+
+    /*! Drop bytes from the beginning of `this` slice.
+
+        \param max_bytes Maximum number of bytes to remove from the beginning.
+        \return Number of bytes removed. */
+    std::size_t remove_prefix(std::size_t max_bytes) noexcept;
+
+    /*! "Take" bytes from the beginning of `this` slice.
+
+        \param max_bytes Maximum number of bytes to take from the beginning.
+        \return Slice sharing the allocation with the bytes that were removed
+          from `this`. */
+    byte_slice take_slice(std::size_t max_bytes) noexcept;
+
+    /*! \return Slice sharing the allocation with bytes `[begin, end)`.
+        \throw std::out_of_range If `end < begin` or `size() < end`. */
+    byte_slice get_slice(std::size_t begin, std::size_t end) const;
+  };
+
+  inline span<const std::uint8_t> to_span(const byte_slice& src) noexcept
+  {
+    return {src.data(), src.size()};
+  }
+} // epee
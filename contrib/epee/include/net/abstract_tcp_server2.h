@@ -63,7 +63,14 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net"
 
-#define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT (1024)
+// per class limits of bytes waiting in a p2p connection's send queue, RPC connections are not limited
+#define ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_HIGH (32 * 1024 * 1024) // over this the peer is not reading, drop it
+#define ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_NORMAL (16 * 1024 * 1024)
+#define ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_BULK (64 * 1024 * 1024)
+#define ABSTRACT_SERVER_SEND_QUE_BACKPRESSURE_BYTES (8 * 1024 * 1024) // context.m_send_backpressure is set above this
+#define ABSTRACT_SERVER_SEND_CHUNK_BYTES (32 * 1024) // p2p message bodies are written in slices of this size for rate limiting
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_COUNT (64) // queued slices handed to one scatter-gather write
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES (64 * 1024)
 
 namespace epee
 {
@@ -140,7 +147,8 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
-    virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
+    virtual bool do_send(byte_slice message); ///< queues `message` without copying it
+    virtual bool do_send(byte_slice header, byte_slice body, send_priority priority); ///< queues one message in its class
     virtual bool send_done();
     virtual bool close();
     virtual bool call_run_once_service_io();
@@ -162,6 +170,12 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Write the front of m_send_que with one scatter-gather operation; m_send_que_lock must be held.
+    void start_write();
+
+    /// Copy the send queue state to the context for the protocol handler; m_send_que_lock must be held.
+    void update_send_context();
+
     /// reset connection timeout timer and callback
     void reset_timer(boost::posix_time::milliseconds ms, bool add);
     boost::posix_time::milliseconds get_default_timeout();
@@ -183,7 +197,6 @@ namespace net_utils
     size_t m_reference_count = 0; // reference count managed through add_ref/release support
     boost::shared_ptr<connection<t_protocol_handler> > m_self_ref; // the reference to hold
     critical_section m_self_refs_lock;
-    critical_section m_chunking_lock; // held while we add small chunks of the big do_send() to small do_send_chunk()
     critical_section m_shutdown_lock; // held while shutting down
     
     t_connection_type m_connection_type;
@@ -104,6 +104,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		m_ready_to_close(false)
   {
     MDEBUG("test, connection constructor set m_connection_type="<<m_connection_type);
+    if (speed_limit_is_enabled())
+    {
+      m_send_que.set_limit(send_priority::high, ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_HIGH);
+      m_send_que.set_limit(send_priority::normal, ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_NORMAL);
+      m_send_que.set_limit(send_priority::bulk, ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_BULK);
+    }
   }
 
 PRAGMA_WARNING_DISABLE_VS(4355)
@@ -370,7 +376,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         boost::interprocess::ipcdetail::atomic_write32(&m_want_close_connection, 1);
         bool do_shutdown = false;
         CRITICAL_REGION_BEGIN(m_send_que_lock);
-        if(!m_send_que.size())
+        if(m_send_que.empty())
           do_shutdown = true;
         CRITICAL_REGION_END();
         if(do_shutdown)
@@ -458,7 +464,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         boost::interprocess::ipcdetail::atomic_write32(&m_want_close_connection, 1);
         bool do_shutdown = false;
         CRITICAL_REGION_BEGIN(m_send_que_lock);
-        if(!m_send_que.size())
+        if(m_send_que.empty())
           do_shutdown = true;
         CRITICAL_REGION_END();
         if(do_shutdown)
@@ -509,100 +515,18 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb) {
     TRY_ENTRY();
-
-    // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
-    auto self = safe_shared_from_this();
-    if (!self) return false;
-    if (m_was_shutdown) return false;
-		// TODO avoid copy
-
-        // I think that author of this was a little drunk, or something else |
-		const double factor = 32; // TODO config
-		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
-		const t_safe chunksize_good = (t_safe)( 1024 * std::max(1.0,factor) );
-        const t_safe chunksize_max = chunksize_good * 2 ;
-        /*const */bool allow_split = (m_connection_type == e_connection_type_RPC) ? false : true; // do not split RPC data
-
-
-        CHECK_AND_ASSERT_MES(! (chunksize_max<0), false, "Negative chunksize_max" ); // make sure it is unsigned before removin sign with cast:
-        long long unsigned int chunksize_max_unsigned = static_cast<long long unsigned int>( chunksize_max ) ;
-        // may be it's better to use "long long long long long long unsigned int" or use multiprecision arithmetics?no? really?
-#if 0
-
-        allow_split = false; // splitting for upload speed control...
-                             // But it's allowed for non RPC connections
-                             // and
-                             // upload speed control turned on ONLY for RPC connections
-                             // So, splitting is meaningless
-                             // * Actually I had turned off RPC connection speed controls, because it hangs io_service threads.
-
-#endif
-        if (allow_split && (cb > chunksize_max_unsigned)) {
-			{ // LOCK: chunking
-    		epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical *** 
-            // Here we should also lock m_send_que_lock but we've forgotten, haven't we?
-
-				MDEBUG("do_send() will SPLIT into small chunks, from packet="<<cb<<" B for ptr="<<ptr);
-				t_safe all = cb; // all bytes to send 
-				t_safe pos = 0; // current sending position
-				// 01234567890 
-				// ^^^^        (pos=0, len=4)     ;   pos:=pos+len, pos=4
-				//     ^^^^    (pos=4, len=4)     ;   pos:=pos+len, pos=8
-				//         ^^^ (pos=8, len=4)    ;   
-
-				// const size_t bufsize = chunksize_good; // TODO safecast
-				// char* buf = new char[ bufsize ];
-
-				bool all_ok = true;
-				while (pos < all) {
-					t_safe lenall = all-pos; // length from here to end
-					t_safe len = std::min( chunksize_good , lenall); // take a smaller part
-					CHECK_AND_ASSERT_MES(len<=chunksize_good, false, "len too large");
-					// pos=8; len=4; all=10;	len=3;
-
-                    CHECK_AND_ASSERT_MES(! (len<0), false, "negative len"); // check before we cast away sign:
-                    unsigned long long int len_unsigned = static_cast<long long int>( len );
-                    CHECK_AND_ASSERT_MES(len>0, false, "len not strictly positive"); // (redundant)
-                    CHECK_AND_ASSERT_MES(len_unsigned < std::numeric_limits<size_t>::max(), false, "Invalid len_unsigned");   // yeap we want strong < then max size, to be sure
-					
-					void *chunk_start = ((char*)ptr) + pos;
-					MDEBUG("chunk_start="<<chunk_start<<" ptr="<<ptr<<" pos="<<pos);
-					CHECK_AND_ASSERT_MES(chunk_start >= ptr, false, "Pointer wraparound"); // not wrapped around address?
-
-					MDEBUG("part of " << lenall << ": pos="<<pos << " len="<<len);
-
-					bool ok = do_send_chunk(chunk_start, len); // <====== ***
-
-					all_ok = all_ok && ok;
-					if (!all_ok) {
-						MDEBUG("do_send() DONE ***FAILED*** from packet="<<cb<<" B for ptr="<<ptr);
-						MDEBUG("do_send() SEND was aborted in middle of big package - this is mostly harmless "
-							<< " (e.g. peer closed connection). " << cb);
-						return false; // partial failure in sending
-					}
-					pos = pos+len;
-					CHECK_AND_ASSERT_MES(pos >0, false, "pos <= 0");
-
-					// (in catch block, or uniq pointer) delete buf;
-				} // each chunk
-
-				MDEBUG("do_send() DONE SPLIT from packet="<<cb<<" B for ptr="<<ptr);
-
-                MDEBUG("do_send() m_connection_type = " << m_connection_type);
-
-				return all_ok; // done - e.g. queued - all the chunks of current do_send call
-			} // LOCK: chunking
-		} // a big block (to be chunked) - all chunks
-		else { // small block
-			return do_send_chunk(ptr,cb); // just send as 1 big chunk
-		}
-
+    // the only copy of the data: the caller keeps ownership of ptr
+    return do_send(byte_slice{{epee::span<const uint8_t>(static_cast<const uint8_t*>(ptr), cb)}});
     CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-	} // do_send()
-
+  }
+  //---------------------------------------------------------------------------------
+    template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send(byte_slice message) {
+    return do_send(std::move(message), byte_slice{}, send_priority::normal);
+  }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
+  bool connection<t_protocol_handler>::do_send(byte_slice header, byte_slice body, send_priority priority)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -611,6 +535,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     if(m_was_shutdown)
       return false;
+    const size_t cb = header.size() + body.size();
     {
 		CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
 		m_throttle_speed_out.handle_trafic_exact(cb);
@@ -621,82 +546,78 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     //_info("[sock " << socket().native_handle() << "] SEND " << cb);
     context.m_last_send = time(NULL);
     context.m_send_cnt += cb;
-    //some data should be wrote to stream
-    //request complete
-    
-    // No sleeping here; sleeping is done once and for all in "handle_write"
 
-    m_send_que_lock.lock(); // *** critical ***
-    epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){m_send_que_lock.unlock();});
+    // No sleeping here; sleeping is done once and for all in "handle_write"
 
-    long int retry=0;
-    const long int retry_limit = 5*4;
-    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    if(!m_send_que.push(std::move(header), std::move(body), priority))
     {
-        retry++;
-
-        /* if ( ::cryptonote::core::get_is_stopping() ) { // TODO re-add fast stop
-            _fact("ABORT queue wait due to stopping");
-            return false; // aborted
-        }*/
-
-        long int ms = 250 + (rand()%50);
-        MDEBUG("Sleeping because QUEUE is FULL, in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<cb); // XXX debug sleep
-        m_send_que_lock.unlock();
-        boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-        m_send_que_lock.lock();
-        _dbg1("sleep for queue: " << ms);
-
-        if (retry > retry_limit) {
-            MWARNING("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
-            shutdown();
-            return false;
-        }
+      if(priority == send_priority::high)
+      {
+        MWARNING(context << "high priority send queue is over " << ABSTRACT_SERVER_SEND_QUE_MAX_BYTES_HIGH << " bytes, shutting down connection");
+        shutdown();
+      }
+      else
+        MDEBUG(context << to_string(priority) << " send queue is full (" << m_send_que.pending_bytes(priority) << " bytes), dropping " << cb << " bytes");
+      update_send_context();
+      return false;
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
-    
-    if(m_send_que.size() > 1)
+    if(m_send_que_inflight)
     { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = cb;
-        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
-      
-      LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+      MDEBUG("do_send() NOW just queues: packet="<<cb<<" B, " << to_string(priority) << " queue=" << m_send_que.pending_bytes(priority) << " B");
     }
-    else
+    else if(m_send_que.fill(ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES, speed_limit_is_enabled() ? ABSTRACT_SERVER_SEND_CHUNK_BYTES : 0))
     { // no active operation
+      MDEBUG("do_send() NOW SENDS: packet="<<cb<<" B");
+      if (speed_limit_is_enabled())
+        do_send_handler_write( m_send_que.wire().front().data() , m_send_que.wire().front().size() ); // (((H)))
 
-        if(m_send_que.size()!=1)
-        {
-            _erro("Looks like no active operations, but send que size != 1!!");
-            return false;
-        }
-
-        auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
-        if (speed_limit_is_enabled())
-			do_send_handler_write( ptr , size_now ); // (((H)))
-
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
-        reset_timer(get_default_timeout(), false);
-            async_write(boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 )
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+      start_write();
     }
-    
-    //do_send_handler_stop( ptr , cb ); // empty function
+    update_send_context();
 
     return true;
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
-  } // do_send_chunk
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+  } // do_send()
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::update_send_context()
+  {
+    context.m_send_queue_bytes = m_send_que.queued_bytes();
+    context.m_send_backpressure = speed_limit_is_enabled() &&
+      m_send_que.queued_bytes() - m_send_que.pending_bytes(send_priority::high) >= ABSTRACT_SERVER_SEND_QUE_BACKPRESSURE_BYTES;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write()
+  {
+    // hand everything already queued (headers, payload chunks, other messages) to a single
+    // scatter-gather write instead of one async_write per queue entry; the slices stay
+    // in m_send_que, which keeps their buffers alive until handle_write releases them
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t bytes = 0;
+    for (const byte_slice& slice: m_send_que.wire())
+    {
+      if (buffers.size() >= ABSTRACT_SERVER_SEND_GATHER_MAX_COUNT)
+        break;
+      // keep gathered writes near the chunk size so rate limiting stays smooth
+      if (!buffers.empty() && bytes + slice.size() > ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES)
+        break;
+      buffers.emplace_back(slice.data(), slice.size());
+      bytes += slice.size();
+    }
+    m_send_que_inflight = buffers.size();
+
+    MDEBUG("start_write() NOW SENDS: " << bytes << " B in " << buffers.size() << " slices, from queue size=" << m_send_que.wire().size());
+    reset_timer(get_default_timeout(), false);
+    async_write(buffers,
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
+      )
+    );
+  }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_default_timeout()
@@ -799,12 +720,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     //_info("[sock " << socket().native_handle() << "] Que Shutdown called.");
     m_timer.cancel();
-    size_t send_que_size = 0;
+    bool send_que_empty = true;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
-    send_que_size = m_send_que.size();
+    send_que_empty = m_send_que.empty();
     CRITICAL_REGION_END();
     boost::interprocess::ipcdetail::atomic_write32(&m_want_close_connection, 1);
-    if(!send_que_size)
+    if(send_que_empty)
     {
       shutdown();
     }
@@ -849,14 +770,17 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     bool do_shutdown = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
-    if(m_send_que.empty())
+    if(m_send_que.wire().size() < m_send_que_inflight || !m_send_que_inflight)
     {
-      _erro("[sock " << socket().native_handle() << "] m_send_que.size() == 0 at handle_write!");
+      _erro("[sock " << socket().native_handle() << "] m_send_que.wire().size() == " << m_send_que.wire().size() << " with " << m_send_que_inflight << " in flight at handle_write!");
       return;
     }
 
-    m_send_que.pop_front();
-    if(m_send_que.empty())
+    m_send_que.pop_written(m_send_que_inflight);
+    m_send_que_inflight = 0;
+    const bool more = m_send_que.fill(ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES, speed_limit_is_enabled() ? ABSTRACT_SERVER_SEND_CHUNK_BYTES : 0);
+    update_send_context();
+    if(!more)
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
       {
@@ -865,18 +789,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
-		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
 		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		  async_write(boost::asio::buffer(m_send_que.front().data(), size_now) , 
-           strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-			  )
-          );
-      //_dbg3("(normal)" << size_now);
+			do_send_handler_write_from_queue(e, m_send_que.wire().front().size() , m_send_que.wire().size()); // (((H)))
+		start_write();
     }
     CRITICAL_REGION_END();
 
@@ -894,6 +809,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   {
     m_connection_type = e_connection_type_RPC; 
     MDEBUG("set m_connection_type = RPC ");
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    for (size_t cls = 0; cls < send_priority_count; ++cls)
+      m_send_que.set_limit(send_priority(cls), 0);
   }
 
 
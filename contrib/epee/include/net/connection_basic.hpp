@@ -43,12 +43,16 @@
 
 
 #include <string>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
+#include "byte_slice.h"
 #include "net/net_utils_base.h"
 #include "net/net_ssl.h"
 #include "syncobj.h"
@@ -82,6 +86,71 @@ namespace net_utils
 		const ssl_options_t& ssl_options() const noexcept { return ssl_options_; }
 	};
 
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  /// Outgoing data of one connection. Messages wait in one queue per
+  /// send_priority and are moved to the wire queue whole, highest class
+  /// first, so a message is never interleaved with another one and a
+  /// high priority message only waits for what is already committed.
+  /// Not thread safe, connection<> guards it with m_send_que_lock.
+  class send_queue
+  {
+  public:
+    struct class_stats
+    {
+      uint64_t messages;      //!< messages committed to the wire
+      uint64_t bytes;
+      uint64_t dropped;       //!< messages refused because the class was full
+      uint64_t wait_us_total; //!< time spent queued, summed over messages
+      uint64_t wait_us_max;
+    };
+    typedef std::array<class_stats, send_priority_count> stats;
+
+    send_queue();
+
+    //! Set the byte limit of a class, 0 (the default) for no limit
+    void set_limit(send_priority priority, size_t bytes) { m_limit[size_t(priority)] = bytes; }
+
+    //! \return False if `priority` is over its limit. A lone message is always accepted.
+    bool push(byte_slice header, byte_slice body, send_priority priority);
+
+    /*! Commits pending messages to the wire queue, highest class first, while
+        it holds less than `low_water` bytes. Bodies are split in `chunk_size`
+        slices for rate limiting (0 to not split).
+        \return False if the wire queue is empty. */
+    bool fill(size_t low_water, size_t chunk_size);
+
+    //! Slices to write, in order
+    const std::deque<byte_slice>& wire() const noexcept { return m_wire; }
+
+    //! Release the first `count` slices of the wire queue once written
+    void pop_written(size_t count);
+
+    bool empty() const noexcept { return m_wire.empty() && !pending_bytes(); }
+    size_t pending_bytes(send_priority priority) const noexcept { return m_pending_bytes[size_t(priority)]; }
+    size_t pending_bytes() const noexcept;
+    //! Bytes not yet acknowledged by the socket, committed or pending
+    size_t queued_bytes() const noexcept { return m_wire_bytes + pending_bytes(); }
+
+    //! \return Totals for all connections of the process
+    static stats get_stats();
+
+  private:
+    struct message
+    {
+      byte_slice header;
+      byte_slice body;
+      std::chrono::steady_clock::time_point queued;
+    };
+
+    std::array<std::deque<message>, send_priority_count> m_pending;
+    std::array<size_t, send_priority_count> m_pending_bytes;
+    std::array<size_t, send_priority_count> m_limit;
+    std::deque<byte_slice> m_wire;
+    size_t m_wire_bytes;
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -108,7 +177,8 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    send_queue m_send_que; // slices share their buffers with the caller, nothing is copied on queueing
+    size_t m_send_que_inflight; // number of m_send_que.wire() entries owned by the async_write in progress
     volatile bool m_is_multithreaded;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
@@ -30,6 +30,7 @@
 #define _LEVIN_BASE_H_
 
 #include "net_utils_base.h"
+#include "int-util.h"
 
 #define LEVIN_SIGNATURE  0x0101010101012101LL  //Bender's nightmare
 
@@ -87,6 +88,9 @@ namespace levin
     virtual void on_connection_new(t_connection_context& context){};
     virtual void on_connection_close(t_connection_context& context){};
 
+    //! \return Send class for requests, notifications and responses of `command`
+    virtual net_utils::send_priority get_send_priority(int command) { return net_utils::send_priority::normal; }
+
     virtual ~levin_commands_handler(){}
   };
 
@@ -118,6 +122,20 @@ namespace levin
     }
   }
 
+  //! \return Little-endian `bucket_head2` for a `payload_size` byte body, to be queued in front of it
+  inline
+  byte_slice make_header(uint32_t command, uint64_t payload_size, uint32_t flags, bool expect_response, int32_t return_code = LEVIN_OK)
+  {
+    bucket_head2 head = {0};
+    head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
+    head.m_cb = SWAP64LE(payload_size);
+    head.m_have_to_return_data = expect_response;
+    head.m_command = SWAP32LE(command);
+    head.m_return_code = SWAP32LE(return_code);
+    head.m_flags = SWAP32LE(flags);
+    head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
+    return byte_slice{{epee::as_byte_span(head)}};
+  }
 
 }
 }
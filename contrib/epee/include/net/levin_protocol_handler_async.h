@@ -98,6 +98,7 @@ public:
   int invoke_async(int command, const epee::span<const uint8_t> in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const epee::span<const uint8_t> in_buff, boost::uuids::uuid connection_id);
+  int notify(int command, byte_slice message, boost::uuids::uuid connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -389,7 +390,35 @@ public:
       return false;
     }
 
-    m_cache_in_buffer.append((const char*)ptr, cb);
+    // When nothing is pending from earlier reads, packets are parsed straight
+    // out of the socket buffer; only a trailing partial packet gets copied into
+    // m_cache_in_buffer. The socket buffer is not reused before we return.
+    const bool direct = m_cache_in_buffer.size() == 0;
+    epee::span<const uint8_t> direct_buff{(const uint8_t*)ptr, cb};
+    if (!direct)
+      m_cache_in_buffer.append((const char*)ptr, cb);
+
+    const auto available = [&]() -> size_t
+    {
+      return direct ? direct_buff.size() : m_cache_in_buffer.size();
+    };
+    const auto peek = [&](size_t sz) -> epee::span<const uint8_t>
+    {
+      return direct ? epee::span<const uint8_t>(direct_buff.data(), sz) : m_cache_in_buffer.span(sz);
+    };
+    const auto carve = [&](size_t sz) -> epee::span<const uint8_t>
+    {
+      if (!direct)
+        return m_cache_in_buffer.carve(sz);
+      const epee::span<const uint8_t> out{direct_buff.data(), sz};
+      direct_buff.remove_prefix(sz);
+      return out;
+    };
+    const auto keep_rest = [&]()
+    {
+      if (direct && !direct_buff.empty())
+        m_cache_in_buffer.append(direct_buff.data(), direct_buff.size());
+    };
 
     bool is_continue = true;
     while(is_continue)
@@ -397,7 +426,7 @@ public:
       switch(m_state)
       {
       case stream_state_body:
-        if(m_cache_in_buffer.size() < m_current_head.m_cb)
+        if(available() < m_current_head.m_cb)
         {
           is_continue = false;
           if(cb >= MIN_BYTES_WANTED)
@@ -414,7 +443,7 @@ public:
           break;
         }
         {
-          epee::span<const uint8_t> buff_to_invoke = m_cache_in_buffer.carve((std::string::size_type)m_current_head.m_cb);
+          epee::span<const uint8_t> buff_to_invoke = carve((std::string::size_type)m_current_head.m_cb);
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
@@ -472,21 +501,10 @@ public:
               m_current_head.m_have_to_return_data = false;
               m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
               m_current_head.m_flags = LEVIN_PACKET_RESPONSE;
-#if BYTE_ORDER == LITTLE_ENDIAN
-              std::string send_buff((const char*)&m_current_head, sizeof(m_current_head));
-#else
-              bucket_head2 head = m_current_head;
-              head.m_signature = SWAP64LE(head.m_signature);
-              head.m_cb = SWAP64LE(head.m_cb);
-              head.m_command = SWAP32LE(head.m_command);
-              head.m_return_code = SWAP32LE(head.m_return_code);
-              head.m_flags = SWAP32LE(head.m_flags);
-              head.m_protocol_version = SWAP32LE(head.m_protocol_version);
-              std::string send_buff((const char*)&head, sizeof(head));
-#endif
-              send_buff += return_buff;
               CRITICAL_REGION_BEGIN(m_send_lock);
-              if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
+              // the response body is handed over as is, only the header is built here
+              byte_slice header = make_header(m_current_head.m_command, return_buff.size(), LEVIN_PACKET_RESPONSE, false, m_current_head.m_return_code);
+              if(!m_pservice_endpoint->do_send(std::move(header), byte_slice{std::move(return_buff)}, get_send_priority(m_current_head.m_command)))
                 return false;
               CRITICAL_REGION_END();
               MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << m_current_head.m_cb
@@ -503,9 +521,9 @@ public:
         break;
       case stream_state_head:
         {
-          if(m_cache_in_buffer.size() < sizeof(bucket_head2))
+          if(available() < sizeof(bucket_head2))
           {
-            if(m_cache_in_buffer.size() >= sizeof(uint64_t) && *((uint64_t*)m_cache_in_buffer.span(8).data()) != SWAP64LE(LEVIN_SIGNATURE))
+            if(available() >= sizeof(uint64_t) && *((uint64_t*)peek(8).data()) != SWAP64LE(LEVIN_SIGNATURE))
             {
               MWARNING(m_connection_context << "Signature mismatch, connection will be closed");
               return false;
@@ -515,9 +533,9 @@ public:
           }
 
 #if BYTE_ORDER == LITTLE_ENDIAN
-          bucket_head2& phead = *(bucket_head2*)m_cache_in_buffer.span(sizeof(bucket_head2)).data();
+          bucket_head2& phead = *(bucket_head2*)peek(sizeof(bucket_head2)).data();
 #else
-          bucket_head2 phead = *(bucket_head2*)m_cache_in_buffer.span(sizeof(bucket_head2)).data();
+          bucket_head2 phead = *(bucket_head2*)peek(sizeof(bucket_head2)).data();
           phead.m_signature = SWAP64LE(phead.m_signature);
           phead.m_cb = SWAP64LE(phead.m_cb);
           phead.m_command = SWAP32LE(phead.m_command);
@@ -532,7 +550,10 @@ public:
           }
           m_current_head = phead;
 
-          m_cache_in_buffer.erase(sizeof(bucket_head2));
+          if (direct)
+            direct_buff.remove_prefix(sizeof(bucket_head2));
+          else
+            m_cache_in_buffer.erase(sizeof(bucket_head2));
           m_state = stream_state_body;
           m_oponent_protocol_ver = m_current_head.m_protocol_version;
           if(m_current_head.m_cb > m_config.m_max_packet_size)
@@ -550,6 +571,7 @@ public:
       }
     }
 
+    keep_rest();
     return true;
   }
 
@@ -589,31 +611,16 @@ public:
         break;
       }
 
-      bucket_head2 head = {0};
-      head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
-      head.m_cb = SWAP64LE(in_buff.size());
-      head.m_have_to_return_data = true;
-
-      head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
-      head.m_command = SWAP32LE(command);
-      head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
-
       boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 0);
       CRITICAL_REGION_BEGIN(m_send_lock);
       CRITICAL_REGION_LOCAL1(m_invoke_response_handlers_lock);
-      if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
+      if(!m_pservice_endpoint->do_send(make_header(command, in_buff.size(), LEVIN_PACKET_REQUEST, true), byte_slice{{in_buff}}, get_send_priority(command)))
       {
         LOG_ERROR_CC(m_connection_context, "Failed to do_send");
         err_code = LEVIN_ERROR_CONNECTION;
         break;
       }
 
-      if(!m_pservice_endpoint->do_send(in_buff.data(), in_buff.size()))
-      {
-        err_code = LEVIN_ERROR_CONNECTION_DESTROYED;
-        break;
-      }
-
       if(!add_invoke_response_handler(cb, timeout, *this, command))
       {
         err_code = LEVIN_ERROR_CONNECTION_DESTROYED;
@@ -647,35 +654,20 @@ public:
     if(m_deletion_initiated)
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-    bucket_head2 head = {0};
-    head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
-    head.m_cb = SWAP64LE(in_buff.size());
-    head.m_have_to_return_data = true;
-
-    head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
-    head.m_command = SWAP32LE(command);
-    head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
-
     boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 0);
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-    {
-      LOG_ERROR_CC(m_connection_context, "Failed to do_send");
-      return LEVIN_ERROR_CONNECTION;
-    }
-
-    if(!m_pservice_endpoint->do_send(in_buff.data(), in_buff.size()))
+    if(!m_pservice_endpoint->do_send(make_header(command, in_buff.size(), LEVIN_PACKET_REQUEST, true), byte_slice{{in_buff}}, get_send_priority(command)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send");
       return LEVIN_ERROR_CONNECTION;
     }
     CRITICAL_REGION_END();
 
-    MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
-                            << ", f=" << head.m_flags 
-                            << ", r?=" << head.m_have_to_return_data 
-                            << ", cmd = " << head.m_command 
-                            << ", ver=" << head.m_protocol_version);
+    MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << in_buff.size()
+                            << ", f=" << LEVIN_PACKET_REQUEST
+                            << ", r?=" << true
+                            << ", cmd = " << command
+                            << ", ver=" << LEVIN_PROTOCOL_VER_1);
 
     uint64_t ticks_start = misc_utils::get_tick_count();
     size_t prev_size = 0;
@@ -709,6 +701,14 @@ public:
   }
 
   int notify(int command, const epee::span<const uint8_t> in_buff)
+  {
+    return notify(command, byte_slice{{in_buff}});
+  }
+
+  /*! Sends `message` as the body of a notification. The bytes are queued by
+      reference, so the same (cloned) message can go out on many connections
+      with a single serialization and no copies. */
+  int notify(int command, byte_slice message)
   {
     misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
                           boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -721,38 +721,30 @@ public:
     if(m_deletion_initiated)
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-    bucket_head2 head = {0};
-    head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
-    head.m_have_to_return_data = false;
-    head.m_cb = SWAP64LE(in_buff.size());
-
-    head.m_command = SWAP32LE(command);
-    head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
-    head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
+    const size_t size = message.size();
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-    {
-      LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
-      return -1;
-    }
-
-    if(!m_pservice_endpoint->do_send(in_buff.data(), in_buff.size()))
+    if(!m_pservice_endpoint->do_send(make_header(command, size, LEVIN_PACKET_REQUEST, false), std::move(message), get_send_priority(command)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
       return -1;
     }
     CRITICAL_REGION_END();
-    LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [len=" << head.m_cb <<
-      ", f=" << head.m_flags << 
-      ", r?=" << head.m_have_to_return_data <<
-      ", cmd = " << head.m_command << 
-      ", ver=" << head.m_protocol_version);
+    LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [len=" << size <<
+      ", f=" << LEVIN_PACKET_REQUEST <<
+      ", r?=" << false <<
+      ", cmd = " << command <<
+      ", ver=" << LEVIN_PROTOCOL_VER_1);
 
     return 1;
   }
   //------------------------------------------------------------------------------------------
   boost::uuids::uuid get_connection_id() {return m_connection_context.m_connection_id;}
   //------------------------------------------------------------------------------------------
+  net_utils::send_priority get_send_priority(int command) const
+  {
+    return m_config.m_pcommands_handler ? m_config.m_pcommands_handler->get_send_priority(command) : net_utils::send_priority::normal;
+  }
+  //------------------------------------------------------------------------------------------
   t_connection_context& get_context_ref() {return m_connection_context;}
 };
 //------------------------------------------------------------------------------------------
@@ -906,6 +898,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(int command, byte_slice message, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(command, std::move(message)) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
@@ -29,10 +29,12 @@
 #ifndef _NET_UTILS_BASE_H_
 #define _NET_UTILS_BASE_H_
 
+#include <atomic>
 #include <boost/uuid/uuid.hpp>
 #include <boost/asio/io_service.hpp>
 #include <typeinfo>
 #include <type_traits>
+#include "byte_slice.h"
 #include "enums.h"
 #include "serialization/keyvalue_serialization.h"
 #include "misc_log_ex.h"
@@ -241,6 +243,17 @@ namespace net_utils
 	inline bool operator>=(const network_address& lhs, const network_address& rhs)
 	{ return !lhs.less(rhs); }
 
+	//! Send classes of a connection; queued messages of a higher class go out first
+	enum class send_priority : uint8_t
+	{
+		high = 0, //!< consensus and RTA traffic, pings
+		normal,   //!< relay and everything unclassified
+		bulk      //!< sync data: block and chain responses, pool reconciliation
+	};
+	constexpr const std::size_t send_priority_count = 3;
+
+	const char* to_string(send_priority priority) noexcept;
+
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
@@ -259,6 +272,9 @@ namespace net_utils
     double m_current_speed_up;
     double m_max_speed_down;
     double m_max_speed_up;
+    // written by the connection under its send queue lock, read from the handlers of other threads
+    std::atomic<uint64_t> m_send_queue_bytes; //!< bytes queued for the socket, not yet written
+    std::atomic<bool> m_send_backpressure; //!< peer is not draining its queue, don't start new bulk sends
 
     connection_context_base(boost::uuids::uuid connection_id,
                             const network_address &remote_address, bool is_income, bool ssl,
@@ -276,7 +292,9 @@ namespace net_utils
                                             m_current_speed_down(0),
                                             m_current_speed_up(0),
                                             m_max_speed_down(0),
-                                            m_max_speed_up(0)
+                                            m_max_speed_up(0),
+                                            m_send_queue_bytes(0),
+                                            m_send_backpressure(false)
     {}
 
     connection_context_base(): m_connection_id(),
@@ -291,7 +309,9 @@ namespace net_utils
                                m_current_speed_down(0),
                                m_current_speed_up(0),
                                m_max_speed_down(0),
-                               m_max_speed_up(0)
+                               m_max_speed_up(0),
+                               m_send_queue_bytes(0),
+                               m_send_backpressure(false)
     {}
 
     connection_context_base(const connection_context_base& a): connection_context_base()
@@ -322,6 +342,13 @@ namespace net_utils
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //! queue `message` without copying it; endpoints that can't keep a reference fall back to a copy
+    virtual bool do_send(byte_slice message) { return do_send(message.data(), message.size()); }
+    //! queue `header` and `body` as one message, ahead of queued messages of a lower `priority`
+    virtual bool do_send(byte_slice header, byte_slice body, send_priority priority)
+    {
+      return do_send(std::move(header)) && (body.empty() || do_send(std::move(body)));
+    }
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
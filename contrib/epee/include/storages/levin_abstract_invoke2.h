@@ -44,7 +44,7 @@ namespace epee
       if(!transport.is_connected())
         return false;
 
-      serialization::portable_storage stg;
+      serialization::portable_binary_writer stg;
       out_struct.store(stg);
       std::string buff_to_send, buff_to_recv;
       stg.store_to_binary(buff_to_send);
@@ -55,7 +55,7 @@ namespace epee
         MERROR("Failed to invoke command " << command << " return code " << res);
         return false;
       }
-      serialization::portable_storage stg_ret;
+      serialization::portable_binary_reader stg_ret;
       if(!stg_ret.load_from_binary(buff_to_recv))
       {
         LOG_ERROR("Failed to load_from_binary on command " << command);
@@ -88,7 +88,7 @@ namespace epee
     bool invoke_remote_command2(boost::uuids::uuid conn_id, int command, const t_arg& out_struct, t_result& result_struct, t_transport& transport)
     {
 
-      typename serialization::portable_storage stg;
+      typename serialization::portable_binary_writer stg;
       out_struct.store(stg);
       std::string buff_to_send, buff_to_recv;
       stg.store_to_binary(buff_to_send);
@@ -99,7 +99,7 @@ namespace epee
         LOG_PRINT_L1("Failed to invoke command " << command << " return code " << res);
         return false;
       }
-      typename serialization::portable_storage stg_ret;
+      typename serialization::portable_binary_reader stg_ret;
       if(!stg_ret.load_from_binary(buff_to_recv))
       {
         LOG_ERROR("Failed to load_from_binary on command " << command);
@@ -111,7 +111,7 @@ namespace epee
     template<class t_result, class t_arg, class callback_t, class t_transport>
     bool async_invoke_remote_command2(boost::uuids::uuid conn_id, int command, const t_arg& out_struct, t_transport& transport, const callback_t &cb, size_t inv_timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED)
     {
-      typename serialization::portable_storage stg;
+      typename serialization::portable_binary_writer stg;
       const_cast<t_arg&>(out_struct).store(stg);//TODO: add true const support to searilzation
       std::string buff_to_send;
       stg.store_to_binary(buff_to_send);
@@ -124,7 +124,7 @@ namespace epee
           cb(code, result_struct, context);
           return false;
         }
-        serialization::portable_storage stg_ret;
+        serialization::portable_binary_reader stg_ret;
         if(!stg_ret.load_from_binary(buff))
         {
           LOG_ERROR("Failed to load_from_binary on command " << command);
@@ -152,12 +152,12 @@ namespace epee
     bool notify_remote_command2(boost::uuids::uuid conn_id, int command, const t_arg& out_struct, t_transport& transport)
     {
 
-      serialization::portable_storage stg;
+      serialization::portable_binary_writer stg;
       out_struct.store(stg);
       std::string buff_to_send;
       stg.store_to_binary(buff_to_send);
 
-      int res = transport.notify(command, epee::strspan<uint8_t>(buff_to_send), conn_id);
+      int res = transport.notify(command, epee::byte_slice{std::move(buff_to_send)}, conn_id);
       if(res <=0 )
       {
         MERROR("Failed to notify command " << command << " return code " << res);
@@ -170,7 +170,7 @@ namespace epee
     template<class t_owner, class t_in_type, class t_out_type, class t_context, class callback_t>
     int buff_to_t_adapter(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, callback_t cb, t_context& context )
     {
-      serialization::portable_storage strg;
+      serialization::portable_binary_reader strg;
       if(!strg.load_from_binary(in_buff))
       {
         LOG_ERROR("Failed to load_from_binary in command " << command);
@@ -185,7 +185,7 @@ namespace epee
         return -1;
       }
       int res = cb(command, static_cast<t_in_type&>(in_struct), static_cast<t_out_type&>(out_struct), context);
-      serialization::portable_storage strg_out;
+      serialization::portable_binary_writer strg_out;
       static_cast<t_out_type&>(out_struct).store(strg_out);
 
       if(!strg_out.store_to_binary(buff_out))
@@ -200,7 +200,7 @@ namespace epee
     template<class t_owner, class t_in_type, class t_context, class callback_t>
     int buff_to_t_adapter(t_owner* powner, int command, const epee::span<const uint8_t> in_buff, callback_t cb, t_context& context)
     {
-      serialization::portable_storage strg;
+      serialization::portable_binary_reader strg;
       if(!strg.load_from_binary(in_buff))
       {
         LOG_ERROR("Failed to load_from_binary in notify " << command);
@@ -0,0 +1,662 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "span.h"
+#include "int-util.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_bin.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    template<class t_value> struct portable_type_code;
+    template<> struct portable_type_code<int64_t>     { enum { value = SERIALIZE_TYPE_INT64 }; };
+    template<> struct portable_type_code<int32_t>     { enum { value = SERIALIZE_TYPE_INT32 }; };
+    template<> struct portable_type_code<int16_t>     { enum { value = SERIALIZE_TYPE_INT16 }; };
+    template<> struct portable_type_code<int8_t>      { enum { value = SERIALIZE_TYPE_INT8 }; };
+    template<> struct portable_type_code<uint64_t>    { enum { value = SERIALIZE_TYPE_UINT64 }; };
+    template<> struct portable_type_code<uint32_t>    { enum { value = SERIALIZE_TYPE_UINT32 }; };
+    template<> struct portable_type_code<uint16_t>    { enum { value = SERIALIZE_TYPE_UINT16 }; };
+    template<> struct portable_type_code<uint8_t>     { enum { value = SERIALIZE_TYPE_UINT8 }; };
+    template<> struct portable_type_code<double>      { enum { value = SERIALIZE_TYPE_DUOBLE }; };
+    template<> struct portable_type_code<bool>        { enum { value = SERIALIZE_TYPE_BOOL }; };
+    template<> struct portable_type_code<std::string> { enum { value = SERIALIZE_TYPE_STRING }; };
+
+    /************************************************************************/
+    /* Storage that writes the portable_storage binary format straight     */
+    /* into one buffer while KV_SERIALIZE walks the object, instead of     */
+    /* building a section tree first. Entries are emitted in the order     */
+    /* they are stored (the tree writer sorts them by name), which every   */
+    /* reader accepts. Handles must be used in nesting order, as the       */
+    /* KV_SERIALIZE overloads do: touching a parent closes its children.   */
+    /************************************************************************/
+    class portable_binary_writer
+    {
+      struct frame
+      {
+        size_t m_count_pos;   //offset of the one byte reserved for the varint count
+        size_t m_count;
+        uint8_t m_array_type; //0 for sections
+      };
+
+      struct buffer_stream
+      {
+        std::string& m_buff;
+        void write(const char* data, size_t size) { m_buff.append(data, size); }
+      };
+
+    public:
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      explicit portable_binary_writer(size_t size_hint = 0);
+
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       set_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      bool       set_value(const std::string& value_name, const storage_entry& target, hsection hparent_section);
+
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool          insert_next_value(harray hval_array, const t_value& target);
+      harray insert_first_section(const std::string& pSectionName, hsection& hinserted_childsection, hsection hparent_section);
+      bool            insert_next_section(harray hSecArray, hsection& hinserted_childsection);
+
+      //closes all open sections and hands the buffer over, the writer is empty afterwards
+      bool		store_to_binary(binarybuffer& target);
+
+    private:
+      void enter(frame* pframe);
+      void close_back();
+      void write_name(const std::string& name);
+      void write_type(uint8_t type) { m_buff.push_back(static_cast<char>(type)); }
+      frame* push_frame(uint8_t array_type);
+      template<class t_value>
+      void write_raw(const t_value& v) { m_buff.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+      void write_raw(const std::string& v) { buffer_stream bs{m_buff}; put_string(bs, v); }
+
+      std::string m_buff;
+      std::deque<frame> m_frames;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_binary_writer::portable_binary_writer(size_t size_hint)
+    {
+      m_buff.reserve(size_hint ? size_hint : 256);
+      const uint32_t signature_a = SWAP32LE(PORTABLE_STORAGE_SIGNATUREA);
+      const uint32_t signature_b = SWAP32LE(PORTABLE_STORAGE_SIGNATUREB);
+      write_raw(signature_a);
+      write_raw(signature_b);
+      write_type(PORTABLE_STORAGE_FORMAT_VER);
+      push_frame(0);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_binary_writer::frame* portable_binary_writer::push_frame(uint8_t array_type)
+    {
+      m_frames.push_back(frame{m_buff.size(), 0, array_type});
+      m_buff.push_back(0);
+      return &m_frames.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_binary_writer::close_back()
+    {
+      const frame& f = m_frames.back();
+      std::string count;
+      buffer_stream bs{count};
+      pack_varint(bs, f.m_count);
+      if(count.size() > 1)
+        m_buff.insert(f.m_count_pos + 1, count.size() - 1, '\0');
+      memcpy(&m_buff[f.m_count_pos], count.data(), count.size());
+      m_frames.pop_back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_binary_writer::enter(frame* pframe)
+    {
+      CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "portable_binary_writer: storage already stored");
+      if(!pframe)
+        pframe = &m_frames.front();
+      while(&m_frames.back() != pframe)
+      {
+        CHECK_AND_ASSERT_THROW_MES(m_frames.size() > 1, "portable_binary_writer: handle used after its section was closed");
+        close_back();
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_binary_writer::write_name(const std::string& name)
+    {
+      CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size() << ", val: " << name);
+      m_buff.push_back(static_cast<char>(name.size()));
+      m_buff.append(name);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_binary_writer::hsection portable_binary_writer::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(create_if_notexist, nullptr, "portable_binary_writer can only create sections");
+      enter(hparent_section);
+      ++m_frames.back().m_count;
+      write_name(section_name);
+      write_type(SERIALIZE_TYPE_OBJECT);
+      return push_frame(0);
+      CATCH_ENTRY("portable_binary_writer::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_binary_writer::set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      enter(hparent_section);
+      ++m_frames.back().m_count;
+      write_name(value_name);
+      write_type(portable_type_code<t_value>::value);
+      write_raw(v);
+      return true;
+      CATCH_ENTRY("portable_binary_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_writer::set_value(const std::string& value_name, const storage_entry& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      enter(hparent_section);
+      ++m_frames.back().m_count;
+      write_name(value_name);
+      buffer_stream bs{m_buff};
+      return pack_entry_to_buff(bs, v);
+      CATCH_ENTRY("portable_binary_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_binary_writer::harray portable_binary_writer::insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      enter(hparent_section);
+      ++m_frames.back().m_count;
+      write_name(value_name);
+      write_type(portable_type_code<t_value>::value | SERIALIZE_FLAG_ARRAY);
+      frame* parray = push_frame(portable_type_code<t_value>::value);
+      write_raw(target);
+      ++parray->m_count;
+      return parray;
+      CATCH_ENTRY("portable_binary_writer::insert_first_value", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_binary_writer::insert_next_value(harray hval_array, const t_value& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hval_array, false);
+      enter(hval_array);
+      CHECK_AND_ASSERT_MES(hval_array->m_array_type == portable_type_code<t_value>::value,
+        false, "unexpected type in insert_next_value: " << typeid(t_value).name());
+      write_raw(target);
+      ++hval_array->m_count;
+      return true;
+      CATCH_ENTRY("portable_binary_writer::insert_next_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_binary_writer::harray portable_binary_writer::insert_first_section(const std::string& sec_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      enter(hparent_section);
+      ++m_frames.back().m_count;
+      write_name(sec_name);
+      write_type(SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY);
+      frame* parray = push_frame(SERIALIZE_TYPE_OBJECT);
+      ++parray->m_count;
+      hinserted_childsection = push_frame(0);
+      return parray;
+      CATCH_ENTRY("portable_binary_writer::insert_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      enter(hsec_array);
+      CHECK_AND_ASSERT_MES(hsec_array->m_array_type == SERIALIZE_TYPE_OBJECT,
+        false, "unexpected type(not 'section') in insert_next_section");
+      ++hsec_array->m_count;
+      hinserted_childsection = push_frame(0);
+      return true;
+      CATCH_ENTRY("portable_binary_writer::insert_next_section", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_writer::store_to_binary(binarybuffer& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(!m_frames.empty(), false, "portable_binary_writer: storage already stored");
+      while(!m_frames.empty())
+        close_back();
+      target = std::move(m_buff);
+      m_buff.clear();
+      return true;
+      CATCH_ENTRY("portable_binary_writer::store_to_binary", false);
+    }
+
+    /************************************************************************/
+    /* Storage that loads KV_SERIALIZE objects directly from a binary      */
+    /* blob. The blob is validated once on load; after that a section is   */
+    /* only indexed (name -> offset) when it is opened, and values are     */
+    /* decoded straight into the target fields. The blob must outlive the  */
+    /* reader.                                                             */
+    /************************************************************************/
+    class portable_binary_reader
+    {
+      struct entry_ref
+      {
+        const char* m_name;
+        uint8_t m_name_size;
+        uint8_t m_type;
+        size_t m_offset; //offset of the value, right after the type byte
+      };
+
+      struct section_ref
+      {
+        std::vector<entry_ref> m_entries;
+      };
+
+      struct array_ref
+      {
+        uint8_t m_type;
+        size_t m_remaining;
+        size_t m_offset;
+        section_ref* m_child;
+        size_t m_sections_mark;
+        size_t m_arrays_mark;
+      };
+
+    public:
+      typedef section_ref* hsection;
+      typedef array_ref* harray;
+      typedef storage_entry meta_entry;
+
+      portable_binary_reader(): m_data(nullptr), m_size(0) {}
+
+      bool       load_from_binary(const epee::span<const uint8_t> source);
+      bool       load_from_binary(const std::string& source) { return load_from_binary(epee::strspan<uint8_t>(source)); }
+
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool       get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool          get_next_value(harray hval_array, t_value& target);
+      harray get_first_section(const std::string& pSectionName, hsection& h_child_section, hsection hparent_section);
+      bool            get_next_section(harray hSecArray, hsection& h_child_section);
+
+    private:
+      void need(size_t offset, size_t count) const;
+      size_t read_varint(size_t& offset) const;
+      size_t skip_value(uint8_t type, size_t offset, size_t depth) const;
+      size_t skip_section(size_t offset, size_t depth) const;
+      size_t index_section(section_ref& sec, size_t offset) const;
+      const entry_ref* find(const std::string& name, hsection hparent_section) const;
+      bool open_array(const entry_ref& entry, uint8_t& type, size_t& count, size_t& offset) const;
+      void load_string(size_t offset, std::string& target) const;
+      template<class t_value>
+      void load_string(size_t offset, t_value& target) const { std::string s; load_string(offset, s); convert_t(s, target); }
+      template<class t_pod_type>
+      t_pod_type load_pod(size_t offset) const { t_pod_type v; need(offset, sizeof(v)); memcpy(&v, m_data + offset, sizeof(v)); return v; }
+      template<class t_value>
+      void load_value(uint8_t type, size_t offset, t_value& target) const;
+
+      const uint8_t* m_data;
+      size_t m_size;
+      std::deque<section_ref> m_sections;
+      std::deque<array_ref> m_arrays;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_binary_reader::need(size_t offset, size_t count) const
+    {
+      CHECK_AND_ASSERT_THROW_MES(offset <= m_size && count <= m_size - offset, " attempt to read " << count << " bytes from buffer with " << (m_size - std::min(offset, m_size)) << " bytes remained");
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_binary_reader::read_varint(size_t& offset) const
+    {
+      need(offset, 1);
+      size_t v = 0;
+      switch(m_data[offset] & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE: v = load_pod<uint8_t>(offset); offset += 1; break;
+      case PORTABLE_RAW_SIZE_MARK_WORD: v = load_pod<uint16_t>(offset); offset += 2; break;
+      case PORTABLE_RAW_SIZE_MARK_DWORD: v = load_pod<uint32_t>(offset); offset += 4; break;
+      default: v = load_pod<uint64_t>(offset); offset += 8; break;
+      }
+      return v >> 2;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_binary_reader::skip_value(uint8_t type, size_t offset, size_t depth) const
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      if(type == SERIALIZE_TYPE_ARRAY)
+      {
+        need(offset, 1);
+        type = m_data[offset++];
+        CHECK_AND_ASSERT_THROW_MES(type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+      }
+      size_t count = 1;
+      if(type & SERIALIZE_FLAG_ARRAY)
+      {
+        type &= ~SERIALIZE_FLAG_ARRAY;
+        count = read_varint(offset);
+        CHECK_AND_ASSERT_THROW_MES(count <= m_size - offset, "Size sanity check failed");
+      }
+      size_t pod_size = 0;
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64: case SERIALIZE_TYPE_UINT64: case SERIALIZE_TYPE_DUOBLE: pod_size = 8; break;
+      case SERIALIZE_TYPE_INT32: case SERIALIZE_TYPE_UINT32: pod_size = 4; break;
+      case SERIALIZE_TYPE_INT16: case SERIALIZE_TYPE_UINT16: pod_size = 2; break;
+      case SERIALIZE_TYPE_INT8: case SERIALIZE_TYPE_UINT8: case SERIALIZE_TYPE_BOOL: pod_size = 1; break;
+      case SERIALIZE_TYPE_STRING:
+        while(count--)
+        {
+          const size_t len = read_varint(offset);
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          need(offset, len);
+          offset += len;
+        }
+        return offset;
+      case SERIALIZE_TYPE_OBJECT:
+        while(count--)
+          offset = skip_section(offset, depth + 1);
+        return offset;
+      case SERIALIZE_TYPE_ARRAY:
+        CHECK_AND_ASSERT_THROW_MES(false, "Reading array entry is not supported");
+      default:
+        CHECK_AND_ASSERT_THROW_MES(false, "unknown entry_type code = " << (unsigned)type);
+      }
+      CHECK_AND_ASSERT_THROW_MES(count <= (m_size - offset) / pod_size, "Size sanity check failed");
+      return offset + count * pod_size;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_binary_reader::skip_section(size_t offset, size_t depth) const
+    {
+      size_t count = read_varint(offset);
+      while(count--)
+      {
+        need(offset, 1);
+        offset += 1 + m_data[offset];
+        need(offset, 1);
+        const uint8_t type = m_data[offset++];
+        offset = skip_value(type, offset, depth);
+      }
+      return offset;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_binary_reader::index_section(section_ref& sec, size_t offset) const
+    {
+      sec.m_entries.clear();
+      size_t count = read_varint(offset);
+      sec.m_entries.reserve(std::min<size_t>(count, 64));
+      while(count--)
+      {
+        entry_ref e;
+        need(offset, 1);
+        e.m_name_size = m_data[offset++];
+        need(offset, e.m_name_size + 1);
+        e.m_name = reinterpret_cast<const char*>(m_data + offset);
+        offset += e.m_name_size;
+        e.m_type = m_data[offset++];
+        e.m_offset = offset;
+        offset = skip_value(e.m_type, offset, 0);
+        sec.m_entries.push_back(e);
+      }
+      return offset;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_reader::load_from_binary(const epee::span<const uint8_t> source)
+    {
+      m_data = nullptr;
+      m_size = 0;
+      m_sections.clear();
+      m_arrays.clear();
+      const size_t header_size = 2 * sizeof(uint32_t) + 1;
+      if(source.size() < header_size)
+      {
+        LOG_ERROR("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << header_size);
+        return false;
+      }
+      uint32_t signature_a, signature_b;
+      memcpy(&signature_a, source.data(), sizeof(signature_a));
+      memcpy(&signature_b, source.data() + sizeof(signature_a), sizeof(signature_b));
+      if(signature_a != SWAP32LE(PORTABLE_STORAGE_SIGNATUREA) ||
+        signature_b != SWAP32LE(PORTABLE_STORAGE_SIGNATUREB)
+        )
+      {
+        LOG_ERROR("portable_storage: wrong binary format - signature mismatch");
+        return false;
+      }
+      if(source.data()[header_size - 1] != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage: wrong binary format - unknown format ver = " << source.data()[header_size - 1]);
+        return false;
+      }
+      TRY_ENTRY();
+      m_data = source.data() + header_size;
+      m_size = source.size() - header_size;
+      skip_section(0, 0);
+      m_sections.emplace_back();
+      index_section(m_sections.back(), 0);
+      return true;
+      CATCH_ENTRY("portable_binary_reader::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_binary_reader::entry_ref* portable_binary_reader::find(const std::string& name, hsection hparent_section) const
+    {
+      if(m_sections.empty())
+        return nullptr;
+      const section_ref& sec = hparent_section ? *hparent_section : m_sections.front();
+      for(const entry_ref& e: sec.m_entries)
+      {
+        if(e.m_name_size == name.size() && memcmp(e.m_name, name.data(), name.size()) == 0)
+          return &e;
+      }
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_reader::open_array(const entry_ref& entry, uint8_t& type, size_t& count, size_t& offset) const
+    {
+      type = entry.m_type;
+      offset = entry.m_offset;
+      if(type == SERIALIZE_TYPE_ARRAY)
+        type = m_data[offset++];
+      if(!(type & SERIALIZE_FLAG_ARRAY))
+        return false;
+      type &= ~SERIALIZE_FLAG_ARRAY;
+      count = read_varint(offset);
+      return count != 0;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_binary_reader::load_string(size_t offset, std::string& target) const
+    {
+      const size_t len = read_varint(offset);
+      need(offset, len);
+      target.assign(reinterpret_cast<const char*>(m_data + offset), len);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_binary_reader::load_value(uint8_t type, size_t offset, t_value& target) const
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  convert_t(load_pod<int64_t>(offset), target); break;
+      case SERIALIZE_TYPE_INT32:  convert_t(load_pod<int32_t>(offset), target); break;
+      case SERIALIZE_TYPE_INT16:  convert_t(load_pod<int16_t>(offset), target); break;
+      case SERIALIZE_TYPE_INT8:   convert_t(load_pod<int8_t>(offset), target); break;
+      case SERIALIZE_TYPE_UINT64: convert_t(load_pod<uint64_t>(offset), target); break;
+      case SERIALIZE_TYPE_UINT32: convert_t(load_pod<uint32_t>(offset), target); break;
+      case SERIALIZE_TYPE_UINT16: convert_t(load_pod<uint16_t>(offset), target); break;
+      case SERIALIZE_TYPE_UINT8:  convert_t(load_pod<uint8_t>(offset), target); break;
+      case SERIALIZE_TYPE_DUOBLE: convert_t(load_pod<double>(offset), target); break;
+      case SERIALIZE_TYPE_BOOL:   convert_t(load_pod<bool>(offset), target); break;
+      case SERIALIZE_TYPE_STRING: load_string(offset, target); break;
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from type code=" << (unsigned)type << " to type " << typeid(target).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_binary_reader::hsection portable_binary_reader::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      const entry_ref* pentry = find(section_name, hparent_section);
+      if(!pentry || pentry->m_type != SERIALIZE_TYPE_OBJECT)
+        return nullptr;
+      m_sections.emplace_back();
+      index_section(m_sections.back(), pentry->m_offset);
+      return &m_sections.back();
+      CATCH_ENTRY("portable_binary_reader::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_binary_reader::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      const entry_ref* pentry = find(value_name, hparent_section);
+      if(!pentry)
+        return false;
+      load_value(pentry->m_type, pentry->m_offset, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_reader::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const entry_ref* pentry = find(value_name, hparent_section);
+      if(!pentry)
+        return false;
+      throwable_buffer_reader buf_reader(m_data + pentry->m_offset - 1, m_size - pentry->m_offset + 1);
+      val = buf_reader.load_storage_entry();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_binary_reader::harray portable_binary_reader::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      const entry_ref* pentry = find(value_name, hparent_section);
+      if(!pentry)
+        return nullptr;
+      array_ref arr = array_ref();
+      if(!open_array(*pentry, arr.m_type, arr.m_remaining, arr.m_offset))
+        return nullptr;
+      load_value(arr.m_type, arr.m_offset, target);
+      arr.m_offset = skip_value(arr.m_type, arr.m_offset, 0);
+      --arr.m_remaining;
+      m_arrays.push_back(arr);
+      return &m_arrays.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_binary_reader::get_next_value(harray hval_array, t_value& target)
+    {
+      CHECK_AND_ASSERT(hval_array, false);
+      if(!hval_array->m_remaining)
+        return false;
+      load_value(hval_array->m_type, hval_array->m_offset, target);
+      hval_array->m_offset = skip_value(hval_array->m_type, hval_array->m_offset, 0);
+      --hval_array->m_remaining;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_binary_reader::harray portable_binary_reader::get_first_section(const std::string& sec_name, hsection& h_child_section, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      const entry_ref* pentry = find(sec_name, hparent_section);
+      if(!pentry)
+        return nullptr;
+      array_ref arr = array_ref();
+      if(!open_array(*pentry, arr.m_type, arr.m_remaining, arr.m_offset) || arr.m_type != SERIALIZE_TYPE_OBJECT)
+        return nullptr;
+      m_sections.emplace_back();
+      arr.m_child = &m_sections.back();
+      arr.m_offset = index_section(*arr.m_child, arr.m_offset);
+      --arr.m_remaining;
+      arr.m_sections_mark = m_sections.size();
+      m_arrays.push_back(arr);
+      m_arrays.back().m_arrays_mark = m_arrays.size();
+      h_child_section = arr.m_child;
+      return &m_arrays.back();
+      CATCH_ENTRY("portable_binary_reader::get_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_binary_reader::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      if(hsec_array->m_type != SERIALIZE_TYPE_OBJECT || !hsec_array->m_remaining)
+        return false;
+      //everything opened while reading the previous element is dead now
+      while(m_sections.size() > hsec_array->m_sections_mark)
+        m_sections.pop_back();
+      while(m_arrays.size() > hsec_array->m_arrays_mark)
+        m_arrays.pop_back();
+      hsec_array->m_offset = index_section(*hsec_array->m_child, hsec_array->m_offset);
+      --hsec_array->m_remaining;
+      h_child_section = hsec_array->m_child;
+      return true;
+      CATCH_ENTRY("portable_binary_reader::get_next_section", false);
+    }
+  }
+}
@@ -72,6 +72,9 @@ namespace
 		CHECK_AND_ASSERT_THROW_MES(state != nullptr, "state shared_ptr cannot be null");
 		return state->ssl_context;
 	}
+
+	critical_section send_stats_lock;
+	send_queue::stats send_stats{};
 }
 
   std::string to_string(t_connection_type type)
@@ -120,6 +123,100 @@ namespace net_utils
 	
 connection_basic_pimpl::connection_basic_pimpl(const std::string &name) : m_throttle(name), m_peer_number(0) { }
 
+// ================================================================================================
+// send_queue
+// ================================================================================================
+
+send_queue::send_queue()
+  : m_pending(),
+    m_pending_bytes(),
+    m_limit(),
+    m_wire(),
+    m_wire_bytes(0)
+{}
+
+bool send_queue::push(byte_slice header, byte_slice body, send_priority priority)
+{
+	const size_t cls = size_t(priority);
+	CHECK_AND_ASSERT_THROW_MES(cls < send_priority_count, "invalid send priority");
+	const size_t bytes = header.size() + body.size();
+	if (!bytes)
+		return true;
+
+	if (m_limit[cls] && m_pending_bytes[cls] && m_pending_bytes[cls] + bytes > m_limit[cls])
+	{
+		CRITICAL_REGION_LOCAL(send_stats_lock);
+		++send_stats[cls].dropped;
+		return false;
+	}
+
+	m_pending[cls].push_back(message{std::move(header), std::move(body), std::chrono::steady_clock::now()});
+	m_pending_bytes[cls] += bytes;
+	return true;
+}
+
+bool send_queue::fill(const size_t low_water, const size_t chunk_size)
+{
+	const auto now = std::chrono::steady_clock::now();
+	for (size_t cls = 0; cls < send_priority_count && m_wire_bytes < low_water; )
+	{
+		if (m_pending[cls].empty())
+		{
+			++cls;
+			continue;
+		}
+
+		message next = std::move(m_pending[cls].front());
+		m_pending[cls].pop_front();
+		const size_t bytes = next.header.size() + next.body.size();
+		m_pending_bytes[cls] -= bytes;
+		m_wire_bytes += bytes;
+
+		if (!next.header.empty())
+			m_wire.push_back(std::move(next.header));
+		if (chunk_size)
+		{
+			while (!next.body.empty())
+				m_wire.push_back(next.body.take_slice(chunk_size));
+		}
+		else if (!next.body.empty())
+			m_wire.push_back(std::move(next.body));
+
+		const uint64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(now - next.queued).count();
+		CRITICAL_REGION_LOCAL(send_stats_lock);
+		class_stats& stats = send_stats[cls];
+		++stats.messages;
+		stats.bytes += bytes;
+		stats.wait_us_total += wait_us;
+		stats.wait_us_max = std::max(stats.wait_us_max, wait_us);
+	}
+	return !m_wire.empty();
+}
+
+void send_queue::pop_written(const size_t count)
+{
+	CHECK_AND_ASSERT_THROW_MES(count <= m_wire.size(), "more slices written than queued");
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_wire_bytes -= m_wire.front().size();
+		m_wire.pop_front();
+	}
+}
+
+size_t send_queue::pending_bytes() const noexcept
+{
+	size_t bytes = 0;
+	for (const size_t class_bytes: m_pending_bytes)
+		bytes += class_bytes;
+	return bytes;
+}
+
+send_queue::stats send_queue::get_stats()
+{
+	CRITICAL_REGION_LOCAL(send_stats_lock);
+	return send_stats;
+}
+
 // ================================================================================================
 // connection_basic
 // ================================================================================================
@@ -136,6 +233,7 @@ connection_basic::connection_basic(boost::asio::ip::tcp::socket&& sock, boost::s
 	socket_(GET_IO_SERVICE(sock), get_context(m_state.get())),
 	m_want_close_connection(false),
 	m_was_shutdown(false),
+	m_send_que_inflight(0),
 	m_ssl_support(ssl_support)
 {
 	// add nullptr checks if removed
@@ -160,6 +258,7 @@ connection_basic::connection_basic(boost::asio::io_service &io_service, boost::s
 	socket_(io_service, get_context(m_state.get())),
 	m_want_close_connection(false),
 	m_was_shutdown(false),
+	m_send_que_inflight(0),
 	m_ssl_support(ssl_support)
 {
 	// add nullptr checks if removed
@@ -70,6 +70,22 @@ namespace epee { namespace net_utils
     return ss.str();
   }
 
+  const char* to_string(send_priority priority) noexcept
+  {
+    switch (priority)
+    {
+    case send_priority::high:
+      return "high";
+    case send_priority::normal:
+      return "normal";
+    case send_priority::bulk:
+      return "bulk";
+    default:
+      break;
+    }
+    return "invalid";
+  }
+
   const char* zone_to_string(zone value) noexcept
   {
     switch (value)
@@ -0,0 +1,978 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "crypto-ops-fe51.h"
+
+#if CRYPTO_OPS_HAVE_FE51
+
+/*
+The point formulas and scalar recodings below are the ref10 ones from
+crypto-ops.c, step for step; only the field element representation differs.
+Inputs and outputs are ref10 structures so callers cannot tell the backends
+apart: every encoded point is identical, only the projective coordinates of
+intermediate results may differ.
+
+Limb bounds: fe51_mul and fe51_sq take limbs below 2^54 and return limbs
+below 2^51 + 2^15; fe51_add does not carry, fe51_sub carries its subtrahend
+first so it is safe on any output of the other functions.
+*/
+
+typedef unsigned __int128 uint128_t;
+
+#define FE51_MASK ((((uint64_t) 1) << 51) - 1)
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+} ge51_p2;
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+  fe51 T;
+} ge51_p3;
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+  fe51 T;
+} ge51_p1p1;
+
+typedef struct {
+  fe51 YplusX;
+  fe51 YminusX;
+  fe51 Z;
+  fe51 T2d;
+} ge51_cached;
+
+typedef ge51_cached ge51_dsmp[8];
+
+/* Field arithmetic */
+
+static uint64_t load_8(const unsigned char *in) {
+  uint64_t result;
+  result = (uint64_t) in[0];
+  result |= ((uint64_t) in[1]) << 8;
+  result |= ((uint64_t) in[2]) << 16;
+  result |= ((uint64_t) in[3]) << 24;
+  result |= ((uint64_t) in[4]) << 32;
+  result |= ((uint64_t) in[5]) << 40;
+  result |= ((uint64_t) in[6]) << 48;
+  result |= ((uint64_t) in[7]) << 56;
+  return result;
+}
+
+static void store_8(unsigned char *out, uint64_t in) {
+  int i;
+  for (i = 0; i < 8; ++i) {
+    out[i] = (unsigned char) (in >> (8 * i));
+  }
+}
+
+static void fe51_0(fe51 h) {
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+static void fe51_1(fe51 h) {
+  h[0] = 1;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+static void fe51_copy(fe51 h, const fe51 f) {
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+static void fe51_add(fe51 h, const fe51 f, const fe51 g) {
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+}
+
+/* h = f - g, computed as f + 2p - g after carrying g below 2p limb by limb */
+static void fe51_sub(fe51 h, const fe51 f, const fe51 g) {
+  uint64_t g0 = g[0];
+  uint64_t g1 = g[1];
+  uint64_t g2 = g[2];
+  uint64_t g3 = g[3];
+  uint64_t g4 = g[4];
+
+  g1 += g0 >> 51; g0 &= FE51_MASK;
+  g2 += g1 >> 51; g1 &= FE51_MASK;
+  g3 += g2 >> 51; g2 &= FE51_MASK;
+  g4 += g3 >> 51; g3 &= FE51_MASK;
+  g0 += 19 * (g4 >> 51); g4 &= FE51_MASK;
+
+  h[0] = (f[0] + 0xfffffffffffdaULL) - g0;
+  h[1] = (f[1] + 0xffffffffffffeULL) - g1;
+  h[2] = (f[2] + 0xffffffffffffeULL) - g2;
+  h[3] = (f[3] + 0xffffffffffffeULL) - g3;
+  h[4] = (f[4] + 0xffffffffffffeULL) - g4;
+}
+
+static void fe51_neg(fe51 h, const fe51 f) {
+  fe51 zero;
+  fe51_0(zero);
+  fe51_sub(h, zero, f);
+}
+
+static void fe51_cmov(fe51 f, const fe51 g, unsigned int b) {
+  uint64_t mask = (uint64_t) 0 - (uint64_t) b;
+  f[0] ^= mask & (f[0] ^ g[0]);
+  f[1] ^= mask & (f[1] ^ g[1]);
+  f[2] ^= mask & (f[2] ^ g[2]);
+  f[3] ^= mask & (f[3] ^ g[3]);
+  f[4] ^= mask & (f[4] ^ g[4]);
+}
+
+static void fe51_carry(fe51 h, uint128_t r0, uint128_t r1, uint128_t r2, uint128_t r3, uint128_t r4) {
+  uint64_t h0, h1, h2, h3, h4, carry;
+
+  r1 += (uint64_t) (r0 >> 51); h0 = (uint64_t) r0 & FE51_MASK;
+  r2 += (uint64_t) (r1 >> 51); h1 = (uint64_t) r1 & FE51_MASK;
+  r3 += (uint64_t) (r2 >> 51); h2 = (uint64_t) r2 & FE51_MASK;
+  r4 += (uint64_t) (r3 >> 51); h3 = (uint64_t) r3 & FE51_MASK;
+  carry = (uint64_t) (r4 >> 51); h4 = (uint64_t) r4 & FE51_MASK;
+  h0 += 19 * carry;
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+static void fe51_mul(fe51 h, const fe51 f, const fe51 g) {
+  uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+  uint128_t r0, r1, r2, r3, r4;
+
+  r0 = (uint128_t) f0 * g0 + (uint128_t) f1 * g4_19 + (uint128_t) f2 * g3_19 + (uint128_t) f3 * g2_19 + (uint128_t) f4 * g1_19;
+  r1 = (uint128_t) f0 * g1 + (uint128_t) f1 * g0 + (uint128_t) f2 * g4_19 + (uint128_t) f3 * g3_19 + (uint128_t) f4 * g2_19;
+  r2 = (uint128_t) f0 * g2 + (uint128_t) f1 * g1 + (uint128_t) f2 * g0 + (uint128_t) f3 * g4_19 + (uint128_t) f4 * g3_19;
+  r3 = (uint128_t) f0 * g3 + (uint128_t) f1 * g2 + (uint128_t) f2 * g1 + (uint128_t) f3 * g0 + (uint128_t) f4 * g4_19;
+  r4 = (uint128_t) f0 * g4 + (uint128_t) f1 * g3 + (uint128_t) f2 * g2 + (uint128_t) f3 * g1 + (uint128_t) f4 * g0;
+
+  fe51_carry(h, r0, r1, r2, r3, r4);
+}
+
+static void fe51_sq(fe51 h, const fe51 f) {
+  uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+  uint64_t f1_38 = 38 * f1, f2_38 = 38 * f2, f3_38 = 38 * f3;
+  uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+  uint128_t r0, r1, r2, r3, r4;
+
+  r0 = (uint128_t) f0 * f0 + (uint128_t) f1_38 * f4 + (uint128_t) f2_38 * f3;
+  r1 = (uint128_t) f0_2 * f1 + (uint128_t) f2_38 * f4 + (uint128_t) f3_19 * f3;
+  r2 = (uint128_t) f0_2 * f2 + (uint128_t) f1 * f1 + (uint128_t) f3_38 * f4;
+  r3 = (uint128_t) f0_2 * f3 + (uint128_t) f1_2 * f2 + (uint128_t) f4_19 * f4;
+  r4 = (uint128_t) f0_2 * f4 + (uint128_t) f1_2 * f3 + (uint128_t) f2 * f2;
+
+  fe51_carry(h, r0, r1, r2, r3, r4);
+}
+
+/* h = 2 * f * f */
+static void fe51_sq2(fe51 h, const fe51 f) {
+  fe51_sq(h, f);
+  fe51_add(h, h, h);
+}
+
+/* Fully reduces f into [0, p) with every limb below 2^51 */
+static void fe51_reduce(fe51 h, const fe51 f) {
+  uint64_t h0 = f[0], h1 = f[1], h2 = f[2], h3 = f[3], h4 = f[4];
+  uint64_t q;
+
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h2 += h1 >> 51; h1 &= FE51_MASK;
+  h3 += h2 >> 51; h2 &= FE51_MASK;
+  h4 += h3 >> 51; h3 &= FE51_MASK;
+  h0 += 19 * (h4 >> 51); h4 &= FE51_MASK;
+
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h2 += h1 >> 51; h1 &= FE51_MASK;
+  h3 += h2 >> 51; h2 &= FE51_MASK;
+  h4 += h3 >> 51; h3 &= FE51_MASK;
+  h0 += 19 * (h4 >> 51); h4 &= FE51_MASK;
+
+  /* Now h < 2^255 + 19 < 2p, so q = floor((h + 19) / 2^255) is h >= p */
+  q = (h0 + 19) >> 51;
+  q = (h1 + q) >> 51;
+  q = (h2 + q) >> 51;
+  q = (h3 + q) >> 51;
+  q = (h4 + q) >> 51;
+
+  h0 += 19 * q;
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h2 += h1 >> 51; h1 &= FE51_MASK;
+  h3 += h2 >> 51; h2 &= FE51_MASK;
+  h4 += h3 >> 51; h3 &= FE51_MASK;
+  h4 &= FE51_MASK;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/* Ignores the top bit, like fe_frombytes */
+static void fe51_frombytes(fe51 h, const unsigned char *s) {
+  h[0] = load_8(s) & FE51_MASK;
+  h[1] = (load_8(s + 6) >> 3) & FE51_MASK;
+  h[2] = (load_8(s + 12) >> 6) & FE51_MASK;
+  h[3] = (load_8(s + 19) >> 1) & FE51_MASK;
+  h[4] = (load_8(s + 24) >> 12) & FE51_MASK;
+}
+
+static void fe51_tobytes(unsigned char *s, const fe51 f) {
+  fe51 t;
+  fe51_reduce(t, f);
+  store_8(s, t[0] | (t[1] << 51));
+  store_8(s + 8, (t[1] >> 13) | (t[2] << 38));
+  store_8(s + 16, (t[2] >> 26) | (t[3] << 25));
+  store_8(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static int fe51_isnegative(const fe51 f) {
+  unsigned char s[32];
+  fe51_tobytes(s, f);
+  return s[0] & 1;
+}
+
+static int fe51_isnonzero(const fe51 f) {
+  fe51 t;
+  fe51_reduce(t, f);
+  return (t[0] | t[1] | t[2] | t[3] | t[4]) != 0;
+}
+
+/*
+ref10 limbs alternate 26 and 25 bits, so limbs 2i and 2i+1 together cover
+exactly the bits of 51-bit limb i. ref10 limbs are signed and only loosely
+bounded (well under 2^28), hence the 16p added before carrying.
+*/
+static void fe51_from_fe(fe51 h, const fe f) {
+  int64_t l0 = (int64_t) f[0] + (int64_t) f[1] * ((int64_t) 1 << 26);
+  int64_t l1 = (int64_t) f[2] + (int64_t) f[3] * ((int64_t) 1 << 26);
+  int64_t l2 = (int64_t) f[4] + (int64_t) f[5] * ((int64_t) 1 << 26);
+  int64_t l3 = (int64_t) f[6] + (int64_t) f[7] * ((int64_t) 1 << 26);
+  int64_t l4 = (int64_t) f[8] + (int64_t) f[9] * ((int64_t) 1 << 26);
+  uint64_t h0 = (uint64_t) (l0 + 0x7ffffffffffed0LL);
+  uint64_t h1 = (uint64_t) (l1 + 0x7ffffffffffff0LL);
+  uint64_t h2 = (uint64_t) (l2 + 0x7ffffffffffff0LL);
+  uint64_t h3 = (uint64_t) (l3 + 0x7ffffffffffff0LL);
+  uint64_t h4 = (uint64_t) (l4 + 0x7ffffffffffff0LL);
+
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h2 += h1 >> 51; h1 &= FE51_MASK;
+  h3 += h2 >> 51; h2 &= FE51_MASK;
+  h4 += h3 >> 51; h3 &= FE51_MASK;
+  h0 += 19 * (h4 >> 51); h4 &= FE51_MASK;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/*
+The inverse split; the limbs are then carried into the signed, centred
+ranges ref10 produces (|h| below 2^25 or 2^24), since its formulas rely on
+that headroom when adding before multiplying.
+*/
+static void fe51_to_fe(fe h, const fe51 f) {
+  fe51 t;
+  int64_t l[10];
+  int64_t carry;
+  int i;
+
+  fe51_reduce(t, f);
+  for (i = 0; i < 5; ++i) {
+    l[2 * i] = (int64_t) (t[i] & ((1 << 26) - 1));
+    l[2 * i + 1] = (int64_t) (t[i] >> 26);
+  }
+  for (i = 0; i < 10; i += 2) {
+    carry = (l[i] + (int64_t) (1 << 25)) >> 26; l[i + 1] += carry; l[i] -= carry << 26;
+    carry = (l[i + 1] + (int64_t) (1 << 24)) >> 25; l[i + 1] -= carry << 25;
+    if (i < 8) {
+      l[i + 2] += carry;
+    } else {
+      l[0] += 19 * carry;
+    }
+  }
+  carry = (l[0] + (int64_t) (1 << 25)) >> 26; l[1] += carry; l[0] -= carry << 26;
+
+  for (i = 0; i < 10; ++i) {
+    h[i] = (int32_t) l[i];
+  }
+}
+
+/* From fe_invert.c */
+
+static void fe51_invert(fe51 out, const fe51 z) {
+  fe51 t0, t1, t2, t3;
+  int i;
+
+  fe51_sq(t0, z);
+  fe51_sq(t1, t0);
+  fe51_sq(t1, t1);
+  fe51_mul(t1, z, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t2, t0);
+  fe51_mul(t1, t1, t2);
+  fe51_sq(t2, t1);
+  for (i = 0; i < 4; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t1, t2, t1);
+  fe51_sq(t2, t1);
+  for (i = 0; i < 9; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t2, t2, t1);
+  fe51_sq(t3, t2);
+  for (i = 0; i < 19; ++i) {
+    fe51_sq(t3, t3);
+  }
+  fe51_mul(t2, t3, t2);
+  fe51_sq(t2, t2);
+  for (i = 0; i < 9; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t1, t2, t1);
+  fe51_sq(t2, t1);
+  for (i = 0; i < 49; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t2, t2, t1);
+  fe51_sq(t3, t2);
+  for (i = 0; i < 99; ++i) {
+    fe51_sq(t3, t3);
+  }
+  fe51_mul(t2, t3, t2);
+  fe51_sq(t2, t2);
+  for (i = 0; i < 49; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t1, t2, t1);
+  fe51_sq(t1, t1);
+  for (i = 0; i < 4; ++i) {
+    fe51_sq(t1, t1);
+  }
+  fe51_mul(out, t1, t0);
+}
+
+/* As fe_divpowm1: r = u * v^3 * (u * v^7)^((q-5)/8) */
+
+static void fe51_divpowm1(fe51 r, const fe51 u, const fe51 v) {
+  fe51 v3, uv7, t0, t1, t2;
+  int i;
+
+  fe51_sq(v3, v);
+  fe51_mul(v3, v3, v); /* v3 = v^3 */
+  fe51_sq(uv7, v3);
+  fe51_mul(uv7, uv7, v);
+  fe51_mul(uv7, uv7, u); /* uv7 = uv^7 */
+
+  /* From fe_pow22523.c */
+
+  fe51_sq(t0, uv7);
+  fe51_sq(t1, t0);
+  fe51_sq(t1, t1);
+  fe51_mul(t1, uv7, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t0, t0);
+  fe51_mul(t0, t1, t0);
+  fe51_sq(t1, t0);
+  for (i = 0; i < 4; ++i) {
+    fe51_sq(t1, t1);
+  }
+  fe51_mul(t0, t1, t0);
+  fe51_sq(t1, t0);
+  for (i = 0; i < 9; ++i) {
+    fe51_sq(t1, t1);
+  }
+  fe51_mul(t1, t1, t0);
+  fe51_sq(t2, t1);
+  for (i = 0; i < 19; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t1, t2, t1);
+  for (i = 0; i < 10; ++i) {
+    fe51_sq(t1, t1);
+  }
+  fe51_mul(t0, t1, t0);
+  fe51_sq(t1, t0);
+  for (i = 0; i < 49; ++i) {
+    fe51_sq(t1, t1);
+  }
+  fe51_mul(t1, t1, t0);
+  fe51_sq(t2, t1);
+  for (i = 0; i < 99; ++i) {
+    fe51_sq(t2, t2);
+  }
+  fe51_mul(t1, t2, t1);
+  for (i = 0; i < 50; ++i) {
+    fe51_sq(t1, t1);
+  }
+  fe51_mul(t0, t1, t0);
+  fe51_sq(t0, t0);
+  fe51_sq(t0, t0);
+  fe51_mul(t0, t0, uv7);
+
+  /* End fe_pow22523.c */
+  fe51_mul(t0, t0, v3);
+  fe51_mul(r, t0, u);
+}
+
+/* Conversions from and to the ref10 point representations */
+
+static void ge51_from_p3(ge51_p3 *r, const ge_p3 *p) {
+  fe51_from_fe(r->X, p->X);
+  fe51_from_fe(r->Y, p->Y);
+  fe51_from_fe(r->Z, p->Z);
+  fe51_from_fe(r->T, p->T);
+}
+
+static void ge51_to_p2(ge_p2 *r, const ge51_p2 *p) {
+  fe51_to_fe(r->X, p->X);
+  fe51_to_fe(r->Y, p->Y);
+  fe51_to_fe(r->Z, p->Z);
+}
+
+static void ge51_to_p3(ge_p3 *r, const ge51_p3 *p) {
+  fe51_to_fe(r->X, p->X);
+  fe51_to_fe(r->Y, p->Y);
+  fe51_to_fe(r->Z, p->Z);
+  fe51_to_fe(r->T, p->T);
+}
+
+/* Group operations, see the ref10 functions of the same name */
+
+static void ge51_p2_0(ge51_p2 *h) {
+  fe51_0(h->X);
+  fe51_1(h->Y);
+  fe51_1(h->Z);
+}
+
+static void ge51_p3_0(ge51_p3 *h) {
+  fe51_0(h->X);
+  fe51_1(h->Y);
+  fe51_1(h->Z);
+  fe51_0(h->T);
+}
+
+static void ge51_p1p1_to_p2(ge51_p2 *r, const ge51_p1p1 *p) {
+  fe51_mul(r->X, p->X, p->T);
+  fe51_mul(r->Y, p->Y, p->Z);
+  fe51_mul(r->Z, p->Z, p->T);
+}
+
+static void ge51_p1p1_to_p3(ge51_p3 *r, const ge51_p1p1 *p) {
+  fe51_mul(r->X, p->X, p->T);
+  fe51_mul(r->Y, p->Y, p->Z);
+  fe51_mul(r->Z, p->Z, p->T);
+  fe51_mul(r->T, p->X, p->Y);
+}
+
+static void ge51_p3_to_cached(ge51_cached *r, const ge51_p3 *p) {
+  fe51_add(r->YplusX, p->Y, p->X);
+  fe51_sub(r->YminusX, p->Y, p->X);
+  fe51_copy(r->Z, p->Z);
+  fe51_mul(r->T2d, p->T, fe51_d2);
+}
+
+static void ge51_p2_dbl(ge51_p1p1 *r, const ge51_p2 *p) {
+  fe51 t0;
+  fe51_sq(r->X, p->X);
+  fe51_sq(r->Z, p->Y);
+  fe51_sq2(r->T, p->Z);
+  fe51_add(r->Y, p->X, p->Y);
+  fe51_sq(t0, r->Y);
+  fe51_add(r->Y, r->Z, r->X);
+  fe51_sub(r->Z, r->Z, r->X);
+  fe51_sub(r->X, t0, r->Y);
+  fe51_sub(r->T, r->T, r->Z);
+}
+
+static void ge51_p3_dbl(ge51_p1p1 *r, const ge51_p3 *p) {
+  ge51_p2 q;
+  fe51_copy(q.X, p->X);
+  fe51_copy(q.Y, p->Y);
+  fe51_copy(q.Z, p->Z);
+  ge51_p2_dbl(r, &q);
+}
+
+static void ge51_add(ge51_p1p1 *r, const ge51_p3 *p, const ge51_cached *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->YplusX);
+  fe51_mul(r->Y, r->Y, q->YminusX);
+  fe51_mul(r->T, q->T2d, p->T);
+  fe51_mul(r->X, p->Z, q->Z);
+  fe51_add(t0, r->X, r->X);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_add(r->Z, t0, r->T);
+  fe51_sub(r->T, t0, r->T);
+}
+
+static void ge51_sub(ge51_p1p1 *r, const ge51_p3 *p, const ge51_cached *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->YminusX);
+  fe51_mul(r->Y, r->Y, q->YplusX);
+  fe51_mul(r->T, q->T2d, p->T);
+  fe51_mul(r->X, p->Z, q->Z);
+  fe51_add(t0, r->X, r->X);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_sub(r->Z, t0, r->T);
+  fe51_add(r->T, t0, r->T);
+}
+
+static void ge51_madd(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->yplusx);
+  fe51_mul(r->Y, r->Y, q->yminusx);
+  fe51_mul(r->T, q->xy2d, p->T);
+  fe51_add(t0, p->Z, p->Z);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_add(r->Z, t0, r->T);
+  fe51_sub(r->T, t0, r->T);
+}
+
+static void ge51_msub(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->yminusx);
+  fe51_mul(r->Y, r->Y, q->yplusx);
+  fe51_mul(r->T, q->xy2d, p->T);
+  fe51_add(t0, p->Z, p->Z);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_sub(r->Z, t0, r->T);
+  fe51_add(r->T, t0, r->T);
+}
+
+static void ge51_dsm_precomp(ge51_dsmp r, const ge51_p3 *s) {
+  ge51_p1p1 t;
+  ge51_p3 s2, u;
+  int i;
+  ge51_p3_to_cached(&r[0], s);
+  ge51_p3_dbl(&t, s); ge51_p1p1_to_p3(&s2, &t);
+  for (i = 0; i < 7; ++i) {
+    ge51_add(&t, &s2, &r[i]); ge51_p1p1_to_p3(&u, &t); ge51_p3_to_cached(&r[i + 1], &u);
+  }
+}
+
+static unsigned char equal(signed char b, signed char c) {
+  unsigned char ub = b;
+  unsigned char uc = c;
+  unsigned char x = ub ^ uc; /* 0: yes; 1..255: no */
+  uint32_t y = x; /* 0: yes; 1..255: no */
+  y -= 1; /* 4294967295: yes; 0..254: no */
+  y >>= 31; /* 1: yes; 0: no */
+  return y;
+}
+
+static unsigned char negative(signed char b) {
+  unsigned long long x = b; /* 18446744073709551361..18446744073709551615: yes; 0..255: no */
+  x >>= 63; /* 1: yes; 0: no */
+  return x;
+}
+
+static void ge51_precomp_cmov(ge51_precomp *t, const ge51_precomp *u, unsigned char b) {
+  fe51_cmov(t->yplusx, u->yplusx, b);
+  fe51_cmov(t->yminusx, u->yminusx, b);
+  fe51_cmov(t->xy2d, u->xy2d, b);
+}
+
+static void ge51_cached_cmov(ge51_cached *t, const ge51_cached *u, unsigned char b) {
+  fe51_cmov(t->YplusX, u->YplusX, b);
+  fe51_cmov(t->YminusX, u->YminusX, b);
+  fe51_cmov(t->Z, u->Z, b);
+  fe51_cmov(t->T2d, u->T2d, b);
+}
+
+/* t = -t if b, constant time */
+static void ge51_precomp_cneg(ge51_precomp *t, unsigned char b) {
+  ge51_precomp minust;
+  fe51_copy(minust.yplusx, t->yminusx);
+  fe51_copy(minust.yminusx, t->yplusx);
+  fe51_neg(minust.xy2d, t->xy2d);
+  ge51_precomp_cmov(t, &minust, b);
+}
+
+static void ge51_select(ge51_precomp *t, const ge51_precomp row[8], signed char b) {
+  unsigned char bnegative = negative(b);
+  unsigned char babs = b - (((-bnegative) & b) << 1);
+  int i;
+
+  fe51_1(t->yplusx);
+  fe51_1(t->yminusx);
+  fe51_0(t->xy2d);
+  for (i = 0; i < 8; ++i) {
+    ge51_precomp_cmov(t, &row[i], equal(babs, i + 1));
+  }
+  ge51_precomp_cneg(t, bnegative);
+}
+
+/*
+Same, from a row of a ref10 table: the selection runs over the ref10 limbs
+and only the chosen entry is converted.
+*/
+static void ge51_select_ref10(ge51_precomp *t, const ge_precomp row[8], signed char b) {
+  ge_precomp u;
+  unsigned char bnegative = negative(b);
+  unsigned char babs = b - (((-bnegative) & b) << 1);
+  int i, k;
+
+  for (k = 0; k < 10; ++k) {
+    u.yplusx[k] = u.yminusx[k] = u.xy2d[k] = 0;
+  }
+  u.yplusx[0] = u.yminusx[0] = 1;
+  for (i = 0; i < 8; ++i) {
+    int32_t mask = -(int32_t) equal(babs, i + 1);
+    for (k = 0; k < 10; ++k) {
+      u.yplusx[k] ^= mask & (u.yplusx[k] ^ row[i].yplusx[k]);
+      u.yminusx[k] ^= mask & (u.yminusx[k] ^ row[i].yminusx[k]);
+      u.xy2d[k] ^= mask & (u.xy2d[k] ^ row[i].xy2d[k]);
+    }
+  }
+  fe51_from_fe(t->yplusx, u.yplusx);
+  fe51_from_fe(t->yminusx, u.yminusx);
+  fe51_from_fe(t->xy2d, u.xy2d);
+  ge51_precomp_cneg(t, bnegative);
+}
+
+/* Public functions */
+
+int ge51_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
+  fe51 y, x, z, t, u, v, vxx, check;
+
+  fe51_frombytes(y, s);
+
+  /* Validate the number to be canonical */
+  if (y[4] == FE51_MASK && y[3] == FE51_MASK && y[2] == FE51_MASK && y[1] == FE51_MASK &&
+    y[0] >= FE51_MASK - 18) {
+    return -1;
+  }
+
+  fe51_1(z);
+  fe51_sq(u, y);
+  fe51_mul(v, u, fe51_d);
+  fe51_sub(u, u, z);       /* u = y^2-1 */
+  fe51_add(v, v, z);       /* v = dy^2+1 */
+
+  fe51_divpowm1(x, u, v); /* x = uv^3(uv^7)^((q-5)/8) */
+
+  fe51_sq(vxx, x);
+  fe51_mul(vxx, vxx, v);
+  fe51_sub(check, vxx, u);    /* vx^2-u */
+  if (fe51_isnonzero(check)) {
+    fe51_add(check, vxx, u);  /* vx^2+u */
+    if (fe51_isnonzero(check)) {
+      return -1;
+    }
+    fe51_mul(x, x, fe51_sqrtm1);
+  }
+
+  if (fe51_isnegative(x) != (s[31] >> 7)) {
+    /* If x = 0, the sign must be positive */
+    if (!fe51_isnonzero(x)) {
+      return -1;
+    }
+    fe51_neg(x, x);
+  }
+
+  fe51_mul(t, x, y);
+
+  fe51_to_fe(h->X, x);
+  fe51_to_fe(h->Y, y);
+  fe51_to_fe(h->Z, z);
+  fe51_to_fe(h->T, t);
+  return 0;
+}
+
+static void ge51_encode(unsigned char *s, const fe51 X, const fe51 Y, const fe51 Z) {
+  fe51 recip, x, y;
+
+  fe51_invert(recip, Z);
+  fe51_mul(x, X, recip);
+  fe51_mul(y, Y, recip);
+  fe51_tobytes(s, y);
+  s[31] ^= fe51_isnegative(x) << 7;
+}
+
+void ge51_tobytes(unsigned char *s, const ge_p2 *h) {
+  fe51 X, Y, Z;
+  fe51_from_fe(X, h->X);
+  fe51_from_fe(Y, h->Y);
+  fe51_from_fe(Z, h->Z);
+  ge51_encode(s, X, Y, Z);
+}
+
+void ge51_p3_tobytes(unsigned char *s, const ge_p3 *h) {
+  fe51 X, Y, Z;
+  fe51_from_fe(X, h->X);
+  fe51_from_fe(Y, h->Y);
+  fe51_from_fe(Z, h->Z);
+  ge51_encode(s, X, Y, Z);
+}
+
+/* Exactly one of table51 and table is set */
+static void ge51_fixed_base(ge_p3 *h, const unsigned char *a, const ge51_precomp (*table51)[8], const ge_precomp (*table)[8]) {
+  signed char e[64];
+  signed char carry;
+  ge51_p1p1 r;
+  ge51_p2 s;
+  ge51_p3 q;
+  ge51_precomp t;
+  int i;
+
+  for (i = 0; i < 32; ++i) {
+    e[2 * i + 0] = (a[i] >> 0) & 15;
+    e[2 * i + 1] = (a[i] >> 4) & 15;
+  }
+
+  carry = 0;
+  for (i = 0; i < 63; ++i) {
+    e[i] += carry;
+    carry = e[i] + 8;
+    carry >>= 4;
+    e[i] -= carry << 4;
+  }
+  e[63] += carry;
+
+  ge51_p3_0(&q);
+  for (i = 1; i < 64; i += 2) {
+    if (table51)
+      ge51_select(&t, table51[i / 2], e[i]);
+    else
+      ge51_select_ref10(&t, table[i / 2], e[i]);
+    ge51_madd(&r, &q, &t); ge51_p1p1_to_p3(&q, &r);
+  }
+
+  ge51_p3_dbl(&r, &q); ge51_p1p1_to_p2(&s, &r);
+  ge51_p2_dbl(&r, &s); ge51_p1p1_to_p2(&s, &r);
+  ge51_p2_dbl(&r, &s); ge51_p1p1_to_p2(&s, &r);
+  ge51_p2_dbl(&r, &s); ge51_p1p1_to_p3(&q, &r);
+
+  for (i = 0; i < 64; i += 2) {
+    if (table51)
+      ge51_select(&t, table51[i / 2], e[i]);
+    else
+      ge51_select_ref10(&t, table[i / 2], e[i]);
+    ge51_madd(&r, &q, &t); ge51_p1p1_to_p3(&q, &r);
+  }
+
+  ge51_to_p3(h, &q);
+}
+
+void ge51_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+  ge51_fixed_base(h, a, ge51_base, NULL);
+}
+
+void ge51_scalarmult_fixed_base(ge_p3 *h, const unsigned char *a, const ge_fixed_base_table table) {
+  ge51_fixed_base(h, a, NULL, table);
+}
+
+/* Leaves the last addition in t so the callers pick the output representation */
+static void ge51_scalarmult_p1p1(ge51_p1p1 *t, const unsigned char *a, const ge_p3 *A) {
+  signed char e[64];
+  int carry, carry2, i, j;
+  ge51_cached Ai[8]; /* 1 * A, 2 * A, ..., 8 * A */
+  ge51_p3 A51, u;
+  ge51_p2 r;
+
+  carry = 0; /* 0..1 */
+  for (i = 0; i < 31; i++) {
+    carry += a[i]; /* 0..256 */
+    carry2 = (carry + 8) >> 4; /* 0..16 */
+    e[2 * i] = carry - (carry2 << 4); /* -8..7 */
+    carry = (carry2 + 8) >> 4; /* 0..1 */
+    e[2 * i + 1] = carry2 - (carry << 4); /* -8..7 */
+  }
+  carry += a[31]; /* 0..128 */
+  carry2 = (carry + 8) >> 4; /* 0..8 */
+  e[62] = carry - (carry2 << 4); /* -8..7 */
+  e[63] = carry2; /* 0..8 */
+
+  ge51_from_p3(&A51, A);
+  ge51_p3_to_cached(&Ai[0], &A51);
+  for (i = 0; i < 7; i++) {
+    ge51_add(t, &A51, &Ai[i]);
+    ge51_p1p1_to_p3(&u, t);
+    ge51_p3_to_cached(&Ai[i + 1], &u);
+  }
+
+  ge51_p2_0(&r);
+  for (i = 63; i >= 0; i--) {
+    signed char b = e[i];
+    unsigned char bnegative = negative(b);
+    unsigned char babs = b - (((-bnegative) & b) << 1);
+    ge51_cached cur, minuscur;
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p2(&r, t);
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p2(&r, t);
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p2(&r, t);
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p3(&u, t);
+    fe51_1(cur.YplusX);
+    fe51_1(cur.YminusX);
+    fe51_1(cur.Z);
+    fe51_0(cur.T2d);
+    for (j = 0; j < 8; ++j) {
+      ge51_cached_cmov(&cur, &Ai[j], equal(babs, j + 1));
+    }
+    fe51_copy(minuscur.YplusX, cur.YminusX);
+    fe51_copy(minuscur.YminusX, cur.YplusX);
+    fe51_copy(minuscur.Z, cur.Z);
+    fe51_neg(minuscur.T2d, cur.T2d);
+    ge51_cached_cmov(&cur, &minuscur, bnegative);
+    ge51_add(t, &u, &cur);
+    if (i > 0)
+      ge51_p1p1_to_p2(&r, t);
+  }
+}
+
+void ge51_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
+  ge51_p1p1 t;
+  ge51_p2 q;
+  ge51_scalarmult_p1p1(&t, a, A);
+  ge51_p1p1_to_p2(&q, &t);
+  ge51_to_p2(r, &q);
+}
+
+void ge51_scalarmult_p3(ge_p3 *r, const unsigned char *a, const ge_p3 *A) {
+  ge51_p1p1 t;
+  ge51_p3 q;
+  ge51_scalarmult_p1p1(&t, a, A);
+  ge51_p1p1_to_p3(&q, &t);
+  ge51_to_p3(r, &q);
+}
+
+/* Returns false if both scalars are zero, in which case t is untouched */
+static int ge51_double_scalarmult_base_vartime_p1p1(ge51_p1p1 *t, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  signed char aslide[256];
+  signed char bslide[256];
+  ge51_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+  ge51_p3 A51, u;
+  ge51_p2 r;
+  int i;
+
+  ge_slide(aslide, a);
+  ge_slide(bslide, b);
+
+  for (i = 255; i >= 0; --i) {
+    if (aslide[i] || bslide[i]) break;
+  }
+  if (i < 0) {
+    return 0;
+  }
+
+  ge51_from_p3(&A51, A);
+  ge51_dsm_precomp(Ai, &A51);
+
+  ge51_p2_0(&r);
+
+  for (; i >= 0; --i) {
+    ge51_p2_dbl(t, &r);
+
+    if (aslide[i] > 0) {
+      ge51_p1p1_to_p3(&u, t);
+      ge51_add(t, &u, &Ai[aslide[i]/2]);
+    } else if (aslide[i] < 0) {
+      ge51_p1p1_to_p3(&u, t);
+      ge51_sub(t, &u, &Ai[(-aslide[i])/2]);
+    }
+
+    if (bslide[i] > 0) {
+      ge51_p1p1_to_p3(&u, t);
+      ge51_madd(t, &u, &ge51_Bi[bslide[i]/2]);
+    } else if (bslide[i] < 0) {
+      ge51_p1p1_to_p3(&u, t);
+      ge51_msub(t, &u, &ge51_Bi[(-bslide[i])/2]);
+    }
+
+    if (i > 0)
+      ge51_p1p1_to_p2(&r, t);
+  }
+  return 1;
+}
+
+void ge51_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge51_p1p1 t;
+  ge51_p2 q;
+  if (!ge51_double_scalarmult_base_vartime_p1p1(&t, a, A, b)) {
+    ge51_p2_0(&q);
+  } else {
+    ge51_p1p1_to_p2(&q, &t);
+  }
+  ge51_to_p2(r, &q);
+}
+
+void ge51_double_scalarmult_base_vartime_p3(ge_p3 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge51_p1p1 t;
+  ge51_p3 q;
+  if (!ge51_double_scalarmult_base_vartime_p1p1(&t, a, A, b)) {
+    ge51_p3_0(&q);
+  } else {
+    ge51_p1p1_to_p3(&q, &t);
+  }
+  ge51_to_p3(r, &q);
+}
+
+#endif
@@ -0,0 +1,77 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "crypto-ops.h"
+
+/*
+Field arithmetic with five unsigned 51-bit limbs and 64x64->128 bit products.
+Only compiled where the compiler provides a 128-bit integer type; elsewhere
+crypto-ops.c keeps using the ref10 code unconditionally.
+*/
+
+#if defined(__SIZEOF_INT128__)
+#define CRYPTO_OPS_HAVE_FE51 1
+#else
+#define CRYPTO_OPS_HAVE_FE51 0
+#endif
+
+#if CRYPTO_OPS_HAVE_FE51
+
+typedef uint64_t fe51[5];
+
+typedef struct {
+  fe51 yplusx;
+  fe51 yminusx;
+  fe51 xy2d;
+} ge51_precomp;
+
+/* From crypto-ops-fe51-data.c: the ref10 tables and constants, canonically reduced */
+
+extern const fe51 fe51_d;
+extern const fe51 fe51_d2;
+extern const fe51 fe51_sqrtm1;
+extern const ge51_precomp ge51_Bi[8];
+extern const ge51_precomp ge51_base[32][8];
+
+/* Same contract as the ref10 function of the same name without the 51 */
+
+int ge51_frombytes_vartime(ge_p3 *, const unsigned char *);
+void ge51_tobytes(unsigned char *, const ge_p2 *);
+void ge51_p3_tobytes(unsigned char *, const ge_p3 *);
+void ge51_scalarmult_base(ge_p3 *, const unsigned char *);
+void ge51_scalarmult_fixed_base(ge_p3 *, const unsigned char *, const ge_fixed_base_table);
+void ge51_scalarmult(ge_p2 *, const unsigned char *, const ge_p3 *);
+void ge51_scalarmult_p3(ge_p3 *, const unsigned char *, const ge_p3 *);
+void ge51_double_scalarmult_base_vartime(ge_p2 *, const unsigned char *, const ge_p3 *, const unsigned char *);
+void ge51_double_scalarmult_base_vartime_p3(ge_p3 *, const unsigned char *, const ge_p3 *, const unsigned char *);
+
+#endif
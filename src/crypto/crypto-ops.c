@@ -33,6 +33,7 @@
 
 #include "warnings.h"
 #include "crypto-ops.h"
+#include "crypto-ops-fe51.h"
 
 DISABLE_VS_WARNINGS(4146 4244)
 
@@ -46,6 +47,34 @@ static void ge_p2_0(ge_p2 *);
 static void ge_p3_dbl(ge_p1p1 *, const ge_p3 *);
 static void fe_divpowm1(fe, const fe, const fe);
 
+/* Backend selection */
+
+static enum crypto_ops_backend crypto_ops_backend = CRYPTO_OPS_HAVE_FE51 ? CRYPTO_OPS_BACKEND_FE51 : CRYPTO_OPS_BACKEND_REF10;
+
+int crypto_ops_set_backend(enum crypto_ops_backend backend) {
+  if (backend == CRYPTO_OPS_BACKEND_FE51 && !CRYPTO_OPS_HAVE_FE51) {
+    return -1;
+  }
+  crypto_ops_backend = backend;
+  return 0;
+}
+
+enum crypto_ops_backend crypto_ops_get_backend(void) {
+  return crypto_ops_backend;
+}
+
+#if CRYPTO_OPS_HAVE_FE51
+#define FE51_DISPATCH(call) \
+  do { \
+    if (crypto_ops_backend == CRYPTO_OPS_BACKEND_FE51) { \
+      call; \
+      return; \
+    } \
+  } while (0)
+#else
+#define FE51_DISPATCH(call) do {} while (0)
+#endif
+
 /* Common functions */
 
 uint64_t load_3(const unsigned char *in) {
@@ -1140,7 +1169,7 @@ void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
 
 /* From ge_double_scalarmult.c, modified */
 
-static void slide(signed char *r, const unsigned char *a) {
+void ge_slide(signed char *r, const unsigned char *a) {
   int i;
   int b;
   int k;
@@ -1201,8 +1230,10 @@ void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const g
   ge_p3 u;
   int i;
 
-  slide(aslide, a);
-  slide(bslide, b);
+  FE51_DISPATCH(ge51_double_scalarmult_base_vartime(r, a, A, b));
+
+  ge_slide(aslide, a);
+  ge_slide(bslide, b);
   ge_dsm_precomp(Ai, A);
 
   ge_p2_0(r);
@@ -1243,8 +1274,10 @@ void ge_double_scalarmult_base_vartime_p3(ge_p3 *r3, const unsigned char *a, con
   ge_p2 r;
   int i;
 
-  slide(aslide, a);
-  slide(bslide, b);
+  FE51_DISPATCH(ge51_double_scalarmult_base_vartime_p3(r3, a, A, b));
+
+  ge_slide(aslide, a);
+  ge_slide(bslide, b);
   ge_dsm_precomp(Ai, A);
 
   ge_p2_0(&r);
@@ -1287,6 +1320,12 @@ int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
   fe vxx;
   fe check;
 
+#if CRYPTO_OPS_HAVE_FE51
+  if (crypto_ops_backend == CRYPTO_OPS_BACKEND_FE51) {
+    return ge51_frombytes_vartime(h, s);
+  }
+#endif
+
   /* From fe_frombytes.c */
 
   int64_t h0 = load_4(s);
@@ -1518,6 +1557,8 @@ void ge_p3_tobytes(unsigned char *s, const ge_p3 *h) {
   fe x;
   fe y;
 
+  FE51_DISPATCH(ge51_p3_tobytes(s, h));
+
   fe_invert(recip, h->Z);
   fe_mul(x, h->X, recip);
   fe_mul(y, h->Y, recip);
@@ -1557,20 +1598,20 @@ static void ge_precomp_cmov(ge_precomp *t, const ge_precomp *u, unsigned char b)
   fe_cmov(t->xy2d, u->xy2d, b);
 }
 
-static void select(ge_precomp *t, int pos, signed char b) {
+static void select(ge_precomp *t, const ge_precomp row[8], signed char b) {
   ge_precomp minust;
   unsigned char bnegative = negative(b);
   unsigned char babs = b - (((-bnegative) & b) << 1);
 
   ge_precomp_0(t);
-  ge_precomp_cmov(t, &ge_base[pos][0], equal(babs, 1));
-  ge_precomp_cmov(t, &ge_base[pos][1], equal(babs, 2));
-  ge_precomp_cmov(t, &ge_base[pos][2], equal(babs, 3));
-  ge_precomp_cmov(t, &ge_base[pos][3], equal(babs, 4));
-  ge_precomp_cmov(t, &ge_base[pos][4], equal(babs, 5));
-  ge_precomp_cmov(t, &ge_base[pos][5], equal(babs, 6));
-  ge_precomp_cmov(t, &ge_base[pos][6], equal(babs, 7));
-  ge_precomp_cmov(t, &ge_base[pos][7], equal(babs, 8));
+  ge_precomp_cmov(t, &row[0], equal(babs, 1));
+  ge_precomp_cmov(t, &row[1], equal(babs, 2));
+  ge_precomp_cmov(t, &row[2], equal(babs, 3));
+  ge_precomp_cmov(t, &row[3], equal(babs, 4));
+  ge_precomp_cmov(t, &row[4], equal(babs, 5));
+  ge_precomp_cmov(t, &row[5], equal(babs, 6));
+  ge_precomp_cmov(t, &row[6], equal(babs, 7));
+  ge_precomp_cmov(t, &row[7], equal(babs, 8));
   fe_copy(minust.yplusx, t->yminusx);
   fe_copy(minust.yminusx, t->yplusx);
   fe_neg(minust.xy2d, t->xy2d);
@@ -1578,15 +1619,16 @@ static void select(ge_precomp *t, int pos, signed char b) {
 }
 
 /*
-h = a * B
+h = a * P
 where a = a[0]+256*a[1]+...+256^31 a[31]
-B is the Ed25519 base point (x,4/5) with x positive.
+and table is ge_base (P = B, the Ed25519 base point (x,4/5) with x positive)
+or was filled by ge_fixed_base_precomp for P.
 
 Preconditions:
   a[31] <= 127
 */
 
-void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+void ge_scalarmult_fixed_base(ge_p3 *h, const unsigned char *a, const ge_fixed_base_table table) {
   signed char e[64];
   signed char carry;
   ge_p1p1 r;
@@ -1594,6 +1636,8 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
   ge_precomp t;
   int i;
 
+  FE51_DISPATCH(ge51_scalarmult_fixed_base(h, a, table));
+
   for (i = 0; i < 32; ++i) {
     e[2 * i + 0] = (a[i] >> 0) & 15;
     e[2 * i + 1] = (a[i] >> 4) & 15;
@@ -1613,7 +1657,7 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
 
   ge_p3_0(h);
   for (i = 1; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+    select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 
@@ -1623,11 +1667,70 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
   ge_p2_dbl(&r, &s); ge_p1p1_to_p3(h, &r);
 
   for (i = 0; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+    select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 }
 
+void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+  FE51_DISPATCH(ge51_scalarmult_base(h, a));
+  ge_scalarmult_fixed_base(h, a, ge_base);
+}
+
+/*
+table[i][j] = (j+1)*256^i*P, in the layout of ge_base, so that
+ge_scalarmult_fixed_base can multiply P like the base point.
+Each row is normalised with a single inversion.
+*/
+
+void ge_fixed_base_precomp(ge_fixed_base_table table, const ge_p3 *P) {
+  ge_p3 base = *P;
+  ge_p3 row[8];
+  ge_cached c;
+  ge_p1p1 t;
+  fe acc[8];
+  fe recip;
+  fe zinv;
+  fe x;
+  fe y;
+  fe xy;
+  int i, j;
+
+  for (i = 0; i < 32; ++i) {
+    row[0] = base;
+    ge_p3_to_cached(&c, &base);
+    for (j = 1; j < 8; ++j) {
+      ge_add(&t, &row[j - 1], &c);
+      ge_p1p1_to_p3(&row[j], &t);
+    }
+
+    fe_copy(acc[0], row[0].Z);
+    for (j = 1; j < 8; ++j) {
+      fe_mul(acc[j], acc[j - 1], row[j].Z);
+    }
+    fe_invert(recip, acc[7]);
+    for (j = 7; j >= 0; --j) {
+      if (j > 0) {
+        fe_mul(zinv, recip, acc[j - 1]);
+        fe_mul(recip, recip, row[j].Z);
+      } else {
+        fe_copy(zinv, recip);
+      }
+      fe_mul(x, row[j].X, zinv);
+      fe_mul(y, row[j].Y, zinv);
+      fe_add(table[i][j].yplusx, y, x);
+      fe_sub(table[i][j].yminusx, y, x);
+      fe_mul(xy, x, y);
+      fe_mul(table[i][j].xy2d, xy, fe_d2);
+    }
+
+    for (j = 0; j < 8; ++j) {
+      ge_p3_dbl(&t, &base);
+      ge_p1p1_to_p3(&base, &t);
+    }
+  }
+}
+
 /* From ge_sub.c */
 
 /*
@@ -1656,6 +1759,8 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   fe x;
   fe y;
 
+  FE51_DISPATCH(ge51_tobytes(s, h));
+
   fe_invert(recip, h->Z);
   fe_mul(x, h->X, recip);
   fe_mul(y, h->Y, recip);
@@ -1663,6 +1768,40 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/*
+Encodes n points to s[0..32n-1] with a single field inversion
+(Montgomery's trick); tmp must hold n field elements.
+*/
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, fe *tmp, size_t n) {
+  fe recip;
+  fe zinv;
+  fe x;
+  fe y;
+  size_t i;
+
+  if (n == 0) {
+    return;
+  }
+  fe_copy(tmp[0], h[0].Z);
+  for (i = 1; i < n; ++i) {
+    fe_mul(tmp[i], tmp[i - 1], h[i].Z);
+  }
+  fe_invert(recip, tmp[n - 1]);
+  for (i = n; i-- > 0; ) {
+    if (i > 0) {
+      fe_mul(zinv, recip, tmp[i - 1]);
+      fe_mul(recip, recip, h[i].Z);
+    } else {
+      fe_copy(zinv, recip);
+    }
+    fe_mul(x, h[i].X, zinv);
+    fe_mul(y, h[i].Y, zinv);
+    fe_tobytes(s + 32 * i, y);
+    s[32 * i + 31] ^= fe_isnegative(x) << 7;
+  }
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -1992,6 +2131,8 @@ void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
   ge_p1p1 t;
   ge_p3 u;
 
+  FE51_DISPATCH(ge51_scalarmult(r, a, A));
+
   carry = 0; /* 0..1 */
   for (i = 0; i < 31; i++) {
     carry += a[i]; /* 0..256 */
@@ -2053,6 +2194,8 @@ void ge_scalarmult_p3(ge_p3 *r3, const unsigned char *a, const ge_p3 *A) {
   ge_p3 u;
   ge_p2 r;
 
+  FE51_DISPATCH(ge51_scalarmult_p3(r3, a, A));
+
   carry = 0; /* 0..1 */
   for (i = 0; i < 31; i++) {
     carry += a[i]; /* 0..256 */
@@ -2116,8 +2259,8 @@ void ge_double_scalarmult_precomp_vartime2(ge_p2 *r, const unsigned char *a, con
   ge_p3 u;
   int i;
 
-  slide(aslide, a);
-  slide(bslide, b);
+  ge_slide(aslide, a);
+  ge_slide(bslide, b);
 
   ge_p2_0(r);
 
@@ -2156,8 +2299,8 @@ void ge_double_scalarmult_precomp_vartime2_p3(ge_p3 *r3, const unsigned char *a,
   ge_p2 r;
   int i;
 
-  slide(aslide, a);
-  slide(bslide, b);
+  ge_slide(aslide, a);
+  ge_slide(bslide, b);
 
   ge_p2_0(&r);
 
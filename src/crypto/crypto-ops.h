@@ -30,6 +30,23 @@
 
 #pragma once
 
+#include <stddef.h>
+
+/*
+Field arithmetic used by ge_frombytes_vartime, ge_tobytes, ge_p3_tobytes,
+ge_scalarmult_base, ge_scalarmult_fixed_base, ge_scalarmult(_p3) and
+ge_double_scalarmult_base_vartime(_p3).
+FE51 (51-bit limbs, 128-bit products) is the default where the compiler
+supports it; both backends produce identical encodings.
+*/
+
+enum crypto_ops_backend {
+  CRYPTO_OPS_BACKEND_REF10,
+  CRYPTO_OPS_BACKEND_FE51
+};
+int crypto_ops_set_backend(enum crypto_ops_backend); /* -1 if not compiled in */
+enum crypto_ops_backend crypto_ops_get_backend(void);
+
 /* From fe.h */
 
 typedef int32_t fe[10];
@@ -116,10 +133,14 @@ void ge_p3_tobytes(unsigned char *, const ge_p3 *);
 
 extern const ge_precomp ge_base[32][8];
 void ge_scalarmult_base(ge_p3 *, const unsigned char *);
+typedef ge_precomp ge_fixed_base_table[32][8];
+void ge_fixed_base_precomp(ge_fixed_base_table, const ge_p3 *);
+void ge_scalarmult_fixed_base(ge_p3 *, const unsigned char *, const ge_fixed_base_table);
 
 /* From ge_tobytes.c */
 
 void ge_tobytes(unsigned char *, const ge_p2 *);
+void ge_tobytes_batch(unsigned char *, const ge_p2 *, fe *, size_t);
 
 /* From sc_reduce.c */
 
@@ -159,5 +180,6 @@ void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void fe_add(fe h, const fe f, const fe g);
 void fe_tobytes(unsigned char *, const fe);
 void fe_invert(fe out, const fe z);
+void ge_slide(signed char *r, const unsigned char *a);
 
 int ge_p3_is_point_at_infinity(const ge_p3 *p);
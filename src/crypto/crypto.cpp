@@ -185,6 +185,23 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::generate_key_derivations(const public_key &key1, const secret_key *keys2, std::size_t count, key_derivation *derivations) {
+    ge_p3 point;
+    ge_p2 point2;
+    ge_p1p1 point3;
+    if (ge_frombytes_vartime(&point, &key1) != 0) {
+      return false;
+    }
+    for (std::size_t n = 0; n < count; ++n) {
+      assert(sc_check(&keys2[n]) == 0);
+      ge_scalarmult(&point2, &unwrap(keys2[n]), &point);
+      ge_mul8(&point3, &point2);
+      ge_p1p1_to_p2(&point2, &point3);
+      ge_tobytes(&derivations[n], &point2);
+    }
+    return true;
+  }
+
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
@@ -118,6 +118,8 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static bool generate_key_derivations(const public_key &, const secret_key *, std::size_t, key_derivation *);
+    friend bool generate_key_derivations(const public_key &, const secret_key *, std::size_t, key_derivation *);
     static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
@@ -216,6 +218,12 @@ namespace crypto {
   inline bool generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
     return crypto_ops::generate_key_derivation(key1, key2, derivation);
   }
+  /* Key derivations of one transaction key against many view keys, as when scanning for many
+   * wallets at once. The transaction key is decompressed once for all of them.
+   */
+  inline bool generate_key_derivations(const public_key &key1, const secret_key *keys2, std::size_t count, key_derivation *derivations) {
+    return crypto_ops::generate_key_derivations(key1, keys2, count, derivations);
+  }
   inline bool derive_public_key(const key_derivation &derivation, std::size_t output_index,
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
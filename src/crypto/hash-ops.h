@@ -86,9 +86,16 @@ enum {
 void cn_fast_hash(const void *data, size_t length, char *hash);
 void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int prehashed, int modifier);
 
+#define CN_FAST_HASH_MAX_LANES 8
+void cn_fast_hash_multi(const void *const *data, const size_t *length, char *const *hash, size_t count);
+
+#define CN_SLOW_HASH_MAX_LANES 4
+void cn_slow_hash_multi(const void *const *data, const size_t *length, char *const *hash, size_t count, int variant, int prehashed, int modifier);
+
 void hash_extra_blake(const void *data, size_t length, char *hash);
 void hash_extra_groestl(const void *data, size_t length, char *hash);
 void hash_extra_jh(const void *data, size_t length, char *hash);
 void hash_extra_skein(const void *data, size_t length, char *hash);
 
+size_t tree_hash_cnt(size_t count);
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash);
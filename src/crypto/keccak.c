@@ -8,6 +8,7 @@
 #include "int-util.h"
 #include "hash-ops.h"
 #include "keccak.h"
+#include "initializer.h"
 
 static void local_abort(const char *msg)
 {
@@ -216,3 +217,181 @@ void keccak_finish(KECCAK_CTX * ctx, uint8_t *md){
         memcpy_swap64le(md, ctx->hash, KECCAK_DIGESTSIZE / sizeof(uint64_t));
     }
 }
+
+// Multi-buffer keccak: independent messages are hashed in lockstep, one per
+// 64 bit lane of a SIMD register, so the permutation cost is shared across
+// up to KECCAK_MULTI_MAX_LANES messages.
+
+#define KECCAK_MULTI_MAX_LANES 8
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_KECCAK_MULTI_SIMD
+
+#include <immintrin.h>
+
+// Same round function as keccakf, written in terms of the KM_* vector ops,
+// which each backend defines before expanding it on its state array s.
+#define KECCAK_MULTI_RP(j, r) { u = s[j]; s[j] = KM_ROL(t, r); t = u; }
+#define KECCAKF_MULTI_ROUNDS(V) \
+    for (int round = 0; round < KECCAK_ROUNDS; round++) { \
+        V bc[5], t, u; \
+        for (int i = 0; i < 5; i++) \
+            bc[i] = KM_XOR(KM_XOR(KM_XOR(s[i], s[i + 5]), KM_XOR(s[i + 10], s[i + 15])), s[i + 20]); \
+        for (int i = 0; i < 5; i++) { \
+            t = KM_XOR(bc[(i + 4) % 5], KM_ROL(bc[(i + 1) % 5], 1)); \
+            for (int j = 0; j < 25; j += 5) \
+                s[j + i] = KM_XOR(s[j + i], t); \
+        } \
+        t = s[1]; \
+        KECCAK_MULTI_RP(10, 1)  KECCAK_MULTI_RP(7, 3)   KECCAK_MULTI_RP(11, 6)  KECCAK_MULTI_RP(17, 10) \
+        KECCAK_MULTI_RP(18, 15) KECCAK_MULTI_RP(3, 21)  KECCAK_MULTI_RP(5, 28)  KECCAK_MULTI_RP(16, 36) \
+        KECCAK_MULTI_RP(8, 45)  KECCAK_MULTI_RP(21, 55) KECCAK_MULTI_RP(24, 2)  KECCAK_MULTI_RP(4, 14) \
+        KECCAK_MULTI_RP(15, 27) KECCAK_MULTI_RP(23, 41) KECCAK_MULTI_RP(19, 56) KECCAK_MULTI_RP(13, 8) \
+        KECCAK_MULTI_RP(12, 25) KECCAK_MULTI_RP(2, 43)  KECCAK_MULTI_RP(20, 62) KECCAK_MULTI_RP(14, 18) \
+        KECCAK_MULTI_RP(22, 39) KECCAK_MULTI_RP(9, 61)  KECCAK_MULTI_RP(6, 20)  KECCAK_MULTI_RP(1, 44) \
+        for (int j = 0; j < 25; j += 5) { \
+            for (int i = 0; i < 5; i++) \
+                bc[i] = s[j + i]; \
+            for (int i = 0; i < 5; i++) \
+                s[j + i] = KM_CHI(bc[i], bc[(i + 1) % 5], bc[(i + 2) % 5]); \
+        } \
+        s[0] = KM_XOR(s[0], KM_BCAST(keccakf_rndc[round])); \
+    }
+
+// 4 states, word i of state l at st[4 * i + l]
+#define KM_XOR(a, b) _mm256_xor_si256(a, b)
+#define KM_ROL(a, n) _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+#define KM_CHI(a, b, c) _mm256_xor_si256(a, _mm256_andnot_si256(b, c))
+#define KM_BCAST(x) _mm256_set1_epi64x((long long)(x))
+__attribute__((target("avx2")))
+static void keccakf_x4(uint64_t *st)
+{
+    __m256i s[25];
+    for (int i = 0; i < 25; i++)
+        s[i] = _mm256_loadu_si256((const __m256i*)(st + 4 * i));
+    KECCAKF_MULTI_ROUNDS(__m256i)
+    for (int i = 0; i < 25; i++)
+        _mm256_storeu_si256((__m256i*)(st + 4 * i), s[i]);
+}
+#undef KM_XOR
+#undef KM_ROL
+#undef KM_CHI
+#undef KM_BCAST
+
+// 8 states, word i of state l at st[8 * i + l]
+#define KM_XOR(a, b) _mm512_xor_si512(a, b)
+#define KM_ROL(a, n) _mm512_rol_epi64(a, n)
+#define KM_CHI(a, b, c) _mm512_ternarylogic_epi64(a, b, c, 0xd2) // a ^ (~b & c)
+#define KM_BCAST(x) _mm512_set1_epi64((long long)(x))
+__attribute__((target("avx512f")))
+static void keccakf_x8(uint64_t *st)
+{
+    __m512i s[25];
+    for (int i = 0; i < 25; i++)
+        s[i] = _mm512_loadu_si512((const void*)(st + 8 * i));
+    KECCAKF_MULTI_ROUNDS(__m512i)
+    for (int i = 0; i < 25; i++)
+        _mm512_storeu_si512((void*)(st + 8 * i), s[i]);
+}
+#undef KM_XOR
+#undef KM_ROL
+#undef KM_CHI
+#undef KM_BCAST
+
+// absorbs up to `lanes` messages into interleaved states, running `permute`
+// once per block of the longest one; a message that ran out of blocks has
+// had its digest taken already, so whatever its lane accumulates later is moot
+static void keccak_multi_lanes(const uint8_t *const *in, const size_t *inlen, uint8_t *const *md, size_t n,
+    size_t lanes, void (*permute)(uint64_t*))
+{
+    uint64_t st[25 * KECCAK_MULTI_MAX_LANES];
+    uint64_t temp[KECCAK_WORDS];
+    size_t blocks[KECCAK_MULTI_MAX_LANES], max_blocks = 0;
+    size_t b, l, w;
+
+    memset(st, 0, 25 * lanes * sizeof(uint64_t));
+    for (l = 0; l < n; ++l) {
+        blocks[l] = inlen[l] / KECCAK_BLOCKLEN + 1;
+        if (blocks[l] > max_blocks)
+            max_blocks = blocks[l];
+    }
+
+    for (b = 0; b < max_blocks; ++b) {
+        for (l = 0; l < n; ++l) {
+            if (b >= blocks[l])
+                continue;
+            const uint8_t *block = in[l] + b * KECCAK_BLOCKLEN;
+            if (b + 1 == blocks[l]) {
+                // last block and padding
+                const size_t rest = inlen[l] - b * KECCAK_BLOCKLEN;
+                memset(temp, 0, sizeof(temp));
+                if (rest > 0)
+                    memcpy(temp, block, rest);
+                ((uint8_t*)temp)[rest] |= 0x01;
+                ((uint8_t*)temp)[KECCAK_BLOCKLEN - 1] |= 0x80;
+                block = (const uint8_t*)temp;
+            }
+            for (w = 0; w < KECCAK_WORDS; ++w) {
+                uint64_t ina;
+                memcpy(&ina, block + w * 8, 8);
+                st[w * lanes + l] ^= swap64le(ina);
+            }
+        }
+        permute(st);
+        for (l = 0; l < n; ++l) {
+            if (b + 1 != blocks[l])
+                continue;
+            for (w = 0; w < KECCAK_DIGESTSIZE / sizeof(uint64_t); ++w)
+                memcpy_swap64le(md[l] + w * 8, &st[w * lanes + l], 1);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief number of messages keccak_multi hashes at once, from CPU features
+ *
+ * MONERO_KECCAK_LANES may lower it (1, 4 or 8), to compare or avoid a backend.
+ * Set once at load time, so concurrent callers only ever read it; hashing one
+ * message at a time until then is always correct.
+ */
+static size_t keccak_multi_width = 1;
+
+INITIALIZER(init_keccak_multi_width) {
+    int w = 1;
+#ifdef HAVE_KECCAK_MULTI_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        w = 8;
+    else if (__builtin_cpu_supports("avx2"))
+        w = 4;
+#endif
+    const char *env = getenv("MONERO_KECCAK_LANES");
+    if (env) {
+        const int max = atoi(env);
+        if (max > 0 && max < w)
+            w = max < 4 ? 1 : 4;
+    }
+    keccak_multi_width = w;
+}
+
+void keccak_multi(const uint8_t *const *in, const size_t *inlen, uint8_t *const *md, size_t n)
+{
+    const size_t width = keccak_multi_width;
+
+    while (n > 0) {
+        const size_t lanes = n < width ? n : width;
+#ifdef HAVE_KECCAK_MULTI_SIMD
+        if (lanes > 4)
+            keccak_multi_lanes(in, inlen, md, lanes, 8, keccakf_x8);
+        else if (lanes > 1)
+            keccak_multi_lanes(in, inlen, md, lanes, 4, keccakf_x4);
+        else
+#endif
+            keccak(in[0], inlen[0], md[0], KECCAK_DIGESTSIZE);
+        in += lanes;
+        inlen += lanes;
+        md += lanes;
+        n -= lanes;
+    }
+}
@@ -34,6 +34,10 @@ void keccakf(uint64_t st[25], int norounds);
 
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
 
+// compute 32 byte keccak hashes of n independent messages, several at a time
+// where the CPU allows; md[i] gets the same as keccak(in[i], inlen[i], md[i], 32)
+void keccak_multi(const uint8_t *const *in, const size_t *inlen, uint8_t *const *md, size_t n);
+
 void keccak_init(KECCAK_CTX * ctx);
 void keccak_update(KECCAK_CTX * ctx, const uint8_t *in, size_t inlen);
 void keccak_finish(KECCAK_CTX * ctx, uint8_t *md);
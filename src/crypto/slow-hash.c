@@ -334,6 +334,8 @@ union cn_slow_hash_state
 
 THREADV uint8_t *hp_state = NULL;
 THREADV int hp_allocated = 0;
+THREADV uint8_t *hp_lanes_state = NULL;
+THREADV int hp_lanes_allocated = 0;
 
 #if defined(_MSC_VER)
 #define cpuid(info,x)    __cpuidex(info,x,0)
@@ -646,11 +648,66 @@ void slow_hash_allocate_state(void)
 }
 
 /**
- *@brief frees the state allocated by slow_hash_allocate_state
+ * @brief allocate the scratch buffers for the extra lanes of cn_slow_hash_multi
+ *
+ * The CN_SLOW_HASH_MAX_LANES - 1 extra 2MB buffers are allocated as one
+ * block, again backed by huge pages where available, and kept for the
+ * thread's lifetime like hp_state (lane 0 uses hp_state itself).
+ */
+
+STATIC INLINE void slow_hash_allocate_lanes_state(void)
+{
+    const size_t size = (CN_SLOW_HASH_MAX_LANES - 1) * MEMORY;
+
+    if(hp_lanes_state != NULL)
+        return;
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
+    hp_lanes_state = (uint8_t *) VirtualAlloc(NULL, size, MEM_LARGE_PAGES |
+                                              MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+  defined(__DragonFly__) || defined(__NetBSD__)
+    hp_lanes_state = mmap(0, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANON, -1, 0);
+#else
+    hp_lanes_state = mmap(0, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if(hp_lanes_state == MAP_FAILED)
+        hp_lanes_state = NULL;
+#endif
+    hp_lanes_allocated = 1;
+    if(hp_lanes_state == NULL)
+    {
+        hp_lanes_allocated = 0;
+        hp_lanes_state = (uint8_t *) malloc(size);
+    }
+}
+
+/**
+ *@brief frees the state allocated by slow_hash_allocate_state and cn_slow_hash_multi
  */
 
 void slow_hash_free_state(void)
 {
+    if(hp_lanes_state != NULL)
+    {
+        if(!hp_lanes_allocated)
+            free(hp_lanes_state);
+        else
+        {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+            VirtualFree(hp_lanes_state, 0, MEM_RELEASE);
+#else
+            munmap(hp_lanes_state, (CN_SLOW_HASH_MAX_LANES - 1) * MEMORY);
+#endif
+        }
+        hp_lanes_state = NULL;
+        hp_lanes_allocated = 0;
+    }
+
     if(hp_state == NULL)
         return;
 
@@ -863,6 +920,255 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
     extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
 }
 
+
+#define HAVE_CN_SLOW_HASH_MULTI
+
+/* Per-hash state of cn_slow_hash_multi, the locals of cn_slow_hash's step 3 */
+struct cn_slow_hash_lane
+{
+    RDATA_ALIGN16 uint64_t a[2];
+    RDATA_ALIGN16 uint64_t b[4];
+    RDATA_ALIGN16 uint64_t c[2];
+    __m128i _a, _b, _b1, _c;
+    uint64_t tweak1_2;
+    uint64_t division_result;
+    uint64_t sqrt_result;
+    uint8_t *local_hp_state;
+    size_t j;
+    union cn_slow_hash_state state;
+};
+
+/**
+ * @brief steps 1 and 2 of cn_slow_hash for one lane of cn_slow_hash_multi (AES-NI only)
+ */
+
+STATIC INLINE void cn_slow_hash_lane_init(struct cn_slow_hash_lane *lane, const void *data, size_t length,
+                                          int variant, int prehashed)
+{
+    RDATA_ALIGN16 uint8_t expandedKey[240];
+    uint8_t text[INIT_SIZE_BYTE];
+    uint8_t *local_hp_state = lane->local_hp_state;
+    uint64_t *b = lane->b;
+    union cn_slow_hash_state state;
+    size_t i;
+
+    if (prehashed) {
+        memcpy(&state.hs, data, length);
+    } else {
+        hash_process(&state.hs, data, length);
+    }
+    memcpy(text, state.init, INIT_SIZE_BYTE);
+
+    VARIANT1_INIT64();
+    VARIANT2_INIT64();
+
+    aes_expand_key(state.hs.b, expandedKey);
+    for(i = 0; i < MEMORY / INIT_SIZE_BYTE; i++)
+    {
+        aes_pseudo_round(text, text, expandedKey, INIT_SIZE_BLK);
+        memcpy(&local_hp_state[i * INIT_SIZE_BYTE], text, INIT_SIZE_BYTE);
+    }
+
+    U64(lane->a)[0] = U64(&state.k[0])[0] ^ U64(&state.k[32])[0];
+    U64(lane->a)[1] = U64(&state.k[0])[1] ^ U64(&state.k[32])[1];
+    U64(b)[0] = U64(&state.k[16])[0] ^ U64(&state.k[48])[0];
+    U64(b)[1] = U64(&state.k[16])[1] ^ U64(&state.k[48])[1];
+
+    lane->state = state;
+    lane->tweak1_2 = tweak1_2;
+    lane->division_result = division_result;
+    lane->sqrt_result = sqrt_result;
+    lane->_b = _mm_load_si128(R128(b));
+    lane->_b1 = _mm_load_si128(R128(b) + 1);
+    lane->j = state_index(lane->a);
+}
+
+/**
+ * @brief first half of a step 3 iteration for one lane: pre_aes, the AES round and the
+ * first scratchpad write of post_aes, then a prefetch of the block the multiply will read
+ */
+
+STATIC INLINE void cn_slow_hash_lane_aes(struct cn_slow_hash_lane *lane, int variant, int reverse)
+{
+    uint8_t *local_hp_state = lane->local_hp_state;
+    const size_t j = lane->j;
+    const __m128i _b = lane->_b, _b1 = lane->_b1;
+    __m128i _a, _c;
+
+    _c = _mm_load_si128(R128(&local_hp_state[j]));
+    _a = _mm_load_si128(R128(lane->a));
+    _c = _mm_aesenc_si128(_c, _a);
+    VARIANT2_SHUFFLE_ADD_SSE2(local_hp_state, j, reverse);
+    _mm_store_si128(R128(lane->c), _c);
+    _mm_store_si128(R128(&local_hp_state[j]), _mm_xor_si128(_b, _c));
+    VARIANT1_1(&local_hp_state[j]);
+
+    lane->_a = _a;
+    lane->_c = _c;
+    lane->j = state_index(lane->c);
+    _mm_prefetch((const char *) &local_hp_state[lane->j], _MM_HINT_T0);
+}
+
+/**
+ * @brief second half of a step 3 iteration for one lane: the rest of post_aes, then a
+ * prefetch of the block the next iteration's AES round will read
+ */
+
+STATIC INLINE void cn_slow_hash_lane_mul(struct cn_slow_hash_lane *lane, int variant, int reverse)
+{
+    uint8_t *local_hp_state = lane->local_hp_state;
+    const size_t j = lane->j;
+    uint64_t *a = lane->a, *b = lane->b, *c = lane->c;
+    const __m128i _a = lane->_a, _b = lane->_b, _b1 = lane->_b1;
+    const uint64_t tweak1_2 = lane->tweak1_2;
+    uint64_t division_result = lane->division_result;
+    uint64_t sqrt_result = lane->sqrt_result;
+    uint64_t hi, lo;
+    uint64_t *p;
+
+    p = U64(&local_hp_state[j]);
+    b[0] = p[0]; b[1] = p[1];
+    VARIANT2_INTEGER_MATH_SSE2(b, c);
+    __mul();
+    VARIANT2_2();
+    VARIANT2_SHUFFLE_ADD_SSE2(local_hp_state, j, reverse);
+    a[0] += hi; a[1] += lo;
+    p = U64(&local_hp_state[j]);
+    p[0] = a[0];  p[1] = a[1];
+    a[0] ^= b[0]; a[1] ^= b[1];
+    VARIANT1_2(p + 1);
+
+    lane->_b1 = _b;
+    lane->_b = lane->_c;
+    lane->division_result = division_result;
+    lane->sqrt_result = sqrt_result;
+    lane->j = state_index(a);
+    _mm_prefetch((const char *) &local_hp_state[lane->j], _MM_HINT_T0);
+}
+
+/**
+ * @brief step 3 for nlanes lanes in lockstep
+ *
+ * The lanes are independent, so while one lane waits on a random scratchpad
+ * read the others have their AES round or multiply to do, and the prefetches
+ * issued at the end of each half have the other lanes' work to hide behind.
+ */
+
+STATIC INLINE void cn_slow_hash_lanes_mix(struct cn_slow_hash_lane *lanes, size_t nlanes, int variant, int reverse, uint64_t iters)
+{
+    uint64_t i;
+    size_t l;
+
+    for(i = 0; i < iters; i++)
+    {
+        for(l = 0; l < nlanes; l++)
+            cn_slow_hash_lane_aes(&lanes[l], variant, reverse);
+        for(l = 0; l < nlanes; l++)
+            cn_slow_hash_lane_mul(&lanes[l], variant, reverse);
+    }
+}
+
+/**
+ * @brief steps 4 and 5 of cn_slow_hash for one lane of cn_slow_hash_multi (AES-NI only)
+ */
+
+STATIC INLINE void cn_slow_hash_lane_final(struct cn_slow_hash_lane *lane, char *hash)
+{
+    RDATA_ALIGN16 uint8_t expandedKey[240];
+    uint8_t text[INIT_SIZE_BYTE];
+    size_t i;
+
+    static void (*const extra_hashes[4])(const void *, size_t, char *) =
+    {
+        hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein
+    };
+
+    memcpy(text, lane->state.init, INIT_SIZE_BYTE);
+    aes_expand_key(&lane->state.hs.b[32], expandedKey);
+    for(i = 0; i < MEMORY / INIT_SIZE_BYTE; i++)
+        aes_pseudo_round_xor(text, text, expandedKey, &lane->local_hp_state[i * INIT_SIZE_BYTE], INIT_SIZE_BLK);
+
+    memcpy(lane->state.init, text, INIT_SIZE_BYTE);
+    hash_permutation(&lane->state.hs);
+    extra_hashes[lane->state.hs.b[0] & 3](&lane->state, 200, hash);
+}
+
+/**
+ * @brief computes cn_slow_hash for count inputs sharing the same variant and modifier
+ *
+ * Up to CN_SLOW_HASH_MAX_LANES hashes are computed together by one thread,
+ * each in its own 2MB scratchpad, with their step 3 iterations interleaved so
+ * the random scratchpad accesses of one hash overlap with the work of the
+ * others. The results are identical to calling cn_slow_hash on each input.
+ * Without hardware AES this falls back to cn_slow_hash on each input.
+ *
+ * @param data the inputs to hash
+ * @param length the lengths in bytes of the inputs
+ * @param hash pointers to count buffers in which the 256 bit hashes will be stored
+ * @param count the number of inputs
+ */
+void cn_slow_hash_multi(const void *const *data, const size_t *length, char *const *hash, size_t count, int variant, int prehashed, int modifier)
+{
+    struct cn_slow_hash_lane lanes[CN_SLOW_HASH_MAX_LANES];
+    const uint64_t iters = (modifier & CN_MODIFIER_WALTZ) ? (3 * ITER) / 8 : ITER / 2;
+    size_t l, nlanes;
+
+    if(force_software_aes() || !check_aes_hw() || count < 2)
+    {
+        for(l = 0; l < count; l++)
+            cn_slow_hash(data[l], length[l], hash[l], variant, prehashed, modifier);
+        return;
+    }
+
+    if(hp_state == NULL)
+        slow_hash_allocate_state();
+    slow_hash_allocate_lanes_state();
+
+    while(count > 0)
+    {
+        nlanes = count < CN_SLOW_HASH_MAX_LANES ? count : CN_SLOW_HASH_MAX_LANES;
+        if(nlanes == 1)
+        {
+            cn_slow_hash(data[0], length[0], hash[0], variant, prehashed, modifier);
+            break;
+        }
+
+        for(l = 0; l < nlanes; l++)
+        {
+            lanes[l].local_hp_state = l == 0 ? hp_state : hp_lanes_state + (l - 1) * MEMORY;
+            cn_slow_hash_lane_init(&lanes[l], data[l], length[l], variant, prehashed);
+        }
+
+        // constant lane counts and reverse flags let the compiler unroll the lanes
+        if(modifier & CN_MODIFIER_REVERSE)
+        {
+            switch(nlanes)
+            {
+                case 2: cn_slow_hash_lanes_mix(lanes, 2, variant, 1, iters); break;
+                case 3: cn_slow_hash_lanes_mix(lanes, 3, variant, 1, iters); break;
+                default: cn_slow_hash_lanes_mix(lanes, 4, variant, 1, iters); break;
+            }
+        }
+        else
+        {
+            switch(nlanes)
+            {
+                case 2: cn_slow_hash_lanes_mix(lanes, 2, variant, 0, iters); break;
+                case 3: cn_slow_hash_lanes_mix(lanes, 3, variant, 0, iters); break;
+                default: cn_slow_hash_lanes_mix(lanes, 4, variant, 0, iters); break;
+            }
+        }
+
+        for(l = 0; l < nlanes; l++)
+            cn_slow_hash_lane_final(&lanes[l], hash[l]);
+
+        data += nlanes;
+        length += nlanes;
+        hash += nlanes;
+        count -= nlanes;
+    }
+}
+
 #elif !defined NO_AES && (defined(__arm__) || defined(__aarch64__))
 void slow_hash_allocate_state(void)
 {
@@ -1629,3 +1935,13 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
 }
 
 #endif
+
+#ifndef HAVE_CN_SLOW_HASH_MULTI
+// no interleaved implementation on this platform, hash the inputs one by one
+void cn_slow_hash_multi(const void *const *data, const size_t *length, char *const *hash, size_t count, int variant, int prehashed, int modifier)
+{
+  size_t i;
+  for (i = 0; i < count; i++)
+    cn_slow_hash(data[i], length[i], hash[i], variant, prehashed, modifier);
+}
+#endif
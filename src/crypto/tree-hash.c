@@ -59,6 +59,30 @@ size_t tree_hash_cnt(size_t count) {
 	return pow >> 1;
 }
 
+/***
+* Hashes count pairs of consecutive hashes from in to count hashes at out,
+* several pairs at a time. out may be in, since pair j is read no later than
+* hash j is written.
+*/
+static void tree_hash_level(const char *in, size_t count, char *out) {
+  const void *data[CN_FAST_HASH_MAX_LANES];
+  size_t length[CN_FAST_HASH_MAX_LANES];
+  char buf[CN_FAST_HASH_MAX_LANES][HASH_SIZE];
+  char *hash[CN_FAST_HASH_MAX_LANES];
+  size_t j, k, n;
+
+  for (j = 0; j < count; j += n) {
+    n = count - j < CN_FAST_HASH_MAX_LANES ? count - j : CN_FAST_HASH_MAX_LANES;
+    for (k = 0; k < n; ++k) {
+      data[k] = in + (j + k) * 2 * HASH_SIZE;
+      length[k] = 2 * HASH_SIZE;
+      hash[k] = buf[k];
+    }
+    cn_fast_hash_multi(data, length, hash, n);
+    memcpy(out + j * HASH_SIZE, buf, n * HASH_SIZE);
+  }
+}
+
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 // The blockchain block at height 202612 https://moneroblocks.info/block/202612
 // contained 514 transactions, that triggered bad calculation of variable "cnt" in the original version of this function
@@ -79,8 +103,6 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   } else if (count == 2) {
     cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
   } else {
-    size_t i, j;
-
     size_t cnt = tree_hash_cnt( count );
 
     char *ints = calloc(cnt, HASH_SIZE);  // zero out as extra protection for using uninitialized mem
@@ -88,16 +110,12 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints + j * HASH_SIZE);
-    }
-    assert(i == count);
+    // the remaining count - cnt pairs make up the rest of the first level
+    tree_hash_level(hashes[2 * cnt - count], count - cnt, ints + (2 * cnt - count) * HASH_SIZE);
 
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints + i * HASH_SIZE, 64, ints + j * HASH_SIZE);
-      }
+      tree_hash_level(ints, cnt, ints);
     }
 
     cn_fast_hash(ints, 64, root_hash);
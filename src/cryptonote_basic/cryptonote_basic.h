@@ -266,6 +266,8 @@ namespace cryptonote
     // hash cash
     mutable std::atomic<bool> hash_valid;
     mutable std::atomic<bool> blob_size_valid;
+    mutable std::atomic<bool> prefix_hash_valid;
+    mutable std::atomic<bool> prunable_hash_valid;
 
   public:
     std::vector<std::vector<crypto::signature> > signatures; //count signatures  always the same as inputs count
@@ -274,6 +276,9 @@ namespace cryptonote
     // hash cash
     mutable crypto::hash hash;
     mutable size_t blob_size;
+    // sub-hashes, set along with the hash
+    mutable crypto::hash prefix_hash;
+    mutable crypto::hash prunable_hash;
 
     // graft: introducing transaction type. currently this field is not used to calculate tx hash
     // TODO: probably move it to transaction_prefix.extra
@@ -299,15 +304,20 @@ namespace cryptonote
     std::atomic<unsigned int> v3_fields_size;
 
     transaction();
-    transaction(const transaction &t): transaction_prefix(t), hash_valid(false), blob_size_valid(false), signatures(t.signatures), rct_signatures(t.rct_signatures), type(t.type), extra2(t.extra2), pruned(t.pruned), unprunable_size(t.unprunable_size.load()), prefix_size(t.prefix_size.load()), v3_fields_size(t.v3_fields_size.load()) { if (t.is_hash_valid()) { hash = t.hash; set_hash_valid(true); } if (t.is_blob_size_valid()) { blob_size = t.blob_size; set_blob_size_valid(true); } }
-    transaction &operator=(const transaction &t) { transaction_prefix::operator=(t); set_hash_valid(false); set_blob_size_valid(false); signatures = t.signatures; rct_signatures = t.rct_signatures; type = t.type; extra2 = t.extra2; if (t.is_hash_valid()) { hash = t.hash; set_hash_valid(true); } if (t.is_blob_size_valid()) { blob_size = t.blob_size; set_blob_size_valid(true); } pruned = t.pruned; unprunable_size = t.unprunable_size.load(); prefix_size = t.prefix_size.load(); v3_fields_size = t.v3_fields_size.load(); return *this; }
+    transaction(const transaction &t): transaction_prefix(t), hash_valid(false), blob_size_valid(false), prefix_hash_valid(false), prunable_hash_valid(false), signatures(t.signatures), rct_signatures(t.rct_signatures), type(t.type), extra2(t.extra2), pruned(t.pruned), unprunable_size(t.unprunable_size.load()), prefix_size(t.prefix_size.load()), v3_fields_size(t.v3_fields_size.load()) { if (t.is_hash_valid()) { hash = t.hash; set_hash_valid(true); } if (t.is_blob_size_valid()) { blob_size = t.blob_size; set_blob_size_valid(true); } if (t.is_prefix_hash_valid()) { prefix_hash = t.prefix_hash; set_prefix_hash_valid(true); } if (t.is_prunable_hash_valid()) { prunable_hash = t.prunable_hash; set_prunable_hash_valid(true); } }
+    transaction &operator=(const transaction &t) { transaction_prefix::operator=(t); set_hash_valid(false); set_blob_size_valid(false); set_prefix_hash_valid(false); set_prunable_hash_valid(false); signatures = t.signatures; rct_signatures = t.rct_signatures; type = t.type; extra2 = t.extra2; if (t.is_hash_valid()) { hash = t.hash; set_hash_valid(true); } if (t.is_blob_size_valid()) { blob_size = t.blob_size; set_blob_size_valid(true); } if (t.is_prefix_hash_valid()) { prefix_hash = t.prefix_hash; set_prefix_hash_valid(true); } if (t.is_prunable_hash_valid()) { prunable_hash = t.prunable_hash; set_prunable_hash_valid(true); } pruned = t.pruned; unprunable_size = t.unprunable_size.load(); prefix_size = t.prefix_size.load(); v3_fields_size = t.v3_fields_size.load(); return *this; }
     virtual ~transaction();
     void set_null();
     void invalidate_hashes();
+    void prepare_reparse();
     bool is_hash_valid() const { return hash_valid.load(std::memory_order_acquire); }
     void set_hash_valid(bool v) const { hash_valid.store(v,std::memory_order_release); }
     bool is_blob_size_valid() const { return blob_size_valid.load(std::memory_order_acquire); }
     void set_blob_size_valid(bool v) const { blob_size_valid.store(v,std::memory_order_release); }
+    bool is_prefix_hash_valid() const { return prefix_hash_valid.load(std::memory_order_acquire); }
+    void set_prefix_hash_valid(bool v) const { prefix_hash_valid.store(v,std::memory_order_release); }
+    bool is_prunable_hash_valid() const { return prunable_hash_valid.load(std::memory_order_acquire); }
+    void set_prunable_hash_valid(bool v) const { prunable_hash_valid.store(v,std::memory_order_release); }
     void set_hash(const crypto::hash &h) { hash = h; set_hash_valid(true); }
     void set_blob_size(size_t sz) { blob_size = sz; set_blob_size_valid(true); }
 
@@ -316,6 +326,8 @@ namespace cryptonote
       {
         set_hash_valid(false);
         set_blob_size_valid(false);
+        set_prefix_hash_valid(false);
+        set_prunable_hash_valid(false);
       }
 
       const unsigned int start_pos = getpos(ar);
@@ -447,6 +459,8 @@ namespace cryptonote
     rct_signatures.type = rct::RCTTypeNull;
     set_hash_valid(false);
     set_blob_size_valid(false);
+    set_prefix_hash_valid(false);
+    set_prunable_hash_valid(false);
     type = tx_type_generic;
     pruned = false;
     unprunable_size = 0;
@@ -459,6 +473,41 @@ namespace cryptonote
   {
     set_hash_valid(false);
     set_blob_size_valid(false);
+    set_prefix_hash_valid(false);
+    set_prunable_hash_valid(false);
+  }
+
+  // Parsing overwrites a tx in place, and vectors it resizes keep their
+  // buffers. This resets what a parse would leave untouched to what a new
+  // tx holds, so a tx can be parsed into again and again without most of
+  // its allocations. RCT data of a tx that turns out to have none is reset
+  // after the parse, see parse_and_validate_tx_from_blob.
+  inline
+  void transaction::prepare_reparse()
+  {
+    invalidate_hashes();
+    signatures.clear();
+    type = tx_type_generic;
+    extra2.clear();
+    pruned = false;
+    unprunable_size = 0;
+    prefix_size = 0;
+    v3_fields_size = 0;
+
+    rct::rctSig &rv = rct_signatures;
+    rv.type = rct::RCTTypeNull;
+    rv.message = rct::key{};
+    rv.mixRing.clear();
+    rv.pseudoOuts.clear();
+    for (rct::ecdhTuple &ecdh: rv.ecdhInfo)
+      ecdh = rct::ecdhTuple{};
+    for (rct::ctkey &pk: rv.outPk)
+      pk = rct::ctkey{};
+    rv.p.pseudoOuts.clear();
+    for (rct::mgSig &mg: rv.p.MGs)
+      mg.II.clear();
+    for (rct::Bulletproof &bp: rv.p.bulletproofs)
+      bp.V.clear();
   }
 
   inline
@@ -39,7 +39,8 @@
 #include "crypto/crypto.h"
 #include "crypto/hash.h"
 #include "ringct/rctSigs.h"
-#include "serialization/binary_utils.h" 
+#include "serialization/binary_utils.h"
+#include "common/threadpool.h"
 
 using namespace epee;
 
@@ -125,6 +126,27 @@ namespace cryptonote
     return h;
   }
   //---------------------------------------------------------------
+  void get_transaction_prefix_hash(const transaction& tx, crypto::hash& h)
+  {
+    if (tx.is_prefix_hash_valid())
+    {
+#ifdef ENABLE_HASH_CASH_INTEGRITY_CHECK
+      get_transaction_prefix_hash(static_cast<const transaction_prefix&>(tx), h);
+      CHECK_AND_ASSERT_THROW_MES(tx.prefix_hash == h, "tx prefix hash cash integrity failure");
+#endif
+      h = tx.prefix_hash;
+      return;
+    }
+    get_transaction_prefix_hash(static_cast<const transaction_prefix&>(tx), h);
+  }
+  //---------------------------------------------------------------
+  crypto::hash get_transaction_prefix_hash(const transaction& tx)
+  {
+    crypto::hash h = null_hash;
+    get_transaction_prefix_hash(tx, h);
+    return h;
+  }
+  //---------------------------------------------------------------
   bool expand_transaction_1(transaction &tx, bool base_only)
   {
     if (tx.version >= 2 && !is_coinbase(tx))
@@ -177,12 +199,28 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
+  // Parses tx_blob where it lies into tx, which may hold a previously parsed
+  // tx whose buffers are then reused (see transaction::prepare_reparse).
+  // serialize is the part of the tx to read from the archive.
+  template<typename F>
+  static bool parse_tx_in_place(const blobdata& tx_blob, transaction& tx, F serialize)
+  {
+    ::serialization::span_streambuf buf(tx_blob.data(), tx_blob.size());
+    std::istream is(&buf);
+    binary_archive<false> ba(is);
+    tx.prepare_reparse();
+    if (!serialize(ba))
+      return false;
+    if (tx.rct_signatures.type == rct::RCTTypeNull)
+      tx.rct_signatures = rct::rctSig();
+    else if (tx.pruned)
+      tx.rct_signatures.p = rct::rctSigPrunable();
+    return true;
+  }
+  //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
-    bool r = ::serialization::serialize(ba, tx);
+    bool r = parse_tx_in_place(tx_blob, tx, [&tx](binary_archive<false> &ba) { return ::serialization::serialize(ba, tx); });
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     CHECK_AND_ASSERT_MES(expand_transaction_1(tx, false), false, "Failed to expand transaction data");
     tx.invalidate_hashes();
@@ -192,10 +230,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_base_from_blob(const blobdata& tx_blob, transaction& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
-    bool r = tx.serialize_base(ba);
+    bool r = parse_tx_in_place(tx_blob, tx, [&tx](binary_archive<false> &ba) { return tx.serialize_base(ba); });
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     CHECK_AND_ASSERT_MES(expand_transaction_1(tx, true), false, "Failed to expand transaction data");
     tx.invalidate_hashes();
@@ -204,9 +239,9 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_prefix_from_blob(const blobdata& tx_blob, transaction_prefix& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
+    ::serialization::span_streambuf buf(tx_blob.data(), tx_blob.size());
+    std::istream is(&buf);
+    binary_archive<false> ba(is);
     bool r = ::serialization::serialize_noeof(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction prefix from blob");
     return true;
@@ -214,10 +249,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx, crypto::hash& tx_hash)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
-    bool r = ::serialization::serialize(ba, tx);
+    bool r = parse_tx_in_place(tx_blob, tx, [&tx](binary_archive<false> &ba) { return ::serialization::serialize(ba, tx); });
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     CHECK_AND_ASSERT_MES(expand_transaction_1(tx, false), false, "Failed to expand transaction data");
     tx.invalidate_hashes();
@@ -250,7 +282,7 @@ namespace cryptonote
     return is_v1_tx(blobdata_ref{tx_blob.data(), tx_blob.size()});
   }
   //---------------------------------------------------------------
-  bool generate_key_image_helper(const account_keys& ack, const std::unordered_map<crypto::public_key, subaddress_index>& subaddresses, const crypto::public_key& out_key, const crypto::public_key& tx_public_key, const std::vector<crypto::public_key>& additional_tx_public_keys, size_t real_output_index, keypair& in_ephemeral, crypto::key_image& ki, hw::device &hwdev)
+  bool generate_key_image_helper(const account_keys& ack, const subaddress_map& subaddresses, const crypto::public_key& out_key, const crypto::public_key& tx_public_key, const std::vector<crypto::public_key>& additional_tx_public_keys, size_t real_output_index, keypair& in_ephemeral, crypto::key_image& ki, hw::device &hwdev)
   {
     crypto::key_derivation recv_derivation = AUTO_VAL_INIT(recv_derivation);
     bool r = hwdev.generate_key_derivation(tx_public_key, ack.m_view_secret_key, recv_derivation);
@@ -851,7 +883,7 @@ namespace cryptonote
     return false;
   }
   //---------------------------------------------------------------
-  boost::optional<subaddress_receive_info> is_out_to_acc_precomp(const std::unordered_map<crypto::public_key, subaddress_index>& subaddresses, const crypto::public_key& out_key, const crypto::key_derivation& derivation, const std::vector<crypto::key_derivation>& additional_derivations, size_t output_index, hw::device &hwdev)
+  boost::optional<subaddress_receive_info> is_out_to_acc_precomp(const subaddress_map& subaddresses, const crypto::public_key& out_key, const crypto::key_derivation& derivation, const std::vector<crypto::key_derivation>& additional_derivations, size_t output_index, hw::device &hwdev)
   {
     // try the shared tx pubkey
     crypto::public_key subaddress_spendkey;
@@ -1022,6 +1054,13 @@ namespace cryptonote
   crypto::hash get_transaction_prunable_hash(const transaction& t, const cryptonote::blobdata *blobdata)
   {
     crypto::hash res;
+    if (t.is_prunable_hash_valid())
+    {
+#ifdef ENABLE_HASH_CASH_INTEGRITY_CHECK
+      CHECK_AND_ASSERT_THROW_MES(!calculate_transaction_prunable_hash(t, blobdata, res) || t.prunable_hash == res, "tx prunable hash cash integrity failure");
+#endif
+      return t.prunable_hash;
+    }
     CHECK_AND_ASSERT_THROW_MES(calculate_transaction_prunable_hash(t, blobdata, res), "Failed to calculate tx prunable hash");
     return res;
   }
@@ -1073,16 +1112,15 @@ namespace cryptonote
     // v2 transactions hash different parts together, than hash the set of those hashes
     crypto::hash hashes[3];
 
-    // prefix
-    get_transaction_prefix_hash(t, hashes[0]);
-
+    // all three parts are slices of the one serialized blob, and are hashed together
     const blobdata blob = tx_to_blob(t);
     const unsigned int unprunable_size = t.unprunable_size;
     const unsigned int prefix_size = t.prefix_size;
-
-    // base rct
     CHECK_AND_ASSERT_MES(prefix_size <= unprunable_size && unprunable_size <= blob.size(), false, "Inconsistent transaction prefix, unprunable and blob sizes");
-    cryptonote::get_blob_hash(epee::span<const char>(blob.data() + prefix_size, unprunable_size - prefix_size), hashes[1]);
+    const void *data[3] = {blob.data(), blob.data() + prefix_size, NULL};
+    size_t length[3] = {prefix_size, unprunable_size - prefix_size, 0};
+    char *hash_ptrs[3] = {hashes[0].data, hashes[1].data, hashes[2].data};
+    size_t parts = 2;
 
     // prunable rct
     if (t.rct_signatures.type == rct::RCTTypeNull)
@@ -1091,7 +1129,20 @@ namespace cryptonote
     }
     else
     {
-      CHECK_AND_ASSERT_MES(calculate_transaction_prunable_hash(t, &blob, hashes[2]), false, "Failed to get tx prunable hash");
+      const unsigned int v3_fields_len = (t.version == 3) ? t.v3_fields_size.load() : 0;
+      CHECK_AND_ASSERT_MES(unprunable_size <= blob.size() - v3_fields_len, false, "Inconsistent transaction unprunable and blob sizes");
+      data[2] = blob.data() + unprunable_size;
+      length[2] = blob.size() - unprunable_size - v3_fields_len;
+      parts = 3;
+    }
+    crypto::cn_fast_hash_multi(data, length, hash_ptrs, parts);
+
+    t.prefix_hash = hashes[0];
+    t.set_prefix_hash_valid(true);
+    if (parts == 3)
+    {
+      t.prunable_hash = hashes[2];
+      t.set_prunable_hash_valid(true);
     }
 
     // the tx hash is the hash of the 3 hashes
@@ -1209,18 +1260,53 @@ namespace cryptonote
     return p;
   }
   //---------------------------------------------------------------
-  bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height)
+  static void get_block_longhash_params(const block& b, int &cn_variant, int &cn_modifier)
   {
-    blobdata bd = get_block_hashing_blob(b);
     // variant = 0 for versions less than 8
     // variant = 1 for versions between 8 and 11
     // variant = 2 for versions 11 and greater
-    const int cn_variant = b.major_version < 8 ? 0 : b.major_version >= 11 ? 2 : 1;
-    const int cn_modifier = b.major_version < 12 ? CN_MODIFIER_NONE : CN_MODIFIER_REVERSE_WALTZ;
+    cn_variant = b.major_version < 8 ? 0 : b.major_version >= 11 ? 2 : 1;
+    cn_modifier = b.major_version < 12 ? CN_MODIFIER_NONE : CN_MODIFIER_REVERSE_WALTZ;
+  }
+  //---------------------------------------------------------------
+  bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height)
+  {
+    blobdata bd = get_block_hashing_blob(b);
+    int cn_variant, cn_modifier;
+    get_block_longhash_params(b, cn_variant, cn_modifier);
     crypto::cn_slow_hash(bd.data(), bd.size(), res, cn_variant, cn_modifier);
     return true;
   }
   //---------------------------------------------------------------
+  void get_block_longhash(const epee::span<const block> &blocks, crypto::hash *res, uint64_t height)
+  {
+    // runs of blocks with the same PoW variant are hashed together, interleaved in this thread
+    for (size_t i = 0; i < blocks.size(); )
+    {
+      int cn_variant, cn_modifier;
+      get_block_longhash_params(blocks[i], cn_variant, cn_modifier);
+      std::vector<blobdata> bd;
+      std::vector<const void*> data;
+      std::vector<size_t> length;
+      std::vector<char*> hashes;
+      for (; i < blocks.size() && bd.size() < CN_SLOW_HASH_MAX_LANES; ++i)
+      {
+        int v, m;
+        get_block_longhash_params(blocks[i], v, m);
+        if (v != cn_variant || m != cn_modifier)
+          break;
+        bd.push_back(get_block_hashing_blob(blocks[i]));
+        hashes.push_back(res[i].data);
+      }
+      for (const blobdata &blob: bd)
+      {
+        data.push_back(blob.data());
+        length.push_back(blob.size());
+      }
+      crypto::cn_slow_hash_multi(data.data(), length.data(), hashes.data(), bd.size(), cn_variant, 0/*prehashed*/, cn_modifier);
+    }
+  }
+  //---------------------------------------------------------------
   std::vector<uint64_t> relative_output_offsets_to_absolute(const std::vector<uint64_t>& off)
   {
     std::vector<uint64_t> res = off;
@@ -1250,9 +1336,9 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b, crypto::hash *block_hash)
   {
-    std::stringstream ss;
-    ss << b_blob;
-    binary_archive<false> ba(ss);
+    ::serialization::span_streambuf buf(b_blob.data(), b_blob.size());
+    std::istream is(&buf);
+    binary_archive<false> ba(is);
     bool r = ::serialization::serialize(ba, b);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse block from blob");
     b.invalidate_hashes();
@@ -1299,7 +1385,51 @@ namespace cryptonote
   //---------------------------------------------------------------
   void get_tx_tree_hash(const std::vector<crypto::hash>& tx_hashes, crypto::hash& h)
   {
-    tree_hash(tx_hashes.data(), tx_hashes.size(), h);
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    const size_t threads = tpool.get_max_concurrency();
+    const size_t count = tx_hashes.size();
+    if (count < TX_TREE_HASH_PARALLEL_MIN_HASHES || threads < 2)
+    {
+      tree_hash(tx_hashes.data(), count, h);
+      return;
+    }
+
+    // Past its first level, the tree is a perfect one over cnt nodes: the
+    // first 2 * cnt - count leaves as they are, then the remaining leaves
+    // hashed in pairs. Each thread builds and hashes one power of two sized
+    // subtree of those nodes, and the subtree roots are hashed last.
+    const size_t cnt = crypto::tree_hash_cnt(count);
+    const size_t offset = 2 * cnt - count;
+    size_t subtrees = 1;
+    while (subtrees * 2 <= threads && cnt / (subtrees * 2) >= 2)
+      subtrees *= 2;
+    const size_t leaves = cnt / subtrees;
+    std::vector<crypto::hash> nodes(cnt), roots(subtrees);
+
+    tools::threadpool::waiter waiter;
+    for (size_t p = 0; p < subtrees; ++p)
+    {
+      tpool.submit(&waiter, [&, p]() {
+        std::vector<const void*> data;
+        std::vector<size_t> length;
+        std::vector<char*> out;
+        for (size_t j = p * leaves; j < (p + 1) * leaves; ++j)
+        {
+          if (j < offset)
+          {
+            nodes[j] = tx_hashes[j];
+            continue;
+          }
+          data.push_back(&tx_hashes[offset + 2 * (j - offset)]);
+          length.push_back(2 * sizeof(crypto::hash));
+          out.push_back(nodes[j].data);
+        }
+        crypto::cn_fast_hash_multi(data.data(), length.data(), out.data(), out.size());
+        crypto::tree_hash(nodes.data() + p * leaves, leaves, roots[p]);
+      });
+    }
+    waiter.wait(&tpool);
+    crypto::tree_hash(roots.data(), subtrees, h);
   }
   //---------------------------------------------------------------
   crypto::hash get_tx_tree_hash(const std::vector<crypto::hash>& tx_hashes)
@@ -0,0 +1,214 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <boost/serialization/split_free.hpp>
+#include "misc_log_ex.h"
+#include "crypto/crypto.h"
+#include "subaddress_index.h"
+
+namespace cryptonote
+{
+  /*!
+   * \brief Map from subaddress spend public keys to their index
+   *
+   * Open addressing table with linear probing. Slots are 8 bytes, a part of the key
+   * prefix and the position of the entry, so probing stays within a few cache lines and
+   * the full keys are only compared on a prefix match. Entries are kept in insertion
+   * order in a separate array. Keys are curve points, so their prefix is already
+   * uniformly distributed. Entries can not be erased, as subaddresses never are.
+   */
+  class subaddress_map
+  {
+  public:
+    typedef crypto::public_key key_type;
+    typedef subaddress_index mapped_type;
+    typedef std::pair<const crypto::public_key, subaddress_index> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+
+    iterator begin() { return m_entries.begin(); }
+    iterator end() { return m_entries.end(); }
+    const_iterator begin() const { return m_entries.begin(); }
+    const_iterator end() const { return m_entries.end(); }
+
+    void clear()
+    {
+      m_entries.clear();
+      m_slots.clear();
+    }
+
+    void reserve(size_t n)
+    {
+      m_entries.reserve(n);
+      if (n > max_load(m_slots.size()))
+        rehash(n);
+    }
+
+    iterator find(const crypto::public_key &key)
+    {
+      const size_t pos = lookup(key);
+      return pos == NONE ? m_entries.end() : m_entries.begin() + pos;
+    }
+    const_iterator find(const crypto::public_key &key) const
+    {
+      const size_t pos = lookup(key);
+      return pos == NONE ? m_entries.end() : m_entries.begin() + pos;
+    }
+    size_t count(const crypto::public_key &key) const { return lookup(key) == NONE ? 0 : 1; }
+
+    std::pair<iterator, bool> emplace(const crypto::public_key &key, const subaddress_index &index)
+    {
+      const size_t pos = lookup(key);
+      if (pos != NONE)
+        return std::make_pair(m_entries.begin() + pos, false);
+      CHECK_AND_ASSERT_THROW_MES(m_entries.size() < (uint32_t)-1, "Too many subaddresses");
+      if (m_entries.size() + 1 > max_load(m_slots.size()))
+        rehash(m_entries.size() + 1);
+      m_entries.emplace_back(key, index);
+      place(key, m_entries.size());
+      return std::make_pair(m_entries.end() - 1, true);
+    }
+    std::pair<iterator, bool> insert(const value_type &value) { return emplace(value.first, value.second); }
+    template<typename It>
+    void insert(It first, It last)
+    {
+      for (; first != last; ++first)
+        emplace(first->first, first->second);
+    }
+
+    subaddress_index &operator[](const crypto::public_key &key) { return emplace(key, subaddress_index{0, 0}).first->second; }
+
+  private:
+    static constexpr size_t NONE = (size_t)-1;
+    static constexpr size_t MIN_SLOTS = 16;
+
+    struct slot
+    {
+      uint32_t tag;
+      uint32_t pos; // position of the entry + 1, 0 if the slot is free
+    };
+
+    static uint64_t prefix(const crypto::public_key &key)
+    {
+      uint64_t p;
+      memcpy(&p, key.data, sizeof(p));
+      return p;
+    }
+    // slots are at most 3/4 full
+    static size_t max_load(size_t slots) { return slots - slots / 4; }
+
+    size_t lookup(const crypto::public_key &key) const
+    {
+      if (m_slots.empty())
+        return NONE;
+      const uint64_t p = prefix(key);
+      const uint32_t tag = p >> 32;
+      const size_t mask = m_slots.size() - 1;
+      for (size_t i = p & mask; m_slots[i].pos; i = (i + 1) & mask)
+      {
+        if (m_slots[i].tag == tag && m_entries[m_slots[i].pos - 1].first == key)
+          return m_slots[i].pos - 1;
+      }
+      return NONE;
+    }
+
+    void place(const crypto::public_key &key, uint32_t pos)
+    {
+      const uint64_t p = prefix(key);
+      const size_t mask = m_slots.size() - 1;
+      size_t i = p & mask;
+      while (m_slots[i].pos)
+        i = (i + 1) & mask;
+      m_slots[i] = slot{(uint32_t)(p >> 32), pos};
+    }
+
+    void rehash(size_t n)
+    {
+      size_t slots = MIN_SLOTS;
+      while (max_load(slots) < n)
+        slots *= 2;
+      m_slots.assign(slots, slot{0, 0});
+      for (size_t i = 0; i < m_entries.size(); ++i)
+        place(m_entries[i].first, i + 1);
+    }
+
+    std::vector<value_type> m_entries;
+    std::vector<slot> m_slots;
+  };
+}
+
+namespace boost
+{
+  namespace serialization
+  {
+    // same layout as the std::unordered_map serializer in common/unordered_containers_boost_serialization.h,
+    // which the wallet caches were written with
+    template <class Archive>
+    inline void save(Archive &a, const cryptonote::subaddress_map &x, const boost::serialization::version_type ver)
+    {
+      size_t s = x.size();
+      a << s;
+      for (const auto &v: x)
+      {
+        a << v.first;
+        a << v.second;
+      }
+    }
+
+    template <class Archive>
+    inline void load(Archive &a, cryptonote::subaddress_map &x, const boost::serialization::version_type ver)
+    {
+      x.clear();
+      size_t s = 0;
+      a >> s;
+      x.reserve(s);
+      for (size_t i = 0; i != s; i++)
+      {
+        crypto::public_key k;
+        cryptonote::subaddress_index v;
+        a >> k;
+        a >> v;
+        x.emplace(k, v);
+      }
+    }
+
+    template <class Archive>
+    inline void serialize(Archive &a, cryptonote::subaddress_map &x, const boost::serialization::version_type ver)
+    {
+      split_free(a, x, ver);
+    }
+  }
+}
@@ -134,7 +134,14 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_TX_RELAY_ANNOUNCE              0x02
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_TX_RELAY_ANNOUNCE)
+
+#define P2P_TX_RECONCILIATION_INTERVAL                  30         // seconds
+#define P2P_TX_SKETCH_CELLS                             120        // 3 hash functions, must be a multiple of 3
+#define P2P_TX_SKETCH_MAX_CELLS                         3000
+#define P2P_TX_REQUEST_TIMEOUT                          10         // seconds
+#define P2P_TX_INVENTORY_MAX_PER_PEER                   20000
 
 #define ALLOW_DEBUG_COMMANDS
 
@@ -164,6 +171,11 @@
 #define DEFAULT_TXPOOL_MAX_WEIGHT               648000000ull // 3 days at 300000, in bytes
 
 #define BULLETPROOF_MAX_OUTPUTS                 16
+#define BULLETPROOF_BATCH_WINDOW_US             3000 // how long a relayed tx waits for others to share its bulletproof batch
+#define BULLETPROOF_BATCH_MAX_PROOFS            64
+#define RCT_POINT_CACHE_MAX_ENTRIES             65536 // ring member keys whose decompression and hash to point are kept, ~28 MB
+#define RCT_VER_CACHE_MAX_ENTRIES               16384 // pool txes whose ringct signatures are not checked again when mined
+#define TX_TREE_HASH_PARALLEL_MIN_HASHES       1024 // blocks with at least that many txes get their merkle root hashed in parallel
 
 #define CRYPTONOTE_PRUNING_STRIPE_SIZE          4096 // the smaller, the smoother the increase
 #define CRYPTONOTE_PRUNING_LOG_STRIPES          3 // the higher, the more space saved
@@ -204,6 +204,7 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool)
   m_long_term_effective_median_block_weight(0),
   m_long_term_block_weights_cache_tip_hash(crypto::null_hash),
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
+  m_rct_ver_cache(RCT_VER_CACHE_MAX_ENTRIES),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
   m_btc_valid(false),
@@ -2855,12 +2856,31 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
   return true;
 }
 //------------------------------------------------------------------
+// The key covers the tx hash (and thus its prunable data, signatures
+// included) and every ring member key and commitment the signatures were
+// checked against. Should a reorg change what an output index resolves
+// to, the key changes with it, so a stale entry can never be hit.
+crypto::hash Blockchain::get_rct_ver_cache_key(const transaction &tx, const std::vector<std::vector<rct::ctkey>> &pubkeys)
+{
+  size_t n_keys = 0;
+  for (const auto &ring: pubkeys)
+    n_keys += ring.size();
+  std::string data;
+  data.reserve(sizeof(crypto::hash) + n_keys * sizeof(rct::ctkey));
+  const crypto::hash tx_hash = get_transaction_hash(tx);
+  data.append((const char*)&tx_hash, sizeof(tx_hash));
+  for (const auto &ring: pubkeys)
+    for (const auto &member: ring)
+      data.append((const char*)&member, sizeof(member));
+  return crypto::cn_fast_hash(data.data(), data.size());
+}
+//------------------------------------------------------------------
 // This function validates transaction inputs and their keys.
 // FIXME: consider moving functionality specific to one input into
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height)
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, std::vector<const rct::rctSig*> *deferred_rct)
 {
   PERF_TIMER(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -3163,11 +3183,29 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimple(rv))
+      // a tx we already verified against these very ring members (typically
+      // on pool admission) does not need its MLSAGs checked again
+      const crypto::hash rct_ver_key = get_rct_ver_cache_key(tx, pubkeys);
+      if (m_rct_ver_cache.contains(rct_ver_key))
+      {
+        MDEBUG("Skipping ringct signature check for tx " << get_transaction_hash(tx) << ", verified already");
+        // at block time, the tx is leaving the pool for good
+        if (deferred_rct)
+          m_rct_ver_cache.erase(rct_ver_key);
+      }
+      else if (deferred_rct)
+      {
+        deferred_rct->push_back(&rv);
+      }
+      else if (!rct::verRctNonSemanticsSimple(rv))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
       }
+      else
+      {
+        m_rct_ver_cache.add(rct_ver_key);
+      }
       break;
     }
     case rct::RCTTypeFull:
@@ -3771,6 +3809,9 @@ leave:
 
   std::vector<std::pair<transaction, blobdata>> txs;
   key_images_container keys;
+  // MLSAGs of the block's txes, verified together once all other checks passed
+  std::vector<const rct::rctSig*> deferred_rct;
+  std::vector<crypto::hash> deferred_rct_txids;
 
   uint64_t fee_summary = 0;
   uint64_t t_checktx = 0;
@@ -3849,7 +3890,8 @@ leave:
     {
       // validate that transaction inputs and the keys spending them are correct.
       tx_verification_context tvc;
-      if(!check_tx_inputs(tx, tvc))
+      const size_t n_deferred = deferred_rct.size();
+      if(!check_tx_inputs(tx, tvc, NULL, &deferred_rct))
       {
         MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -3862,6 +3904,8 @@ leave:
         return_tx_to_pool(txs);
         goto leave;
       }
+      if (deferred_rct.size() != n_deferred)
+        deferred_rct_txids.push_back(tx_id);
     }
 #if defined(PER_BLOCK_CHECKPOINT)
     else
@@ -3888,6 +3932,31 @@ leave:
 
   m_blocks_txs_check.clear();
 
+  if (!deferred_rct.empty())
+  {
+    TIME_MEASURE_START(ver_rct);
+    const bool rct_ok = rct::verRctNonSemanticsSimple(deferred_rct);
+    TIME_MEASURE_FINISH(ver_rct);
+    t_checktx += ver_rct;
+    if (!rct_ok)
+    {
+      // the batch only says the block is bad, recheck one by one to name the tx
+      for (size_t i = 0; i < deferred_rct.size(); ++i)
+      {
+        if (!rct::verRctNonSemanticsSimple(*deferred_rct[i]))
+        {
+          MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << deferred_rct_txids[i] << ") with wrong inputs.");
+          break;
+        }
+      }
+      add_block_as_invalid(bl, id);
+      MERROR_VER("Block with id " << id << " added as invalid because of wrong inputs in transactions");
+      bvc.m_verifivation_failed = true;
+      return_tx_to_pool(txs);
+      goto leave;
+    }
+  }
+
   TIME_MEASURE_START(vmt);
   uint64_t base_reward = 0;
   uint64_t already_generated_coins = blockchain_height ? m_db->get_block_already_generated_coins(blockchain_height - 1) : 0;
@@ -4227,13 +4296,15 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
   TIME_MEASURE_START(t);
   slow_hash_allocate_state();
 
-  for (const auto & block : blocks)
+  crypto::hash pow[CN_SLOW_HASH_MAX_LANES];
+  for (size_t i = 0; i < blocks.size(); i += CN_SLOW_HASH_MAX_LANES)
   {
     if (m_cancel)
        break;
-    crypto::hash id = get_block_hash(block);
-    crypto::hash pow = get_block_longhash(block, height++);
-    map.emplace(id, pow);
+    const size_t n = std::min<size_t>(CN_SLOW_HASH_MAX_LANES, blocks.size() - i);
+    get_block_longhash(epee::span<const block>(blocks.data() + i, n), pow, height + i);
+    for (size_t j = 0; j < n; ++j)
+      map.emplace(get_block_hash(blocks[i + j]), pow[j]);
   }
 
   slow_hash_free_state();
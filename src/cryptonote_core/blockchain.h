@@ -38,6 +38,7 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <unordered_map>
 #include <unordered_set>
@@ -57,6 +58,7 @@
 #include "checkpoints/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "rct_ver_cache.h"
 
 namespace tools { class Notify; }
 
@@ -1046,6 +1048,9 @@ namespace cryptonote
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, bool>> m_check_txin_table;
 
+    // simple ringct txes whose MLSAGs passed, see get_rct_ver_cache_key
+    rct_ver_cache m_rct_ver_cache;
+
     // SHA-3 hashes for each block and for fast pow checking
     std::vector<crypto::hash> m_blocks_hash_of_hashes;
     std::vector<crypto::hash> m_blocks_hash_check;
@@ -1173,10 +1178,23 @@ namespace cryptonote
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param deferred_rct if not NULL, simple ringct signatures are added to it
+     *        for the caller to verify in a batch instead of being verified here.
+     *        Signatures found in the verified cache are neither added nor checked.
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL);
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, std::vector<const rct::rctSig*> *deferred_rct = NULL);
+
+    /**
+     * @brief computes the verified ringct cache key for a transaction
+     *
+     * @param tx the transaction
+     * @param pubkeys the ring members its inputs resolved to
+     *
+     * @return a hash of the tx hash and all ring member keys and commitments
+     */
+    static crypto::hash get_rct_ver_cache_key(const transaction &tx, const std::vector<std::vector<rct::ctkey>> &pubkeys);
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
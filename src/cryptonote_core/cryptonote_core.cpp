@@ -189,6 +189,11 @@ namespace cryptonote
   , "Disable stake transaction processing."
   , false
   };
+  static const command_line::arg_descriptor<bool> arg_enable_light_wallet_scanner = {
+    "enable-light-wallet-scanner"
+  , "Scan new blocks for the view keys registered by light wallets and serve the light wallet RPC calls."
+  , false
+  };
   static const command_line::arg_descriptor<bool> arg_prune_blockchain  = {
     "prune-blockchain"
   , "Prune blockchain"
@@ -220,6 +225,7 @@ namespace cryptonote
               m_mempool(m_blockchain_storage),
               m_blockchain_storage(m_mempool),
               m_graft_stake_transaction_processor(m_blockchain_storage),
+              m_light_wallet_scanner(m_blockchain_storage),
               m_miner(this),
               m_miner_address(boost::value_initialized<account_public_address>()),
               m_starter_message_showed(false),
@@ -231,7 +237,8 @@ namespace cryptonote
               m_update_download(0),
               m_nettype(UNDEFINED),
               m_update_available(false),
-              m_pad_transactions(false)
+              m_pad_transactions(false),
+              m_bulletproof_batcher(BULLETPROOF_BATCH_WINDOW_US, BULLETPROOF_BATCH_MAX_PROOFS)
   {
     m_checkpoints_updating.clear();
     set_cryptonote_protocol(pprotocol);
@@ -328,6 +335,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_block_download_max_size);
     command_line::add_arg(desc, arg_max_txpool_weight);
     command_line::add_arg(desc, arg_disable_stake_tx_processing);
+    command_line::add_arg(desc, arg_enable_light_wallet_scanner);
     command_line::add_arg(desc, arg_pad_transactions);
     command_line::add_arg(desc, arg_block_notify);
     command_line::add_arg(desc, arg_prune_blockchain);
@@ -388,6 +396,11 @@ namespace cryptonote
       m_graft_stake_transaction_processor.set_enabled(false);
     }
 
+    if (get_arg(vm, arg_enable_light_wallet_scanner)) {
+      MGINFO("light wallet scanner enabled");
+      m_light_wallet_scanner.set_enabled(true);
+    }
+
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -499,6 +512,12 @@ namespace cryptonote
     MGINFO("Initialize stake transaction processor");
     m_graft_stake_transaction_processor.init_storages(folder.string());
 
+    if (m_light_wallet_scanner.is_enabled())
+    {
+      MGINFO("Initialize light wallet scanner");
+      m_light_wallet_scanner.init_storages(folder.string());
+    }
+
     std::unique_ptr<BlockchainDB> db(new_db(db_type));
 
     if (db == NULL)
@@ -661,6 +680,7 @@ namespace cryptonote
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
     m_graft_stake_transaction_processor.synchronize();
+    m_light_wallet_scanner.synchronize();
 
     // now that we have a valid m_blockchain_storage, we can clean out any
     // transactions in the pool that do not conform to the current fork
@@ -840,7 +860,7 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block)
+  bool core::handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block, bool others_pending)
   {
     bool ret = true;
     if (keeped_by_block && get_blockchain_storage().is_within_compiled_block_hash_area())
@@ -850,6 +870,7 @@ namespace cryptonote
     }
 
     std::vector<const rct::rctSig*> rvv;
+    std::vector<size_t> rvv_tx;
     for (size_t n = 0; n < tx_info.size(); ++n)
     {
       if (!check_tx_semantic(*tx_info[n].tx, keeped_by_block))
@@ -902,6 +923,7 @@ namespace cryptonote
             break;
           }
           rvv.push_back(&rv); // delayed batch verification
+          rvv_tx.push_back(n);
           break;
         default:
           MERROR_VER("Unknown rct type: " << rv.type);
@@ -911,19 +933,21 @@ namespace cryptonote
           break;
       }
     }
-    if (!rvv.empty() && !rct::verRctSemanticsSimple(rvv))
+    if (!rvv.empty())
     {
-      LOG_PRINT_L1("One transaction among this group has bad semantics, verifying one at a time");
-      ret = false;
-      const bool assumed_bad = rvv.size() == 1; // if there's only one tx, it must be the bad one
-      for (size_t n = 0; n < tx_info.size(); ++n)
+      // txes from a block are a batch already; relayed ones share a batch with
+      // whatever other peers and RPC clients submit at the same time
+      std::deque<bool> results;
+      const bool verified = keeped_by_block ? rct::bulletproof_batcher::verify_bisect(rvv, results) : m_bulletproof_batcher.verify(rvv, results, others_pending);
+      if (!verified)
       {
-        if (!tx_info[n].result)
-          continue;
-        if (tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof && tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof2)
-          continue;
-        if (assumed_bad || !rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures))
+        LOG_PRINT_L1("One transaction among this group has bad semantics");
+        ret = false;
+        for (size_t i = 0; i < rvv.size(); ++i)
         {
+          if (results[i])
+            continue;
+          const size_t n = rvv_tx[i];
           set_semantics_failed(tx_info[n].tx_hash);
           tx_info[n].tvc.m_verifivation_failed = true;
           tx_info[n].result = false;
@@ -935,14 +959,36 @@ namespace cryptonote
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay)
+  {
+    std::vector<crypto::hash> tx_hashes;
+    return handle_incoming_txs(tx_blobs, tvc, tx_hashes, keeped_by_block, relayed, do_not_relay);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, std::vector<crypto::hash>& tx_hashes, bool keeped_by_block, bool relayed, bool do_not_relay)
   {
     TRY_ENTRY();
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
 
+    // parsing and semantics checks run without m_incoming_tx_lock, so txes handed in by
+    // several connections at once can share a bulletproof batch; add_new_tx rechecks
+    // whether another caller added the same tx in the meantime
     struct result { bool res; cryptonote::transaction tx; crypto::hash hash; };
     std::vector<result> results(tx_blobs.size());
 
+    // a tx relayed by several peers is only verified by the first caller to get it, the
+    // others see it as already known; txes from a block are all verified, as the block
+    // needs every one of them
+    std::vector<crypto::hash> in_flight;
+    bool others_pending = false;
+    auto in_flight_release = epee::misc_utils::create_scope_leave_handler([&, this]() {
+      if (in_flight.empty())
+        return;
+      boost::lock_guard<boost::mutex> lock(m_incoming_tx_in_flight_lock);
+      for (const crypto::hash &tx_hash: in_flight)
+        m_incoming_tx_in_flight.erase(tx_hash);
+    });
+
     tvc.resize(tx_blobs.size());
+    tx_hashes.assign(tx_blobs.size(), crypto::null_hash);
     tools::threadpool& tpool = tools::threadpool::getInstance();
     tools::threadpool::waiter waiter;
     std::vector<blobdata>::const_iterator it = tx_blobs.begin();
@@ -961,10 +1007,28 @@ namespace cryptonote
       });
     }
     waiter.wait(&tpool);
-    it = tx_blobs.begin();
+    for (size_t i = 0; i < tx_blobs.size(); i++)
+      tx_hashes[i] = results[i].hash;
     std::vector<bool> already_have(tx_blobs.size(), false);
+    if (!keeped_by_block)
+    {
+      boost::lock_guard<boost::mutex> lock(m_incoming_tx_in_flight_lock);
+      for (size_t i = 0; i < tx_blobs.size(); i++) {
+        if (!results[i].res)
+          continue;
+        if (!m_incoming_tx_in_flight.insert(results[i].hash).second)
+        {
+          LOG_PRINT_L2("tx " << results[i].hash << " is already being verified");
+          already_have[i] = true;
+          continue;
+        }
+        in_flight.push_back(results[i].hash);
+      }
+      others_pending = m_incoming_tx_in_flight.size() > in_flight.size();
+    }
+    it = tx_blobs.begin();
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
-      if (!results[i].res)
+      if (!results[i].res || already_have[i])
         continue;
       if(m_mempool.have_tx(results[i].hash))
       {
@@ -1002,8 +1066,9 @@ namespace cryptonote
       tx_info.push_back({&results[i].tx, results[i].hash, tvc[i], results[i].res});
     }
     if (!tx_info.empty())
-      handle_incoming_tx_accumulated_batch(tx_info, keeped_by_block);
+      handle_incoming_tx_accumulated_batch(tx_info, keeped_by_block, others_pending);
 
+    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
     bool ok = true;
     it = tx_blobs.begin();
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
@@ -1661,6 +1726,7 @@ namespace cryptonote
     m_miner.on_idle();
     m_mempool.on_idle();
     m_graft_stake_transaction_processor.synchronize();
+    m_light_wallet_scanner.synchronize();
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -42,9 +42,11 @@
 #include "tx_pool.h"
 #include "blockchain.h"
 #include "stake_transaction_processor.h"
+#include "light_wallet_scanner.h"
 #include "cryptonote_basic/miner.h"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_basic/cryptonote_stat_info.h"
+#include "ringct/bulletproof_batcher.h"
 #include "warnings.h"
 #include "crypto/hash.h"
 
@@ -139,6 +141,23 @@ namespace cryptonote
       */
      bool handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay);
 
+     /**
+      * @brief handles a list of incoming transactions, and returns their hashes
+      *
+      * As above, for callers which need the hashes of the transactions too,
+      * so they don't have to parse them a second time
+      *
+      * @param tx_blobs the txs to handle
+      * @param tvc metadata about the transactions' validity
+      * @param tx_hashes return-by-reference the transactions' hashes, null_hash for those which failed to parse
+      * @param keeped_by_block if the transactions have been in a block
+      * @param relayed whether or not the transactions were relayed to us
+      * @param do_not_relay whether to prevent the transactions from being relayed
+      *
+      * @return true if the transactions were accepted, false otherwise
+      */
+     bool handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, std::vector<crypto::hash>& tx_hashes, bool keeped_by_block, bool relayed, bool do_not_relay);
+
      /**
       * @brief handles an incoming block
       *
@@ -856,6 +875,13 @@ namespace cryptonote
       * @return 
       */
      StakeTransactionProcessor &get_stake_tx_processor() { return  m_graft_stake_transaction_processor; }
+
+     /**
+      * @brief get_light_wallet_scanner - returns light wallet scanner reference
+      *
+      * @return
+      */
+     LightWalletScanner &get_light_wallet_scanner() { return m_light_wallet_scanner; }
      
 
    private:
@@ -946,7 +972,7 @@ namespace cryptonote
      bool handle_incoming_tx_pre(const blobdata& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash, bool keeped_by_block, bool relayed, bool do_not_relay);
      bool handle_incoming_tx_post(const blobdata& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash, bool keeped_by_block, bool relayed, bool do_not_relay);
      struct tx_verification_batch_info { const cryptonote::transaction *tx; crypto::hash tx_hash; tx_verification_context &tvc; bool &result; };
-     bool handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block);
+     bool handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block, bool others_pending);
 
      /**
       * @copydoc miner::on_block_chain_update
@@ -1041,10 +1067,13 @@ namespace cryptonote
      tx_memory_pool m_mempool; //!< transaction pool instance
      Blockchain m_blockchain_storage; //!< Blockchain instance
      StakeTransactionProcessor m_graft_stake_transaction_processor; //<! StakeTransactionProcessor instance
+     LightWalletScanner m_light_wallet_scanner; //<! LightWalletScanner instance
 
      i_cryptonote_protocol* m_pprotocol; //!< cryptonote protocol instance
 
      epee::critical_section m_incoming_tx_lock; //!< incoming transaction lock
+     boost::mutex m_incoming_tx_in_flight_lock;
+     std::unordered_set<crypto::hash> m_incoming_tx_in_flight; //!< relayed txes being verified, so another copy of one is not verified alongside
 
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner; //!< miner instance
@@ -1099,6 +1128,8 @@ namespace cryptonote
      bool m_offline;
      bool m_pad_transactions;
 
+     rct::bulletproof_batcher m_bulletproof_batcher; //!< batches bulletproofs of txes relayed by different peers
+
      std::shared_ptr<tools::Notify> m_block_rate_notify;
    };
 }
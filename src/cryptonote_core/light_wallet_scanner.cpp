@@ -0,0 +1,918 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <mutex>
+
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "misc_language.h"
+#include "ringct/rctOps.h"
+#include "light_wallet_scanner.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "lightwallet.scanner"
+
+using namespace cryptonote;
+
+namespace
+{
+
+const char* LIGHT_WALLET_DB_DIR_NAME = "lightwallet";
+
+/// Space reserved before each write transaction
+const size_t DB_GROWTH_PER_SYNC = 16 * 1024 * 1024;
+
+/// Accounts registered at most, each one is scanned for in every block
+const size_t MAX_ACCOUNTS = 10000;
+
+/// Accounts created at most per period, so they can't be registered in bulk
+const unsigned MAX_NEW_ACCOUNTS_PER_PERIOD = 100;
+const time_t NEW_ACCOUNTS_PERIOD = 60 * 60;
+
+struct owner_key
+{
+  uint64_t amount;
+  uint64_t global_index;
+};
+
+/// Dups of the outputs and spends tables are sorted by height first, so everything found
+/// at or above a height can be reached with MDB_GET_BOTH_RANGE when unrolling a block
+int compare_height_then_data(const MDB_val *a, const MDB_val *b)
+{
+  const uint64_t ha = *(const uint64_t*) a->mv_data;
+  const uint64_t hb = *(const uint64_t*) b->mv_data;
+  if (ha != hb)
+    return ha < hb ? -1 : 1;
+  const size_t size = std::min(a->mv_size, b->mv_size);
+  const int r = memcmp((const char*)a->mv_data + sizeof(uint64_t), (const char*)b->mv_data + sizeof(uint64_t), size - sizeof(uint64_t));
+  if (r)
+    return r;
+  return a->mv_size < b->mv_size ? -1 : a->mv_size > b->mv_size;
+}
+
+int compare_uint64(const MDB_val *a, const MDB_val *b)
+{
+  const uint64_t va = *(const uint64_t*) a->mv_data;
+  const uint64_t vb = *(const uint64_t*) b->mv_data;
+  return va < vb ? -1 : va > vb;
+}
+
+void check_mdb(int dbr, const char* what)
+{
+  if (dbr)
+    throw std::runtime_error(std::string(what) + ": " + mdb_strerror(dbr));
+}
+
+int resize_env(MDB_env *env, const std::string& db_path, size_t needed)
+{
+  MDB_envinfo mei;
+  MDB_stat mst;
+  int ret;
+
+  ret = mdb_env_info(env, &mei);
+  if (ret)
+    return ret;
+  ret = mdb_env_stat(env, &mst);
+  if (ret)
+    return ret;
+  uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+  uint64_t mapsize = mei.me_mapsize;
+  if (size_used + needed > mei.me_mapsize)
+  {
+    needed = std::max(needed, (size_t)(100ul * 1024 * 1024)); // grow by at least 100 MB
+    try
+    {
+      boost::filesystem::space_info si = boost::filesystem::space(boost::filesystem::path(db_path));
+      if (si.available < needed)
+      {
+        MERROR("!! WARNING: Insufficient free space to extend light wallet database !!: " << (si.available >> 20L) << " MB available");
+        return ENOSPC;
+      }
+    }
+    catch(...)
+    {
+      MWARNING("Unable to query free disk space.");
+    }
+
+    mapsize += needed;
+  }
+  return mdb_env_set_mapsize(env, mapsize);
+}
+
+crypto::hash get_view_key_hash(const crypto::secret_key& view_secret_key)
+{
+  return crypto::cn_fast_hash(&view_secret_key, sizeof(view_secret_key));
+}
+
+std::string make_account_key(const account_public_address& address)
+{
+  std::string key(sizeof(address.m_spend_public_key) + sizeof(address.m_view_public_key), '\0');
+  memcpy(&key[0], &address.m_spend_public_key, sizeof(address.m_spend_public_key));
+  memcpy(&key[sizeof(address.m_spend_public_key)], &address.m_view_public_key, sizeof(address.m_view_public_key));
+  return key;
+}
+
+MDB_val make_val(const std::string& s)
+{
+  return MDB_val{s.size(), (void*)s.data()};
+}
+
+template <class T> MDB_val make_val(const T& value)
+{
+  return MDB_val{sizeof(T), (void*)&value};
+}
+
+template <class T> void read_val(const MDB_val& v, T& value)
+{
+  if (v.mv_size != sizeof(T))
+    throw std::runtime_error("Unexpected light wallet database record size");
+  memcpy(&value, v.mv_data, sizeof(T));
+}
+
+template <class T> void load_records(MDB_txn* txn, MDB_dbi dbi, const std::string& account_key, std::vector<T>& records)
+{
+  MDB_cursor* cursor;
+  check_mdb(mdb_cursor_open(txn, dbi, &cursor), "Failed to open LMDB cursor");
+  epee::misc_utils::auto_scope_leave_caller cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(cursor);});
+
+  MDB_val k = make_val(account_key), v;
+  int dbr = mdb_cursor_get(cursor, &k, &v, MDB_SET);
+  while (dbr == 0)
+  {
+    records.emplace_back();
+    read_val(v, records.back());
+    dbr = mdb_cursor_get(cursor, &k, &v, MDB_NEXT_DUP);
+  }
+  if (dbr != MDB_NOTFOUND)
+    check_mdb(dbr, "Failed to read light wallet account records");
+}
+
+}
+
+struct LightWalletScanner::account_record
+{
+  crypto::hash view_key_hash;
+  uint64_t start_height;
+  uint64_t scanned_height;
+};
+
+struct LightWalletScanner::owner_record
+{
+  char account[2 * sizeof(crypto::public_key)];
+  uint64_t amount;
+  crypto::public_key tx_pub_key;
+  uint32_t out_index;
+  uint32_t padding;
+};
+
+LightWalletScanner::LightWalletScanner(Blockchain& blockchain, size_t max_derivations_per_sync)
+  : m_blockchain(blockchain)
+  , m_max_derivations_per_sync(std::max<size_t>(max_derivations_per_sync, 1))
+  , m_env(nullptr)
+{
+}
+
+LightWalletScanner::~LightWalletScanner()
+{
+  close();
+}
+
+void LightWalletScanner::close()
+{
+  CRITICAL_REGION_LOCAL1(m_db_lock);
+
+  if (!m_env)
+    return;
+
+  mdb_env_close(m_env);
+  m_env = nullptr;
+}
+
+void LightWalletScanner::init_storages(const std::string& config_dir)
+{
+  CRITICAL_REGION_LOCAL1(m_db_lock);
+
+  if (m_env)
+    throw std::runtime_error("LightWalletScanner storage has been already initialized");
+
+  if (!m_enabled)
+    return;
+
+  m_db_path = config_dir + "/" + LIGHT_WALLET_DB_DIR_NAME;
+
+  if (!tools::create_directories_if_necessary(m_db_path))
+    throw std::runtime_error("Failed to create light wallet database directory " + m_db_path);
+
+    //the database tells which addresses use this node, keep it to the daemon's user
+
+  boost::system::error_code ec;
+  boost::filesystem::permissions(m_db_path, boost::filesystem::owner_all, ec);
+  if (ec)
+    MWARNING("Failed to restrict permissions of " << m_db_path << ": " << ec.message());
+
+  MDB_env* env = nullptr;
+  MDB_txn* txn = nullptr;
+  bool tx_active = false;
+  epee::misc_utils::auto_scope_leave_caller env_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    if (tx_active) mdb_txn_abort(txn);
+    if (env && env != m_env) mdb_env_close(env);
+  });
+
+  check_mdb(mdb_env_create(&env), "Failed to create LMDB environment");
+  check_mdb(mdb_env_set_maxdbs(env, 5), "Failed to set max env dbs");
+  check_mdb(mdb_env_open(env, m_db_path.c_str(), 0, 0600), ("Failed to open light wallet database " + m_db_path).c_str());
+
+  check_mdb(mdb_txn_begin(env, NULL, 0, &txn), "Failed to create LMDB transaction");
+  tx_active = true;
+
+  check_mdb(mdb_dbi_open(txn, "accounts", MDB_CREATE, &m_accounts), "Failed to open LMDB dbi");
+  check_mdb(mdb_dbi_open(txn, "outputs", MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, &m_outputs), "Failed to open LMDB dbi");
+  mdb_set_dupsort(txn, m_outputs, compare_height_then_data);
+  check_mdb(mdb_dbi_open(txn, "spends", MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, &m_spends), "Failed to open LMDB dbi");
+  mdb_set_dupsort(txn, m_spends, compare_height_then_data);
+  check_mdb(mdb_dbi_open(txn, "owners", MDB_CREATE, &m_owners), "Failed to open LMDB dbi");
+  check_mdb(mdb_dbi_open(txn, "blocks", MDB_CREATE | MDB_INTEGERKEY, &m_blocks), "Failed to open LMDB dbi");
+  mdb_set_compare(txn, m_blocks, compare_uint64);
+
+  check_mdb(mdb_txn_commit(txn), "Failed to commit txn opening light wallet database");
+  tx_active = false;
+
+  m_env = env;
+
+  MINFO("Light wallet scanner database opened at " << m_db_path);
+}
+
+bool LightWalletScanner::check_account(MDB_txn* txn, const account_public_address& address, const crypto::secret_key& view_secret_key, account_record& record) const
+{
+  const std::string account_key = make_account_key(address);
+  MDB_val k = make_val(account_key), v;
+
+  int dbr = mdb_get(txn, m_accounts, &k, &v);
+  if (dbr == MDB_NOTFOUND)
+    return false;
+  check_mdb(dbr, "Failed to read light wallet account");
+
+  read_val(v, record);
+
+  if (record.view_key_hash != get_view_key_hash(view_secret_key))
+    return false;
+
+    //the view key is needed to scan the account, it only lives in memory
+
+  m_view_keys[account_key] = view_secret_key;
+
+  return true;
+}
+
+bool LightWalletScanner::login(const account_public_address& address, const crypto::secret_key& view_secret_key, bool create_account, bool& new_address)
+{
+  new_address = false;
+
+  crypto::public_key view_public_key;
+  if (!crypto::secret_key_to_public_key(view_secret_key, view_public_key) || view_public_key != address.m_view_public_key)
+    return false;
+
+  std::unique_lock<epee::critical_section> db_lock{m_db_lock, std::defer_lock};
+  std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
+  std::lock(db_lock, blockchain_lock);
+
+  if (!m_env)
+    return false;
+
+  check_mdb(resize_env(m_env, m_db_path, sizeof(account_record)), "Failed to set env map size");
+
+  MDB_txn* txn;
+  bool tx_active = false;
+  check_mdb(mdb_txn_begin(m_env, NULL, 0, &txn), "Failed to create LMDB transaction");
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
+  tx_active = true;
+
+  account_record record;
+  if (check_account(txn, address, view_secret_key, record))
+    return true;
+
+  const std::string account_key = make_account_key(address);
+  MDB_val k = make_val(account_key), v;
+  if (mdb_get(txn, m_accounts, &k, &v) == 0 || !create_account)
+    return false; //registered with another view key, or not registered
+
+  MDB_stat stat;
+  check_mdb(mdb_stat(txn, m_accounts, &stat), "Failed to query light wallet accounts");
+  if (stat.ms_entries >= MAX_ACCOUNTS)
+    throw std::runtime_error("Too many light wallet accounts");
+
+  const time_t now = time(NULL);
+  if (now - m_new_accounts_period_start >= NEW_ACCOUNTS_PERIOD)
+  {
+    m_new_accounts_period_start = now;
+    m_new_accounts_in_period = 0;
+  }
+  if (m_new_accounts_in_period >= MAX_NEW_ACCOUNTS_PER_PERIOD)
+    throw std::runtime_error("Too many new light wallet accounts, try again later");
+
+  record.view_key_hash  = get_view_key_hash(view_secret_key);
+  record.start_height   = m_blockchain.get_current_blockchain_height();
+  record.scanned_height = record.start_height;
+
+  v = make_val(record);
+  check_mdb(mdb_put(txn, m_accounts, &k, &v, MDB_NOOVERWRITE), "Failed to add light wallet account");
+  check_mdb(mdb_txn_commit(txn), "Failed to commit light wallet account");
+  tx_active = false;
+
+  m_view_keys[account_key] = view_secret_key;
+  ++m_new_accounts_in_period;
+  new_address = true;
+
+  MINFO("Light wallet account registered at height " << record.start_height);
+
+  return true;
+}
+
+bool LightWalletScanner::rescan(const account_public_address& address, const crypto::secret_key& view_secret_key, uint64_t start_height)
+{
+  CRITICAL_REGION_LOCAL1(m_db_lock);
+
+  if (!m_env)
+    return false;
+
+  check_mdb(resize_env(m_env, m_db_path, DB_GROWTH_PER_SYNC), "Failed to set env map size");
+
+  MDB_txn* txn;
+  bool tx_active = false;
+  check_mdb(mdb_txn_begin(m_env, NULL, 0, &txn), "Failed to create LMDB transaction");
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
+  tx_active = true;
+
+  account_record record;
+  if (!check_account(txn, address, view_secret_key, record))
+    return false;
+
+  const std::string account_key = make_account_key(address);
+  MDB_val k = make_val(account_key), v;
+
+    //forget everything found for this account, synchronize() will find it again
+
+  for (MDB_dbi dbi : {m_outputs, m_spends})
+  {
+    int dbr = mdb_del(txn, dbi, &k, NULL);
+    if (dbr != MDB_NOTFOUND)
+      check_mdb(dbr, "Failed to remove light wallet account records");
+  }
+
+  MDB_cursor* cursor;
+  check_mdb(mdb_cursor_open(txn, m_owners, &cursor), "Failed to open LMDB cursor");
+  epee::misc_utils::auto_scope_leave_caller cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(cursor);});
+
+  MDB_val ok, ov;
+  int dbr = mdb_cursor_get(cursor, &ok, &ov, MDB_FIRST);
+  while (dbr == 0)
+  {
+    owner_record owner;
+    read_val(ov, owner);
+    if (!memcmp(owner.account, account_key.data(), sizeof(owner.account)))
+      check_mdb(mdb_cursor_del(cursor, 0), "Failed to remove light wallet output owner");
+    dbr = mdb_cursor_get(cursor, &ok, &ov, MDB_NEXT);
+  }
+  if (dbr != MDB_NOTFOUND)
+    check_mdb(dbr, "Failed to iterate light wallet output owners");
+
+  record.start_height   = start_height;
+  record.scanned_height = start_height;
+
+  v = make_val(record);
+  check_mdb(mdb_put(txn, m_accounts, &k, &v, 0), "Failed to update light wallet account");
+
+  cursor_dtor.reset();
+  check_mdb(mdb_txn_commit(txn), "Failed to commit light wallet account");
+  tx_active = false;
+
+  MINFO("Light wallet account rescan requested from height " << start_height);
+
+  return true;
+}
+
+bool LightWalletScanner::get_account_data(const account_public_address& address, const crypto::secret_key& view_secret_key, account_data& data) const
+{
+  CRITICAL_REGION_LOCAL1(m_db_lock);
+
+  if (!m_env)
+    return false;
+
+  MDB_txn* txn;
+  check_mdb(mdb_txn_begin(m_env, NULL, MDB_RDONLY, &txn), "Failed to create LMDB transaction");
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_txn_abort(txn);});
+
+  account_record record;
+  if (!check_account(txn, address, view_secret_key, record))
+    return false;
+
+  data.start_height   = record.start_height;
+  data.scanned_height = record.scanned_height;
+  data.outputs.clear();
+  data.spends.clear();
+
+  const std::string account_key = make_account_key(address);
+
+  load_records(txn, m_outputs, account_key, data.outputs);
+  load_records(txn, m_spends, account_key, data.spends);
+
+  return true;
+}
+
+void LightWalletScanner::unroll_block(MDB_txn* txn, uint64_t height)
+{
+  std::vector<std::pair<std::string, account_record>> accounts;
+
+  {
+    MDB_cursor* cursor;
+    check_mdb(mdb_cursor_open(txn, m_accounts, &cursor), "Failed to open LMDB cursor");
+    epee::misc_utils::auto_scope_leave_caller cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(cursor);});
+
+    MDB_val k, v;
+    int dbr = mdb_cursor_get(cursor, &k, &v, MDB_FIRST);
+    while (dbr == 0)
+    {
+      accounts.emplace_back(std::string((const char*)k.mv_data, k.mv_size), account_record());
+      read_val(v, accounts.back().second);
+      dbr = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+    }
+    if (dbr != MDB_NOTFOUND)
+      check_mdb(dbr, "Failed to iterate light wallet accounts");
+  }
+
+  MDB_cursor* outputs_cursor;
+  check_mdb(mdb_cursor_open(txn, m_outputs, &outputs_cursor), "Failed to open LMDB cursor");
+  epee::misc_utils::auto_scope_leave_caller outputs_cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(outputs_cursor);});
+
+  MDB_cursor* spends_cursor;
+  check_mdb(mdb_cursor_open(txn, m_spends, &spends_cursor), "Failed to open LMDB cursor");
+  epee::misc_utils::auto_scope_leave_caller spends_cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(spends_cursor);});
+
+  for (auto& account : accounts)
+  {
+    account_record& record = account.second;
+
+    if (record.scanned_height <= height)
+      continue;
+
+    int dbr;
+
+    account_output output = {};
+    output.height = height;
+
+    MDB_val k = make_val(account.first), v = make_val(output);
+    while ((dbr = mdb_cursor_get(outputs_cursor, &k, &v, MDB_GET_BOTH_RANGE)) == 0)
+    {
+      read_val(v, output);
+
+      owner_key okey{output.rct ? 0 : output.amount, output.global_index};
+      MDB_val ok = make_val(okey);
+      dbr = mdb_del(txn, m_owners, &ok, NULL);
+      if (dbr != MDB_NOTFOUND)
+        check_mdb(dbr, "Failed to remove light wallet output owner");
+
+      check_mdb(mdb_cursor_del(outputs_cursor, 0), "Failed to remove light wallet output");
+
+      output = {};
+      output.height = height;
+      k = make_val(account.first);
+      v = make_val(output);
+    }
+    if (dbr != MDB_NOTFOUND)
+      check_mdb(dbr, "Failed to unroll light wallet outputs");
+
+    account_spend spend = {};
+    spend.height = height;
+
+    k = make_val(account.first);
+    v = make_val(spend);
+    while ((dbr = mdb_cursor_get(spends_cursor, &k, &v, MDB_GET_BOTH_RANGE)) == 0)
+    {
+      check_mdb(mdb_cursor_del(spends_cursor, 0), "Failed to remove light wallet spend");
+      k = make_val(account.first);
+      v = make_val(spend);
+    }
+    if (dbr != MDB_NOTFOUND)
+      check_mdb(dbr, "Failed to unroll light wallet spends");
+
+    record.scanned_height = height;
+
+    k = make_val(account.first);
+    v = make_val(record);
+    check_mdb(mdb_put(txn, m_accounts, &k, &v, 0), "Failed to update light wallet account");
+  }
+
+  MDB_val k = make_val(height);
+  int dbr = mdb_del(txn, m_blocks, &k, NULL);
+  if (dbr != MDB_NOTFOUND)
+    check_mdb(dbr, "Failed to remove light wallet block");
+}
+
+void LightWalletScanner::scan_block(MDB_txn* txn, const block_data& data, std::vector<std::pair<std::string, account_record>>& accounts)
+{
+  const uint64_t height = data.height;
+  const block& block = data.blk;
+
+  auto process_tx = [&](const transaction& tx, const crypto::hash& tx_hash, const std::vector<uint64_t>& global_indices, bool coinbase) {
+      //inputs: a ring member owned by an account is a candidate spend
+
+    for (const txin_v& in : tx.vin)
+    {
+      if (in.type() != typeid(txin_to_key))
+        continue;
+
+      const txin_to_key& in_to_key = boost::get<txin_to_key>(in);
+      const std::vector<uint64_t> ring_indices = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+
+      for (uint64_t global_index : ring_indices)
+      {
+        owner_key okey{in_to_key.amount, global_index};
+        MDB_val k = make_val(okey), v;
+
+        int dbr = mdb_get(txn, m_owners, &k, &v);
+        if (dbr == MDB_NOTFOUND)
+          continue;
+        check_mdb(dbr, "Failed to read light wallet output owner");
+
+        owner_record owner;
+        read_val(v, owner);
+
+        const std::string account_key(owner.account, sizeof(owner.account));
+        auto it = std::find_if(accounts.begin(), accounts.end(), [&](const std::pair<std::string, account_record>& account) {
+          return account.first == account_key;
+        });
+
+        if (it == accounts.end() || it->second.scanned_height > height)
+          continue;
+
+        account_spend spend = {};
+        spend.height       = height;
+        spend.global_index = global_index;
+        spend.amount       = owner.amount;
+        spend.timestamp    = block.timestamp;
+        spend.unlock_time  = tx.unlock_time;
+        spend.tx_hash      = tx_hash;
+        spend.key_image    = in_to_key.k_image;
+        spend.tx_pub_key   = owner.tx_pub_key;
+        spend.out_index    = owner.out_index;
+        spend.mixin        = ring_indices.size() - 1;
+
+        MDB_val ak = make_val(account_key), sv = make_val(spend);
+        dbr = mdb_put(txn, m_spends, &ak, &sv, MDB_NODUPDATA);
+        if (dbr != MDB_KEYEXIST)
+          check_mdb(dbr, "Failed to add light wallet spend");
+      }
+    }
+
+      //outputs
+
+    const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
+    if (tx_pub_key == crypto::null_pkey)
+      return;
+
+    crypto::hash long_payment_id = crypto::null_hash;
+    crypto::hash8 short_payment_id = crypto::null_hash8;
+    bool has_short_payment_id = false;
+
+    std::vector<tx_extra_field> tx_extra_fields;
+    parse_tx_extra(tx.extra, tx_extra_fields);
+    tx_extra_nonce extra_nonce;
+    if (find_tx_extra_field_by_type(tx_extra_fields, extra_nonce))
+    {
+      if (!get_payment_id_from_tx_extra_nonce(extra_nonce.nonce, long_payment_id))
+        has_short_payment_id = get_encrypted_payment_id_from_tx_extra_nonce(extra_nonce.nonce, short_payment_id);
+    }
+
+    crypto::hash tx_prefix_hash = crypto::null_hash;
+
+    for (auto& account : accounts)
+    {
+      account_record& record = account.second;
+
+      if (record.scanned_height > height)
+        continue;
+
+      crypto::public_key spend_public_key;
+      memcpy(&spend_public_key, account.first.data(), sizeof(spend_public_key));
+
+      const crypto::secret_key& view_secret_key = m_view_keys.at(account.first);
+
+      crypto::key_derivation derivation;
+      if (!crypto::generate_key_derivation(tx_pub_key, view_secret_key, derivation))
+        continue;
+
+      for (size_t i = 0; i < tx.vout.size(); ++i)
+      {
+        const tx_out& out = tx.vout[i];
+
+        if (out.target.type() != typeid(txout_to_key))
+          continue;
+
+        const crypto::public_key& out_key = boost::get<txout_to_key>(out.target).key;
+
+        crypto::public_key public_key;
+        if (!crypto::derive_public_key(derivation, i, spend_public_key, public_key) || public_key != out_key)
+          continue;
+
+        account_output output = {};
+        output.height      = height;
+        output.amount      = out.amount;
+        output.timestamp   = block.timestamp;
+        output.unlock_time = tx.unlock_time;
+        output.tx_hash     = tx_hash;
+        output.tx_pub_key  = tx_pub_key;
+        output.public_key  = out_key;
+        output.out_index   = i;
+        output.rct         = tx.version > 1;
+        output.coinbase    = coinbase;
+
+        if (output.rct)
+        {
+          crypto::secret_key scalar;
+          crypto::derivation_to_scalar(derivation, i, scalar);
+
+          rct::key mask = rct::identity();
+
+          if (coinbase)
+          {
+            output.commitment = rct::zeroCommit(out.amount);
+          }
+          else
+          {
+            if (i >= tx.rct_signatures.ecdhInfo.size() || i >= tx.rct_signatures.outPk.size())
+              continue;
+
+            rct::ecdhTuple ecdh_info = tx.rct_signatures.ecdhInfo[i];
+            rct::ecdhDecode(ecdh_info, rct::sk2rct(scalar), tx.rct_signatures.type == rct::RCTTypeBulletproof2);
+
+            rct::key commitment;
+            rct::addKeys2(commitment, ecdh_info.mask, ecdh_info.amount, rct::H);
+            if (!rct::equalKeys(commitment, tx.rct_signatures.outPk[i].mask))
+            {
+              MWARNING("Skipping output " << i << " of tx " << tx_hash << ": amount doesn't match its commitment");
+              continue;
+            }
+
+            mask                    = ecdh_info.mask;
+            output.amount           = rct::h2d(ecdh_info.amount);
+            output.commitment       = tx.rct_signatures.outPk[i].mask;
+            output.encrypted_amount = tx.rct_signatures.ecdhInfo[i].amount;
+          }
+
+            //light wallets decrypt the mask as mask + Hs(scalar) whatever the rct type is
+
+          sc_add(output.encrypted_mask.bytes, mask.bytes, rct::hash_to_scalar(rct::sk2rct(scalar)).bytes);
+        }
+
+        if (long_payment_id != crypto::null_hash)
+        {
+          output.payment_id = long_payment_id;
+        }
+        else if (has_short_payment_id)
+        {
+          crypto::hash8 payment_id = short_payment_id;
+          if (hw::get_device("default").decrypt_payment_id(payment_id, tx_pub_key, view_secret_key))
+            memcpy(output.payment_id.data, payment_id.data, sizeof(payment_id.data));
+        }
+
+        if (tx_prefix_hash == crypto::null_hash)
+          tx_prefix_hash = get_transaction_prefix_hash(tx);
+
+        output.global_index   = global_indices[i];
+        output.tx_prefix_hash = tx_prefix_hash;
+
+        MDB_val k = make_val(account.first), v = make_val(output);
+        int dbr = mdb_put(txn, m_outputs, &k, &v, MDB_NODUPDATA);
+        if (dbr != MDB_KEYEXIST)
+          check_mdb(dbr, "Failed to add light wallet output");
+
+        owner_record owner = {};
+        memcpy(owner.account, account.first.data(), sizeof(owner.account));
+        owner.amount     = output.amount;
+        owner.tx_pub_key = tx_pub_key;
+        owner.out_index  = i;
+
+        owner_key okey{output.rct ? 0 : output.amount, output.global_index};
+        MDB_val ok = make_val(okey), ov = make_val(owner);
+        check_mdb(mdb_put(txn, m_owners, &ok, &ov, 0), "Failed to add light wallet output owner");
+      }
+    }
+  };
+
+  process_tx(block.miner_tx, get_transaction_hash(block.miner_tx), data.global_indices[0], true);
+
+  for (size_t i = 0; i < data.txs.size(); ++i)
+    process_tx(data.txs[i], block.tx_hashes[i], data.global_indices[i + 1], false);
+
+  for (auto& account : accounts)
+    if (account.second.scanned_height <= height)
+      account.second.scanned_height = height + 1;
+}
+
+void LightWalletScanner::load_blocks(uint64_t height, std::vector<std::pair<std::string, account_record>>& accounts, std::vector<block_data>& blocks)
+{
+    //each tx of a block costs one derivation per account scanning that block: lagging accounts go first,
+    //and blocks are added while the budget allows, with at least one block for at least one account
+
+  std::sort(accounts.begin(), accounts.end(), [](const std::pair<std::string, account_record>& a, const std::pair<std::string, account_record>& b) {
+    return a.second.scanned_height < b.second.scanned_height;
+  });
+
+  const uint64_t first_height = accounts.empty() ? height : accounts.front().second.scanned_height;
+  size_t derivations = 0;
+  size_t scanning = 0;
+
+  for (uint64_t block_height = first_height; block_height < height; ++block_height)
+  {
+    block_data data;
+    data.height = block_height;
+    data.hash = m_blockchain.get_block_id_by_height(block_height);
+    if (!m_blockchain.get_block_by_hash(data.hash, data.blk))
+      throw std::runtime_error("Failed to get block " + std::to_string(block_height));
+
+    while (scanning < accounts.size() && accounts[scanning].second.scanned_height <= block_height)
+      ++scanning;
+
+    const size_t txes = data.blk.tx_hashes.size() + 1;
+    if (blocks.empty())
+    {
+      const size_t max_accounts = std::max<size_t>(m_max_derivations_per_sync / txes, 1);
+      if (scanning > max_accounts)
+      {
+        accounts.resize(max_accounts);
+        scanning = max_accounts;
+      }
+    }
+    else if (derivations + txes * scanning > m_max_derivations_per_sync)
+      break;
+    derivations += txes * scanning;
+
+    std::vector<crypto::hash> missed_txs;
+    if (!m_blockchain.get_transactions(data.blk.tx_hashes, data.txs, missed_txs) || !missed_txs.empty())
+      throw std::runtime_error("Missing transactions of block " + std::to_string(block_height));
+
+    data.global_indices.resize(txes);
+    for (size_t i = 0; i < txes; ++i)
+    {
+      const crypto::hash tx_hash = i ? data.blk.tx_hashes[i - 1] : get_transaction_hash(data.blk.miner_tx);
+      const size_t outputs = i ? data.txs[i - 1].vout.size() : data.blk.miner_tx.vout.size();
+      if (!m_blockchain.get_tx_outputs_gindexs(tx_hash, data.global_indices[i]) || data.global_indices[i].size() != outputs)
+        throw std::runtime_error("Failed to get output global indices of tx " + epee::string_tools::pod_to_hex(tx_hash));
+    }
+
+    blocks.push_back(std::move(data));
+  }
+}
+
+void LightWalletScanner::synchronize()
+{
+  if (!m_enabled)
+    return;
+
+  CRITICAL_REGION_LOCAL1(m_db_lock);
+
+  if (!m_env)
+    return;
+
+  try
+  {
+    check_mdb(resize_env(m_env, m_db_path, DB_GROWTH_PER_SYNC), "Failed to set env map size");
+
+    MDB_txn* txn;
+    bool tx_active = false;
+    check_mdb(mdb_txn_begin(m_env, NULL, 0, &txn), "Failed to create LMDB transaction");
+    epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
+    tx_active = true;
+
+    std::vector<std::pair<std::string, account_record>> accounts;
+    std::vector<block_data> blocks;
+
+      //the blockchain is only locked while the blocks to scan are copied, not while they are scanned
+
+    {
+      std::unique_lock<Blockchain> blockchain_lock{m_blockchain};
+
+      const uint64_t height = m_blockchain.get_current_blockchain_height();
+
+        //unroll already scanned blocks for alternative chains
+
+      for (;;)
+      {
+        uint64_t last_height = 0;
+        crypto::hash last_hash;
+
+        {
+          MDB_cursor* cursor;
+          check_mdb(mdb_cursor_open(txn, m_blocks, &cursor), "Failed to open LMDB cursor");
+          epee::misc_utils::auto_scope_leave_caller cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(cursor);});
+
+          MDB_val k, v;
+          int dbr = mdb_cursor_get(cursor, &k, &v, MDB_LAST);
+          if (dbr == MDB_NOTFOUND)
+            break;
+          check_mdb(dbr, "Failed to read light wallet blocks");
+
+          read_val(k, last_height);
+          read_val(v, last_hash);
+        }
+
+        if (last_height < height && m_blockchain.get_block_id_by_height(last_height) == last_hash)
+          break;
+
+        MWARNING("Unroll light wallet scanned block " << last_height);
+
+        unroll_block(txn, last_height);
+      }
+
+        //scan new blocks once for all accounts whose view key is known
+
+      {
+        MDB_cursor* cursor;
+        check_mdb(mdb_cursor_open(txn, m_accounts, &cursor), "Failed to open LMDB cursor");
+        epee::misc_utils::auto_scope_leave_caller cursor_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(cursor);});
+
+        MDB_val k, v;
+        int dbr = mdb_cursor_get(cursor, &k, &v, MDB_FIRST);
+        while (dbr == 0)
+        {
+          std::string account_key((const char*)k.mv_data, k.mv_size);
+          if (m_view_keys.count(account_key))
+          {
+            accounts.emplace_back(std::move(account_key), account_record());
+            read_val(v, accounts.back().second);
+          }
+          dbr = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+        }
+        if (dbr != MDB_NOTFOUND)
+          check_mdb(dbr, "Failed to iterate light wallet accounts");
+      }
+
+      load_blocks(height, accounts, blocks);
+    }
+
+    for (const block_data& data : blocks)
+    {
+      scan_block(txn, data, accounts);
+
+      MDB_val k = make_val(data.height), v = make_val(data.hash);
+      check_mdb(mdb_put(txn, m_blocks, &k, &v, 0), "Failed to add light wallet block");
+    }
+
+    for (const auto& account : accounts)
+    {
+      MDB_val k = make_val(account.first), v = make_val(account.second);
+      check_mdb(mdb_put(txn, m_accounts, &k, &v, 0), "Failed to update light wallet account");
+    }
+
+      //drop the scan if the chain was reorganized meanwhile, the next call unrolls what left it
+
+    if (!blocks.empty())
+    {
+      std::unique_lock<Blockchain> blockchain_lock{m_blockchain};
+      const block_data& last = blocks.back();
+      if (last.height >= m_blockchain.get_current_blockchain_height() || m_blockchain.get_block_id_by_height(last.height) != last.hash)
+      {
+        MDEBUG("Light wallet scanner dropped blocks " << blocks.front().height << ".." << last.height << ", they left the main chain");
+        return;
+      }
+    }
+
+    check_mdb(mdb_txn_commit(txn), "Failed to commit light wallet scan");
+    tx_active = false;
+
+    if (!blocks.empty())
+      MDEBUG("Light wallet scanner processed blocks " << blocks.front().height << ".." << blocks.back().height << " for " << accounts.size() << " account(s)");
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Light wallet scanner synchronization failed: " << e.what());
+  }
+}
@@ -0,0 +1,162 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <ctime>
+#include <lmdb.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "blockchain.h"
+#include "ringct/rctTypes.h"
+
+namespace cryptonote
+{
+
+/// Scans new blocks once, from the core idle loop, for the view keys registered by light wallets,
+/// and keeps what it finds in its own LMDB database to answer the light wallet RPC calls.
+/// The blockchain is only locked while the blocks are copied, and each call does a bounded number
+/// of key derivations, so lagging or rescanning accounts catch up over several calls.
+/// Only a hash of each view key is stored, the keys themselves are kept in memory: an account
+/// is scanned again after a restart once its wallet has called in with its view key
+class LightWalletScanner
+{
+public:
+  /// Output received by a registered account
+  struct account_output
+  {
+    uint64_t height;
+    uint64_t global_index;
+    uint64_t amount;
+    uint64_t timestamp;
+    uint64_t unlock_time;
+    crypto::hash tx_hash;
+    crypto::hash tx_prefix_hash;
+    crypto::hash payment_id;
+    crypto::public_key tx_pub_key;
+    crypto::public_key public_key;
+    rct::key commitment;
+    rct::key encrypted_mask;
+    rct::key encrypted_amount;
+    uint32_t out_index;
+    uint8_t rct;
+    uint8_t coinbase;
+    uint8_t padding[2];
+  };
+
+  /// Input which may spend an output of a registered account: its ring has that output,
+  /// only the wallet can tell whether the key image is its own
+  struct account_spend
+  {
+    uint64_t height;
+    uint64_t global_index;
+    uint64_t amount;
+    uint64_t timestamp;
+    uint64_t unlock_time;
+    crypto::hash tx_hash;
+    crypto::key_image key_image;
+    crypto::public_key tx_pub_key;
+    uint32_t out_index;
+    uint32_t mixin;
+  };
+
+  struct account_data
+  {
+    uint64_t start_height;
+    uint64_t scanned_height;
+    std::vector<account_output> outputs;
+    std::vector<account_spend> spends;
+  };
+
+  /// Key derivations done per synchronize() call, one per tx and account scanning its block
+  static constexpr size_t DEFAULT_MAX_DERIVATIONS_PER_SYNC = 20000;
+
+  LightWalletScanner(Blockchain& blockchain, size_t max_derivations_per_sync = DEFAULT_MAX_DERIVATIONS_PER_SYNC);
+  ~LightWalletScanner();
+
+  /// Open the database (only when enabled)
+  void init_storages(const std::string& config_dir);
+
+  /// Turns on/off scanning
+  void set_enabled(bool arg) { m_enabled = arg; }
+
+  bool is_enabled() const { return m_enabled; }
+
+  /// Scan the blocks added since the last call and unroll those which left the main chain
+  void synchronize();
+
+  /// Register an account, or check the view key of a registered one; new accounts are scanned from the current height.
+  /// Throws when the account can't be created because of the account limits
+  bool login(const account_public_address& address, const crypto::secret_key& view_secret_key, bool create_account, bool& new_address);
+
+  /// Scan a registered account again from the given height
+  bool rescan(const account_public_address& address, const crypto::secret_key& view_secret_key, uint64_t start_height);
+
+  /// Get what was found for a registered account, false if it is not registered with this view key
+  bool get_account_data(const account_public_address& address, const crypto::secret_key& view_secret_key, account_data& data) const;
+
+private:
+  struct account_record;
+  struct owner_record;
+
+  /// A block to scan, copied with its txes and their output indices while the blockchain is locked
+  struct block_data
+  {
+    uint64_t height;
+    crypto::hash hash;
+    block blk;
+    std::vector<transaction> txs;
+    std::vector<std::vector<uint64_t>> global_indices; //of the miner tx, then of txs
+  };
+
+  void close();
+  void unroll_block(MDB_txn* txn, uint64_t height);
+  void load_blocks(uint64_t height, std::vector<std::pair<std::string, account_record>>& accounts, std::vector<block_data>& blocks);
+  void scan_block(MDB_txn* txn, const block_data& data, std::vector<std::pair<std::string, account_record>>& accounts);
+  bool check_account(MDB_txn* txn, const account_public_address& address, const crypto::secret_key& view_secret_key, account_record& record) const;
+
+private:
+  Blockchain& m_blockchain;
+  size_t m_max_derivations_per_sync;
+  std::string m_db_path;
+  MDB_env* m_env;
+  MDB_dbi m_accounts;
+  MDB_dbi m_outputs;
+  MDB_dbi m_spends;
+  MDB_dbi m_owners;
+  MDB_dbi m_blocks;
+  mutable epee::critical_section m_db_lock;
+  mutable std::unordered_map<std::string, crypto::secret_key> m_view_keys; //by account key, guarded by m_db_lock
+  time_t m_new_accounts_period_start {0};
+  unsigned m_new_accounts_in_period {0};
+  bool m_enabled {false};
+};
+
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /*!
+   * \brief Bounded set of verified ringct cache keys, evicting the oldest first
+   *
+   * Each key maps to its position in the insertion order, so a key erased before
+   * it is evicted leaves nothing behind that a later eviction could act upon.
+   */
+  class rct_ver_cache
+  {
+  public:
+    explicit rct_ver_cache(size_t max_entries): m_max_entries(max_entries) {}
+
+    bool contains(const crypto::hash &key) const { return m_entries.find(key) != m_entries.end(); }
+    size_t size() const { return m_entries.size(); }
+
+    /// adds a key, evicting the oldest keys past max_entries; re-adding a key keeps its position
+    void add(const crypto::hash &key)
+    {
+      if (m_entries.find(key) != m_entries.end())
+        return;
+      m_order.push_back(key);
+      m_entries.emplace(key, std::prev(m_order.end()));
+      while (m_order.size() > m_max_entries)
+      {
+        m_entries.erase(m_order.front());
+        m_order.pop_front();
+      }
+    }
+
+    /// removes a key, returns false if it was not there
+    bool erase(const crypto::hash &key)
+    {
+      const auto i = m_entries.find(key);
+      if (i == m_entries.end())
+        return false;
+      m_order.erase(i->second);
+      m_entries.erase(i);
+      return true;
+    }
+
+  private:
+    size_t m_max_entries;
+    std::list<crypto::hash> m_order;
+    std::unordered_map<crypto::hash, std::list<crypto::hash>::iterator> m_entries;
+  };
+}
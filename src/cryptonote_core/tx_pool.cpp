@@ -1227,6 +1227,8 @@ namespace cryptonote
 
     LockedTXN lock(m_blockchain);
 
+    // parsed into over and over, reusing its buffers
+    cryptonote::transaction tx;
     auto sorted_it = m_txs_by_fee_and_receive_time.begin();
     for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
     {
@@ -1275,7 +1277,6 @@ namespace cryptonote
       }
 
       cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second);
-      cryptonote::transaction tx;
 
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
@@ -1355,12 +1356,12 @@ namespace cryptonote
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain);
+      cryptonote::transaction tx;
       for (const crypto::hash &txid: remove)
       {
         try
         {
           cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
-          cryptonote::transaction tx;
           if (!parse_and_validate_tx_from_blob(txblob, tx))
           {
             MERROR("Failed to parse tx from txpool");
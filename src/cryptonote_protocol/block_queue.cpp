@@ -40,6 +40,8 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "cn.block_queue"
 
+#define SPAN_TARGET_TIME 5.0f // seconds a span download should take, including the round trip
+
 namespace std {
   static_assert(sizeof(size_t) <= sizeof(boost::uuids::uuid), "boost::uuids::uuid too small");
   template<> struct hash<boost::uuids::uuid> {
@@ -528,4 +530,86 @@ bool block_queue::foreach(std::function<bool(const span&)> f) const
   return true;
 }
 
+void block_queue::add_rtt_sample(const boost::uuids::uuid &connection_id, float rtt)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  if (rtt < 0.0f)
+    return;
+  peer_throughput &throughput = peer_throughputs[connection_id];
+  // same pseudo average as get_speed, favouring the latest measurements
+  throughput.rtt = throughput.rtt > 0.0f ? (throughput.rtt + rtt) / 2 : rtt;
+  MTRACE("RTT for " << connection_id << ": " << throughput.rtt << " s");
+}
+
+void block_queue::add_throughput_sample(const boost::uuids::uuid &connection_id, size_t bytes, uint64_t nblocks, float seconds)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  if (bytes == 0 || nblocks == 0 || seconds <= 0.0f)
+    return;
+  const float block_size = bytes / (float)nblocks;
+  avg_block_size = avg_block_size > 0.0f ? (avg_block_size + block_size) / 2 : block_size;
+  peer_throughput &throughput = peer_throughputs[connection_id];
+  // the request round trip is paid once per span whatever its size, so keep it out of
+  // the bandwidth, but never let a noisy rtt make the transfer look near instantaneous
+  const float transfer_time = std::max(seconds - throughput.rtt, seconds / 4);
+  const float bandwidth = bytes / transfer_time;
+  throughput.bandwidth = throughput.nspans ? (throughput.bandwidth + bandwidth) / 2 : bandwidth;
+  ++throughput.nspans;
+  throughput.bytes += bytes;
+  MTRACE("Bandwidth for " << connection_id << ": " << throughput.bandwidth << " B/s");
+}
+
+bool block_queue::get_peer_throughput(const boost::uuids::uuid &connection_id, peer_throughput &throughput) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peer_throughputs.find(connection_id);
+  if (i == peer_throughputs.end())
+    return false;
+  throughput = i->second;
+  return true;
+}
+
+std::map<boost::uuids::uuid, block_queue::peer_throughput> block_queue::get_peer_throughputs() const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  return peer_throughputs;
+}
+
+void block_queue::flush_peer_throughput(const boost::uuids::uuid &connection_id)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  peer_throughputs.erase(connection_id);
+}
+
+float block_queue::get_avg_block_size() const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  return avg_block_size;
+}
+
+float block_queue::get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peer_throughputs.find(connection_id);
+  if (i == peer_throughputs.end() || i->second.nspans == 0 || i->second.bandwidth <= 0.0f)
+    return -1.0f;
+  return i->second.rtt + nblocks * avg_block_size / i->second.bandwidth;
+}
+
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t max_blocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peer_throughputs.find(connection_id);
+  if (i == peer_throughputs.end() || i->second.nspans == 0 || i->second.bandwidth <= 0.0f || avg_block_size <= 0.0f)
+    return default_blocks; // no measurement yet, the first span is the probe
+
+  // size the span so it comes back in about SPAN_TARGET_TIME: a slow peer then only
+  // holds a few blocks hostage, and a fast one isn't limited by round trips
+  const float transfer_time = std::max(SPAN_TARGET_TIME - i->second.rtt, SPAN_TARGET_TIME / 4);
+  const float nblocks = transfer_time * i->second.bandwidth / avg_block_size;
+  const uint64_t span_size = std::max<uint64_t>(1, (uint64_t)std::min<float>(max_blocks, nblocks));
+  MTRACE("Span size for " << connection_id << ": " << span_size << " (" << nblocks << ", rtt " << i->second.rtt << ", bw " << i->second.bandwidth << ")");
+  return span_size;
+}
+
 }
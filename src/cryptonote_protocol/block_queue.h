@@ -33,6 +33,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 #include <unordered_set>
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -67,6 +68,16 @@ namespace cryptonote
     };
     typedef std::set<span> block_map;
 
+    struct peer_throughput
+    {
+      float bandwidth; // bytes/s, with the request round trip taken out
+      float rtt; // seconds
+      uint64_t nspans;
+      uint64_t bytes;
+
+      peer_throughput(): bandwidth(0.0f), rtt(0.0f), nspans(0), bytes(0) {}
+    };
+
   public:
     void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
     void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time = boost::date_time::min_date_time);
@@ -96,6 +107,14 @@ namespace cryptonote
     bool foreach(std::function<bool(const span&)> f) const;
     bool requested(const crypto::hash &hash) const;
     bool have(const crypto::hash &hash) const;
+    void add_rtt_sample(const boost::uuids::uuid &connection_id, float rtt);
+    void add_throughput_sample(const boost::uuids::uuid &connection_id, size_t bytes, uint64_t nblocks, float seconds);
+    bool get_peer_throughput(const boost::uuids::uuid &connection_id, peer_throughput &throughput) const;
+    std::map<boost::uuids::uuid, peer_throughput> get_peer_throughputs() const;
+    void flush_peer_throughput(const boost::uuids::uuid &connection_id);
+    float get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const;
+    uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t max_blocks) const;
+    float get_avg_block_size() const;
 
   private:
     void erase_block(block_map::iterator j);
@@ -106,5 +125,7 @@ namespace cryptonote
     mutable boost::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+    std::map<boost::uuids::uuid, peer_throughput> peer_throughputs;
+    float avg_block_size = 0.0f;
   };
 }
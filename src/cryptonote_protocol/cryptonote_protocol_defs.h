@@ -298,5 +298,72 @@ namespace cryptonote
     };
     typedef epee::misc_utils::struct_init<request_t> request;
   }; 
+
+  /************************************************************************/
+  /* Announces pool txes by id, sent instead of the full blobs to peers   */
+  /* supporting P2P_SUPPORT_FLAG_TX_RELAY_ANNOUNCE                        */
+  /************************************************************************/
+  struct NOTIFY_TX_INVENTORY
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+
+    struct request_t
+    {
+      std::vector<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /* Requests pool txes, either by id or by salted short id coming from a */
+  /* pool sketch. Answered with NOTIFY_NEW_TRANSACTIONS                   */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX_POOL_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request_t
+    {
+      std::vector<crypto::hash> txs;
+      std::vector<uint64_t> short_ids;
+      uint64_t salt;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(short_ids)
+        KV_SERIALIZE_OPT(salt, (uint64_t)0)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /* Periodic sketch of the sender's relayable pool contents, see         */
+  /* tx_pool_sketch                                                       */
+  /************************************************************************/
+  struct NOTIFY_TX_POOL_SKETCH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct request_t
+    {
+      uint64_t salt;
+      std::vector<uint32_t> counts;
+      std::vector<uint64_t> key_sums;
+      std::vector<uint32_t> check_sums;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(counts)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_sums)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(check_sums)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
     
 }
@@ -71,6 +71,9 @@
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000) // microseconds
 #define DROP_ON_SYNC_WEDGE_THRESHOLD (30 * 1000000000ull) // nanoseconds
 #define LAST_ACTIVITY_STALL_THRESHOLD (2.0f) // seconds
+#define SPAN_SIZE_MAX_MULTIPLIER 4 // fast peers may get spans up to N times the block sync size
+#define SPAN_OVERDUE_MULTIPLIER (2.0f) // next span is overdue after N times its expected download time
+#define SPAN_OVERDUE_MIN_TIME (1.0f) // seconds
 
 namespace cryptonote
 {
@@ -152,6 +155,26 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  epee::net_utils::send_priority t_cryptonote_protocol_handler<t_core>::get_send_priority(int command) const
+  {
+    switch (command)
+    {
+      // new blocks propagate consensus, so they go ahead of everything queued for sync
+      case NOTIFY_NEW_BLOCK::ID:
+      case NOTIFY_NEW_FLUFFY_BLOCK::ID:
+      case NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID:
+        return epee::net_utils::send_priority::high;
+      // large responses that only serve a peer catching up
+      case NOTIFY_RESPONSE_GET_OBJECTS::ID:
+      case NOTIFY_RESPONSE_CHAIN_ENTRY::ID:
+      case NOTIFY_TX_POOL_SKETCH::ID:
+        return epee::net_utils::send_priority::bulk;
+      default:
+        return epee::net_utils::send_priority::normal;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::get_stat_info(core_stat_info& stat_inf)
   {
     return m_core.get_stat_info(stat_inf);
@@ -887,8 +910,6 @@ namespace cryptonote
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
-    for (const auto &blob: arg.txs)
-      MLOGIF_P2P_MESSAGE(cryptonote::transaction tx; crypto::hash hash; bool ret = cryptonote::parse_and_validate_tx_from_blob(blob, tx, hash);, ret, "Including transaction " << hash);
 
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
@@ -902,29 +923,203 @@ namespace cryptonote
       return 1;
     }
 
+    // the txes go to core together, so their bulletproofs can be verified in one batch,
+    // and core hands back the hashes it got parsing them
+    std::vector<cryptonote::tx_verification_context> tvc;
+    std::vector<crypto::hash> tx_hashes;
+    m_core.handle_incoming_txs(arg.txs, tvc, tx_hashes, false, true, false);
+
+    // the sender has the txes, so they are neither relayed nor announced back to it
+    for (const crypto::hash &tx_hash: tx_hashes)
+      if (tx_hash != crypto::null_hash)
+        m_tx_relay_inventory.add_known(context.m_connection_id, tx_hash);
+
     std::vector<cryptonote::blobdata> newtxs;
+    std::vector<crypto::hash> newtx_hashes;
     newtxs.reserve(arg.txs.size());
+    newtx_hashes.reserve(arg.txs.size());
     for (size_t i = 0; i < arg.txs.size(); ++i)
     {
-      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-      m_core.handle_incoming_tx(arg.txs[i], tvc, false, true, false);
-      if(tvc.m_verifivation_failed)
+      if(tvc[i].m_verifivation_failed)
       {
         LOG_PRINT_CCONTEXT_L1("Tx verification failed, dropping connection");
         drop_connection(context, false, false);
         return 1;
       }
-      if(tvc.m_should_be_relayed)
+      if(tvc[i].m_should_be_relayed)
+      {
+        MLOG_P2P_MESSAGE("Including transaction " << tx_hashes[i]);
         newtxs.push_back(std::move(arg.txs[i]));
+        newtx_hashes.push_back(tx_hashes[i]);
+      }
     }
     arg.txs = std::move(newtxs);
 
     if(arg.txs.size())
     {
-      //TODO: add announce usage here
-      relay_transactions(arg, context);
+      relay_transactions(arg, newtx_hashes, context);
+    }
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_tx_inventory(int command, NOTIFY_TX_INVENTORY::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_INVENTORY (" << arg.txs.size() << " txes)");
+
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received tx inventory while syncing, ignored");
+      return 1;
+    }
+
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Tx inventory is too big (" << arg.txs.size() << "), dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    NOTIFY_REQUEST_TX_POOL_TXS::request req = AUTO_VAL_INIT(req);
+    for (const crypto::hash &tx_hash: arg.txs)
+    {
+      m_tx_relay_inventory.add_known(context.m_connection_id, tx_hash);
+      if (!m_core.pool_has_tx(tx_hash) && m_tx_relay_inventory.request(context.m_connection_id, tx_hash))
+        req.txs.push_back(tx_hash);
+    }
+
+    if (!req.txs.empty())
+    {
+      MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_TX_POOL_TXS: txs.size()=" << req.txs.size());
+      post_notify<NOTIFY_REQUEST_TX_POOL_TXS>(req, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx_pool_txs(int command, NOTIFY_REQUEST_TX_POOL_TXS::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX_POOL_TXS (" << arg.txs.size() << " txes, " << arg.short_ids.size() << " short ids)");
+
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if (arg.txs.size() + arg.short_ids.size() > CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Requested pool txes count is too big (" << arg.txs.size() + arg.short_ids.size() << "), dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    if (context.m_send_backpressure)
+    {
+      MDEBUG(context << "send queue backed up (" << context.m_send_queue_bytes << " bytes), not serving NOTIFY_REQUEST_TX_POOL_TXS");
+      return 1;
+    }
+
+    // only ever hand out txes we would relay anyway, never ones kept private
+    std::unordered_set<crypto::hash> relayable;
+    get_relayable_pool_tx_hashes(relayable);
+
+    std::vector<crypto::hash> tx_hashes;
+    tx_hashes.reserve(arg.txs.size() + arg.short_ids.size());
+    for (const crypto::hash &tx_hash: arg.txs)
+      if (relayable.find(tx_hash) != relayable.end())
+        tx_hashes.push_back(tx_hash);
+    if (!arg.short_ids.empty())
+    {
+      std::unordered_map<uint64_t, crypto::hash> short_ids;
+      for (const crypto::hash &tx_hash: relayable)
+        short_ids.emplace(tx_pool_sketch::get_short_id(tx_hash, arg.salt), tx_hash);
+      for (uint64_t short_id: arg.short_ids)
+      {
+        const auto i = short_ids.find(short_id);
+        if (i != short_ids.end())
+          tx_hashes.push_back(i->second);
+      }
+    }
+
+    NOTIFY_NEW_TRANSACTIONS::request rsp;
+    for (const crypto::hash &tx_hash: tx_hashes)
+    {
+      cryptonote::blobdata tx_blob;
+      if (m_core.get_pool_transaction(tx_hash, tx_blob))
+      {
+        m_tx_relay_inventory.add_known(context.m_connection_id, tx_hash);
+        rsp.txs.push_back(std::move(tx_blob));
+      }
+    }
+
+    if (!rsp.txs.empty())
+    {
+      MLOG_P2P_MESSAGE("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << rsp.txs.size());
+      post_notify<NOTIFY_NEW_TRANSACTIONS>(rsp, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_tx_pool_sketch(int command, NOTIFY_TX_POOL_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_POOL_SKETCH (" << arg.counts.size() << " cells)");
+
+    if(context.m_state != cryptonote_connection_context::state_normal || !is_synchronized())
+      return 1;
+
+    tx_pool_sketch theirs(P2P_TX_SKETCH_CELLS, 0);
+    if (!tx_pool_sketch::load(arg, theirs))
+    {
+      LOG_ERROR_CCONTEXT("Invalid tx pool sketch, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::unordered_set<crypto::hash> relayable;
+    get_relayable_pool_tx_hashes(relayable);
+    tx_pool_sketch ours(theirs.get_cells(), theirs.get_salt());
+    std::unordered_map<uint64_t, crypto::hash> short_ids;
+    for (const crypto::hash &tx_hash: relayable)
+    {
+      const uint64_t short_id = tx_pool_sketch::get_short_id(tx_hash, ours.get_salt());
+      ours.add(short_id);
+      short_ids.emplace(short_id, tx_hash);
+    }
+
+    std::vector<uint64_t> only_theirs, only_ours;
+    std::vector<crypto::hash> announce;
+    theirs.subtract(ours);
+    if (theirs.decode(only_theirs, only_ours))
+    {
+      MDEBUG(context << "tx pool reconciliation: " << only_theirs.size() << " txes missing here, " << only_ours.size() << " missing there");
+      for (uint64_t short_id: only_ours)
+      {
+        const auto i = short_ids.find(short_id);
+        if (i != short_ids.end())
+          announce.push_back(i->second);
+      }
+      if (!only_theirs.empty())
+      {
+        NOTIFY_REQUEST_TX_POOL_TXS::request req = AUTO_VAL_INIT(req);
+        req.salt = ours.get_salt();
+        req.short_ids = std::move(only_theirs);
+        if (req.short_ids.size() > CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT)
+          req.short_ids.resize(CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+        post_notify<NOTIFY_REQUEST_TX_POOL_TXS>(req, context);
+      }
+    }
+    else
+    {
+      // difference too large for the sketch, fall back to announcing what we
+      // have, the peer's own sketch will let us catch up on its side
+      MDEBUG(context << "tx pool reconciliation failed to decode, announcing " << relayable.size() << " pool txes");
+      announce.assign(relayable.begin(), relayable.end());
     }
 
+    announce_transactions(announce, context);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -943,6 +1138,13 @@ namespace cryptonote
         return 1;
       }
 
+    if (context.m_send_backpressure)
+    {
+      // the peer is not draining what we already queued; it will time out the span and ask someone else
+      MDEBUG(context << "send queue backed up (" << context.m_send_queue_bytes << " bytes), not serving NOTIFY_REQUEST_GET_OBJECTS");
+      return 1;
+    }
+
     NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
     if(!m_core.handle_get_objects(arg, rsp, context))
     {
@@ -1099,6 +1301,7 @@ namespace cryptonote
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
       m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      m_block_queue.add_throughput_sample(context.m_connection_id, size, arg.blocks.size(), dt.total_microseconds() / 1e6f);
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
       context.m_last_known_hash = last_block_hash;
@@ -1452,6 +1655,7 @@ skip:
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
     m_standby_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::check_standby_peers, this));
     m_sync_search_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::update_sync_search, this));
+    m_tx_reconciliation_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::reconcile_tx_pool, this));
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -1584,6 +1788,27 @@ skip:
           return true;
         }
 
+        // the next span holds up the whole sync, so if the peer it was given to is well past
+        // what its measured throughput predicts, and we'd get it in less time than it's
+        // already been waiting, request it again from here
+        if (connection_id != context.m_connection_id)
+        {
+          std::vector<crypto::hash> scheduled_hashes;
+          boost::uuids::uuid scheduled_connection_id;
+          boost::posix_time::ptime scheduled_time;
+          const uint64_t nblocks = m_block_queue.get_next_span_if_scheduled(scheduled_hashes, scheduled_connection_id, scheduled_time).second;
+          const float expected = m_block_queue.get_expected_span_time(scheduled_connection_id, nblocks);
+          const float ours = m_block_queue.get_expected_span_time(context.m_connection_id, nblocks);
+          const float waited = dt / 1e6f;
+          if (nblocks > 0 && scheduled_connection_id != context.m_connection_id && expected > 0.0f && ours > 0.0f && waited >= SPAN_OVERDUE_MIN_TIME &&
+              waited > expected * SPAN_OVERDUE_MULTIPLIER && ours < waited)
+          {
+            MDEBUG(context << " we should download it as it's overdue (" << waited << " seconds, expected " << expected <<
+                ", we'd take " << ours << ")");
+            return true;
+          }
+        }
+
         // in standby, be ready to double download early since we're idling anyway
         // let the fastest peer trigger first
         long threshold;
@@ -1844,7 +2069,9 @@ skip:
       NOTIFY_REQUEST_GET_OBJECTS::request req;
       bool is_next = false;
       size_t count = 0;
-      const size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      const size_t block_sync_size = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      const size_t count_limit = m_block_queue.get_span_size(context.m_connection_id, block_sync_size,
+          std::min<size_t>(block_sync_size * SPAN_SIZE_MAX_MULTIPLIER, CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT));
       std::pair<uint64_t, uint64_t> span = std::make_pair(0, 0);
       if (force_next_span)
       {
@@ -2111,6 +2338,18 @@ skip:
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
     MLOG_PEER_STATE("received chain");
 
+    if (context.m_last_request_time != boost::date_time::not_a_date_time)
+    {
+      // the chain request is cheap to serve, so its latency minus the time to
+      // transfer the reply is our best estimate of the round trip to this peer
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      const float dt = (now - context.m_last_request_time).total_microseconds() / 1e6f;
+      block_queue::peer_throughput throughput;
+      float transfer_time = 0.0f;
+      if (m_block_queue.get_peer_throughput(context.m_connection_id, throughput) && throughput.bandwidth > 0.0f)
+        transfer_time = arg.m_block_ids.size() * sizeof(crypto::hash) / throughput.bandwidth;
+      m_block_queue.add_rtt_sample(context.m_connection_id, std::max(0.0f, dt - transfer_time));
+    }
     context.m_last_request_time = boost::date_time::not_a_date_time;
 
     m_sync_download_chain_size += arg.m_block_ids.size() * sizeof(crypto::hash);
@@ -2211,13 +2450,13 @@ skip:
     {
       std::string fluffyBlob;
       epee::serialization::store_t_to_binary(fluffy_arg, fluffyBlob);
-      m_p2p->relay_notify_to_list(NOTIFY_NEW_FLUFFY_BLOCK::ID, epee::strspan<uint8_t>(fluffyBlob), std::move(fluffyConnections));
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_FLUFFY_BLOCK::ID, epee::byte_slice{std::move(fluffyBlob)}, std::move(fluffyConnections));
     }
     if (!fullConnections.empty())
     {
       std::string fullBlob;
       epee::serialization::store_t_to_binary(arg, fullBlob);
-      m_p2p->relay_notify_to_list(NOTIFY_NEW_BLOCK::ID, epee::strspan<uint8_t>(fullBlob), std::move(fullConnections));
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_BLOCK::ID, epee::byte_slice{std::move(fullBlob)}, std::move(fullConnections));
     }
 
     return true;
@@ -2225,6 +2464,13 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    // the hashes are only needed, and worked out, for peers txes are announced to
+    return relay_transactions(arg, std::vector<crypto::hash>(), exclude_context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const std::vector<crypto::hash>& tx_hashes, cryptonote_connection_context& exclude_context)
   {
     const bool hide_tx_broadcast =
       1 < m_p2p->get_zone_count() && exclude_context.m_remote_address.get_zone() == epee::net_utils::zone::invalid;
@@ -2266,8 +2512,13 @@ skip:
       // if the size of _ moved enough, we might lose byte in size encoding, we don't care
     }
 
+    // txes we originate are flooded so they reach the network in one hop,
+    // txes received from peers are only announced to peers supporting it
+    const bool announce = !hide_tx_broadcast && exclude_context.m_remote_address.get_zone() != epee::net_utils::zone::invalid;
+
     std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections;
-    m_p2p->for_each_connection([hide_tx_broadcast, &exclude_context, &connections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    std::vector<boost::uuids::uuid> announce_connections;
+    m_p2p->for_each_connection([hide_tx_broadcast, announce, &exclude_context, &connections, &announce_connections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       const epee::net_utils::zone current_zone = context.m_remote_address.get_zone();
       const bool broadcast_to_peer =
@@ -2276,19 +2527,116 @@ skip:
 	exclude_context.m_connection_id != context.m_connection_id;
 
       if (broadcast_to_peer)
-        connections.push_back({current_zone, context.m_connection_id});
+      {
+        if (announce && (support_flags & P2P_SUPPORT_FLAG_TX_RELAY_ANNOUNCE))
+          announce_connections.push_back(context.m_connection_id);
+        else
+          connections.push_back({current_zone, context.m_connection_id});
+      }
 
       return true;
     });
 
-    if (connections.empty())
+    if (connections.empty() && announce_connections.empty())
       MERROR("Transaction not relayed - no" << (hide_tx_broadcast ? " privacy": "") << " peers available");
-    else
+
+    if (!connections.empty())
     {
       std::string fullBlob;
       epee::serialization::store_t_to_binary(arg, fullBlob);
-      m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<uint8_t>(fullBlob), std::move(connections));
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, epee::byte_slice{std::move(fullBlob)}, std::move(connections));
+    }
+
+    if (!announce_connections.empty())
+    {
+      std::vector<crypto::hash> parsed_tx_hashes;
+      if (tx_hashes.size() != arg.txs.size())
+      {
+        parsed_tx_hashes.reserve(arg.txs.size());
+        for (const auto &tx_blob: arg.txs)
+        {
+          cryptonote::transaction tx;
+          crypto::hash tx_hash;
+          if (cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash))
+            parsed_tx_hashes.push_back(tx_hash);
+        }
+      }
+      const std::vector<crypto::hash> &announced = tx_hashes.size() == arg.txs.size() ? tx_hashes : parsed_tx_hashes;
+      for (const boost::uuids::uuid &connection_id: announce_connections)
+      {
+        m_p2p->for_connection(connection_id, [this, &announced](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags) {
+          announce_transactions(announced, context);
+          return true;
+        });
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::announce_transactions(const std::vector<crypto::hash>& tx_hashes, cryptonote_connection_context& context)
+  {
+    NOTIFY_TX_INVENTORY::request arg = AUTO_VAL_INIT(arg);
+    for (const crypto::hash &tx_hash: tx_hashes)
+    {
+      if (m_tx_relay_inventory.add_known(context.m_connection_id, tx_hash))
+        arg.txs.push_back(tx_hash);
+      if (arg.txs.size() == CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT)
+      {
+        post_notify<NOTIFY_TX_INVENTORY>(arg, context);
+        arg.txs.clear();
+      }
     }
+    if (!arg.txs.empty())
+      post_notify<NOTIFY_TX_INVENTORY>(arg, context);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::get_relayable_pool_tx_hashes(std::unordered_set<crypto::hash>& tx_hashes) const
+  {
+    std::vector<crypto::hash> pool_tx_hashes;
+    if (!m_core.get_pool_transaction_hashes(pool_tx_hashes, false))
+      return false;
+    tx_hashes.clear();
+    tx_hashes.insert(pool_tx_hashes.begin(), pool_tx_hashes.end());
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::reconcile_tx_pool()
+  {
+    m_tx_relay_inventory.prune();
+
+    if (!is_synchronized())
+      return true;
+
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections;
+    m_p2p->for_each_connection([&connections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (peer_id && context.m_state == cryptonote_connection_context::state_normal &&
+          context.m_remote_address.get_zone() == epee::net_utils::zone::public_ &&
+          (support_flags & P2P_SUPPORT_FLAG_TX_RELAY_ANNOUNCE))
+        connections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+      return true;
+    });
+    if (connections.empty())
+      return true;
+
+    std::unordered_set<crypto::hash> relayable;
+    if (!get_relayable_pool_tx_hashes(relayable))
+      return true;
+
+    tx_pool_sketch sketch(P2P_TX_SKETCH_CELLS, crypto::rand<uint64_t>());
+    for (const crypto::hash &tx_hash: relayable)
+      sketch.add_tx(tx_hash);
+
+    NOTIFY_TX_POOL_SKETCH::request arg = AUTO_VAL_INIT(arg);
+    sketch.store(arg);
+    std::string blob;
+    epee::serialization::store_t_to_binary(arg, blob);
+    MDEBUG("Sending tx pool sketch of " << relayable.size() << " txes to " << connections.size() << " peers");
+    m_p2p->relay_notify_to_list(NOTIFY_TX_POOL_SKETCH::ID, epee::byte_slice{std::move(blob)}, std::move(connections));
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -2400,6 +2748,8 @@ skip:
     }
 
     m_block_queue.flush_spans(context.m_connection_id, false);
+    m_block_queue.flush_peer_throughput(context.m_connection_id);
+    m_tx_relay_inventory.flush(context.m_connection_id);
     MLOG_PEER_STATE("closed");
   }
 
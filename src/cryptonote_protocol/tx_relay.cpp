@@ -0,0 +1,262 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <deque>
+#include <boost/uuid/uuid_io.hpp>
+#include "int-util.h"
+#include "misc_log_ex.h"
+#include "cryptonote_config.h"
+#include "tx_relay.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "cn.tx_relay"
+
+namespace
+{
+  // splitmix64 finalizer, short ids are already uniformly distributed, this
+  // only decorrelates the cell indices and checksum derived from them
+  uint64_t mix64(uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+  }
+
+  uint32_t get_check_sum(uint64_t short_id)
+  {
+    return mix64(short_id ^ 0xd6e8feb86659fd93ull) >> 32;
+  }
+}
+
+namespace cryptonote
+{
+
+tx_pool_sketch::tx_pool_sketch(size_t cells, uint64_t salt):
+  m_salt(salt),
+  m_counts(cells, 0),
+  m_key_sums(cells, 0),
+  m_check_sums(cells, 0)
+{
+  CHECK_AND_ASSERT_THROW_MES(is_valid_size(cells), "Invalid tx pool sketch size: " << cells);
+}
+
+uint64_t tx_pool_sketch::get_short_id(const crypto::hash &txid, uint64_t salt)
+{
+  char data[sizeof(uint64_t) + sizeof(crypto::hash)];
+  salt = SWAP64LE(salt);
+  memcpy(data, &salt, sizeof(salt));
+  memcpy(data + sizeof(salt), &txid, sizeof(txid));
+  const crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+  uint64_t short_id;
+  memcpy(&short_id, &h, sizeof(short_id));
+  return SWAP64LE(short_id);
+}
+
+size_t tx_pool_sketch::get_cell(uint64_t short_id, size_t n) const
+{
+  const size_t subtable = m_counts.size() / 3;
+  return n * subtable + mix64(short_id + (n + 1) * 0x9e3779b97f4a7c15ull) % subtable;
+}
+
+void tx_pool_sketch::toggle(uint64_t short_id, int32_t delta)
+{
+  const uint32_t check_sum = get_check_sum(short_id);
+  for (size_t n = 0; n < 3; ++n)
+  {
+    const size_t cell = get_cell(short_id, n);
+    m_counts[cell] += delta;
+    m_key_sums[cell] ^= short_id;
+    m_check_sums[cell] ^= check_sum;
+  }
+}
+
+void tx_pool_sketch::add(uint64_t short_id)
+{
+  toggle(short_id, 1);
+}
+
+bool tx_pool_sketch::subtract(const tx_pool_sketch &other)
+{
+  if (other.m_salt != m_salt || other.m_counts.size() != m_counts.size())
+    return false;
+  for (size_t cell = 0; cell < m_counts.size(); ++cell)
+  {
+    m_counts[cell] -= other.m_counts[cell];
+    m_key_sums[cell] ^= other.m_key_sums[cell];
+    m_check_sums[cell] ^= other.m_check_sums[cell];
+  }
+  return true;
+}
+
+bool tx_pool_sketch::is_pure(size_t cell) const
+{
+  return (m_counts[cell] == 1 || m_counts[cell] == -1) && m_check_sums[cell] == get_check_sum(m_key_sums[cell]);
+}
+
+bool tx_pool_sketch::decode(std::vector<uint64_t> &only_ours, std::vector<uint64_t> &only_theirs) const
+{
+  only_ours.clear();
+  only_theirs.clear();
+
+  tx_pool_sketch sketch = *this;
+  std::deque<size_t> pure;
+  for (size_t cell = 0; cell < sketch.m_counts.size(); ++cell)
+    if (sketch.is_pure(cell))
+      pure.push_back(cell);
+
+  while (!pure.empty())
+  {
+    const size_t cell = pure.front();
+    pure.pop_front();
+    if (!sketch.is_pure(cell))
+      continue;
+    const uint64_t short_id = sketch.m_key_sums[cell];
+    const int32_t count = sketch.m_counts[cell];
+    (count > 0 ? only_ours : only_theirs).push_back(short_id);
+    // a well formed difference can't have more ids than cells
+    if (only_ours.size() + only_theirs.size() > sketch.m_counts.size())
+      return false;
+    sketch.toggle(short_id, -count);
+    for (size_t n = 0; n < 3; ++n)
+    {
+      const size_t other_cell = sketch.get_cell(short_id, n);
+      if (sketch.is_pure(other_cell))
+        pure.push_back(other_cell);
+    }
+  }
+
+  for (size_t cell = 0; cell < sketch.m_counts.size(); ++cell)
+    if (sketch.m_counts[cell] || sketch.m_key_sums[cell] || sketch.m_check_sums[cell])
+      return false;
+  return true;
+}
+
+void tx_pool_sketch::store(NOTIFY_TX_POOL_SKETCH::request_t &req) const
+{
+  req.salt = m_salt;
+  req.counts.resize(m_counts.size());
+  for (size_t cell = 0; cell < m_counts.size(); ++cell)
+    req.counts[cell] = SWAP32LE((uint32_t)m_counts[cell]);
+  req.key_sums.resize(m_key_sums.size());
+  for (size_t cell = 0; cell < m_key_sums.size(); ++cell)
+    req.key_sums[cell] = SWAP64LE(m_key_sums[cell]);
+  req.check_sums.resize(m_check_sums.size());
+  for (size_t cell = 0; cell < m_check_sums.size(); ++cell)
+    req.check_sums[cell] = SWAP32LE(m_check_sums[cell]);
+}
+
+bool tx_pool_sketch::load(const NOTIFY_TX_POOL_SKETCH::request_t &req, tx_pool_sketch &sketch)
+{
+  const size_t cells = req.counts.size();
+  if (!is_valid_size(cells) || cells > P2P_TX_SKETCH_MAX_CELLS || req.key_sums.size() != cells || req.check_sums.size() != cells)
+    return false;
+  sketch.m_salt = req.salt;
+  sketch.m_counts.resize(cells);
+  sketch.m_key_sums.resize(cells);
+  sketch.m_check_sums.resize(cells);
+  for (size_t cell = 0; cell < cells; ++cell)
+  {
+    sketch.m_counts[cell] = (int32_t)SWAP32LE(req.counts[cell]);
+    sketch.m_key_sums[cell] = SWAP64LE(req.key_sums[cell]);
+    sketch.m_check_sums[cell] = SWAP32LE(req.check_sums[cell]);
+  }
+  return true;
+}
+
+bool tx_relay_inventory::add_known(const boost::uuids::uuid &connection_id, const crypto::hash &txid)
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  std::unordered_set<crypto::hash> &txes = known[connection_id];
+  if (txes.size() >= P2P_TX_INVENTORY_MAX_PER_PEER)
+  {
+    MDEBUG("Inventory for " << connection_id << " full, resetting");
+    txes.clear();
+  }
+  return txes.insert(txid).second;
+}
+
+bool tx_relay_inventory::is_known(const boost::uuids::uuid &connection_id, const crypto::hash &txid) const
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  const auto i = known.find(connection_id);
+  return i != known.end() && i->second.find(txid) != i->second.end();
+}
+
+bool tx_relay_inventory::request(const boost::uuids::uuid &connection_id, const crypto::hash &txid, boost::posix_time::ptime now)
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  const auto i = requested.find(txid);
+  if (i != requested.end() && (now - i->second.second).total_seconds() < P2P_TX_REQUEST_TIMEOUT)
+    return false;
+  requested[txid] = std::make_pair(connection_id, now);
+  return true;
+}
+
+void tx_relay_inventory::flush(const boost::uuids::uuid &connection_id)
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  known.erase(connection_id);
+  // let another peer serve whatever this one did not answer yet
+  for (auto i = requested.begin(); i != requested.end(); )
+  {
+    if (i->second.first == connection_id)
+      i = requested.erase(i);
+    else
+      ++i;
+  }
+}
+
+void tx_relay_inventory::prune(boost::posix_time::ptime now)
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  for (auto i = requested.begin(); i != requested.end(); )
+  {
+    if ((now - i->second.second).total_seconds() >= P2P_TX_REQUEST_TIMEOUT)
+      i = requested.erase(i);
+    else
+      ++i;
+  }
+}
+
+size_t tx_relay_inventory::get_known_count(const boost::uuids::uuid &connection_id) const
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  const auto i = known.find(connection_id);
+  return i == known.end() ? 0 : i->second.size();
+}
+
+size_t tx_relay_inventory::get_requested_count() const
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  return requested.size();
+}
+
+}
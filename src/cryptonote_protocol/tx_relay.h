@@ -0,0 +1,104 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/thread/mutex.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "crypto/hash.h"
+#include "cryptonote_protocol_defs.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "cn.tx_relay"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /* Invertible bloom lookup table over salted 64 bit short tx ids.       */
+  /* Subtracting a peer's sketch from ours and peeling the result yields  */
+  /* the ids only one side has, as long as the difference is small enough */
+  /* compared to the number of cells.                                     */
+  /************************************************************************/
+  class tx_pool_sketch
+  {
+  public:
+    tx_pool_sketch(size_t cells, uint64_t salt);
+
+    static uint64_t get_short_id(const crypto::hash &txid, uint64_t salt);
+    static bool is_valid_size(size_t cells) { return cells > 0 && cells % 3 == 0; }
+
+    void add(uint64_t short_id);
+    void add_tx(const crypto::hash &txid) { add(get_short_id(txid, m_salt)); }
+    bool subtract(const tx_pool_sketch &other);
+    bool decode(std::vector<uint64_t> &only_ours, std::vector<uint64_t> &only_theirs) const;
+
+    uint64_t get_salt() const { return m_salt; }
+    size_t get_cells() const { return m_counts.size(); }
+
+    void store(NOTIFY_TX_POOL_SKETCH::request_t &req) const;
+    static bool load(const NOTIFY_TX_POOL_SKETCH::request_t &req, tx_pool_sketch &sketch);
+
+  private:
+    void toggle(uint64_t short_id, int32_t delta);
+    size_t get_cell(uint64_t short_id, size_t n) const;
+    bool is_pure(size_t cell) const;
+
+  private:
+    uint64_t m_salt;
+    std::vector<int32_t> m_counts;
+    std::vector<uint64_t> m_key_sums;
+    std::vector<uint32_t> m_check_sums;
+  };
+
+  /************************************************************************/
+  /* Which txes each peer is known to have, and which txes we already     */
+  /* asked for, so announcements are neither echoed back nor requested    */
+  /* from several peers at once                                           */
+  /************************************************************************/
+  class tx_relay_inventory
+  {
+  public:
+    bool add_known(const boost::uuids::uuid &connection_id, const crypto::hash &txid);
+    bool is_known(const boost::uuids::uuid &connection_id, const crypto::hash &txid) const;
+    bool request(const boost::uuids::uuid &connection_id, const crypto::hash &txid, boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time());
+    void flush(const boost::uuids::uuid &connection_id);
+    void prune(boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time());
+    size_t get_known_count(const boost::uuids::uuid &connection_id) const;
+    size_t get_requested_count() const;
+
+  private:
+    mutable boost::mutex mutex;
+    std::map<boost::uuids::uuid, std::unordered_set<crypto::hash>> known;
+    std::unordered_map<crypto::hash, std::pair<boost::uuids::uuid, boost::posix_time::ptime>> requested;
+  };
+}
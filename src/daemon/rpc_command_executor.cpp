@@ -687,6 +687,17 @@ bool t_rpc_command_executor::print_net_stats()
     % percent
     % tools::get_human_readable_bytes(limit);
 
+  for (const auto &q: net_stats_res.send_queues)
+  {
+    tools::msg_writer() << boost::format("%-6s queue: %u messages (%s), %u dropped, wait avg %u us, max %u us")
+      % q.priority
+      % q.messages
+      % tools::get_human_readable_bytes(q.bytes)
+      % q.dropped
+      % q.avg_wait_us
+      % q.max_wait_us;
+  }
+
   return true;
 }
 
@@ -2130,7 +2141,8 @@ bool t_rpc_command_executor::sync_info()
       tools::success_msg_writer() << address << "  " << epee::string_tools::pad_string(p.info.peer_id, 16, '0', true) << "  " <<
           epee::string_tools::pad_string(p.info.state, 16) << "  " <<
           epee::string_tools::pad_string(epee::string_tools::to_string_hex(p.info.pruning_seed), 8) << "  " << p.info.height << "  "  <<
-          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued";
+          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued, sync " <<
+          p.sync_bandwidth/1e3 << " kB/s, rtt " << p.sync_rtt << " ms";
     }
 
     uint64_t total_size = 0;
@@ -143,10 +143,12 @@ namespace hw {
 
         std::vector<crypto::public_key>  device_default::get_subaddress_spend_public_keys(const cryptonote::account_keys &keys, uint32_t account, uint32_t begin, uint32_t end) {
             CHECK_AND_ASSERT_THROW_MES(begin <= end, "begin > end");
+            static_assert(sizeof(crypto::public_key) == 32, "Unexpected public key size");
 
-            std::vector<crypto::public_key> pkeys;
-            pkeys.reserve(end - begin);
-            cryptonote::subaddress_index index = {account, begin};
+            // the points are encoded by batches, sharing a single field inversion
+            static const size_t BATCH_SIZE = 256;
+
+            std::vector<crypto::public_key> pkeys(end - begin);
 
             ge_p3 p3;
             ge_cached cached;
@@ -154,28 +156,44 @@ namespace hw {
                 "ge_frombytes_vartime failed to convert spend public key");
             ge_p3_to_cached(&cached, &p3);
 
-            for (uint32_t idx = begin; idx < end; ++idx)
+            // m = Hs("SubAddr" || a || index_major || index_minor), only the minor index changes
+            const char prefix[] = "SubAddr";
+            char data[sizeof(prefix) + sizeof(crypto::secret_key) + 2 * sizeof(uint32_t)];
+            memcpy(data, prefix, sizeof(prefix));
+            memcpy(data + sizeof(prefix), &keys.m_view_secret_key, sizeof(crypto::secret_key));
+            const uint32_t major = SWAP32LE(account);
+            memcpy(data + sizeof(prefix) + sizeof(crypto::secret_key), &major, sizeof(uint32_t));
+            char *minor_data = data + sizeof(prefix) + sizeof(crypto::secret_key) + sizeof(uint32_t);
+
+            std::vector<ge_p2> points;
+            points.reserve(std::min<size_t>(BATCH_SIZE, end - begin));
+            std::unique_ptr<fe[]> tmp(new fe[BATCH_SIZE]);
+            crypto::secret_key m;
+            for (uint32_t batch_begin = begin; batch_begin < end; )
             {
-                index.minor = idx;
-                if (index.is_zero())
+                const uint32_t batch_end = (uint32_t)std::min<uint64_t>(end, (uint64_t)batch_begin + BATCH_SIZE);
+                points.clear();
+                for (uint32_t idx = batch_begin; idx < batch_end; ++idx)
                 {
-                    pkeys.push_back(keys.m_account_address.m_spend_public_key);
-                    continue;
+                    const uint32_t minor = SWAP32LE(idx);
+                    memcpy(minor_data, &minor, sizeof(uint32_t));
+                    crypto::hash_to_scalar(data, sizeof(data), m);
+
+                    // D = B + m*G
+                    ge_p1p1 p1p1;
+                    ge_scalarmult_base(&p3, (const unsigned char*)m.data);
+                    ge_add(&p1p1, &p3, &cached);
+                    points.emplace_back();
+                    ge_p1p1_to_p2(&points.back(), &p1p1);
                 }
-                crypto::secret_key m = get_subaddress_secret_key(keys.m_view_secret_key, index);
-
-                // M = m*G
-                ge_scalarmult_base(&p3, (const unsigned char*)m.data);
-
-                // D = B + M
-                crypto::public_key D;
-                ge_p1p1 p1p1;
-                ge_add(&p1p1, &p3, &cached);
-                ge_p1p1_to_p3(&p3, &p1p1);
-                ge_p3_tobytes((unsigned char*)D.data, &p3);
-
-                pkeys.push_back(D);
+                ge_tobytes_batch((unsigned char*)pkeys[batch_begin - begin].data, points.data(), tmp.get(), points.size());
+                batch_begin = batch_end;
             }
+            memwipe(data, sizeof(data));
+
+            // the subaddress 0/0 is the main address, the point computed for it above is discarded
+            if (account == 0 && begin == 0 && end > 0)
+                pkeys[0] = keys.m_account_address.m_spend_public_key;
             return pkeys;
         }
 
@@ -38,6 +38,7 @@
 #include "net/error.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_stream.h"
 #include "string_tools.h"
 
 namespace net
@@ -120,7 +121,8 @@ namespace net
         return i2p_address{host, porti};
     }
 
-    bool i2p_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    template<typename t_storage>
+    bool i2p_address::_load(t_storage& src, typename t_storage::hsection hparent)
     {
         i2p_serialized in{};
         if (in._load(src, hparent) && in.host.size() < sizeof(host_) && (in.host == unknown_host || !host_check(in.host).has_error()))
@@ -136,12 +138,18 @@ namespace net
         return false;
     }
 
-    bool i2p_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
+    template<typename t_storage>
+    bool i2p_address::store(t_storage& dest, typename t_storage::hsection hparent) const
     {
         const i2p_serialized out{std::string{host_}, port_};
         return out.store(dest, hparent);
     }
 
+    template bool i2p_address::_load(epee::serialization::portable_storage&, epee::serialization::portable_storage::hsection);
+    template bool i2p_address::_load(epee::serialization::portable_binary_reader&, epee::serialization::portable_binary_reader::hsection);
+    template bool i2p_address::store(epee::serialization::portable_storage&, epee::serialization::portable_storage::hsection) const;
+    template bool i2p_address::store(epee::serialization::portable_binary_writer&, epee::serialization::portable_binary_writer::hsection) const;
+
     i2p_address::i2p_address(const i2p_address& rhs) noexcept
       : port_(rhs.port_)
     {
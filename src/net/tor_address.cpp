@@ -38,6 +38,7 @@
 #include "net/error.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_stream.h"
 #include "string_tools.h"
 
 namespace net
@@ -122,7 +123,8 @@ namespace net
         return tor_address{host, porti};
     }
 
-    bool tor_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    template<typename t_storage>
+    bool tor_address::_load(t_storage& src, typename t_storage::hsection hparent)
     {
         tor_serialized in{};
         if (in._load(src, hparent) && in.host.size() < sizeof(host_) && (in.host == unknown_host || !host_check(in.host).has_error()))
@@ -138,12 +140,18 @@ namespace net
         return false;
     }
 
-    bool tor_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
+    template<typename t_storage>
+    bool tor_address::store(t_storage& dest, typename t_storage::hsection hparent) const
     {
         const tor_serialized out{std::string{host_}, port_};
         return out.store(dest, hparent);
     }
 
+    template bool tor_address::_load(epee::serialization::portable_storage&, epee::serialization::portable_storage::hsection);
+    template bool tor_address::_load(epee::serialization::portable_binary_reader&, epee::serialization::portable_binary_reader::hsection);
+    template bool tor_address::store(epee::serialization::portable_storage&, epee::serialization::portable_storage::hsection) const;
+    template bool tor_address::store(epee::serialization::portable_binary_writer&, epee::serialization::portable_binary_writer::hsection) const;
+
     tor_address::tor_address(const tor_address& rhs) noexcept
       : port_(rhs.port_)
     {
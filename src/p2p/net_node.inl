@@ -1006,6 +1006,7 @@ namespace nodetool
           
           m_broadcast_bytes_out += buff.size() * get_connections_count();
           m_rta_msg_p2p_counter++;
+          const epee::byte_slice message{std::move(buff)};
           // Graft: removed in Monero, inlining: relay_notify_to_all(command, buff, context);
           for (auto &zone : m_network_zones) {
             std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections;
@@ -1021,7 +1022,7 @@ namespace nodetool
             if (connections.empty())
               MERROR("no connections to relay message: " << arg.message_id);
             else
-              relay_notify_to_list(command, epee::strspan<uint8_t>(buff), std::move(connections));
+              relay_notify_to_list(command, message.clone(), std::move(connections));
               MDEBUG("handle_broadcast: relayed broadcast from " << arg.sender_address
                    << ", message: '" << arg.message_id << "',  to peers. Hop level: " << arg.hop );
           };
@@ -2042,7 +2043,7 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections)
+  bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, epee::byte_slice message, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections)
   {
     std::sort(connections.begin(), connections.end());
     auto zone = m_network_zones.begin();
@@ -2060,8 +2061,9 @@ namespace nodetool
 	  
         ++zone;
       }
+      // every peer queues a reference to the same serialized message
       if (zone->first == c_id.first)
-        zone->second.m_net_server.get_config_object().notify(command, data_buff, c_id.second);
+        zone->second.m_net_server.get_config_object().notify(command, message.clone(), c_id.second);
     }
     return true;
   }
@@ -2073,13 +2075,29 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context)
+  epee::net_utils::send_priority node_server<t_payload_net_handler>::get_send_priority(int command)
+  {
+    switch (command)
+    {
+      // RTA broadcasts and connection keepalive must not queue behind block sync
+      case COMMAND_BROADCAST::ID:
+      case COMMAND_HANDSHAKE::ID:
+      case COMMAND_TIMED_SYNC::ID:
+      case COMMAND_PING::ID:
+        return epee::net_utils::send_priority::high;
+      default:
+        return m_payload_handler.get_send_priority(command);
+    }
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::invoke_notify_to_peer(int command, epee::byte_slice message, const epee::net_utils::connection_context_base& context)
   {
     if(is_filtered_command(context.m_remote_address, command))
       return false;
 
     network_zone& zone = m_network_zones.at(context.m_remote_address.get_zone());
-    int res = zone.m_net_server.get_config_object().notify(command, req_buff, context.m_connection_id);
+    int res = zone.m_net_server.get_config_object().notify(command, std::move(message), context.m_connection_id);
     return res > 0;
   }
   //-----------------------------------------------------------------------------------
@@ -2398,6 +2416,9 @@ namespace nodetool
 
       std::string blob;
       epee::serialization::store_t_to_binary(p2p_req, blob);
+      const size_t blob_size = blob.size();
+      // serialized once, every peer is sent a reference to the same buffer
+      const epee::byte_slice message{std::move(blob)};
       std::set<peerid_type> announced_peers;
 
       // send to peers
@@ -2420,14 +2441,14 @@ namespace nodetool
   
         for (const auto &c: connections) {
             MTRACE("[" << c.info << "] invoking COMMAND_BROADCAST");
-            if (zone.second.m_net_server.get_config_object().notify(COMMAND_BROADCAST::ID, epee::strspan<uint8_t>(blob), c.id)) {
+            if (zone.second.m_net_server.get_config_object().notify(COMMAND_BROADCAST::ID, message.clone(), c.id)) {
                 MTRACE("[" << c.info << "] COMMAND_BROADCAST invoked, peer_id: " << c.peer_id);
                 announced_peers.insert(c.peer_id);
             }
             else
                 LOG_ERROR("[" << c.info << "] failed to invoke COMMAND_BROADCAST");
         }
-        m_broadcast_bytes_out += blob.size() * announced_peers.size();
+        m_broadcast_bytes_out += blob_size * announced_peers.size();
   
      }
       
@@ -0,0 +1,147 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/thread/thread_time.hpp>
+
+#include "misc_log_ex.h"
+#include "rctSigs.h"
+#include "bulletproof_batcher.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "bulletproofs"
+
+namespace
+{
+  // verifies [begin, end); `known_bad` means a sibling check already proved
+  // the range holds a failure, so it is split without verifying it whole
+  bool bisect(const std::vector<const rct::rctSig*> &rvv, size_t begin, size_t end, bool known_bad, std::deque<bool> &results)
+  {
+    if (!known_bad)
+    {
+      const std::vector<const rct::rctSig*> range(rvv.begin() + begin, rvv.begin() + end);
+      if (rct::verRctSemanticsSimple(range))
+        return true;
+    }
+    if (end - begin == 1)
+    {
+      results[begin] = false;
+      return false;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    const bool left = bisect(rvv, begin, mid, false, results);
+    bisect(rvv, mid, end, left, results);
+    return false;
+  }
+}
+
+namespace rct
+{
+  bulletproof_batcher::bulletproof_batcher(const uint64_t window_us, const size_t max_proofs)
+    : m_window_us(window_us), m_max_proofs(max_proofs), m_queued_proofs(0), m_leader(false)
+  {
+  }
+
+  bool bulletproof_batcher::verify_bisect(const std::vector<const rctSig*> &rvv, std::deque<bool> &results)
+  {
+    results.assign(rvv.size(), true);
+    if (rvv.empty())
+      return true;
+    if (bisect(rvv, 0, rvv.size(), false, results))
+      return true;
+    MDEBUG("Bulletproof batch of " << rvv.size() << " failed, " << std::count(results.begin(), results.end(), false) << " bad");
+    return false;
+  }
+
+  bool bulletproof_batcher::verify(const std::vector<const rctSig*> &rvv, std::deque<bool> &results, const bool others_pending)
+  {
+    if (!m_window_us || !m_max_proofs || !others_pending)
+      return verify_bisect(rvv, results);
+
+    results.assign(rvv.size(), false);
+    if (rvv.empty())
+      return true;
+
+    request req{rvv.size()};
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    for (size_t i = 0; i < rvv.size(); ++i)
+    {
+      m_queue.push_back({rvv[i], &results[i], &req});
+      m_queued_proofs += std::max<size_t>(1, rvv[i]->p.bulletproofs.size());
+    }
+
+    if (!m_leader)
+    {
+      m_leader = true;
+      const boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds(m_window_us);
+      while (m_queued_proofs < m_max_proofs)
+        if (!m_cond.timed_wait(lock, deadline))
+          break;
+
+      // the next caller starts a new batch while this one is verified
+      std::vector<entry> batch;
+      batch.swap(m_queue);
+      m_queued_proofs = 0;
+      m_leader = false;
+      lock.unlock();
+
+      std::vector<const rctSig*> sigs;
+      sigs.reserve(batch.size());
+      for (const entry &e: batch)
+        sigs.push_back(e.rv);
+      std::deque<bool> batch_results;
+      try
+      {
+        verify_bisect(sigs, batch_results);
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Exception verifying bulletproof batch: " << e.what());
+        batch_results.assign(sigs.size(), false);
+      }
+      MDEBUG("Verified a batch of " << sigs.size() << " rctSigs");
+
+      lock.lock();
+      for (size_t i = 0; i < batch.size(); ++i)
+      {
+        *batch[i].result = batch_results[i];
+        --batch[i].req->pending;
+      }
+      m_cond.notify_all();
+    }
+    else if (m_queued_proofs >= m_max_proofs)
+    {
+      m_cond.notify_all();
+    }
+
+    while (req.pending)
+      m_cond.wait(lock);
+
+    return std::find(results.begin(), results.end(), false) == results.end();
+  }
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "rctTypes.h"
+
+namespace rct
+{
+  /*! Verifies the semantics of rctSigs handed in by concurrent callers (txes
+      relayed by different peers, RPC submissions) as one bulletproof batch.
+
+      The first caller to find no batch forming waits up to the window, or
+      until the proof cap is reached, for others to join, verifies the whole
+      batch and wakes everyone. A failed batch is bisected so only the bad
+      rctSigs are reported, instead of reverifying every one of them. */
+  class bulletproof_batcher
+  {
+  public:
+    //! A zero `window_us` or `max_proofs` verifies each call on its own
+    bulletproof_batcher(uint64_t window_us, size_t max_proofs);
+
+    /*! Blocks until `rvv` has been verified, with whatever other callers
+        submitted in the meantime. Without `others_pending` no caller can
+        join, so no batch is waited for and `rvv` is verified at once.
+        \return True if all of `rvv` passed; `results[i]` is set for `rvv[i]` */
+    bool verify(const std::vector<const rctSig*> &rvv, std::deque<bool> &results, bool others_pending = true);
+
+    //! Verifies `rvv` as one batch and bisects it on failure
+    static bool verify_bisect(const std::vector<const rctSig*> &rvv, std::deque<bool> &results);
+
+  private:
+    struct request
+    {
+      size_t pending;
+    };
+
+    struct entry
+    {
+      const rctSig *rv;
+      bool *result;
+      request *req;
+    };
+
+    const uint64_t m_window_us;
+    const size_t m_max_proofs;
+    boost::mutex m_lock;
+    boost::condition_variable m_cond;
+    std::vector<entry> m_queue;
+    size_t m_queued_proofs;
+    bool m_leader;
+  };
+}
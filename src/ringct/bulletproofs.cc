@@ -184,6 +184,40 @@ static rct::key cross_vector_exponent8(size_t size, const std::vector<ge_p3> &A,
   return multiexp(multiexp_data, 0);
 }
 
+/* Same as cross_vector_exponent8, for the first inner product round, where A and B are
+   still Gi and Hi: the terms are laid out as the Gi/Hi cache expects, with zero scalars
+   in the unused half, so the multiexp reuses the cached data rather than building its
+   own tables, and the extra H term goes through the fixed base table */
+static rct::key cross_vector_exponent8_HiGi(size_t size, size_t Ao, size_t Bo, const rct::keyV &a, size_t ao, const rct::keyV &b, size_t bo, const rct::keyV *scale, const rct::key &extra_scalar)
+{
+  CHECK_AND_ASSERT_THROW_MES(size + Ao <= 2 * size, "Incompatible size for A");
+  CHECK_AND_ASSERT_THROW_MES(size + Bo <= 2 * size, "Incompatible size for B");
+  CHECK_AND_ASSERT_THROW_MES(size + ao <= a.size(), "Incompatible size for a");
+  CHECK_AND_ASSERT_THROW_MES(size + bo <= b.size(), "Incompatible size for b");
+  CHECK_AND_ASSERT_THROW_MES(2 * size <= maxN*maxM, "size is too large");
+  CHECK_AND_ASSERT_THROW_MES(!scale || size == scale->size() / 2, "Incompatible size for scale");
+
+  std::vector<MultiexpData> multiexp_data;
+  multiexp_data.reserve(size*4);
+  for (size_t i = 0; i < size*2; ++i)
+  {
+    multiexp_data.emplace_back(rct::zero(), Gi_p3[i]);
+    multiexp_data.emplace_back(rct::zero(), Hi_p3[i]);
+  }
+  for (size_t i = 0; i < size; ++i)
+  {
+    rct::key &as = multiexp_data[(Ao+i)*2].scalar;
+    sc_mul(as.bytes, a[ao+i].bytes, INV_EIGHT.bytes);
+    rct::key &bs = multiexp_data[(Bo+i)*2+1].scalar;
+    sc_mul(bs.bytes, b[bo+i].bytes, INV_EIGHT.bytes);
+    if (scale)
+      sc_mul(bs.bytes, bs.bytes, (*scale)[Bo+i].bytes);
+  }
+  rct::key extra;
+  sc_mul(extra.bytes, extra_scalar.bytes, INV_EIGHT.bytes);
+  return rct::addKeys(multiexp(multiexp_data, size*4), rct::scalarmultH(extra));
+}
+
 /* Given a scalar, construct a vector of powers */
 static rct::keyV vector_powers(const rct::key &x, size_t n)
 {
@@ -481,6 +515,11 @@ Bulletproof bulletproof_PROVE(uint64_t v, const rct::key &gamma)
   return bulletproof_PROVE(std::vector<uint64_t>(1, v), rct::keyV(1, gamma));
 }
 
+void bulletproof_init()
+{
+  init_exponents();
+}
+
 /* Given a set of values v (0..2^N-1) and masks gamma, construct a range proof */
 Bulletproof bulletproof_PROVE(const rct::keyV &sv, const rct::keyV &gamma)
 {
@@ -635,15 +674,12 @@ try_again:
   rct::key tau1 = rct::skGen(), tau2 = rct::skGen();
 
   rct::key T1, T2;
-  ge_p3 p3;
   sc_mul(tmp.bytes, t1.bytes, INV_EIGHT.bytes);
   sc_mul(tmp2.bytes, tau1.bytes, INV_EIGHT.bytes);
-  ge_double_scalarmult_base_vartime_p3(&p3, tmp.bytes, &ge_p3_H, tmp2.bytes);
-  ge_p3_tobytes(T1.bytes, &p3);
+  rct::addKeys2(T1, tmp2, tmp, rct::H);
   sc_mul(tmp.bytes, t2.bytes, INV_EIGHT.bytes);
   sc_mul(tmp2.bytes, tau2.bytes, INV_EIGHT.bytes);
-  ge_double_scalarmult_base_vartime_p3(&p3, tmp.bytes, &ge_p3_H, tmp2.bytes);
-  ge_p3_tobytes(T2.bytes, &p3);
+  rct::addKeys2(T2, tmp2, tmp, rct::H);
 
   // PAPER LINES 49-51
   rct::key x = hash_cache_mash(hash_cache, z, T1, T2);
@@ -737,10 +773,20 @@ try_again:
 
     // PAPER LINES 18-19
     PERF_TIMER_START_BP(PROVE_LR);
-    sc_mul(tmp.bytes, cL.bytes, x_ip.bytes);
-    L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmp);
-    sc_mul(tmp.bytes, cR.bytes, x_ip.bytes);
-    R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmp);
+    if (round == 0)
+    {
+      sc_mul(tmp.bytes, cL.bytes, x_ip.bytes);
+      L[round] = cross_vector_exponent8_HiGi(nprime, nprime, 0, aprime, 0, bprime, nprime, scale, tmp);
+      sc_mul(tmp.bytes, cR.bytes, x_ip.bytes);
+      R[round] = cross_vector_exponent8_HiGi(nprime, 0, nprime, aprime, nprime, bprime, 0, scale, tmp);
+    }
+    else
+    {
+      sc_mul(tmp.bytes, cL.bytes, x_ip.bytes);
+      L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmp);
+      sc_mul(tmp.bytes, cR.bytes, x_ip.bytes);
+      R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmp);
+    }
     PERF_TIMER_STOP_BP(PROVE_LR);
 
     // PAPER LINES 21-22
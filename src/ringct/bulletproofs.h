@@ -38,6 +38,8 @@
 namespace rct
 {
 
+/* Computes the generators and multiexp caches shared by all proofs, which is otherwise done by the first proof */
+void bulletproof_init();
 Bulletproof bulletproof_PROVE(const rct::key &v, const rct::key &gamma);
 Bulletproof bulletproof_PROVE(uint64_t v, const rct::key &gamma);
 Bulletproof bulletproof_PROVE(const rct::keyV &v, const rct::keyV &gamma);
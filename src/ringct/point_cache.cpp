@@ -0,0 +1,176 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstring>
+
+#include "misc_log_ex.h"
+#include "cryptonote_config.h"
+#include "rctOps.h"
+#include "point_cache.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "ringct"
+
+// log the hit rates every that many lookups
+#define POINT_CACHE_STATS_INTERVAL 65536
+
+namespace rct
+{
+  point_cache::point_cache(size_t max_entries):
+    m_max_per_shard((max_entries + SHARDS - 1) / SHARDS),
+    m_point_hits(0),
+    m_point_misses(0),
+    m_hash_point_hits(0),
+    m_hash_point_misses(0),
+    m_lookups(0)
+  {
+  }
+
+  point_cache &point_cache::instance()
+  {
+    static point_cache cache(RCT_POINT_CACHE_MAX_ENTRIES);
+    return cache;
+  }
+
+  bool point_cache::lookup(const key &k, uint8_t have, uint8_t valid, ge_p3 entry::*field, ge_p3 &p3, bool &is_valid)
+  {
+    shard &s = get_shard(k);
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    const auto it = s.index.find(k);
+    if (it == s.index.end() || !(it->second->flags & have))
+      return false;
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    is_valid = it->second->flags & valid;
+    if (is_valid)
+      p3 = (*it->second).*field;
+    return true;
+  }
+
+  void point_cache::store(const key &k, uint8_t have, uint8_t valid, ge_p3 entry::*field, const ge_p3 &p3)
+  {
+    shard &s = get_shard(k);
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    auto it = s.index.find(k);
+    if (it == s.index.end())
+    {
+      s.lru.emplace_front();
+      s.lru.front().k = k;
+      s.lru.front().flags = 0;
+      it = s.index.emplace(k, s.lru.begin()).first;
+      if (s.lru.size() > m_max_per_shard)
+      {
+        s.index.erase(s.lru.back().k);
+        s.lru.pop_back();
+      }
+    }
+    entry &e = *it->second;
+    e.flags |= have | valid;
+    e.*field = p3;
+  }
+
+  void point_cache::count(std::atomic<uint64_t> &counter)
+  {
+    ++counter;
+    if (++m_lookups % POINT_CACHE_STATS_INTERVAL == 0)
+    {
+      const stats st = get_stats();
+      MINFO("Point cache: " << st.entries << " entries, decompression hit rate " <<
+          st.point_hits * 100 / std::max<uint64_t>(st.point_hits + st.point_misses, 1) << "%, hash to point hit rate " <<
+          st.hash_point_hits * 100 / std::max<uint64_t>(st.hash_point_hits + st.hash_point_misses, 1) << "%");
+    }
+  }
+
+  bool point_cache::point(const key &k, ge_p3 &p3)
+  {
+    if (m_max_per_shard == 0)
+      return ge_frombytes_vartime(&p3, k.bytes) == 0;
+
+    bool valid;
+    if (lookup(k, HAVE_POINT, POINT_VALID, &entry::point, p3, valid))
+    {
+      count(m_point_hits);
+      return valid;
+    }
+    count(m_point_misses);
+    valid = ge_frombytes_vartime(&p3, k.bytes) == 0;
+    store(k, HAVE_POINT, valid ? POINT_VALID : 0, &entry::point, p3);
+    return valid;
+  }
+
+  bool point_cache::hash_point(const key &k, ge_p3 &p3)
+  {
+    bool valid;
+    if (m_max_per_shard > 0 && lookup(k, HAVE_HASH_POINT, HASH_POINT_VALID, &entry::hash_point, p3, valid))
+    {
+      count(m_hash_point_hits);
+      return valid;
+    }
+
+    const key h = cn_fast_hash(k);
+    ge_p2 p2;
+    ge_p1p1 p1;
+    ge_fromfe_frombytes_vartime(&p2, h.bytes);
+    ge_mul8(&p1, &p2);
+    ge_p1p1_to_p3(&p3, &p1);
+    valid = !ge_p3_is_point_at_infinity(&p3);
+
+    if (m_max_per_shard > 0)
+    {
+      count(m_hash_point_misses);
+      store(k, HAVE_HASH_POINT, valid ? HASH_POINT_VALID : 0, &entry::hash_point, p3);
+    }
+    return valid;
+  }
+
+  point_cache::stats point_cache::get_stats() const
+  {
+    stats st;
+    st.point_hits = m_point_hits;
+    st.point_misses = m_point_misses;
+    st.hash_point_hits = m_hash_point_hits;
+    st.hash_point_misses = m_hash_point_misses;
+    st.entries = 0;
+    for (const shard &s: m_shards)
+    {
+      boost::lock_guard<boost::mutex> lock(s.lock);
+      st.entries += s.lru.size();
+    }
+    return st;
+  }
+
+  void point_cache::clear()
+  {
+    for (shard &s: m_shards)
+    {
+      boost::lock_guard<boost::mutex> lock(s.lock);
+      s.index.clear();
+      s.lru.clear();
+    }
+  }
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "rctTypes.h"
+
+namespace rct
+{
+  /*! Bounded, thread safe cache of the decompressed form and hash-to-point of
+      keys seen during ringct validation.
+
+      Popular decoys appear in many rings, and a tx is verified once on pool
+      admission and again when mined, so the same ring member keys (and key
+      images) are decompressed and hashed to points over and over. Entries are
+      kept per shard in LRU order; lookups of different keys rarely contend. */
+  class point_cache
+  {
+  public:
+    struct stats
+    {
+      uint64_t point_hits;
+      uint64_t point_misses;
+      uint64_t hash_point_hits;
+      uint64_t hash_point_misses;
+      size_t entries;
+    };
+
+    //! A zero `max_entries` disables the cache, every lookup is computed
+    explicit point_cache(size_t max_entries);
+
+    //! The process wide cache used by ringct verification
+    static point_cache &instance();
+
+    /*! ge_frombytes_vartime of `k`
+        \return False if `k` is not a valid point encoding */
+    bool point(const key &k, ge_p3 &p3);
+
+    /*! hashToPoint of `k`, in extended form
+        \return False if it is the point at infinity */
+    bool hash_point(const key &k, ge_p3 &p3);
+
+    stats get_stats() const;
+    void clear();
+
+  private:
+    enum : uint8_t
+    {
+      HAVE_POINT = 1,
+      POINT_VALID = 2,
+      HAVE_HASH_POINT = 4,
+      HASH_POINT_VALID = 8
+    };
+
+    struct entry
+    {
+      key k;
+      uint8_t flags;
+      ge_p3 point;
+      ge_p3 hash_point;
+    };
+
+    struct shard
+    {
+      mutable boost::mutex lock;
+      std::list<entry> lru; // most recently used first
+      std::unordered_map<key, std::list<entry>::iterator> index;
+    };
+
+    static constexpr size_t SHARDS = 16;
+
+    shard &get_shard(const key &k) { return m_shards[k.bytes[0] % SHARDS]; }
+    bool lookup(const key &k, uint8_t have, uint8_t valid, ge_p3 entry::*field, ge_p3 &p3, bool &is_valid);
+    void store(const key &k, uint8_t have, uint8_t valid, ge_p3 entry::*field, const ge_p3 &p3);
+    void count(std::atomic<uint64_t> &counter);
+
+    const size_t m_max_per_shard;
+    shard m_shards[SHARDS];
+    std::atomic<uint64_t> m_point_hits;
+    std::atomic<uint64_t> m_point_misses;
+    std::atomic<uint64_t> m_hash_point_hits;
+    std::atomic<uint64_t> m_hash_point_misses;
+    std::atomic<uint64_t> m_lookups;
+  };
+}
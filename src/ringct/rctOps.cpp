@@ -385,12 +385,37 @@ namespace rct {
     }
 
 
+    //(j+1)*256^i*H, the counterpart of ge_base, built on first use
+    static const ge_fixed_base_table &H_table() {
+        static ge_fixed_base_table table;
+        static const bool ready = (ge_fixed_base_precomp(table, &ge_p3_H), true);
+        (void)ready;
+        return table;
+    }
+
+    //aG + bH, both through the fixed base tables
+    //G and H have order l, so reducing the scalars first does not change the result
+    static void addKeysGH(ge_p3 &aGbH, const key &a, const key &b) {
+        key reduced;
+        ge_p3 bH;
+        ge_cached cached;
+        ge_p1p1 p1;
+        sc_reduce32copy(reduced.bytes, a.bytes);
+        ge_scalarmult_base(&aGbH, reduced.bytes);
+        sc_reduce32copy(reduced.bytes, b.bytes);
+        ge_scalarmult_fixed_base(&bH, reduced.bytes, H_table());
+        ge_p3_to_cached(&cached, &bH);
+        ge_add(&p1, &aGbH, &cached);
+        ge_p1p1_to_p3(&aGbH, &p1);
+    }
+
     //Computes aH where H= toPoint(cn_fast_hash(G)), G the basepoint
     key scalarmultH(const key & a) {
-        ge_p2 R;
-        ge_scalarmult(&R, a.bytes, &ge_p3_H);
+        ge_p3 R;
         key aP;
-        ge_tobytes(aP.bytes, &R);
+        sc_reduce32copy(aP.bytes, a.bytes); //H has order l
+        ge_scalarmult_fixed_base(&R, aP.bytes, H_table());
+        ge_p3_tobytes(aP.bytes, &R);
         return aP;
     }
 
@@ -464,6 +489,12 @@ namespace rct {
     //addKeys2
     //aGbB = aG + bB where a, b are scalars, G is the basepoint and B is a point
     void addKeys2(key &aGbB, const key &a, const key &b, const key & B) {
+        if (B == rct::H) {
+            ge_p3 rv;
+            addKeysGH(rv, a, b);
+            ge_p3_tobytes(aGbB.bytes, &rv);
+            return;
+        }
         ge_p2 rv;
         ge_p3 B2;
         CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&B2, B.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
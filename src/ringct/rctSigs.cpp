@@ -34,6 +34,7 @@
 #include "common/util.h"
 #include "rctSigs.h"
 #include "bulletproofs.h"
+#include "point_cache.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 
 using namespace crypto;
@@ -290,7 +291,9 @@ namespace rct {
         CHECK_AND_ASSERT_MES(sc_check(rv.cc.bytes) == 0, false, "Bad cc");
 
         size_t i = 0, j = 0, ii = 0;
-        key c,  L, R, Hi;
+        key c,  L, R;
+        ge_p3 pk_p3, Hi_p3;
+        ge_p2 p2;
         key c_old = copy(rv.cc);
         vector<geDsmp> Ip(dsRows);
         for (i = 0 ; i < dsRows ; i++) {
@@ -303,10 +306,12 @@ namespace rct {
         while (i < cols) {
             sc_0(c.bytes);
             for (j = 0; j < dsRows; j++) {
-                addKeys2(L, rv.ss[i][j], c_old, pk[i][j]);
-                hashToPoint(Hi, pk[i][j]);
-                CHECK_AND_ASSERT_MES(!(Hi == rct::identity()), false, "Data hashed to point at infinity");
-                addKeys3(R, rv.ss[i][j], Hi, c_old, Ip[j].k);
+                CHECK_AND_ASSERT_MES(point_cache::instance().point(pk[i][j], pk_p3), false, "point conv failed");
+                ge_double_scalarmult_base_vartime(&p2, c_old.bytes, &pk_p3, rv.ss[i][j].bytes);
+                ge_tobytes(L.bytes, &p2);
+                CHECK_AND_ASSERT_MES(point_cache::instance().hash_point(pk[i][j], Hi_p3), false, "Data hashed to point at infinity");
+                ge_double_scalarmult_precomp_vartime(&p2, rv.ss[i][j].bytes, &Hi_p3, c_old.bytes, Ip[j].k);
+                ge_tobytes(R.bytes, &p2);
                 toHash[3 * j + 1] = pk[i][j];
                 toHash[3 * j + 2] = L; 
                 toHash[3 * j + 3] = R;
@@ -615,7 +620,7 @@ namespace rct {
             for (i = 0; i < cols; i++) {
                     M[i][0] = pubs[i].dest;
                     ge_p3 p3;
-                    CHECK_AND_ASSERT_MES_L1(ge_frombytes_vartime(&p3, pubs[i].mask.bytes) == 0, false, "point conv failed");
+                    CHECK_AND_ASSERT_MES_L1(point_cache::instance().point(pubs[i].mask, p3), false, "point conv failed");
                     ge_sub(&p1, &p3, &Ccached);
                     ge_p1p1_to_p3(&p3, &p1);
                     ge_p3_tobytes(M[i][1].bytes, &p3);
@@ -626,6 +631,225 @@ namespace rct {
         catch (...) { return false; }
     }
 
+    namespace
+    {
+        struct mg_batch_point
+        {
+            bool valid;
+            ge_p3 p3;
+        };
+
+        struct mg_batch_hp
+        {
+            bool valid;
+            ge_dsmp table;
+        };
+
+        // one ring of a batch, with the challenge carried from column to column
+        struct mg_batch_ring
+        {
+            size_t index;
+            const mgSimpleInput *input;
+            std::vector<const ge_p3*> dests;
+            std::vector<const mg_batch_hp*> hps;
+            std::vector<ge_p3> commitments;
+            keyV commitment_bytes;
+            ge_dsmp I;
+            key c;
+        };
+
+        class mg_batch_cache
+        {
+        public:
+            const ge_p3 *point(const key &k)
+            {
+                auto it = m_points.find(k);
+                if (it == m_points.end())
+                {
+                    mg_batch_point &p = m_points[k];
+                    p.valid = point_cache::instance().point(k, p.p3);
+                    it = m_points.find(k);
+                }
+                return it->second.valid ? &it->second.p3 : NULL;
+            }
+
+            const mg_batch_hp *hash_point(const key &k)
+            {
+                auto it = m_hps.find(k);
+                if (it == m_hps.end())
+                {
+                    mg_batch_hp &hp = m_hps[k];
+                    ge_p3 p3;
+                    hp.valid = point_cache::instance().hash_point(k, p3);
+                    if (hp.valid)
+                        ge_dsm_precomp(hp.table, &p3);
+                    it = m_hps.find(k);
+                }
+                return it->second.valid ? &it->second : NULL;
+            }
+
+        private:
+            std::unordered_map<key, mg_batch_point> m_points;
+            std::unordered_map<key, mg_batch_hp> m_hps;
+        };
+
+        void encode_points(keyV &out, const std::vector<ge_p2> &points)
+        {
+            out.resize(points.size());
+            if (points.empty())
+                return;
+            std::unique_ptr<fe[]> tmp(new fe[points.size()]);
+            ge_tobytes_batch(out[0].bytes, points.data(), tmp.get(), points.size());
+        }
+
+        // same checks as verRctMGSimple/MLSAG_Ver with one double spend row
+        bool mg_batch_setup(mg_batch_ring &ring, mg_batch_cache &cache)
+        {
+            const mgSig &mg = *ring.input->mg;
+            const ctkeyV &pubs = *ring.input->pubs;
+            const size_t cols = pubs.size();
+            CHECK_AND_ASSERT_MES(cols >= 2, false, "Error! What is c if cols = 1!");
+            CHECK_AND_ASSERT_MES(mg.II.size() == 1, false, "Bad II size");
+            CHECK_AND_ASSERT_MES(mg.ss.size() == cols, false, "Bad rv.ss size");
+            for (size_t i = 0; i < cols; ++i)
+            {
+                CHECK_AND_ASSERT_MES(mg.ss[i].size() == 2, false, "rv.ss is not rectangular");
+                CHECK_AND_ASSERT_MES(sc_check(mg.ss[i][0].bytes) == 0 && sc_check(mg.ss[i][1].bytes) == 0, false, "Bad ss slot");
+            }
+            CHECK_AND_ASSERT_MES(sc_check(mg.cc.bytes) == 0, false, "Bad cc");
+
+            ge_p3 p3;
+            CHECK_AND_ASSERT_MES_L1(point_cache::instance().point(mg.II[0], p3), false, "point conv failed");
+            ge_dsm_precomp(ring.I, &p3);
+            const ge_p3 *C = cache.point(*ring.input->C);
+            CHECK_AND_ASSERT_MES_L1(C, false, "point conv failed");
+            ge_cached Ccached;
+            ge_p3_to_cached(&Ccached, C);
+
+            ring.dests.resize(cols);
+            ring.hps.resize(cols);
+            ring.commitments.resize(cols);
+            std::vector<ge_p2> commitments(cols);
+            for (size_t i = 0; i < cols; ++i)
+            {
+                ring.dests[i] = cache.point(pubs[i].dest);
+                CHECK_AND_ASSERT_MES_L1(ring.dests[i], false, "point conv failed");
+                ring.hps[i] = cache.hash_point(pubs[i].dest);
+                CHECK_AND_ASSERT_MES(ring.hps[i], false, "Data hashed to point at infinity");
+                const ge_p3 *mask = cache.point(pubs[i].mask);
+                CHECK_AND_ASSERT_MES_L1(mask, false, "point conv failed");
+                ge_p1p1 p1;
+                ge_sub(&p1, mask, &Ccached);
+                ge_p1p1_to_p3(&ring.commitments[i], &p1);
+                ge_p3_to_p2(&commitments[i], &ring.commitments[i]);
+            }
+            encode_points(ring.commitment_bytes, commitments);
+            ring.c = mg.cc;
+            return true;
+        }
+
+        void verRctMGSimpleBatch(const std::vector<mgSimpleInput> &inputs, size_t begin, size_t end, std::deque<bool> &results)
+        {
+            mg_batch_cache cache;
+            std::vector<mg_batch_ring> rings;
+            rings.reserve(end - begin);
+            size_t max_cols = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                results[i] = false;
+                rings.emplace_back();
+                rings.back().index = i;
+                rings.back().input = &inputs[i];
+                if (!mg_batch_setup(rings.back(), cache))
+                {
+                    rings.pop_back();
+                    continue;
+                }
+                max_cols = std::max(max_cols, inputs[i].pubs->size());
+            }
+
+            // L, R for the double spend row and L for the commitment row, for each ring still in the column
+            std::vector<ge_p2> points;
+            keyV encoded;
+            keyV toHash(6);
+            for (size_t col = 0; col < max_cols; ++col)
+            {
+                points.clear();
+                for (const mg_batch_ring &ring: rings)
+                {
+                    if (col >= ring.dests.size())
+                        continue;
+                    const keyV &ss = ring.input->mg->ss[col];
+                    points.emplace_back();
+                    ge_double_scalarmult_base_vartime(&points.back(), ring.c.bytes, ring.dests[col], ss[0].bytes);
+                    points.emplace_back();
+                    ge_double_scalarmult_precomp_vartime2(&points.back(), ss[0].bytes, ring.hps[col]->table, ring.c.bytes, ring.I);
+                    points.emplace_back();
+                    ge_double_scalarmult_base_vartime(&points.back(), ring.c.bytes, &ring.commitments[col], ss[1].bytes);
+                }
+                encode_points(encoded, points);
+
+                size_t n = 0;
+                for (mg_batch_ring &ring: rings)
+                {
+                    if (col >= ring.dests.size())
+                        continue;
+                    toHash[0] = *ring.input->message;
+                    toHash[1] = (*ring.input->pubs)[col].dest;
+                    toHash[2] = encoded[n++];
+                    toHash[3] = encoded[n++];
+                    toHash[4] = ring.commitment_bytes[col];
+                    toHash[5] = encoded[n++];
+                    ring.c = hash_to_scalar(toHash);
+                }
+            }
+
+            for (const mg_batch_ring &ring: rings)
+            {
+                key c;
+                sc_sub(c.bytes, ring.c.bytes, ring.input->mg->cc.bytes);
+                results[ring.index] = sc_isnonzero(c.bytes) == 0;
+            }
+        }
+    }
+
+    bool verRctMGSimple(const std::vector<mgSimpleInput> &inputs, std::deque<bool> &results)
+    {
+        PERF_TIMER(verRctMGSimpleBatch);
+        results.clear();
+        results.resize(inputs.size());
+        if (inputs.empty())
+          return true;
+
+        // split in one batch per thread; each thread keeps its own ring member cache
+        tools::threadpool& tpool = tools::threadpool::getInstance();
+        tools::threadpool::waiter waiter;
+        const size_t batches = std::min<size_t>(std::max(1u, tpool.get_max_concurrency()), inputs.size());
+        const size_t batch_size = (inputs.size() + batches - 1) / batches;
+        for (size_t begin = 0; begin < inputs.size(); begin += batch_size)
+        {
+          const size_t end = std::min(begin + batch_size, inputs.size());
+          tpool.submit(&waiter, [&inputs, &results, begin, end] {
+            try
+            {
+              verRctMGSimpleBatch(inputs, begin, end, results);
+            }
+            catch (...)
+            {
+              // fall back to verifying the inputs of this batch one by one
+              for (size_t i = begin; i < end; ++i)
+                results[i] = verRctMGSimple(*inputs[i].message, *inputs[i].mg, *inputs[i].pubs, *inputs[i].C);
+            }
+          });
+        }
+        waiter.wait(&tpool);
+
+        for (size_t i = 0; i < results.size(); ++i)
+          if (!results[i])
+            return false;
+        return true;
+    }
+
 
     //These functions get keys from blockchain
     //replace these when connecting blockchain
@@ -1082,47 +1306,52 @@ namespace rct {
 
     //ver RingCT simple
     //assumes only post-rct style inputs (at least for max anonymity)
-    bool verRctNonSemanticsSimple(const rctSig & rv) {
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rvv) {
       try
       {
         PERF_TIMER(verRctNonSemanticsSimple);
 
-        CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2,
-            false, "verRctNonSemanticsSimple called on non simple rctSig");
-        const bool bulletproof = is_rct_bulletproof(rv.type);
-        // semantics check is early, and mixRing/MGs aren't resolved yet
-        if (bulletproof)
-          CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
-        else
-          CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
-
-        const size_t threads = std::max(rv.outPk.size(), rv.mixRing.size());
-
-        std::deque<bool> results(threads);
-        tools::threadpool& tpool = tools::threadpool::getInstance();
-        tools::threadpool::waiter waiter;
-
-        const keyV &pseudoOuts = bulletproof ? rv.p.pseudoOuts : rv.pseudoOuts;
-
-        const key message = get_pre_mlsag_hash(rv, hw::get_device("default"));
+        keyV messages;
+        messages.reserve(rvv.size());
+        size_t n_inputs = 0;
+        for (const rctSig *rvp: rvv)
+        {
+          CHECK_AND_ASSERT_MES(rvp, false, "rctSig pointer is NULL");
+          const rctSig &rv = *rvp;
+          CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2,
+              false, "verRctNonSemanticsSimple called on non simple rctSig");
+          const bool bulletproof = is_rct_bulletproof(rv.type);
+          // semantics check is early, and mixRing/MGs aren't resolved yet
+          if (bulletproof)
+            CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
+          else
+            CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
+          CHECK_AND_ASSERT_MES(rv.p.MGs.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.MGs and mixRing");
 
-        results.clear();
-        results.resize(rv.mixRing.size());
-        for (size_t i = 0 ; i < rv.mixRing.size() ; i++) {
-          tpool.submit(&waiter, [&, i] {
-              results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
-          });
+          messages.push_back(get_pre_mlsag_hash(rv, hw::get_device("default")));
+          n_inputs += rv.mixRing.size();
         }
-        waiter.wait(&tpool);
 
-        for (size_t i = 0; i < results.size(); ++i) {
-          if (!results[i]) {
-            LOG_PRINT_L1("verRctMGSimple failed for input " << i);
-            return false;
-          }
+        // all inputs of all the txes go in the same batch
+        std::vector<mgSimpleInput> inputs;
+        inputs.reserve(n_inputs);
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          const rctSig &rv = *rvv[n];
+          const keyV &pseudoOuts = is_rct_bulletproof(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
+          for (size_t i = 0; i < rv.mixRing.size(); ++i)
+            inputs.push_back({&messages[n], &rv.p.MGs[i], &rv.mixRing[i], &pseudoOuts[i]});
         }
 
-        return true;
+        std::deque<bool> results;
+        if (verRctMGSimple(inputs, results))
+          return true;
+
+        for (size_t n = 0, k = 0; n < rvv.size(); ++n)
+          for (size_t i = 0; i < rvv[n]->mixRing.size(); ++i, ++k)
+            if (!results[k])
+              LOG_PRINT_L1("verRctMGSimple failed for input " << i << (rvv.size() > 1 ? " of rctSig " + std::to_string(n) : std::string()));
+        return false;
       }
       // we can get deep throws from ge_frombytes_vartime if input isn't valid
       catch (const std::exception &e)
@@ -1137,6 +1366,11 @@ namespace rct {
       }
     }
 
+    bool verRctNonSemanticsSimple(const rctSig & rv)
+    {
+      return verRctNonSemanticsSimple(std::vector<const rctSig*>(1, &rv));
+    }
+
     //RingCT protocol
     //genRct: 
     //   creates an rctSig with all data necessary to verify the rangeProofs and that the signer owns one of the
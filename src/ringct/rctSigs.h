@@ -36,6 +36,7 @@
 #define RCTSIGS_H
 
 #include <cstddef>
+#include <deque>
 #include <vector>
 #include <tuple>
 
@@ -101,6 +102,20 @@ namespace rct {
     bool verRctMG(const mgSig &mg, const ctkeyM & pubs, const ctkeyV & outPk, const key &txnFee, const key &message);
     bool verRctMGSimple(const key &message, const mgSig &mg, const ctkeyV & pubs, const key & C);
 
+    //Batched verRctMGSimple:
+    //   verifies the simple MG sigs of several inputs, possibly from different txes, column by
+    //   column in lockstep, so ring members shared between rings are decompressed and hashed to
+    //   a point once, and the L/R points of a column are compressed with a single inversion.
+    //   results[i] is set for inputs[i]; returns true if all of them verify
+    struct mgSimpleInput
+    {
+      const key *message;
+      const mgSig *mg;
+      const ctkeyV *pubs;
+      const key *C;
+    };
+    bool verRctMGSimple(const std::vector<mgSimpleInput> &inputs, std::deque<bool> &results);
+
     //These functions get keys from blockchain
     //replace these when connecting blockchain
     //getKeyFromBlockchain grabs a key from the blockchain at "reference_index" to mix with
@@ -128,6 +143,7 @@ namespace rct {
     bool verRctSemanticsSimple(const rctSig & rv);
     bool verRctSemanticsSimple(const std::vector<const rctSig*> & rv);
     bool verRctNonSemanticsSimple(const rctSig & rv);
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rv);
     static inline bool verRctSimple(const rctSig & rv) { return verRctSemanticsSimple(rv) && verRctNonSemanticsSimple(rv); }
     xmr_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, key & mask, hw::device &hwdev);
     xmr_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, hw::device &hwdev);
@@ -30,6 +30,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <boost/preprocessor/stringize.hpp>
+#include <unordered_set>
 #include "include_base_utils.h"
 #include "string_tools.h"
 using namespace epee;
@@ -44,6 +45,7 @@ using namespace epee;
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_core/tx_sanity_check.h"
+#include "cryptonote_core/gamma_picker.h"
 #include "misc_language.h"
 #include "net/parse.h"
 #include "storages/http_abstract_invoke.h"
@@ -62,6 +64,9 @@ using namespace epee;
 
 #define OUTPUT_HISTOGRAM_RECENT_CUTOFF_RESTRICTION (3 * 86400) // 3 days max, the wallet requests 1.8 days
 
+#define LIGHT_WALLET_FEE_ESTIMATE_GRACE_BLOCKS 10
+#define LIGHT_WALLET_RANDOM_OUTS_ATTEMPTS 10
+
 namespace
 {
   void add_reason(std::string &reasons, const char *reason)
@@ -75,6 +80,15 @@ namespace
   {
     return (value + quantum - 1) / quantum * quantum;
   }
+
+  bool is_light_wallet_output_unlocked(uint64_t output_height, uint64_t unlock_time, uint64_t blockchain_height)
+  {
+    if (output_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > blockchain_height)
+      return false;
+    if (unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER)
+      return blockchain_height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= unlock_time;
+    return (uint64_t)time(NULL) + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V2 >= unlock_time;
+  }
 }
 
 namespace cryptonote
@@ -254,6 +268,20 @@ namespace cryptonote
       CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
       epee::net_utils::network_throttle_manager::get_global_throttle_out().get_stats(res.total_packets_out, res.total_bytes_out);
     }
+    const epee::net_utils::send_queue::stats send_stats = epee::net_utils::send_queue::get_stats();
+    res.send_queues.reserve(send_stats.size());
+    for (size_t i = 0; i < send_stats.size(); ++i)
+    {
+      const epee::net_utils::send_queue::class_stats &s = send_stats[i];
+      res.send_queues.push_back({});
+      COMMAND_RPC_GET_NET_STATS::send_queue_stats &q = res.send_queues.back();
+      q.priority = epee::net_utils::to_string(epee::net_utils::send_priority(i));
+      q.messages = s.messages;
+      q.bytes = s.bytes;
+      q.dropped = s.dropped;
+      q.avg_wait_us = s.messages ? s.wait_us_total / s.messages : 0;
+      q.max_wait_us = s.wait_us_max;
+    }
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -2175,6 +2203,431 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_light_wallet_account(const std::string& address, const std::string& view_key, account_public_address& account_address, crypto::secret_key& view_secret_key)
+  {
+    address_parse_info info;
+    if (!get_account_address_from_str(info, nettype(), address) || info.is_subaddress)
+      return false;
+
+    if (!epee::string_tools::hex_to_pod(view_key, view_secret_key))
+      return false;
+
+    crypto::public_key view_public_key;
+    if (!crypto::secret_key_to_public_key(view_secret_key, view_public_key) || view_public_key != info.address.m_view_public_key)
+      return false;
+
+    account_address = info.address;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_light_wallet_account_data(const std::string& address, const std::string& view_key, LightWalletScanner::account_data& data, std::string& reason)
+  {
+    account_public_address account_address;
+    crypto::secret_key view_secret_key;
+    if (!get_light_wallet_account(address, view_key, account_address, view_secret_key))
+    {
+      reason = "Invalid address or view key";
+      return false;
+    }
+
+    try
+    {
+      if (!m_core.get_light_wallet_scanner().get_account_data(account_address, view_secret_key, data))
+      {
+        reason = "Account is not registered";
+        return false;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      reason = e.what();
+      return false;
+    }
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_login(const tools::COMMAND_RPC_LOGIN::request& req, tools::COMMAND_RPC_LOGIN::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_login);
+
+    res.status = "error";
+    res.new_address = false;
+
+    if (req.create_account && m_restricted && ctx)
+    {
+      res.reason = "Account creation is disabled on restricted RPC";
+      return true;
+    }
+
+    account_public_address account_address;
+    crypto::secret_key view_secret_key;
+    if (!get_light_wallet_account(req.address, req.view_key, account_address, view_secret_key))
+    {
+      res.reason = "Invalid address or view key";
+      return true;
+    }
+
+    try
+    {
+      if (!m_core.get_light_wallet_scanner().login(account_address, view_secret_key, req.create_account, res.new_address))
+      {
+        res.reason = "Account is not registered";
+        return true;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      res.reason = e.what();
+      return true;
+    }
+
+    res.status = "success";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_import_wallet_request(const tools::COMMAND_RPC_IMPORT_WALLET_REQUEST::request& req, tools::COMMAND_RPC_IMPORT_WALLET_REQUEST::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_import_wallet_request);
+
+    res.status = "error";
+    res.import_fee = 0;
+    res.new_request = false;
+    res.request_fulfilled = false;
+
+    if (m_restricted && ctx)
+    {
+      res.status = "Import is disabled on restricted RPC";
+      return true;
+    }
+
+    account_public_address account_address;
+    crypto::secret_key view_secret_key;
+    if (!get_light_wallet_account(req.address, req.view_key, account_address, view_secret_key))
+      return true;
+
+    try
+    {
+      if (!m_core.get_light_wallet_scanner().rescan(account_address, view_secret_key, 0))
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Light wallet import request failed: " << e.what());
+      return true;
+    }
+
+      //no approval step: the rescan is scheduled right away, synchronize() catches the account up
+
+    res.new_request = true;
+    res.request_fulfilled = true;
+    res.status = "Import accepted, the wallet is being rescanned";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_get_address_info(const tools::COMMAND_RPC_GET_ADDRESS_INFO::request& req, tools::COMMAND_RPC_GET_ADDRESS_INFO::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_get_address_info);
+
+    res.status = "error";
+
+    LightWalletScanner::account_data data;
+    if (!get_light_wallet_account_data(req.address, req.view_key, data, res.reason))
+    {
+      MDEBUG("get_address_info failed: " << res.reason);
+      return true;
+    }
+
+    const uint64_t height = m_core.get_current_blockchain_height();
+
+    res.locked_funds = 0;
+    res.total_received = 0;
+    res.total_sent = 0;
+
+    for (const LightWalletScanner::account_output& output : data.outputs)
+    {
+      res.total_received += output.amount;
+      if (!is_light_wallet_output_unlocked(output.height, output.unlock_time, height))
+        res.locked_funds += output.amount;
+    }
+
+    for (const LightWalletScanner::account_spend& spend : data.spends)
+    {
+      res.total_sent += spend.amount;
+
+      res.spent_outputs.push_back(tools::COMMAND_RPC_GET_ADDRESS_INFO::spent_output());
+      tools::COMMAND_RPC_GET_ADDRESS_INFO::spent_output& spent_output = res.spent_outputs.back();
+      spent_output.amount = spend.amount;
+      spent_output.key_image = epee::string_tools::pod_to_hex(spend.key_image);
+      spent_output.tx_pub_key = epee::string_tools::pod_to_hex(spend.tx_pub_key);
+      spent_output.out_index = spend.out_index;
+      spent_output.mixin = spend.mixin;
+    }
+
+    res.blockchain_height = height ? height - 1 : 0;
+    res.transaction_height = res.blockchain_height;
+    res.scanned_height = data.scanned_height ? data.scanned_height - 1 : 0;
+    res.scanned_block_height = res.scanned_height;
+    res.start_height = data.start_height;
+    res.status = "success";
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_get_address_txs(const tools::COMMAND_RPC_GET_ADDRESS_TXS::request& req, tools::COMMAND_RPC_GET_ADDRESS_TXS::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_get_address_txs);
+
+    res.status = "error";
+
+    LightWalletScanner::account_data data;
+    std::string reason;
+    if (!get_light_wallet_account_data(req.address, req.view_key, data, reason))
+    {
+      MDEBUG("get_address_txs failed: " << reason);
+      return true;
+    }
+
+    const uint64_t height = m_core.get_current_blockchain_height();
+
+    std::unordered_map<crypto::hash, size_t> tx_indices;
+
+    auto get_tx = [&](const crypto::hash& tx_hash, uint64_t tx_height, uint64_t timestamp, uint64_t unlock_time) -> tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& {
+      auto it = tx_indices.find(tx_hash);
+      if (it != tx_indices.end())
+        return res.transactions[it->second];
+
+      tx_indices.emplace(tx_hash, res.transactions.size());
+      res.transactions.push_back(tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction());
+      tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& tx = res.transactions.back();
+      tx.hash = epee::string_tools::pod_to_hex(tx_hash);
+      tx.timestamp = timestamp;
+      tx.total_received = 0;
+      tx.total_sent = 0;
+      tx.unlock_time = unlock_time;
+      tx.height = tx_height;
+      tx.payment_id = epee::string_tools::pod_to_hex(crypto::null_hash);
+      tx.coinbase = false;
+      tx.mempool = false;
+      tx.mixin = 0;
+      return tx;
+    };
+
+    res.total_received = 0;
+    res.total_received_unlocked = 0;
+
+    for (const LightWalletScanner::account_output& output : data.outputs)
+    {
+      tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& tx = get_tx(output.tx_hash, output.height, output.timestamp, output.unlock_time);
+      tx.total_received += output.amount;
+      tx.coinbase = output.coinbase;
+      tx.payment_id = epee::string_tools::pod_to_hex(output.payment_id);
+
+      res.total_received += output.amount;
+      if (is_light_wallet_output_unlocked(output.height, output.unlock_time, height))
+        res.total_received_unlocked += output.amount;
+    }
+
+    for (const LightWalletScanner::account_spend& spend : data.spends)
+    {
+      tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& tx = get_tx(spend.tx_hash, spend.height, spend.timestamp, spend.unlock_time);
+      tx.total_sent += spend.amount;
+      tx.mixin = spend.mixin;
+
+      tx.spent_outputs.push_back(tools::COMMAND_RPC_GET_ADDRESS_TXS::spent_output());
+      tools::COMMAND_RPC_GET_ADDRESS_TXS::spent_output& spent_output = tx.spent_outputs.back();
+      spent_output.amount = spend.amount;
+      spent_output.key_image = epee::string_tools::pod_to_hex(spend.key_image);
+      spent_output.tx_pub_key = epee::string_tools::pod_to_hex(spend.tx_pub_key);
+      spent_output.out_index = spend.out_index;
+      spent_output.mixin = spend.mixin;
+    }
+
+    std::stable_sort(res.transactions.begin(), res.transactions.end(), [](const tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& a, const tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& b) {
+      return a.height < b.height;
+    });
+
+    for (size_t i = 0; i < res.transactions.size(); ++i)
+      res.transactions[i].id = i;
+
+    res.blockchain_height = height ? height - 1 : 0;
+    res.scanned_height = data.scanned_height ? data.scanned_height - 1 : 0;
+    res.scanned_block_height = res.scanned_height;
+    res.status = "success";
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_get_unspent_outs(const tools::COMMAND_RPC_GET_UNSPENT_OUTS::request& req, tools::COMMAND_RPC_GET_UNSPENT_OUTS::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_get_unspent_outs);
+
+    res.status = "error";
+    res.amount = 0;
+    res.per_kb_fee = 0;
+
+    LightWalletScanner::account_data data;
+    if (!get_light_wallet_account_data(req.address, req.view_key, data, res.reason))
+      return true;
+
+    uint64_t min_amount = 0, dust_threshold = 0;
+    if ((!req.amount.empty() && !epee::string_tools::get_xtype_from_string(min_amount, req.amount)) ||
+        (!req.dust_threshold.empty() && !epee::string_tools::get_xtype_from_string(dust_threshold, req.dust_threshold)))
+    {
+      res.reason = "Invalid amount";
+      return true;
+    }
+
+      //the wallet tells which candidate spends are its own from their key images
+
+    std::unordered_multimap<crypto::public_key, const LightWalletScanner::account_spend*> spends;
+    for (const LightWalletScanner::account_spend& spend : data.spends)
+      spends.emplace(spend.tx_pub_key, &spend);
+
+    for (const LightWalletScanner::account_output& output : data.outputs)
+    {
+      if (output.amount < min_amount)
+        continue;
+
+      if (!req.use_dust && !output.rct && output.amount < dust_threshold)
+        continue;
+
+      res.outputs.push_back(tools::COMMAND_RPC_GET_UNSPENT_OUTS::output());
+      tools::COMMAND_RPC_GET_UNSPENT_OUTS::output& out = res.outputs.back();
+      out.amount = output.amount;
+      out.public_key = epee::string_tools::pod_to_hex(output.public_key);
+      out.index = output.out_index;
+      out.global_index = output.global_index;
+      if (output.rct)
+        out.rct = epee::string_tools::pod_to_hex(output.commitment) + epee::string_tools::pod_to_hex(output.encrypted_mask) + epee::string_tools::pod_to_hex(output.encrypted_amount);
+      out.tx_hash = epee::string_tools::pod_to_hex(output.tx_hash);
+      out.tx_pub_key = epee::string_tools::pod_to_hex(output.tx_pub_key);
+      out.tx_prefix_hash = epee::string_tools::pod_to_hex(output.tx_prefix_hash);
+      out.timestamp = output.timestamp;
+      out.height = output.height;
+
+      auto range = spends.equal_range(output.tx_pub_key);
+      for (auto it = range.first; it != range.second; ++it)
+        if (it->second->out_index == output.out_index)
+          out.spend_key_images.push_back(epee::string_tools::pod_to_hex(it->second->key_image));
+
+      res.amount += output.amount;
+    }
+
+    res.per_kb_fee = m_core.get_blockchain_storage().get_dynamic_base_fee_estimate(LIGHT_WALLET_FEE_ESTIMATE_GRACE_BLOCKS) * 1024;
+    res.status = "success";
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTS::request& req, COMMAND_RPC_GET_RANDOM_OUTS::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_get_random_outs);
+
+    const bool restricted = m_restricted && ctx;
+    if (restricted && req.count > MAX_RESTRICTED_FAKE_OUTS_COUNT)
+    {
+      res.Error = "Too many outs requested";
+      return true;
+    }
+
+    const BlockchainDB& db = m_core.get_blockchain_storage().get_db();
+    static const std::string zero_key_hex = epee::string_tools::pod_to_hex(rct::zero());
+
+    for (const std::string& amount_str : req.amounts)
+    {
+      uint64_t amount = 0;
+      if (!epee::string_tools::get_xtype_from_string(amount, amount_str))
+      {
+        res.Error = "Invalid amount " + amount_str;
+        return true;
+      }
+
+      res.amount_outs.push_back(COMMAND_RPC_GET_RANDOM_OUTS::amount_out());
+      COMMAND_RPC_GET_RANDOM_OUTS::amount_out& amount_out = res.amount_outs.back();
+      amount_out.amount = amount;
+
+      const uint64_t num_outputs = db.get_num_outputs(amount);
+      std::unordered_set<uint64_t> picked;
+
+        //rct outputs are picked by age like wallets pick their decoys, so the real output
+        //doesn't stand out; pre-rct ones uniformly. Locked ones are dropped and picked again
+
+      std::vector<uint64_t> rct_offsets;
+      std::unique_ptr<gamma_picker> gamma;
+      if (amount == 0)
+      {
+        try
+        {
+          const uint64_t height = m_core.get_current_blockchain_height();
+          auto data = rpc::RpcHandler::get_output_distribution([this](uint64_t amount, uint64_t from, uint64_t to, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base) { return m_core.get_output_distribution(amount, from, to, start_height, distribution, base); }, 0, 0, height - 1, [this](uint64_t height) { return m_core.get_blockchain_storage().get_db().get_block_hash_from_height(height); }, true, height);
+          if (!data)
+            throw std::runtime_error("Failed to get output distribution");
+          rct_offsets = std::move(data->distribution);
+          gamma.reset(new gamma_picker(rct_offsets));
+        }
+        catch (const std::exception& e)
+        {
+          MDEBUG("Picking rct outputs uniformly: " << e.what());
+        }
+      }
+
+      for (size_t attempt = 0; attempt < LIGHT_WALLET_RANDOM_OUTS_ATTEMPTS && amount_out.outputs.size() < req.count && picked.size() < num_outputs; ++attempt)
+      {
+        COMMAND_RPC_GET_OUTPUTS_BIN::request req_bin;
+        COMMAND_RPC_GET_OUTPUTS_BIN::response res_bin;
+        req_bin.get_txid = false;
+
+        const size_t wanted = std::min<uint64_t>((req.count - amount_out.outputs.size()) * 2, num_outputs - picked.size());
+        for (uint64_t index : pick_decoy_outputs(gamma.get(), num_outputs, wanted, picked))
+          req_bin.outputs.push_back({amount, index});
+
+        if (!m_core.get_outs(req_bin, res_bin))
+        {
+          res.Error = "Failed to get outputs";
+          return true;
+        }
+
+        for (size_t i = 0; i < res_bin.outs.size() && amount_out.outputs.size() < req.count; ++i)
+        {
+          if (!res_bin.outs[i].unlocked)
+            continue;
+
+          amount_out.outputs.push_back(COMMAND_RPC_GET_RANDOM_OUTS::output());
+          COMMAND_RPC_GET_RANDOM_OUTS::output& out = amount_out.outputs.back();
+          out.public_key = epee::string_tools::pod_to_hex(res_bin.outs[i].key);
+          out.global_index = req_bin.outputs[i].index;
+          if (amount == 0)
+            out.rct = epee::string_tools::pod_to_hex(res_bin.outs[i].mask) + zero_key_hex + zero_key_hex;
+        }
+      }
+    }
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_submit_raw_tx(const COMMAND_RPC_SUBMIT_RAW_TX::request& req, COMMAND_RPC_SUBMIT_RAW_TX::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_light_wallet_submit_raw_tx);
+
+    COMMAND_RPC_SEND_RAW_TX::request send_req;
+    COMMAND_RPC_SEND_RAW_TX::response send_res;
+    send_req.tx_as_hex = req.tx;
+    send_req.do_not_relay = false;
+    send_req.do_sanity_checks = true;
+
+    if (!on_send_raw_tx(send_req, send_res, ctx))
+    {
+      res.status = "error";
+      res.error = "Failed to send transaction";
+      return true;
+    }
+
+    res.status = send_res.status;
+    res.error = send_res.reason;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_relay_tx(const COMMAND_RPC_RELAY_TX::request& req, COMMAND_RPC_RELAY_TX::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_relay_tx);
@@ -2231,9 +2684,18 @@ namespace cryptonote
     res.target_height = m_core.get_target_blockchain_height();
     res.next_needed_pruning_seed = m_p2p.get_payload_object().get_next_needed_pruning_stripe().second;
 
-    for (const auto &c: m_p2p.get_payload_object().get_connections())
-      res.peers.push_back({c});
     const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+    std::unordered_map<std::string, cryptonote::block_queue::peer_throughput> throughputs;
+    for (const auto &t: block_queue.get_peer_throughputs())
+      throughputs[epee::string_tools::pod_to_hex(t.first)] = t.second;
+    for (const auto &c: m_p2p.get_payload_object().get_connections())
+    {
+      const auto i = throughputs.find(c.connection_id);
+      if (i == throughputs.end())
+        res.peers.push_back({c, 0, 0});
+      else
+        res.peers.push_back({c, (uint64_t)(i->second.bandwidth + 0.5f), (uint32_t)(i->second.rtt * 1000 + 0.5f)});
+    }
     block_queue.foreach([&](const cryptonote::block_queue::span &span) {
       const std::string span_connection_id = epee::string_tools::pod_to_hex(span.connection_id);
       uint32_t speed = (uint32_t)(100.0f * block_queue.get_speed(span.connection_id) + 0.5f);
@@ -39,6 +39,7 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "wallet/wallet_light_rpc.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
@@ -129,6 +130,13 @@ namespace cryptonote
       MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
       MAP_URI_AUTO_BIN2("/get_output_distribution.bin", on_get_output_distribution_bin, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
       MAP_URI_AUTO_JON2_IF("/pop_blocks", on_pop_blocks, COMMAND_RPC_POP_BLOCKS, !m_restricted)
+      MAP_URI_AUTO_JON2_IF("/login", on_light_wallet_login, tools::COMMAND_RPC_LOGIN, m_core.get_light_wallet_scanner().is_enabled())
+      MAP_URI_AUTO_JON2_IF("/import_wallet_request", on_light_wallet_import_wallet_request, tools::COMMAND_RPC_IMPORT_WALLET_REQUEST, m_core.get_light_wallet_scanner().is_enabled())
+      MAP_URI_AUTO_JON2_IF("/get_address_info", on_light_wallet_get_address_info, tools::COMMAND_RPC_GET_ADDRESS_INFO, m_core.get_light_wallet_scanner().is_enabled())
+      MAP_URI_AUTO_JON2_IF("/get_address_txs", on_light_wallet_get_address_txs, tools::COMMAND_RPC_GET_ADDRESS_TXS, m_core.get_light_wallet_scanner().is_enabled())
+      MAP_URI_AUTO_JON2_IF("/get_unspent_outs", on_light_wallet_get_unspent_outs, tools::COMMAND_RPC_GET_UNSPENT_OUTS, m_core.get_light_wallet_scanner().is_enabled())
+      MAP_URI_AUTO_JON2_IF("/get_random_outs", on_light_wallet_get_random_outs, COMMAND_RPC_GET_RANDOM_OUTS, m_core.get_light_wallet_scanner().is_enabled())
+      MAP_URI_AUTO_JON2_IF("/submit_raw_tx", on_light_wallet_submit_raw_tx, COMMAND_RPC_SUBMIT_RAW_TX, m_core.get_light_wallet_scanner().is_enabled())
       BEGIN_JSON_RPC_MAP("/json_rpc")
         MAP_JON_RPC("get_block_count",           on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
         MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
@@ -213,6 +221,14 @@ namespace cryptonote
     bool on_update(const COMMAND_RPC_UPDATE::request& req, COMMAND_RPC_UPDATE::response& res, const connection_context *ctx = NULL);
     bool on_get_output_distribution_bin(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, const connection_context *ctx = NULL);
     bool on_pop_blocks(const COMMAND_RPC_POP_BLOCKS::request& req, COMMAND_RPC_POP_BLOCKS::response& res, const connection_context *ctx = NULL);
+    //light wallet
+    bool on_light_wallet_login(const tools::COMMAND_RPC_LOGIN::request& req, tools::COMMAND_RPC_LOGIN::response& res, const connection_context *ctx = NULL);
+    bool on_light_wallet_import_wallet_request(const tools::COMMAND_RPC_IMPORT_WALLET_REQUEST::request& req, tools::COMMAND_RPC_IMPORT_WALLET_REQUEST::response& res, const connection_context *ctx = NULL);
+    bool on_light_wallet_get_address_info(const tools::COMMAND_RPC_GET_ADDRESS_INFO::request& req, tools::COMMAND_RPC_GET_ADDRESS_INFO::response& res, const connection_context *ctx = NULL);
+    bool on_light_wallet_get_address_txs(const tools::COMMAND_RPC_GET_ADDRESS_TXS::request& req, tools::COMMAND_RPC_GET_ADDRESS_TXS::response& res, const connection_context *ctx = NULL);
+    bool on_light_wallet_get_unspent_outs(const tools::COMMAND_RPC_GET_UNSPENT_OUTS::request& req, tools::COMMAND_RPC_GET_UNSPENT_OUTS::response& res, const connection_context *ctx = NULL);
+    bool on_light_wallet_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTS::request& req, COMMAND_RPC_GET_RANDOM_OUTS::response& res, const connection_context *ctx = NULL);
+    bool on_light_wallet_submit_raw_tx(const COMMAND_RPC_SUBMIT_RAW_TX::request& req, COMMAND_RPC_SUBMIT_RAW_TX::response& res, const connection_context *ctx = NULL);
     
     //json_rpc
     bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res, const connection_context *ctx = NULL);
@@ -255,6 +271,8 @@ private:
     bool on_broadcast_impl(const COMMAND_RPC_BROADCAST::request &req, COMMAND_RPC_BROADCAST::response &res, epee::json_rpc::error &error_resp, bool wide = false, const connection_context *ctx = NULL);
     bool check_core_busy();
     bool check_core_ready();
+    bool get_light_wallet_account(const std::string& address, const std::string& view_key, account_public_address& account_address, crypto::secret_key& view_secret_key);
+    bool get_light_wallet_account_data(const std::string& address, const std::string& view_key, LightWalletScanner::account_data& data, std::string& reason);
     
     //utils
     uint64_t get_block_reward(const block& blk);
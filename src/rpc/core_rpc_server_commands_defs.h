@@ -88,7 +88,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 2
-#define CORE_RPC_VERSION_MINOR 6
+#define CORE_RPC_VERSION_MINOR 8
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -763,6 +763,25 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<request_t> request;
 
 
+    struct send_queue_stats
+    {
+      std::string priority;
+      uint64_t messages;
+      uint64_t bytes;
+      uint64_t dropped;
+      uint64_t avg_wait_us;
+      uint64_t max_wait_us;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(priority)
+        KV_SERIALIZE(messages)
+        KV_SERIALIZE(bytes)
+        KV_SERIALIZE(dropped)
+        KV_SERIALIZE(avg_wait_us)
+        KV_SERIALIZE(max_wait_us)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response_t
     {
       std::string status;
@@ -771,6 +790,7 @@ namespace cryptonote
       uint64_t total_bytes_in;
       uint64_t total_packets_out;
       uint64_t total_bytes_out;
+      std::vector<send_queue_stats> send_queues;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -779,6 +799,7 @@ namespace cryptonote
         KV_SERIALIZE(total_bytes_in)
         KV_SERIALIZE(total_packets_out)
         KV_SERIALIZE(total_bytes_out)
+        KV_SERIALIZE(send_queues)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -2139,9 +2160,13 @@ namespace cryptonote
     struct peer
     {
       connection_info info;
+      uint64_t sync_bandwidth;
+      uint32_t sync_rtt;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(info)
+        KV_SERIALIZE_OPT(sync_bandwidth, (uint64_t)0)
+        KV_SERIALIZE_OPT(sync_rtt, (uint32_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -34,12 +34,43 @@
 #include "binary_archive.h"
 
 namespace serialization {
+  /*! \brief a read only streambuf over memory the caller owns
+   *
+   * Lets a blob be parsed where it lies, instead of first being copied
+   * into a stringstream. The memory must outlive the streambuf.
+   */
+  class span_streambuf: public std::streambuf
+  {
+  public:
+    span_streambuf(const char *data, size_t size)
+    {
+      char *begin = const_cast<char*>(data);
+      setg(begin, begin, begin + size);
+    }
+
+  protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+      char *base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+      if (!(which & std::ios_base::in) || off < eback() - base || off > egptr() - base)
+        return pos_type(off_type(-1));
+      setg(eback(), base + off, egptr());
+      return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+      return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+  };
+
   /*! creates a new archive with the passed blob and serializes it into v
    */
   template <class T>
     bool parse_binary(const std::string &blob, T &v)
     {
-      std::istringstream istr(blob);
+      span_streambuf buf(blob.data(), blob.size());
+      std::istream istr(&buf);
       binary_archive<false> iar(istr);
       return ::serialization::serialize(iar, v);
     }
@@ -0,0 +1,192 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include "crypto/crypto.h"
+#include "ringct/rctTypes.h"
+
+namespace tools
+{
+  /*!
+   * \brief State kept by the wallet between transactions to cut the cost of decoy selection
+   *
+   * The cumulative rct output distribution is kept and only its last blocks are requested
+   * again, instead of the whole distribution for every transaction. The rings picked for
+   * the inputs of the transactions being built are kept too, so adding an input only fetches
+   * the ring of that input, while the rings of the other inputs are reused as they are.
+   * Rings of the inputs kept ready for rta transfers are pinned, so they outlive the batch,
+   * until the chain has grown by more than max_pin_age blocks: the decoys are picked by age
+   * from the tip, so an old ring would stand out among the ones picked at the current tip.
+   */
+  class decoy_cache
+  {
+  public:
+    typedef std::tuple<uint64_t, crypto::public_key, rct::key> ring_entry;
+
+    static constexpr uint64_t DEFAULT_REORG_DEPTH = 10;
+    static constexpr uint64_t DEFAULT_MAX_PIN_AGE = 5;
+
+    explicit decoy_cache(uint64_t reorg_depth = DEFAULT_REORG_DEPTH, uint64_t max_pin_age = DEFAULT_MAX_PIN_AGE):
+      m_reorg_depth(reorg_depth), m_max_pin_age(max_pin_age), m_rct_start_height(0) {}
+
+    /// height the next distribution request should start from: its last reorg_depth blocks are requested again
+    uint64_t rct_distribution_request_height() const
+    {
+      const uint64_t size = m_rct_distribution.size();
+      return m_rct_start_height + (size > m_reorg_depth ? size - m_reorg_depth : 0);
+    }
+
+    /*!
+     * \brief merges the per block (non cumulative) output counts returned by the daemon from start_height
+     *
+     * \return false if they can't be merged, the distribution is then cleared and must be requested whole
+     */
+    bool update_rct_distribution(uint64_t start_height, const std::vector<uint64_t> &per_block)
+    {
+      if (m_rct_distribution.empty())
+        m_rct_start_height = start_height;
+      else if (start_height < m_rct_start_height || start_height > m_rct_start_height + m_rct_distribution.size())
+      {
+        clear_rct_distribution();
+        return false;
+      }
+
+      m_rct_distribution.resize(start_height - m_rct_start_height);
+      uint64_t total = m_rct_distribution.empty() ? 0 : m_rct_distribution.back();
+      m_rct_distribution.reserve(m_rct_distribution.size() + per_block.size());
+      for (uint64_t count: per_block)
+        m_rct_distribution.push_back(total += count);
+      return true;
+    }
+
+    void clear_rct_distribution()
+    {
+      m_rct_distribution.clear();
+      m_rct_start_height = 0;
+    }
+
+    bool has_rct_distribution() const { return !m_rct_distribution.empty(); }
+    uint64_t rct_start_height() const { return m_rct_start_height; }
+    /// cumulative number of rct outputs at each height from rct_start_height()
+    const std::vector<uint64_t> &rct_distribution() const { return m_rct_distribution; }
+
+    /// ring picked for the output (amount, global_index), if any with that ring size
+    const std::vector<ring_entry> *find_ring(uint64_t amount, uint64_t global_index, size_t ring_size) const
+    {
+      const std::pair<uint64_t, uint64_t> key(amount, global_index);
+      auto it = m_rings.find(key);
+      if (it != m_rings.end() && it->second.size() == ring_size)
+        return &it->second;
+      auto pinned = m_pinned_rings.find(key);
+      if (pinned != m_pinned_rings.end() && pinned->second.ring.size() == ring_size)
+        return &pinned->second.ring;
+      return nullptr;
+    }
+
+    void add_ring(uint64_t amount, uint64_t global_index, std::vector<ring_entry> ring)
+    {
+      m_rings[std::make_pair(amount, global_index)] = std::move(ring);
+    }
+
+    /// rings are only reused while building one batch of transactions
+    void clear_rings() { m_rings.clear(); }
+
+    /*!
+     * \brief keeps the ring picked for the output (amount, global_index) at the given chain height
+     *        until unpin_rings, or until expire_pinned_rings finds it too old
+     *
+     * \return false if no ring was picked for it
+     */
+    bool pin_ring(uint64_t amount, uint64_t global_index, uint64_t height)
+    {
+      const std::pair<uint64_t, uint64_t> key(amount, global_index);
+      auto it = m_rings.find(key);
+      if (it == m_rings.end())
+        return m_pinned_rings.count(key) > 0;
+      pinned_ring &pinned = m_pinned_rings[key];
+      pinned.height = height;
+      pinned.ring = it->second;
+      return true;
+    }
+
+    bool is_pinned(uint64_t amount, uint64_t global_index) const { return m_pinned_rings.count(std::make_pair(amount, global_index)) > 0; }
+
+    /*!
+     * \brief unpins the rings pinned more than max_pin_age blocks before height, or above it
+     *        after a reorg, so they are picked again
+     *
+     * \return the number of rings unpinned
+     */
+    size_t expire_pinned_rings(uint64_t height)
+    {
+      size_t expired = 0;
+      for (auto it = m_pinned_rings.begin(); it != m_pinned_rings.end(); )
+      {
+        if (it->second.height > height || height - it->second.height > m_max_pin_age)
+        {
+          it = m_pinned_rings.erase(it);
+          ++expired;
+        }
+        else
+          ++it;
+      }
+      return expired;
+    }
+
+    void unpin_ring(uint64_t amount, uint64_t global_index) { m_pinned_rings.erase(std::make_pair(amount, global_index)); }
+    void unpin_rings() { m_pinned_rings.clear(); }
+    size_t pinned_rings() const { return m_pinned_rings.size(); }
+
+    void clear()
+    {
+      clear_rct_distribution();
+      clear_rings();
+      unpin_rings();
+    }
+
+  private:
+    struct pinned_ring
+    {
+      uint64_t height;
+      std::vector<ring_entry> ring;
+    };
+
+    uint64_t m_reorg_depth;
+    uint64_t m_max_pin_age;
+    uint64_t m_rct_start_height;
+    std::vector<uint64_t> m_rct_distribution;
+    std::unordered_map<std::pair<uint64_t, uint64_t>, std::vector<ring_entry>, boost::hash<std::pair<uint64_t, uint64_t>>> m_rings;
+    std::unordered_map<std::pair<uint64_t, uint64_t>, pinned_ring, boost::hash<std::pair<uint64_t, uint64_t>>> m_pinned_rings;
+  };
+}
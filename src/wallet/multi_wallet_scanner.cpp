@@ -0,0 +1,292 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "common/threadpool.h"
+#include "ringct/rctOps.h"
+#include "multi_wallet_scanner.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet.scanner"
+
+// view keys handled together per tx public key, bounds the derivations held at once
+#define SCAN_WALLET_GROUP_SIZE 64
+// tx public keys per threadpool job when generating derivations
+#define SCAN_PUBKEYS_PER_JOB 32
+// derivations held at once, groups get smaller when a pull has many tx public keys
+#define SCAN_MAX_DERIVATIONS (1024 * 1024)
+// consecutive failed scans after which a wallet is refreshed on its own
+#define SCAN_MAX_FAILURES 3
+
+namespace tools
+{
+
+multi_wallet_scanner::multi_wallet_scanner()
+  : m_run(true)
+{
+}
+//----------------------------------------------------------------------------------------------------
+bool multi_wallet_scanner::can_share_refresh(const wallet2 &wallet) const
+{
+  if (wallet.light_wallet() || wallet.m_offline)
+    return false;
+  if (wallet.get_account().get_device().get_type() != hw::device::SOFTWARE)
+    return false;
+  return m_wallets.empty() || wallet.get_refresh_type() == m_wallets.front()->get_refresh_type();
+}
+//----------------------------------------------------------------------------------------------------
+void multi_wallet_scanner::add_wallet(wallet2 *wallet)
+{
+  if (can_share_refresh(*wallet))
+    m_wallets.push_back(wallet);
+  else
+    m_own_refresh_wallets.push_back(wallet);
+}
+//----------------------------------------------------------------------------------------------------
+void multi_wallet_scanner::remove_wallet(wallet2 *wallet)
+{
+  m_wallets.erase(std::remove(m_wallets.begin(), m_wallets.end(), wallet), m_wallets.end());
+  m_own_refresh_wallets.erase(std::remove(m_own_refresh_wallets.begin(), m_own_refresh_wallets.end(), wallet), m_own_refresh_wallets.end());
+  m_failures.erase(wallet);
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t multi_wallet_scanner::scan(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<wallet2::parsed_block> &parsed_blocks)
+{
+  if (m_wallets.empty())
+    return 0;
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  const wallet2 &lead = *m_wallets.front();
+
+  // tx extras are the same for all the wallets, parse them once
+  size_t num_txes = 0;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    THROW_WALLET_EXCEPTION_IF(parsed_blocks[i].txes.size() != parsed_blocks[i].block.tx_hashes.size(),
+        error::wallet_internal_error, "Mismatched parsed_blocks[i].txes.size() and parsed_blocks[i].block.tx_hashes.size()");
+    num_txes += 1 + parsed_blocks[i].txes.size();
+  }
+  std::vector<wallet2::tx_cache_data> tx_cache_data(num_txes);
+  size_t txidx = 0;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    if (lead.get_refresh_type() != wallet2::RefreshNoCoinbase)
+      tpool.submit(&waiter, [&, i, txidx](){ lead.cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); });
+    ++txidx;
+    for (size_t idx = 0; idx < parsed_blocks[i].txes.size(); ++idx)
+    {
+      tpool.submit(&waiter, [&, i, idx, txidx](){ lead.cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); });
+      ++txidx;
+    }
+  }
+  waiter.wait(&tpool);
+
+  std::vector<const crypto::public_key*> pkeys;
+  for (const auto &slot: tx_cache_data)
+  {
+    for (const auto &iod: slot.primary)
+      pkeys.push_back(&iod.pkey);
+    for (const auto &iod: slot.additional)
+      pkeys.push_back(&iod.pkey);
+  }
+
+  const size_t group_size = std::max<size_t>(1, std::min<size_t>(SCAN_WALLET_GROUP_SIZE, SCAN_MAX_DERIVATIONS / std::max<size_t>(1, pkeys.size())));
+  uint64_t blocks_added = 0;
+  for (size_t group = 0; group < m_wallets.size() && m_run.load(std::memory_order_relaxed); group += group_size)
+  {
+    const size_t n_wallets = std::min<size_t>(group_size, m_wallets.size() - group);
+    std::vector<crypto::secret_key> view_keys(n_wallets);
+    for (size_t w = 0; w < n_wallets; ++w)
+      view_keys[w] = m_wallets[group + w]->get_account().get_keys().m_view_secret_key;
+
+    // derivations[k * n_wallets + w] is that of tx public key k for wallet w
+    std::vector<crypto::key_derivation> derivations(pkeys.size() * n_wallets);
+    for (size_t k0 = 0; k0 < pkeys.size(); k0 += SCAN_PUBKEYS_PER_JOB)
+    {
+      tpool.submit(&waiter, [&, k0, n_wallets](){
+        const size_t k1 = std::min<size_t>(k0 + SCAN_PUBKEYS_PER_JOB, pkeys.size());
+        for (size_t k = k0; k < k1; ++k)
+        {
+          crypto::key_derivation *d = &derivations[k * n_wallets];
+          if (!crypto::generate_key_derivations(*pkeys[k], view_keys.data(), n_wallets, d))
+          {
+            MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+            static_assert(sizeof(crypto::key_derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
+            for (size_t w = 0; w < n_wallets; ++w)
+              memcpy(&d[w], rct::identity().bytes, sizeof(d[w]));
+          }
+        }
+      }, true);
+    }
+    waiter.wait(&tpool);
+
+    std::vector<uint64_t> added(n_wallets, 0);
+    std::vector<char> failed(n_wallets, 0);
+    for (size_t w = 0; w < n_wallets; ++w)
+    {
+      tpool.submit(&waiter, [&, w, n_wallets](){
+        wallet2 &wallet = *m_wallets[group + w];
+        if (!wallet.m_blockchain.is_in_bounds(start_height))
+        {
+          // ahead of the wallets pulling, or behind a trimmed hash chain, it catches up later
+          MDEBUG("Blocks from " << start_height << " out of hash chain bounds for " << wallet.get_wallet_file());
+          return;
+        }
+        std::vector<wallet2::tx_cache_data> wallet_tx_cache_data = tx_cache_data;
+        size_t k = 0;
+        for (auto &slot: wallet_tx_cache_data)
+        {
+          for (auto &iod: slot.primary)
+            iod.derivation = derivations[k++ * n_wallets + w];
+          for (auto &iod: slot.additional)
+            iod.derivation = derivations[k++ * n_wallets + w];
+        }
+        try
+        {
+          wallet.process_parsed_blocks(start_height, blocks, parsed_blocks, added[w], NULL, &wallet_tx_cache_data);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to scan blocks for " << wallet.get_wallet_file() << ": " << e.what());
+          failed[w] = 1;
+        }
+      });
+    }
+    waiter.wait(&tpool);
+    for (size_t w = 0; w < n_wallets; ++w)
+    {
+      blocks_added += added[w];
+      if (failed[w])
+        ++m_failures[m_wallets[group + w]];
+      else
+        m_failures.erase(m_wallets[group + w]);
+    }
+  }
+  return blocks_added;
+}
+//----------------------------------------------------------------------------------------------------
+void multi_wallet_scanner::refresh(uint64_t &blocks_fetched)
+{
+  blocks_fetched = 0;
+  m_run.store(true, std::memory_order_relaxed);
+
+  for (wallet2 *wallet: m_own_refresh_wallets)
+  {
+    if (!m_run.load(std::memory_order_relaxed))
+      return;
+    try
+    {
+      uint64_t fetched = 0;
+      wallet->refresh(wallet->is_trusted_daemon(), 0, fetched);
+      blocks_fetched += fetched;
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to refresh " << wallet->get_wallet_file() << ": " << e.what());
+    }
+  }
+  if (m_wallets.empty())
+    return;
+
+  // wallets restored from some height only need the block hashes up to it, which are
+  // pulled by each wallet, like a lone refresh would
+  for (wallet2 *wallet: m_wallets)
+  {
+    if (wallet->m_refresh_from_block_height > wallet->m_blockchain.size())
+    {
+      std::list<crypto::hash> short_chain_history;
+      uint64_t blocks_start_height;
+      wallet->m_run.store(true, std::memory_order_relaxed);
+      wallet->get_short_chain_history(short_chain_history);
+      wallet->fast_refresh(wallet->m_refresh_from_block_height, blocks_start_height, short_chain_history);
+    }
+  }
+
+  // wallets failing a scan sit out the rest of this refresh, so the others are not held back
+  // by pulling the same blocks for them again, and are refreshed on their own if they keep failing
+  std::vector<wallet2*> failed_wallets;
+  auto restore_failed_wallets = epee::misc_utils::create_scope_leave_handler([&](){
+    for (wallet2 *wallet: failed_wallets)
+    {
+      if (m_failures[wallet] >= SCAN_MAX_FAILURES)
+      {
+        MWARNING(wallet->get_wallet_file() << " failed " << m_failures[wallet] << " scans in a row, refreshing it on its own from now on");
+        m_failures.erase(wallet);
+        m_own_refresh_wallets.push_back(wallet);
+      }
+      else
+      {
+        m_wallets.push_back(wallet);
+      }
+    }
+  });
+
+  while (m_run.load(std::memory_order_relaxed) && !m_wallets.empty())
+  {
+    // the wallet furthest behind pulls the blocks for all of them
+    wallet2 *lead = *std::min_element(m_wallets.begin(), m_wallets.end(), [](const wallet2 *w0, const wallet2 *w1) {
+      return w0->m_blockchain.size() < w1->m_blockchain.size();
+    });
+    std::list<crypto::hash> short_chain_history;
+    lead->get_short_chain_history(short_chain_history);
+    uint64_t blocks_start_height;
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<wallet2::parsed_block> parsed_blocks;
+    bool error = false;
+    lead->pull_and_parse_next_blocks(0, blocks_start_height, short_chain_history, {}, {}, blocks, parsed_blocks, error);
+    THROW_WALLET_EXCEPTION_IF(error, error::wallet_internal_error, "Failed to pull and parse blocks");
+    blocks_fetched += blocks.size();
+
+    const uint64_t blocks_added = scan(blocks_start_height, blocks, parsed_blocks);
+    const size_t n_failed = failed_wallets.size();
+    for (auto i = m_wallets.begin(); i != m_wallets.end(); )
+    {
+      if (m_failures.find(*i) != m_failures.end())
+      {
+        failed_wallets.push_back(*i);
+        i = m_wallets.erase(i);
+      }
+      else
+        ++i;
+    }
+
+    // up to date once a pass adds nothing to any of the wallets
+    if (blocks_added == 0 && failed_wallets.size() == n_failed)
+      break;
+  }
+
+  for (wallet2 *wallet: m_wallets)
+  {
+    wallet->m_first_refresh_done = true;
+    wallet->m_node_rpc_proxy.set_height(wallet->m_blockchain.size());
+  }
+}
+
+}
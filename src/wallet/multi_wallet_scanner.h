@@ -0,0 +1,86 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include "wallet2.h"
+
+namespace tools
+{
+
+/*!
+ * \brief Refreshes many wallets with a single pass over the blocks
+ *
+ * Blocks are pulled from the daemon and parsed once, tx extras are parsed
+ * once, and each tx public key is decompressed once for the view keys of a
+ * whole group of wallets. Only the output checks and the bookkeeping are
+ * done per wallet. Wallets the shared pass cannot serve (light wallets,
+ * wallets on a hardware device, a refresh type other than the first
+ * wallet's) are refreshed on their own, as are wallets that keep failing
+ * to process the shared blocks.
+ *
+ * The wallets are not owned, and must not be used elsewhere while a refresh
+ * or a scan runs.
+ */
+class multi_wallet_scanner
+{
+public:
+  multi_wallet_scanner();
+
+  void add_wallet(wallet2 *wallet);
+  void remove_wallet(wallet2 *wallet);
+  size_t num_wallets() const { return m_wallets.size() + m_own_refresh_wallets.size(); }
+
+  /*!
+   * \brief Brings all the wallets up to the daemon's height
+   * \param blocks_fetched  Number of blocks pulled from the daemon
+   */
+  void refresh(uint64_t &blocks_fetched);
+  void refresh() { uint64_t blocks_fetched; refresh(blocks_fetched); }
+
+  /*!
+   * \brief Scans pulled and parsed blocks for all the wallets of the shared pass
+   * \return the number of blocks added, summed over the wallets
+   */
+  uint64_t scan(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<wallet2::parsed_block> &parsed_blocks);
+
+  void stop() { m_run.store(false, std::memory_order_relaxed); }
+
+private:
+  bool can_share_refresh(const wallet2 &wallet) const;
+
+  std::vector<wallet2*> m_wallets;
+  std::vector<wallet2*> m_own_refresh_wallets;
+  std::unordered_map<const wallet2*, unsigned> m_failures; // consecutive failed scans
+  std::atomic<bool> m_run;
+};
+
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+namespace tools
+{
+  /*!
+   * \brief Latency percentiles of RPC calls, per method
+   *
+   * The last window latencies of each method are kept, and percentiles are computed
+   * over them when asked for, so recording a call is cheap. Safe to use from several
+   * threads.
+   */
+  class rpc_latency_stats
+  {
+  public:
+    static constexpr size_t DEFAULT_WINDOW = 1024;
+
+    struct method_stats
+    {
+      std::string method;
+      uint64_t count; // calls since startup, the percentiles are over the last window ones
+      uint64_t p50, p90, p99, max; // microseconds
+    };
+
+    explicit rpc_latency_stats(size_t window = DEFAULT_WINDOW): m_window(std::max<size_t>(window, 1)) {}
+
+    void add(const std::string &method, uint64_t latency)
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      samples &s = m_samples[method];
+      if (s.latencies.size() < m_window)
+        s.latencies.push_back(latency);
+      else
+        s.latencies[s.count % m_window] = latency;
+      ++s.count;
+    }
+
+    std::vector<method_stats> get() const
+    {
+      std::vector<method_stats> stats;
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      stats.reserve(m_samples.size());
+      std::vector<uint64_t> sorted;
+      for (const auto &e: m_samples)
+      {
+        sorted = e.second.latencies;
+        std::sort(sorted.begin(), sorted.end());
+        stats.push_back({e.first, e.second.count, percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), sorted.empty() ? 0 : sorted.back()});
+      }
+      return stats;
+    }
+
+    void clear()
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_samples.clear();
+    }
+
+    /// nearest rank percentile of sorted values
+    static uint64_t percentile(const std::vector<uint64_t> &sorted, unsigned int p)
+    {
+      if (sorted.empty())
+        return 0;
+      const size_t rank = (sorted.size() * p + 99) / 100;
+      return sorted[rank ? rank - 1 : 0];
+    }
+
+  private:
+    struct samples
+    {
+      uint64_t count = 0;
+      std::vector<uint64_t> latencies;
+    };
+
+    const size_t m_window;
+    mutable boost::mutex m_mutex;
+    std::map<std::string, samples> m_samples;
+  };
+}
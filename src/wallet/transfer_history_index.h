@@ -0,0 +1,271 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <boost/optional/optional.hpp>
+#include "string_tools.h"
+#include "crypto/hash.h"
+
+namespace tools
+{
+  /*!
+   * \brief Position of an entry in the wallet history: entries are ordered by height,
+   *        then txid, then n which tells apart several entries for the same tx, then
+   *        dup which tells apart distinct entries given the same position, in insertion
+   *        order. dup is set by the index, callers leave it to 0.
+   */
+  struct transfer_history_key
+  {
+    uint64_t height;
+    crypto::hash txid;
+    uint64_t n;
+    uint32_t dup;
+
+    bool operator<(const transfer_history_key &other) const
+    {
+      if (height != other.height)
+        return height < other.height;
+      const int r = memcmp(txid.data, other.txid.data, sizeof(txid.data));
+      if (r != 0)
+        return r < 0;
+      if (n != other.n)
+        return n < other.n;
+      return dup < other.dup;
+    }
+    bool operator==(const transfer_history_key &other) const { return same_position(other) && dup == other.dup; }
+    bool same_position(const transfer_history_key &other) const { return height == other.height && txid == other.txid && n == other.n; }
+
+    // opaque cursor handed out to RPC clients to resume a query after this entry
+    std::string to_string() const
+    {
+      std::string s = std::to_string(height) + "-" + epee::string_tools::pod_to_hex(txid) + "-" + std::to_string(n);
+      if (dup)
+        s += "-" + std::to_string(dup);
+      return s;
+    }
+    static bool from_string(const std::string &s, transfer_history_key &key)
+    {
+      const size_t p0 = s.find('-');
+      const size_t p1 = p0 == std::string::npos ? std::string::npos : s.find('-', p0 + 1);
+      if (p1 == std::string::npos)
+        return false;
+      const size_t p2 = s.find('-', p1 + 1);
+      key.dup = 0;
+      return epee::string_tools::get_xtype_from_string(key.height, s.substr(0, p0)) &&
+          epee::string_tools::hex_to_pod(s.substr(p0 + 1, p1 - p0 - 1), key.txid) &&
+          epee::string_tools::get_xtype_from_string(key.n, s.substr(p1 + 1, p2 == std::string::npos ? std::string::npos : p2 - p1 - 1)) &&
+          (p2 == std::string::npos || epee::string_tools::get_xtype_from_string(key.dup, s.substr(p2 + 1)));
+    }
+  };
+
+  /*!
+   * \brief Ordered secondary index over one of the wallet history containers
+   *
+   * Entries are kept by history position, by subaddress account and by subaddress (an
+   * entry may belong to several subaddresses of its account), and by txid, so filtered
+   * and paginated queries cost O(log n + k) rather than a scan of the whole history.
+   * T is a cheap handle to the indexed element, eg a pointer into the container.
+   * Distinct elements at the same position are all kept, like the multimaps the
+   * history lives in, while inserting an element again replaces its entry.
+   */
+  template<typename T>
+  class transfer_history_index
+  {
+  public:
+    void insert(const transfer_history_key &key, const T &value, uint32_t account, const std::set<uint32_t> &minors)
+    {
+      transfer_history_key k = key;
+      k.dup = 0;
+      for (auto it = m_entries.lower_bound(k); it != m_entries.end() && it->first.same_position(k); )
+      {
+        if (it->second.value == value)
+        {
+          it = erase_entry(it);
+        }
+        else
+        {
+          k.dup = it->first.dup + 1;
+          ++it;
+        }
+      }
+      m_entries.emplace(k, entry{value, account, std::vector<uint32_t>(minors.begin(), minors.end())});
+      m_by_subaddress[std::make_tuple(account, (uint64_t)ANY_MINOR, k)] = value;
+      for (uint32_t minor: minors)
+        m_by_subaddress[std::make_tuple(account, (uint64_t)minor + 1, k)] = value;
+      m_by_txid.emplace(k.txid, k);
+    }
+
+    // removes the entry of value at that position, if any
+    void erase(const transfer_history_key &key, const T &value)
+    {
+      transfer_history_key k = key;
+      k.dup = 0;
+      for (auto it = m_entries.lower_bound(k); it != m_entries.end() && it->first.same_position(k); ++it)
+      {
+        if (it->second.value == value)
+        {
+          erase_entry(it);
+          return;
+        }
+      }
+    }
+
+    void clear()
+    {
+      m_entries.clear();
+      m_by_subaddress.clear();
+      m_by_txid.clear();
+    }
+
+    size_t size() const { return m_entries.size(); }
+
+    void find(const crypto::hash &txid, std::vector<T> &values) const
+    {
+      auto range = m_by_txid.equal_range(txid);
+      for (auto i = range.first; i != range.second; ++i)
+        values.push_back(m_entries.find(i->second)->second.value);
+    }
+
+    /*!
+     * \brief Appends, in history order, the entries with min_height <= height <= max_height,
+     *        optionally of the given account and any of the given subaddresses of it,
+     *        which pass the filter and come after the given position
+     * \param limit - maximum number of entries to append, 0 for no limit
+     * \return the position to resume from if more entries matched than the limit
+     */
+    boost::optional<transfer_history_key> query(std::vector<T> &values, uint64_t min_height, uint64_t max_height,
+        const boost::optional<uint32_t> &account, const std::set<uint32_t> &minors,
+        const boost::optional<transfer_history_key> &after, size_t limit, const std::function<bool(const T&)> &filter = {}) const
+    {
+      if (min_height > max_height)
+        return boost::none;
+      const transfer_history_key start{min_height, crypto::null_hash, 0};
+      const bool resume = after && !(*after < start);
+      // the first limit + 1 matches of a union of ranges are among the first limit + 1 of each range
+      const size_t wanted = limit ? limit + 1 : std::numeric_limits<size_t>::max();
+
+      std::vector<std::pair<transfer_history_key, T>> found;
+      if (!account)
+      {
+        auto it = resume ? m_entries.upper_bound(*after) : m_entries.lower_bound(start);
+        for (size_t n = 0; n < wanted && it != m_entries.end() && it->first.height <= max_height; ++it)
+        {
+          if (!filter || filter(it->second.value))
+          {
+            found.emplace_back(it->first, it->second.value);
+            ++n;
+          }
+        }
+      }
+      else
+      {
+        std::vector<uint64_t> subkeys;
+        if (minors.empty())
+          subkeys.push_back((uint64_t)ANY_MINOR);
+        for (uint32_t minor: minors)
+          subkeys.push_back((uint64_t)minor + 1);
+        for (uint64_t subkey: subkeys)
+        {
+          auto it = resume ? m_by_subaddress.upper_bound(std::make_tuple(*account, subkey, *after)) : m_by_subaddress.lower_bound(std::make_tuple(*account, subkey, start));
+          for (size_t n = 0; n < wanted && it != m_by_subaddress.end(); ++it)
+          {
+            const transfer_history_key &key = std::get<2>(it->first);
+            if (std::get<0>(it->first) != *account || std::get<1>(it->first) != subkey || key.height > max_height)
+              break;
+            if (!filter || filter(it->second))
+            {
+              found.emplace_back(key, it->second);
+              ++n;
+            }
+          }
+        }
+        if (subkeys.size() > 1)
+        {
+          std::sort(found.begin(), found.end(), [](const std::pair<transfer_history_key, T> &a, const std::pair<transfer_history_key, T> &b) { return a.first < b.first; });
+          found.erase(std::unique(found.begin(), found.end(), [](const std::pair<transfer_history_key, T> &a, const std::pair<transfer_history_key, T> &b) { return a.first == b.first; }), found.end());
+        }
+      }
+
+      boost::optional<transfer_history_key> next;
+      if (limit && found.size() > limit)
+      {
+        found.resize(limit);
+        next = found.back().first;
+      }
+      values.reserve(values.size() + found.size());
+      for (const auto &e: found)
+        values.push_back(e.second);
+      return next;
+    }
+
+  private:
+    static constexpr uint64_t ANY_MINOR = 0;
+
+    struct entry
+    {
+      T value;
+      uint32_t account;
+      std::vector<uint32_t> minors;
+    };
+
+    typedef typename std::map<transfer_history_key, entry>::iterator entry_iterator;
+
+    entry_iterator erase_entry(entry_iterator it)
+    {
+      const transfer_history_key &key = it->first;
+      m_by_subaddress.erase(std::make_tuple(it->second.account, (uint64_t)ANY_MINOR, key));
+      for (uint32_t minor: it->second.minors)
+        m_by_subaddress.erase(std::make_tuple(it->second.account, (uint64_t)minor + 1, key));
+      auto range = m_by_txid.equal_range(key.txid);
+      for (auto i = range.first; i != range.second; ++i)
+      {
+        if (i->second == key)
+        {
+          m_by_txid.erase(i);
+          break;
+        }
+      }
+      return m_entries.erase(it);
+    }
+
+    std::map<transfer_history_key, entry> m_entries;
+    std::map<std::tuple<uint32_t, uint64_t, transfer_history_key>, T> m_by_subaddress;
+    std::unordered_multimap<crypto::hash, transfer_history_key> m_by_txid;
+  };
+}
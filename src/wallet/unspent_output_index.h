@@ -0,0 +1,82 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <tuple>
+#include <utility>
+
+namespace tools
+{
+  /*!
+   * \brief Index of the unspent outputs of the wallet by subaddress and amount
+   *
+   * Entries are ordered by account, subaddress, amount and transfer index, so the outputs
+   * of a subaddress within an amount range are found in O(log n + k) instead of a scan of
+   * every output the wallet ever received. Only the spent status is tracked here: callers
+   * still check the other flags (frozen, locked, ...) of the transfers they get back.
+   */
+  class unspent_output_index
+  {
+  public:
+    typedef std::tuple<uint32_t, uint32_t, uint64_t, size_t> entry;
+    typedef std::set<entry>::const_iterator const_iterator;
+    typedef std::pair<const_iterator, const_iterator> range_type;
+
+    static uint32_t minor_of(const entry &e) { return std::get<1>(e); }
+    static uint64_t amount_of(const entry &e) { return std::get<2>(e); }
+    static size_t index_of(const entry &e) { return std::get<3>(e); }
+
+    void insert(uint32_t account, uint32_t minor, uint64_t amount, size_t idx) { m_entries.insert(std::make_tuple(account, minor, amount, idx)); }
+    void erase(uint32_t account, uint32_t minor, uint64_t amount, size_t idx) { m_entries.erase(std::make_tuple(account, minor, amount, idx)); }
+    bool contains(uint32_t account, uint32_t minor, uint64_t amount, size_t idx) const { return m_entries.count(std::make_tuple(account, minor, amount, idx)) > 0; }
+    void clear() { m_entries.clear(); }
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+
+    /// outputs of the account, by subaddress then increasing amount
+    range_type account_range(uint32_t account) const
+    {
+      return range_type(m_entries.lower_bound(std::make_tuple(account, (uint32_t)0, (uint64_t)0, (size_t)0)),
+          m_entries.upper_bound(std::make_tuple(account, std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint64_t>::max(), std::numeric_limits<size_t>::max())));
+    }
+
+    /// outputs of the subaddress with an amount of at least min_amount, by increasing amount
+    range_type range(uint32_t account, uint32_t minor, uint64_t min_amount = 0) const
+    {
+      return range_type(m_entries.lower_bound(std::make_tuple(account, minor, min_amount, (size_t)0)),
+          m_entries.upper_bound(std::make_tuple(account, minor, std::numeric_limits<uint64_t>::max(), std::numeric_limits<size_t>::max())));
+    }
+
+  private:
+    std::set<entry> m_entries;
+  };
+}
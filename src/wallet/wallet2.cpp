@@ -29,6 +29,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <deque>
 #include <numeric>
 #include <tuple>
 #include <boost/format.hpp>
@@ -74,6 +75,7 @@ using namespace epee;
 #include "common/notify.h"
 #include "common/perf_timer.h"
 #include "ringct/rctSigs.h"
+#include "ringct/bulletproofs.h"
 #include "ringdb.h"
 #include "utils/utils.h"
 #include "device/device_cold.hpp"
@@ -118,8 +120,11 @@ using namespace cryptonote;
 
 #define SECOND_OUTPUT_RELATEDNESS_THRESHOLD 0.0f
 
+#define POP_BEST_VALUE_SAMPLING_ATTEMPTS 16 // random draws tried before scanning all unused outputs for unrelated ones
+
 #define SUBADDRESS_LOOKAHEAD_MAJOR 50
 #define SUBADDRESS_LOOKAHEAD_MINOR 200
+#define SUBADDRESS_PARALLEL_DERIVATION_MIN 2048 // smaller ranges of subaddresses are derived on the calling thread
 
 #define KEY_IMAGE_EXPORT_FILE_MAGIC "Graft key image export\003"
 
@@ -133,14 +138,15 @@ using namespace cryptonote;
 #define SEGREGATION_FORK_VICINITY 1500 /* blocks */
 
 #define FIRST_REFRESH_GRANULARITY     1024
+#define DEFAULT_REFRESH_PIPELINE_DEPTH 3 // batches of blocks fetched and prepared ahead of the one being scanned
 
 
-#define GAMMA_SHAPE 19.28
-#define GAMMA_SCALE (1/1.61)
-
 #define DEFAULT_MIN_OUTPUT_COUNT 5
 #define DEFAULT_MIN_OUTPUT_VALUE (2*COIN)
 
+#define CACHE_JOURNAL_MIN_COMPACTION_SIZE (4*1024*1024) // the journal may always grow this large before the cache file is rewritten
+#define CACHE_JOURNAL_COMPACTION_RATIO 0.5 // rewrite the cache file once the journal grows past this fraction of it
+
 static const std::string MULTISIG_SIGNATURE_MAGIC = "SigMultisigPkV1";
 static const std::string MULTISIG_EXTRA_INFO_MAGIC = "MultisigxV1";
 
@@ -237,6 +243,17 @@ namespace
         add_reason(reason, "tx was not relayed");
       return reason;
   }
+
+  // a batch of blocks on its way through the refresh pipeline
+  struct refresh_batch
+  {
+    uint64_t start_height = 0;
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<tools::wallet2::parsed_block> parsed_blocks;
+    std::vector<tools::wallet2::tx_cache_data> tx_cache_data;
+    bool tx_cache_data_ready = false;
+    bool error = false;
+  };
 }
 
 namespace
@@ -279,6 +296,7 @@ struct options {
   const command_line::arg_descriptor<std::string> tx_notify = { "tx-notify" , "Run a program for each new incoming transaction, '%s' will be replaced by the transaction hash" , "" };
   const command_line::arg_descriptor<bool> no_dns = {"no-dns", tools::wallet2::tr("Do not use DNS"), false};
   const command_line::arg_descriptor<bool> offline = {"offline", tools::wallet2::tr("Do not connect to a daemon, nor use DNS"), false};
+  const command_line::arg_descriptor<uint64_t> refresh_pipeline_depth = {"refresh-pipeline-depth", tools::wallet2::tr("Number of batches of blocks to fetch and prepare ahead of the one being scanned"), DEFAULT_REFRESH_PIPELINE_DEPTH};
 };
 
 void do_prepare_file_names(const std::string& file_path, std::string& keys_file, std::string& wallet_file, std::string &mms_file)
@@ -296,6 +314,126 @@ void do_prepare_file_names(const std::string& file_path, std::string& keys_file,
   mms_file = file_path + ".mms";
 }
 
+uint64_t get_cache_snapshot_id(const crypto::chacha_iv &iv)
+{
+  static_assert(sizeof(iv.data) == sizeof(uint64_t), "Unexpected chacha iv size");
+  uint64_t id;
+  memcpy(&id, iv.data, sizeof(id));
+  return id;
+}
+
+template<typename T>
+void add_to_fingerprint(std::string &blob, const T &t)
+{
+  static_assert(std::is_standard_layout<T>::value, "Unexpected fingerprint field type");
+  blob.append((const char*)&t, sizeof(t));
+}
+
+template<typename T>
+void add_vector_to_fingerprint(std::string &blob, const std::vector<T> &v)
+{
+  static_assert(std::is_standard_layout<T>::value, "Unexpected fingerprint field type");
+  add_to_fingerprint(blob, (uint64_t)v.size());
+  blob.append((const char*)v.data(), v.size() * sizeof(T));
+}
+
+uint64_t get_fingerprint(const std::string &blob)
+{
+  const crypto::hash hash = crypto::cn_fast_hash(blob.data(), blob.size());
+  uint64_t fingerprint;
+  memcpy(&fingerprint, &hash, sizeof(fingerprint));
+  return fingerprint;
+}
+
+uint64_t get_confirmed_tx_fingerprint(const tools::wallet2::confirmed_transfer_details &ctd)
+{
+  // entries are only ever touched again while processing the same tx, so the scalars are enough
+  std::string blob;
+  add_to_fingerprint(blob, ctd.m_amount_in);
+  add_to_fingerprint(blob, ctd.m_amount_out);
+  add_to_fingerprint(blob, ctd.m_change);
+  add_to_fingerprint(blob, ctd.m_block_height);
+  add_to_fingerprint(blob, ctd.m_payment_id);
+  add_to_fingerprint(blob, ctd.m_timestamp);
+  add_to_fingerprint(blob, ctd.m_unlock_time);
+  add_to_fingerprint(blob, ctd.m_subaddr_account);
+  add_to_fingerprint(blob, (uint64_t)ctd.m_dests.size());
+  add_to_fingerprint(blob, (uint64_t)ctd.m_subaddr_indices.size());
+  add_to_fingerprint(blob, (uint64_t)ctd.m_rings.size());
+  return get_fingerprint(blob);
+}
+
+uint64_t get_cache_journal_fingerprint(const crypto::secret_key &key)
+{
+  return get_fingerprint(std::string((const char*)key.data, sizeof(key.data)));
+}
+
+uint64_t get_cache_journal_fingerprint(const std::vector<crypto::secret_key> &keys)
+{
+  std::string blob;
+  for (const crypto::secret_key &key: keys)
+    blob.append((const char*)key.data, sizeof(key.data));
+  return get_fingerprint(blob);
+}
+
+uint64_t get_cache_journal_fingerprint(const std::string &note)
+{
+  return get_fingerprint(note);
+}
+
+uint64_t get_cache_journal_fingerprint(const tools::wallet2::address_book_row &row)
+{
+  std::string blob;
+  add_to_fingerprint(blob, row.m_address);
+  add_to_fingerprint(blob, row.m_payment_id);
+  add_to_fingerprint(blob, row.m_is_subaddress);
+  blob.append(row.m_description);
+  return get_fingerprint(blob);
+}
+
+uint64_t get_cache_journal_fingerprint(const tools::wallet2::confirmed_transfer_details &ctd)
+{
+  return get_confirmed_tx_fingerprint(ctd);
+}
+
+// fingerprints the entries of a txid keyed map, picking those which changed since the last store
+template<typename T>
+void get_cache_journal_changes(const std::unordered_map<crypto::hash, T> &map, const std::unordered_map<crypto::hash, uint64_t> &stored,
+    std::vector<std::pair<crypto::hash, T>> &changed, std::vector<crypto::hash> &removed, std::unordered_map<crypto::hash, uint64_t> &fingerprints)
+{
+  fingerprints.clear();
+  fingerprints.reserve(map.size());
+  for (const auto &e: map)
+  {
+    const uint64_t fingerprint = get_cache_journal_fingerprint(e.second);
+    fingerprints.emplace(e.first, fingerprint);
+    const auto i = stored.find(e.first);
+    if (i == stored.end() || i->second != fingerprint)
+      changed.push_back(e);
+  }
+  for (const auto &e: stored)
+    if (map.find(e.first) == map.end())
+      removed.push_back(e.first);
+}
+
+template<typename T>
+void get_cache_journal_fingerprints(const std::unordered_map<crypto::hash, T> &map, std::unordered_map<crypto::hash, uint64_t> &fingerprints)
+{
+  fingerprints.clear();
+  fingerprints.reserve(map.size());
+  for (const auto &e: map)
+    fingerprints.emplace(e.first, get_cache_journal_fingerprint(e.second));
+}
+
+template<typename T>
+void apply_cache_journal_changes(std::unordered_map<crypto::hash, T> &map, std::vector<std::pair<crypto::hash, T>> &changed, const std::vector<crypto::hash> &removed)
+{
+  for (const crypto::hash &key: removed)
+    map.erase(key);
+  for (auto &e: changed)
+    map[e.first] = std::move(e.second);
+}
+
 uint64_t calculate_fee(uint64_t fee_per_kb, size_t bytes, uint64_t fee_multiplier, bool rta_tx_fee)
 {
   if (rta_tx_fee)
@@ -484,6 +622,10 @@ std::unique_ptr<tools::wallet2> make_basic(const boost::program_options::variabl
   if (command_line::get_arg(vm, opts.offline))
     wallet->set_offline();
 
+  const uint64_t refresh_pipeline_depth = command_line::get_arg(vm, opts.refresh_pipeline_depth);
+  THROW_WALLET_EXCEPTION_IF(refresh_pipeline_depth == 0, tools::error::wallet_internal_error, "Refresh pipeline depth must not be 0");
+  wallet->set_refresh_pipeline_depth(refresh_pipeline_depth);
+
   try
   {
     if (!command_line::is_arg_defaulted(vm, opts.tx_notify))
@@ -983,44 +1125,6 @@ const size_t MAX_SPLIT_ATTEMPTS = 30;
 constexpr const std::chrono::seconds wallet2::rpc_timeout;
 const char* wallet2::tr(const char* str) { return i18n_translate(str, "tools::wallet2"); }
 
-gamma_picker::gamma_picker(const std::vector<uint64_t> &rct_offsets, double shape, double scale):
-    rct_offsets(rct_offsets)
-{
-  gamma = std::gamma_distribution<double>(shape, scale);
-  THROW_WALLET_EXCEPTION_IF(rct_offsets.size() <= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, error::wallet_internal_error, "Bad offset calculation");
-  const size_t blocks_in_a_year = 86400 * 365 / DIFFICULTY_TARGET_V2;
-  const size_t blocks_to_consider = std::min<size_t>(rct_offsets.size(), blocks_in_a_year);
-  const size_t outputs_to_consider = rct_offsets.back() - (blocks_to_consider < rct_offsets.size() ? rct_offsets[rct_offsets.size() - blocks_to_consider - 1] : 0);
-  begin = rct_offsets.data();
-  end = rct_offsets.data() + rct_offsets.size() - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
-  num_rct_outputs = *(end - 1);
-  THROW_WALLET_EXCEPTION_IF(num_rct_outputs == 0, error::wallet_internal_error, "No rct outputs");
-  average_output_time = DIFFICULTY_TARGET_V2 * blocks_to_consider / outputs_to_consider; // this assumes constant target over the whole rct range
-};
-
-gamma_picker::gamma_picker(const std::vector<uint64_t> &rct_offsets): gamma_picker(rct_offsets, GAMMA_SHAPE, GAMMA_SCALE) {}
-
-uint64_t gamma_picker::pick()
-{
-  double x = gamma(engine);
-  x = exp(x);
-  uint64_t output_index = x / average_output_time;
-  if (output_index >= num_rct_outputs)
-    return std::numeric_limits<uint64_t>::max(); // bad pick
-  output_index = num_rct_outputs - 1 - output_index;
-
-  const uint64_t *it = std::lower_bound(begin, end, output_index);
-  THROW_WALLET_EXCEPTION_IF(it == end, error::wallet_internal_error, "output_index not found");
-  uint64_t index = std::distance(begin, it);
-
-  const uint64_t first_rct = index == 0 ? 0 : rct_offsets[index - 1];
-  const uint64_t n_rct = rct_offsets[index] - first_rct;
-  if (n_rct == 0)
-    return std::numeric_limits<uint64_t>::max(); // bad pick
-  MTRACE("Picking 1/" << n_rct << " in block " << index);
-  return first_rct + crypto::rand_idx(n_rct);
-};
-
 wallet_keys_unlocker::wallet_keys_unlocker(wallet2 &w, const boost::optional<tools::password_container> &password):
   w(w),
   locked(password != boost::none)
@@ -1091,6 +1195,7 @@ void wallet_device_callback::on_progress(const hw::device_progress& event)
 
 wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, boost::shared_ptr<boost::asio::io_service> ios):
   m_http_client(ios),
+  m_history_version(0),
   m_multisig_rescan_info(NULL),
   m_multisig_rescan_k(NULL),
   m_upper_transaction_weight_limit(0),
@@ -1105,6 +1210,9 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, boo
   m_default_mixin(0),
   m_default_priority(0),
   m_refresh_type(RefreshOptimizeCoinbase),
+  m_refresh_pipeline_depth(DEFAULT_REFRESH_PIPELINE_DEPTH),
+  m_rta_inputs_account(0),
+  m_rta_inputs_fake_outs_count(0),
   m_auto_refresh(true),
   m_first_refresh_done(false),
   m_refresh_from_block_height(0),
@@ -1209,6 +1317,7 @@ void wallet2::init_options(boost::program_options::options_description& desc_par
   command_line::add_arg(desc_params, opts.tx_notify);
   command_line::add_arg(desc_params, opts.no_dns);
   command_line::add_arg(desc_params, opts.offline);
+  command_line::add_arg(desc_params, opts.refresh_pipeline_depth);
 }
 
 std::pair<std::unique_ptr<wallet2>, tools::password_container> wallet2::make_from_json(const boost::program_options::variables_map& vm, bool unattended, const std::string& json_file, const std::function<boost::optional<tools::password_container>(const char *, bool)> &password_prompter)
@@ -1433,6 +1542,41 @@ crypto::public_key wallet2::get_subaddress_spend_public_key(const cryptonote::su
   return hwdev.get_subaddress_spend_public_key(m_account.get_keys(), index);
 }
 //----------------------------------------------------------------------------------------------------
+std::vector<crypto::public_key> wallet2::get_subaddress_spend_public_keys(uint32_t account, uint32_t begin, uint32_t end) const
+{
+  THROW_WALLET_EXCEPTION_IF(begin > end, error::wallet_internal_error, "begin > end");
+  hw::device &hwdev = m_account.get_device();
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t chunks = std::min<size_t>(tpool.get_max_concurrency(), (end - begin) / (SUBADDRESS_PARALLEL_DERIVATION_MIN / 2));
+  // hardware devices derive the keys themselves, one at a time
+  if (hwdev.get_type() != hw::device::SOFTWARE || chunks < 2)
+    return hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), account, begin, end);
+
+  std::vector<crypto::public_key> pkeys(end - begin);
+  const uint32_t chunk_size = (end - begin + chunks - 1) / chunks;
+  std::atomic<bool> failed(false);
+  tools::threadpool::waiter waiter;
+  for (uint32_t chunk_begin = begin; chunk_begin < end; chunk_begin += std::min(chunk_size, end - chunk_begin))
+  {
+    const uint32_t chunk_end = chunk_begin + std::min(chunk_size, end - chunk_begin);
+    tpool.submit(&waiter, [&, chunk_begin, chunk_end]() {
+      try
+      {
+        const std::vector<crypto::public_key> chunk = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), account, chunk_begin, chunk_end);
+        std::copy(chunk.begin(), chunk.end(), pkeys.begin() + (chunk_begin - begin));
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to derive subaddresses " << account << "/" << chunk_begin << " to " << chunk_end << ": " << e.what());
+        failed = true;
+      }
+    });
+  }
+  waiter.wait(&tpool);
+  THROW_WALLET_EXCEPTION_IF(failed, error::wallet_internal_error, "Failed to derive subaddress keys");
+  return pkeys;
+}
+//----------------------------------------------------------------------------------------------------
 std::string wallet2::get_subaddress_as_str(const cryptonote::subaddress_index& index) const
 {
   cryptonote::account_public_address address = get_subaddress(index);
@@ -1461,7 +1605,6 @@ void wallet2::add_subaddress(uint32_t index_major, const std::string& label)
 //----------------------------------------------------------------------------------------------------
 void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
 {
-  hw::device &hwdev = m_account.get_device();
   if (m_subaddress_labels.size() <= index.major)
   {
     // add new accounts
@@ -1470,7 +1613,7 @@ void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
     for (index2.major = m_subaddress_labels.size(); index2.major < major_end; ++index2.major)
     {
       const uint32_t end = get_subaddress_clamped_sum((index2.major == index.major ? index.minor : 0), m_subaddress_lookahead_minor);
-      const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, 0, end);
+      const std::vector<crypto::public_key> pkeys = get_subaddress_spend_public_keys(index2.major, 0, end);
       for (index2.minor = 0; index2.minor < end; ++index2.minor)
       {
          const crypto::public_key &D = pkeys[index2.minor];
@@ -1487,7 +1630,8 @@ void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
     const uint32_t end = get_subaddress_clamped_sum(index.minor, m_subaddress_lookahead_minor);
     const uint32_t begin = m_subaddress_labels[index.major].size();
     cryptonote::subaddress_index index2 = {index.major, begin};
-    const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, index2.minor, end);
+    m_subaddresses.reserve(m_subaddresses.size() + (end - begin));
+    const std::vector<crypto::public_key> pkeys = get_subaddress_spend_public_keys(index2.major, index2.minor, end);
     for (; index2.minor < end; ++index2.minor)
     {
        const crypto::public_key &D = pkeys[index2.minor - begin];
@@ -1534,6 +1678,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
 {
   transfer_details &td = m_transfers[idx];
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
+  remove_from_unspent_index(idx);
   td.m_spent = true;
   td.m_spent_height = height;
 }
@@ -1544,6 +1689,7 @@ void wallet2::set_unspent(size_t idx)
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = false;
   td.m_spent_height = 0;
+  add_to_unspent_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::freeze(size_t idx)
@@ -2020,6 +2166,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
             if (td.m_key_image_known)
 	      m_key_images[td.m_key_image] = m_transfers.size()-1;
 	    m_pub_keys[tx_scan_info[o].in_ephemeral.pub] = m_transfers.size()-1;
+            add_to_history_index(m_transfers.size() - 1);
             if (output_tracker_cache)
               (*output_tracker_cache)[std::make_pair(tx.vout[o].amount, td.m_global_output_index)] = m_transfers.size() - 1;
             if (m_multisig)
@@ -2062,6 +2209,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           uint64_t extra_amount = amount - m_transfers[kit->second].amount();
           if (!pool)
           {
+            remove_from_history_index(kit->second);
+            remove_from_unspent_index(kit->second);
             transfer_details &td = m_transfers[kit->second];
 	    td.m_block_height = height;
 	    td.m_internal_output_index = o;
@@ -2087,6 +2236,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
               td.m_mask = rct::identity();
               td.m_rct = false;
             }
+            add_to_history_index(kit->second);
+            add_to_unspent_index(kit->second);
             if (output_tracker_cache)
               (*output_tracker_cache)[std::make_pair(tx.vout[o].amount, td.m_global_output_index)] = kit->second;
             if (m_multisig)
@@ -2136,7 +2287,9 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           //   1) the same output pub key was used as destination multiple times,
           //   2) the wallet set the highest amount among them to transfer_details::m_amount, and
           //   3) the wallet somehow spent that output with an amount smaller than the above amount, causing inconsistency
+          remove_from_unspent_index(it->second);
           td.m_amount = amount;
+          add_to_unspent_index(it->second);
         }
       }
       else
@@ -2292,7 +2445,10 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
-        m_payments.emplace(payment_id, payment);
+      {
+        add_to_history_index(*m_payments.emplace(payment_id, payment));
+        invalidate_journaled_payments(payment.m_block_height);
+      }
       LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
 
@@ -2319,7 +2475,9 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
   if(unconf_it != m_unconfirmed_txs.end()) {
     if (store_tx_info()) {
       try {
-        m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        auto inserted = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        if (inserted.second)
+          add_to_history_index(*inserted.first);
       }
       catch (...) {
         // can fail if the tx has unexpected input types
@@ -2333,6 +2491,8 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::transaction &tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices)
 {
   std::pair<std::unordered_map<crypto::hash, confirmed_transfer_details>::iterator, bool> entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details()));
+  if (!entry.second)
+    remove_from_history_index(*entry.first);
   // fill with the info we know, some info might already be there
   if (entry.second)
   {
@@ -2369,6 +2529,7 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
   entry.first->second.m_block_height = height;
   entry.first->second.m_timestamp = ts;
   entry.first->second.m_unlock_time = tx.unlock_time;
+  add_to_history_index(*entry.first);
 
   add_rings(tx);
 }
@@ -2457,6 +2618,12 @@ void wallet2::parse_block_round(const cryptonote::blobdata &blob, cryptonote::bl
 //----------------------------------------------------------------------------------------------------
 void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices)
 {
+  if (m_pull_blocks_override)
+  {
+    m_pull_blocks_override(start_height, blocks_start_height, short_chain_history, blocks, o_indices);
+    return;
+  }
+
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
   req.block_ids = short_chain_history;
@@ -2497,24 +2664,18 @@ void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height,
   hashes = std::move(res.m_block_ids);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+void wallet2::prepare_tx_cache_data(uint64_t start_height, const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data, const crypto::secret_key &view_secret_key) const
 {
-  size_t current_index = start_height;
-  blocks_added = 0;
-
-  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
-
   tools::threadpool& tpool = tools::threadpool::getInstance();
   tools::threadpool::waiter waiter;
+  hw::device &hwdev = m_account.get_device();
 
   size_t num_txes = 0;
-  std::vector<tx_cache_data> tx_cache_data;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
     num_txes += 1 + parsed_blocks[i].txes.size();
-  tx_cache_data.resize(num_txes);
   size_t txidx = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  tx_cache_data.resize(num_txes);
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
   {
     THROW_WALLET_EXCEPTION_IF(parsed_blocks[i].txes.size() != parsed_blocks[i].block.tx_hashes.size(),
         error::wallet_internal_error, "Mismatched parsed_blocks[i].txes.size() and parsed_blocks[i].block.tx_hashes.size()");
@@ -2535,13 +2696,8 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   THROW_WALLET_EXCEPTION_IF(txidx != num_txes, error::wallet_internal_error, "txidx does not match tx_cache_data size");
   waiter.wait(&tpool);
 
-  hw::device &hwdev =  m_account.get_device();
-  hw::reset_mode rst(hwdev);
-  hwdev.set_mode(hw::device::TRANSACTION_PARSE);
-  const cryptonote::account_keys &keys = m_account.get_keys();
-
   auto gender = [&](wallet2::is_out_data &iod) {
-    if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
+    if (!hwdev.generate_key_derivation(iod.pkey, view_secret_key, iod.derivation))
     {
       MWARNING("Failed to generate key derivation from tx pubkey, skipping");
       static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
@@ -2563,6 +2719,32 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
     }, true);
   }
   waiter.wait(&tpool);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache, std::vector<tx_cache_data> *precomputed_tx_cache_data)
+{
+  size_t current_index = start_height;
+  blocks_added = 0;
+
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
+  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+
+  size_t num_txes = 0;
+  std::vector<tx_cache_data> local_tx_cache_data;
+  for (size_t i = 0; i < blocks.size(); ++i)
+    num_txes += 1 + parsed_blocks[i].txes.size();
+  // the caller may have parsed the tx extras and generated the derivations
+  // already, eg when scanning for many wallets at once
+  std::vector<tx_cache_data> &tx_cache_data = precomputed_tx_cache_data ? *precomputed_tx_cache_data : local_tx_cache_data;
+  THROW_WALLET_EXCEPTION_IF(precomputed_tx_cache_data && tx_cache_data.size() != num_txes, error::wallet_internal_error, "Unexpected precomputed tx cache data size");
+  hw::device &hwdev =  m_account.get_device();
+  hw::reset_mode rst(hwdev);
+  hwdev.set_mode(hw::device::TRANSACTION_PARSE);
+  if (!precomputed_tx_cache_data)
+    prepare_tx_cache_data(start_height, parsed_blocks, tx_cache_data, m_account.get_keys().m_view_secret_key);
 
   auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
     for (size_t k = 0; k < n_vouts; ++k)
@@ -2586,7 +2768,7 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
     }
   };
 
-  txidx = 0;
+  size_t txidx = 0;
   for (size_t i = 0; i < blocks.size(); ++i)
   {
     if (should_skip_block(parsed_blocks[i].block, start_height + i))
@@ -3117,11 +3299,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   size_t try_count = 0;
   crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
   std::list<crypto::hash> short_chain_history;
-  tools::threadpool& tpool = tools::threadpool::getInstance();
-  tools::threadpool::waiter waiter;
   uint64_t blocks_start_height;
-  std::vector<cryptonote::block_complete_entry> blocks;
-  std::vector<parsed_block> parsed_blocks;
   bool refreshed = false;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
@@ -3157,106 +3335,204 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   });
 
   auto scope_exit_handler_hwdev = epee::misc_utils::create_scope_leave_handler([&](){hwdev.computing_key_images(false);});
+
+  // Blocks are pulled and parsed, and the key derivations of their txes generated,
+  // by a fetching thread which runs up to m_refresh_pipeline_depth batches ahead
+  // of this one, which scans the batches in order and updates the wallet. The
+  // output checks stay in the scanning stage, since it may grow m_subaddresses.
+  const bool prepare_ahead = hwdev.get_type() == hw::device::SOFTWARE;
+  // scanning an output may decrypt the keys, which scrambles the view key in place for a
+  // moment, so the fetching thread derives from a copy taken while nothing else touches it
+  const crypto::secret_key view_secret_key = m_account.get_keys().m_view_secret_key;
+  boost::mutex pipeline_mutex;
+  boost::condition_variable pipeline_cv;
+  std::deque<std::shared_ptr<refresh_batch>> pipeline;
+  bool pipeline_stop = false, fetch_done = false;
+  boost::thread fetch_thread;
+  uint64_t fetch_time = 0, prepare_time = 0, scan_time = 0, blocks_scanned = 0;
+
+  auto fetch_blocks = [&](uint64_t fetch_start_height) {
+    const std::vector<cryptonote::block_complete_entry> no_blocks;
+    const std::vector<parsed_block> no_parsed_blocks;
+    std::shared_ptr<refresh_batch> prev;
+    while (m_run.load(std::memory_order_relaxed))
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(pipeline_mutex);
+        while (!pipeline_stop && pipeline.size() >= m_refresh_pipeline_depth)
+          pipeline_cv.wait(lock);
+        if (pipeline_stop)
+          break;
+      }
+
+      std::shared_ptr<refresh_batch> batch = std::make_shared<refresh_batch>();
+      TIME_MEASURE_START(pull_time);
+      pull_and_parse_next_blocks(fetch_start_height, batch->start_height, short_chain_history, prev ? prev->blocks : no_blocks, prev ? prev->parsed_blocks : no_parsed_blocks, batch->blocks, batch->parsed_blocks, batch->error);
+      TIME_MEASURE_FINISH(pull_time);
+      fetch_time += pull_time;
+
+      if (prepare_ahead && !batch->error)
+      {
+        TIME_MEASURE_START(derivation_time);
+        try
+        {
+          prepare_tx_cache_data(batch->start_height, batch->parsed_blocks, batch->tx_cache_data, view_secret_key);
+          batch->tx_cache_data_ready = true;
+        }
+        catch (const std::exception &e)
+        {
+          // the scanning stage will try again and report it
+          MDEBUG("Failed to prepare tx cache data ahead: " << e.what());
+          batch->tx_cache_data.clear();
+        }
+        TIME_MEASURE_FINISH(derivation_time);
+        prepare_time += derivation_time;
+      }
+
+      const bool last = batch->error || batch->blocks.empty() || (prev && prev->start_height == batch->start_height);
+      {
+        boost::unique_lock<boost::mutex> lock(pipeline_mutex);
+        pipeline.push_back(batch);
+      }
+      pipeline_cv.notify_all();
+      if (last)
+        break;
+      prev = std::move(batch);
+    }
+    boost::unique_lock<boost::mutex> lock(pipeline_mutex);
+    fetch_done = true;
+    pipeline_cv.notify_all();
+  };
+  auto stop_fetching = [&]() {
+    {
+      boost::unique_lock<boost::mutex> lock(pipeline_mutex);
+      pipeline_stop = true;
+    }
+    pipeline_cv.notify_all();
+    if (fetch_thread.joinable())
+      fetch_thread.join();
+    pipeline.clear();
+    pipeline_stop = false;
+    fetch_done = false;
+  };
+  auto fetch_thread_stopper = epee::misc_utils::create_scope_leave_handler([&](){ stop_fetching(); });
+
   bool first = true;
+  boost::optional<uint64_t> last_start_height;
   while(m_run.load(std::memory_order_relaxed))
   {
-    uint64_t next_blocks_start_height;
-    std::vector<cryptonote::block_complete_entry> next_blocks;
-    std::vector<parsed_block> next_parsed_blocks;
-    bool error;
     try
     {
-      // pull the next set of blocks while we're processing the current one
-      error = false;
-      next_blocks.clear();
-      next_parsed_blocks.clear();
       added_blocks = 0;
-      if (!first && blocks.empty())
+      if (first)
       {
-        refreshed = false;
-        break;
+        first = false;
+        last_start_height = boost::none;
+        boost::thread::attributes attrs;
+        attrs.set_stack_size(THREAD_STACK_SIZE);
+        fetch_thread = boost::thread(attrs, [&fetch_blocks, start_height]{ fetch_blocks(start_height); });
       }
-      tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, error);});
 
-      if (!first)
+      std::shared_ptr<refresh_batch> batch;
       {
-        try
-        {
-          process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
-        }
-        catch (const tools::error::out_of_hashchain_bounds_error&)
+        boost::unique_lock<boost::mutex> lock(pipeline_mutex);
+        while (pipeline.empty() && !fetch_done)
+          pipeline_cv.wait(lock);
+        if (pipeline.empty())
         {
-          MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
-          uint64_t stop_height = m_blockchain.offset();
-          std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
-          for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
-            tip[i - m_blockchain.offset()] = m_blockchain[i];
-          cryptonote::block b;
-          generate_genesis(b);
-          m_blockchain.clear();
-          m_blockchain.push_back(get_block_hash(b));
-          short_chain_history.clear();
-          get_short_chain_history(short_chain_history);
-          fast_refresh(stop_height, blocks_start_height, short_chain_history, true);
-          THROW_WALLET_EXCEPTION_IF((m_blockchain.size() == stop_height || (m_blockchain.size() == 1 && stop_height == 0) ? false : true), error::wallet_internal_error, "Unexpected hashchain size");
-          THROW_WALLET_EXCEPTION_IF(m_blockchain.offset() != 0, error::wallet_internal_error, "Unexpected hashchain offset");
-          for (const auto &h: tip)
-            m_blockchain.push_back(h);
-          short_chain_history.clear();
-          get_short_chain_history(short_chain_history);
-          start_height = stop_height;
-          throw std::runtime_error(""); // loop again
-        }
-        catch (const std::exception &e)
-        {
-          MERROR("Error parsing blocks: " << e.what());
-          error = true;
+          // stopped before getting more blocks
+          refreshed = false;
+          break;
         }
-        blocks_fetched += added_blocks;
+        batch = pipeline.front();
+        pipeline.pop_front();
       }
-      waiter.wait(&tpool);
-      if(!first && blocks_start_height == next_blocks_start_height)
+      pipeline_cv.notify_all();
+
+      // handle error from async fetching thread
+      if (batch->error)
+      {
+        throw std::runtime_error("proxy exception in refresh thread");
+      }
+      if (last_start_height && *last_start_height == batch->start_height)
       {
         m_node_rpc_proxy.set_height(m_blockchain.size());
         refreshed = true;
         break;
       }
-
-      first = false;
-
-      // handle error from async fetching thread
-      if (error)
+      if (batch->blocks.empty())
       {
-        throw std::runtime_error("proxy exception in refresh thread");
+        refreshed = false;
+        break;
       }
 
       // if we've got at least 10 blocks to refresh, assume we're starting
       // a long refresh, and setup a tracking output cache if we need to
-      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next_blocks.size() >= 10)
+      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && batch->blocks.size() >= 10)
         output_tracker_cache = create_output_tracker_cache();
 
-      // switch to the new blocks from the daemon
-      blocks_start_height = next_blocks_start_height;
-      blocks = std::move(next_blocks);
-      parsed_blocks = std::move(next_parsed_blocks);
+      bool error = false;
+      try
+      {
+        TIME_MEASURE_START(process_time);
+        process_parsed_blocks(batch->start_height, batch->blocks, batch->parsed_blocks, added_blocks, output_tracker_cache.get(), batch->tx_cache_data_ready ? &batch->tx_cache_data : NULL);
+        TIME_MEASURE_FINISH(process_time);
+        scan_time += process_time;
+        blocks_scanned += batch->blocks.size();
+      }
+      catch (const tools::error::out_of_hashchain_bounds_error&)
+      {
+        MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
+        // the fetching thread works off short_chain_history
+        stop_fetching();
+        uint64_t stop_height = m_blockchain.offset();
+        std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
+        for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
+          tip[i - m_blockchain.offset()] = m_blockchain[i];
+        cryptonote::block b;
+        generate_genesis(b);
+        m_blockchain.clear();
+        m_blockchain.push_back(get_block_hash(b));
+        short_chain_history.clear();
+        get_short_chain_history(short_chain_history);
+        fast_refresh(stop_height, blocks_start_height, short_chain_history, true);
+        THROW_WALLET_EXCEPTION_IF((m_blockchain.size() == stop_height || (m_blockchain.size() == 1 && stop_height == 0) ? false : true), error::wallet_internal_error, "Unexpected hashchain size");
+        THROW_WALLET_EXCEPTION_IF(m_blockchain.offset() != 0, error::wallet_internal_error, "Unexpected hashchain offset");
+        for (const auto &h: tip)
+          m_blockchain.push_back(h);
+        short_chain_history.clear();
+        get_short_chain_history(short_chain_history);
+        start_height = stop_height;
+        throw std::runtime_error(""); // loop again
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Error parsing blocks: " << e.what());
+        error = true;
+      }
+      blocks_fetched += added_blocks;
+      added_blocks = 0;
+      if (error)
+      {
+        throw std::runtime_error("error processing blocks in refresh");
+      }
+      last_start_height = batch->start_height;
     }
     catch (const tools::error::password_needed&)
     {
       blocks_fetched += added_blocks;
-      waiter.wait(&tpool);
+      stop_fetching();
       throw;
     }
     catch (const std::exception&)
     {
       blocks_fetched += added_blocks;
-      waiter.wait(&tpool);
+      stop_fetching();
       if(try_count < 3)
       {
         LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
         first = true;
         start_height = 0;
-        blocks.clear();
-        parsed_blocks.clear();
         short_chain_history.clear();
         get_short_chain_history(short_chain_history, 1);
         ++try_count;
@@ -3268,6 +3544,13 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       }
     }
   }
+  stop_fetching();
+  if (blocks_scanned)
+  {
+    const auto rate = [blocks_scanned](uint64_t ms) { return blocks_scanned * 1000 / std::max<uint64_t>(ms, 1); };
+    LOG_PRINT_L1("Refresh pipeline, " << blocks_scanned << " blocks: fetch " << fetch_time << " ms (" << rate(fetch_time) << " blocks/s), derivations "
+        << prepare_time << " ms (" << rate(prepare_time) << " blocks/s), scan " << scan_time << " ms (" << rate(scan_time) << " blocks/s)");
+  }
   if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_txid : null_hash))
     received_money = true;
 
@@ -3330,52 +3613,71 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
     }
   }
 
-  cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
-  cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
-  req.amounts.push_back(0);
-  req.from_height = 0;
-  req.cumulative = false;
-  req.binary = true;
-  req.compress = true;
-  m_daemon_rpc_mutex.lock();
-  bool r = invoke_http_bin("/get_output_distribution.bin", req, res, rpc_timeout);
-  m_daemon_rpc_mutex.unlock();
-  if (!r)
-  {
-    MWARNING("Failed to request output distribution: no connection to daemon");
-    return false;
-  }
-  if (res.status == CORE_RPC_STATUS_BUSY)
-  {
-    MWARNING("Failed to request output distribution: daemon is busy");
-    return false;
-  }
-  if (res.status != CORE_RPC_STATUS_OK)
-  {
-    MWARNING("Failed to request output distribution: " << res.status);
-    return false;
-  }
-  if (res.distributions.size() != 1)
-  {
-    MWARNING("Failed to request output distribution: not the expected single result");
-    return false;
-  }
-  if (res.distributions[0].amount != 0)
+  // only the last blocks of the cached distribution are requested again, the whole
+  // distribution is requested if there's none yet or if the daemon's can't be merged
+  for (int attempt = 0; attempt < 2; ++attempt)
   {
-    MWARNING("Failed to request output distribution: results are not for amount 0");
-    return false;
+    cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
+    cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
+    req.amounts.push_back(0);
+    req.from_height = m_decoy_cache.rct_distribution_request_height();
+    req.cumulative = false;
+    req.binary = true;
+    req.compress = true;
+    m_daemon_rpc_mutex.lock();
+    bool r = invoke_http_bin("/get_output_distribution.bin", req, res, rpc_timeout);
+    m_daemon_rpc_mutex.unlock();
+    if (!r)
+    {
+      MWARNING("Failed to request output distribution: no connection to daemon");
+      return false;
+    }
+    if (res.status == CORE_RPC_STATUS_BUSY)
+    {
+      MWARNING("Failed to request output distribution: daemon is busy");
+      return false;
+    }
+    if (res.status != CORE_RPC_STATUS_OK)
+    {
+      if (req.from_height > 0)
+      {
+        MDEBUG("Failed to request output distribution from height " << req.from_height << ", requesting it whole");
+        m_decoy_cache.clear_rct_distribution();
+        continue;
+      }
+      MWARNING("Failed to request output distribution: " << res.status);
+      return false;
+    }
+    if (res.distributions.size() != 1)
+    {
+      MWARNING("Failed to request output distribution: not the expected single result");
+      return false;
+    }
+    if (res.distributions[0].amount != 0)
+    {
+      MWARNING("Failed to request output distribution: results are not for amount 0");
+      return false;
+    }
+    if (!m_decoy_cache.update_rct_distribution(res.distributions[0].data.start_height, res.distributions[0].data.distribution))
+    {
+      MDEBUG("Output distribution from height " << res.distributions[0].data.start_height << " doesn't match the cached one, requesting it whole");
+      continue;
+    }
+    start_height = m_decoy_cache.rct_start_height();
+    distribution = m_decoy_cache.rct_distribution();
+    return true;
   }
-  for (size_t i = 1; i < res.distributions[0].data.distribution.size(); ++i)
-    res.distributions[0].data.distribution[i] += res.distributions[0].data.distribution[i-1];
-  start_height = res.distributions[0].data.start_height;
-  distribution = std::move(res.distributions[0].data.distribution);
-  return true;
+  return false;
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
   LOG_PRINT_L0("Detaching blockchain on height " << height);
 
+  // the cached output distribution may now be off by more than the blocks it requests again
+  m_decoy_cache.clear();
+  m_rta_inputs.clear();
+
   // size  1 2 3 4 5 6 7 8 9
   // block 0 1 2 3 4 5 6 7 8
   //               C
@@ -3421,6 +3723,8 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
     auto it_pk = m_pub_keys.find(m_transfers[i].get_public_key());
     THROW_WALLET_EXCEPTION_IF(it_pk == m_pub_keys.end(), error::wallet_internal_error, "public key not found");
     m_pub_keys.erase(it_pk);
+    remove_from_history_index(i);
+    remove_from_unspent_index(i);
   }
   m_transfers.erase(it, m_transfers.end());
 
@@ -3430,15 +3734,22 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
   for (auto it = m_payments.begin(); it != m_payments.end(); )
   {
     if(height <= it->second.m_block_height)
+    {
+      remove_from_history_index(*it);
       it = m_payments.erase(it);
+    }
     else
       ++it;
   }
+  invalidate_journaled_payments(height);
 
   for (auto it = m_confirmed_txs.begin(); it != m_confirmed_txs.end(); )
   {
     if(height <= it->second.m_block_height)
+    {
+      remove_from_history_index(*it);
       it = m_confirmed_txs.erase(it);
+    }
     else
       ++it;
   }
@@ -3473,6 +3784,10 @@ bool wallet2::clear()
   m_subaddress_labels.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
+  m_cache_journal = cache_journal_state();
+  rebuild_history_index();
+  rebuild_unspent_index();
+  clear_rta_inputs();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -3485,10 +3800,14 @@ void wallet2::clear_soft(bool keep_key_images)
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
+  invalidate_journaled_payments(0);
   m_confirmed_txs.clear();
   m_unconfirmed_payments.clear();
   m_scanned_pool_txs[0].clear();
   m_scanned_pool_txs[1].clear();
+  rebuild_history_index();
+  rebuild_unspent_index();
+  clear_rta_inputs();
 
   cryptonote::block b;
   generate_genesis(b);
@@ -5307,6 +5626,7 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
   else
   {
     load_cache(m_wallet_file);
+    load_cache_journal();
 //MONERO specific
 #if 0
     wallet2::cache_file_data cache_file_data;
@@ -5438,6 +5758,10 @@ void wallet2::load_cache(const string &cache_filename)
   bool r = epee::file_io_utils::load_file_to_string(cache_filename, buf, std::numeric_limits<size_t>::max());
   THROW_WALLET_EXCEPTION_IF(!r, error::file_read_error, cache_filename);
 
+  // whatever was tracked for the journal does not describe this state anymore
+  m_cache_journal.compact = true;
+  m_cache_journal.snapshot_id = 0;
+
   // try to read it as an encrypted cache
   try
   {
@@ -5445,6 +5769,7 @@ void wallet2::load_cache(const string &cache_filename)
 
     r = ::serialization::parse_binary(buf, cache_file_data);
     THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "internal error: failed to deserialize \"" + cache_filename + '\"');
+    m_cache_journal.snapshot_id = get_cache_snapshot_id(cache_file_data.iv);
     std::string cache_data;
     cache_data.resize(cache_file_data.cache_data.size());
     crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
@@ -5494,6 +5819,7 @@ void wallet2::load_cache(const string &cache_filename)
   catch (...)
   {
     LOG_PRINT_L1("Failed to load encrypted cache, trying unencrypted");
+    m_cache_journal.snapshot_id = 0;
     try {
       std::stringstream iss;
       iss << buf;
@@ -5515,6 +5841,9 @@ void wallet2::load_cache(const string &cache_filename)
       m_account_public_address.m_spend_public_key != m_account.get_keys().m_account_address.m_spend_public_key ||
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
         error::wallet_files_doesnt_correspond, m_keys_file, cache_filename);
+
+  rebuild_history_index();
+  rebuild_unspent_index();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::trim_hashchain()
@@ -5662,8 +5991,12 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
         LOG_ERROR("error removing file: " << old_mms_file);
       }
     }
-  } else {
-    store_cache(new_file);
+    // remove old cache journal
+    boost::system::error_code ec;
+    boost::filesystem::remove(old_file + ".journal", ec);
+    m_cache_journal.compact = true;
+  } else if (!append_cache_journal()) {
+    const crypto::chacha_iv snapshot_iv = store_cache_snapshot(new_file);
     //MONERO specific
 #if 0
     // save to new file
@@ -5690,6 +6023,11 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     // here we have "*.new" file, we need to rename it to be without ".new"
     std::error_code e = tools::replace_file(new_file, m_wallet_file);
     THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+
+    // the journal applied to the cache file we just replaced
+    boost::system::error_code ec;
+    boost::filesystem::remove(m_wallet_file + ".journal", ec);
+    track_cache_journal(get_cache_snapshot_id(snapshot_iv), 0);
   }
   
   if (m_message_store.get_active())
@@ -5702,6 +6040,11 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::store_cache(const string &filename)
+{
+  store_cache_snapshot(filename);
+}
+//----------------------------------------------------------------------------------------------------
+crypto::chacha_iv wallet2::store_cache_snapshot(const string &filename)
 {
   // preparing wallet data
   std::stringstream oss;
@@ -5734,42 +6077,415 @@ void wallet2::store_cache(const string &filename)
     ostr.close();
     THROW_WALLET_EXCEPTION_IF(!success || !ostr.good(), error::file_save_error, filename);
 #endif
+  return cache_file_data.iv;
 }
 //----------------------------------------------------------------------------------------------------
-// TODO: implement till_block
-uint64_t wallet2::balance(uint32_t index_major/*, uint64_t till_block*/) const
+void wallet2::swap_cache_journal_containers(cache_journal_containers &containers)
 {
-  uint64_t amount = 0;
-  if(m_light_wallet)
-    return m_light_wallet_unlocked_balance;
-  for (const auto& i : balance_per_subaddress(index_major/*, till_block*/))
-    amount += i.second;
-  return amount;
+  std::swap(m_blockchain, containers.blockchain);
+  m_transfers.swap(containers.transfers);
+  m_payments.swap(containers.payments);
+  m_key_images.swap(containers.key_images);
+  m_pub_keys.swap(containers.pub_keys);
+  m_confirmed_txs.swap(containers.confirmed_txs);
+  m_tx_keys.swap(containers.tx_keys);
+  m_additional_tx_keys.swap(containers.additional_tx_keys);
+  m_tx_notes.swap(containers.tx_notes);
+  std::swap(m_subaddresses, containers.subaddresses);
+  m_address_book.swap(containers.address_book);
 }
 //----------------------------------------------------------------------------------------------------
-//uint64_t wallet2::unlocked_balance(uint32_t index_major/*, uint64_t till_block (graft proposed)*/) const
-uint64_t wallet2::unlocked_balance(uint32_t index_major, uint64_t *blocks_to_unlock) const
+uint64_t wallet2::get_transfer_fingerprint(size_t idx) const
 {
-  uint64_t amount = 0;
-  if (blocks_to_unlock)
-    *blocks_to_unlock = 0;
-  if(m_light_wallet)
-    return m_light_wallet_balance;
-  for (const auto& i : unlocked_balance_per_subaddress(index_major))
-  {
-    amount += i.second.first;
-    if (blocks_to_unlock && i.second.second > *blocks_to_unlock)
-      *blocks_to_unlock = i.second.second;
-  }
+  // m_tx is left out: it does not change for a given m_txid, and it is most of the transfer's size
+  const transfer_details &td = m_transfers[idx];
+  const auto ki = m_key_images.find(td.m_key_image);
+  const bool has_key_image = ki != m_key_images.end() && ki->second == idx;
+  std::string blob;
+  blob.reserve(512);
+  add_to_fingerprint(blob, td.m_block_height);
+  add_to_fingerprint(blob, td.m_txid);
+  add_to_fingerprint(blob, (uint64_t)td.m_internal_output_index);
+  add_to_fingerprint(blob, td.m_global_output_index);
+  add_to_fingerprint(blob, td.m_spent);
+  add_to_fingerprint(blob, td.m_frozen);
+  add_to_fingerprint(blob, td.m_spent_height);
+  add_to_fingerprint(blob, td.m_key_image);
+  add_to_fingerprint(blob, td.m_mask);
+  add_to_fingerprint(blob, td.m_amount);
+  add_to_fingerprint(blob, td.m_rct);
+  add_to_fingerprint(blob, td.m_key_image_known);
+  add_to_fingerprint(blob, td.m_key_image_request);
+  add_to_fingerprint(blob, (uint64_t)td.m_pk_index);
+  add_to_fingerprint(blob, td.m_subaddr_index);
+  add_to_fingerprint(blob, td.m_key_image_partial);
+  add_vector_to_fingerprint(blob, td.m_multisig_k);
+  add_to_fingerprint(blob, (uint64_t)td.m_multisig_info.size());
+  for (const multisig_info &info: td.m_multisig_info)
+  {
+    add_to_fingerprint(blob, info.m_signer);
+    add_vector_to_fingerprint(blob, info.m_LR);
+    add_vector_to_fingerprint(blob, info.m_partial_key_images);
+  }
+  add_vector_to_fingerprint(blob, td.m_uses);
+  add_to_fingerprint(blob, has_key_image);
+  return get_fingerprint(blob);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::track_cache_journal(uint64_t snapshot_id, uint64_t journal_size)
+{
+  boost::system::error_code e;
+  const uint64_t snapshot_size = boost::filesystem::file_size(m_wallet_file, e);
+
+  m_cache_journal.snapshot_id = snapshot_id;
+  m_cache_journal.snapshot_size = e ? 0 : snapshot_size;
+  m_cache_journal.journal_size = journal_size;
+  m_cache_journal.compact = snapshot_id == 0;
+  m_cache_journal.hashchain_size = m_blockchain.size();
+  m_cache_journal.hashchain_offset = m_blockchain.offset();
+  m_cache_journal.hashchain_top = m_blockchain.is_in_bounds(m_blockchain.size() - 1) ? m_blockchain[m_blockchain.size() - 1] : crypto::null_hash;
+  m_cache_journal.transfers.resize(m_transfers.size());
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+    m_cache_journal.transfers[i] = get_transfer_fingerprint(i);
+  get_cache_journal_fingerprints(m_confirmed_txs, m_cache_journal.confirmed_txs);
+  m_cache_journal.payments_height = std::numeric_limits<uint64_t>::max();
+  get_cache_journal_fingerprints(m_tx_keys, m_cache_journal.tx_keys);
+  get_cache_journal_fingerprints(m_additional_tx_keys, m_cache_journal.additional_tx_keys);
+  get_cache_journal_fingerprints(m_tx_notes, m_cache_journal.tx_notes);
+  m_cache_journal.subaddresses_size = m_subaddresses.size();
+  m_cache_journal.subaddresses_top = m_subaddresses.empty() ? crypto::null_pkey : (m_subaddresses.end() - 1)->first;
+  m_cache_journal.address_book.resize(m_address_book.size());
+  for (size_t i = 0; i < m_address_book.size(); ++i)
+    m_cache_journal.address_book[i] = get_cache_journal_fingerprint(m_address_book[i]);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::append_cache_journal()
+{
+#ifdef WIN32
+  // append_string_to_file does not handle UTF-8 filenames on Windows, always rewrite the cache file
+  return false;
+#else
+  if (m_cache_journal.compact || m_light_wallet)
+    return false;
+
+  // only a hashchain which grew on top of the stored one can be journaled, a reorg rewrites the cache file
+  const uint64_t hashchain_start = m_cache_journal.hashchain_size;
+  if (hashchain_start > m_blockchain.size() || hashchain_start < m_blockchain.offset() || m_blockchain.offset() < m_cache_journal.hashchain_offset)
+    return false;
+  if (hashchain_start > 0 && (!m_blockchain.is_in_bounds(hashchain_start - 1) || m_blockchain[hashchain_start - 1] != m_cache_journal.hashchain_top))
+    return false;
+  // likewise for subaddresses, which are rebuilt when the keys change
+  const uint64_t subaddresses_start = m_cache_journal.subaddresses_size;
+  if (subaddresses_start > m_subaddresses.size())
+    return false;
+  if (subaddresses_start > 0 && (m_subaddresses.begin() + (subaddresses_start - 1))->first != m_cache_journal.subaddresses_top)
+    return false;
+
+  cache_journal_record record;
+  record.snapshot_id = m_cache_journal.snapshot_id;
+  record.hashchain_offset = m_blockchain.offset();
+  record.hashchain_start = hashchain_start;
+  for (uint64_t height = hashchain_start; height < m_blockchain.size(); ++height)
+    record.hashchain_tail.push_back(m_blockchain[height]);
+
+  std::vector<uint64_t> transfer_fingerprints(m_transfers.size());
+  record.transfers_size = m_transfers.size();
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    transfer_fingerprints[i] = get_transfer_fingerprint(i);
+    if (i < m_cache_journal.transfers.size() && transfer_fingerprints[i] == m_cache_journal.transfers[i])
+      continue;
+    const transfer_details &td = m_transfers[i];
+    record.transfer_indices.push_back(i);
+    record.transfers.push_back(td);
+    const auto ki = m_key_images.find(td.m_key_image);
+    if (ki != m_key_images.end() && ki->second == i)
+      record.key_image_indices.push_back(i);
+  }
+
+  record.payments_height = m_cache_journal.payments_height;
+  if (record.payments_height != std::numeric_limits<uint64_t>::max())
+  {
+    for (const auto &payment: m_payments)
+      if (payment.second.m_block_height >= record.payments_height)
+        record.payments.push_back(payment);
+  }
+
+  std::unordered_map<crypto::hash, uint64_t> confirmed_tx_fingerprints, tx_key_fingerprints, additional_tx_key_fingerprints, tx_note_fingerprints;
+  get_cache_journal_changes(m_confirmed_txs, m_cache_journal.confirmed_txs, record.confirmed_txs, record.removed_confirmed_txs, confirmed_tx_fingerprints);
+  get_cache_journal_changes(m_tx_keys, m_cache_journal.tx_keys, record.tx_keys, record.removed_tx_keys, tx_key_fingerprints);
+  get_cache_journal_changes(m_additional_tx_keys, m_cache_journal.additional_tx_keys, record.additional_tx_keys, record.removed_additional_tx_keys, additional_tx_key_fingerprints);
+  get_cache_journal_changes(m_tx_notes, m_cache_journal.tx_notes, record.tx_notes, record.removed_tx_notes, tx_note_fingerprints);
+
+  record.subaddresses_start = subaddresses_start;
+  record.subaddresses.assign(m_subaddresses.begin() + subaddresses_start, m_subaddresses.end());
+
+  std::vector<uint64_t> address_book_fingerprints(m_address_book.size());
+  record.address_book_size = m_address_book.size();
+  for (size_t i = 0; i < m_address_book.size(); ++i)
+  {
+    address_book_fingerprints[i] = get_cache_journal_fingerprint(m_address_book[i]);
+    if (i < m_cache_journal.address_book.size() && address_book_fingerprints[i] == m_cache_journal.address_book[i])
+      continue;
+    record.address_book_indices.push_back(i);
+    record.address_book.push_back(m_address_book[i]);
+  }
+
+  {
+    // the rest of the state, with the containers recorded above left empty
+    cache_journal_containers containers;
+    swap_cache_journal_containers(containers);
+    auto containers_restorer = epee::misc_utils::create_scope_leave_handler([&, this]() {
+      swap_cache_journal_containers(containers);
+    });
+    std::stringstream oss;
+    boost::archive::portable_binary_oarchive ar(oss);
+    ar << *this;
+    record.state = oss.str();
+  }
+
+  std::stringstream oss;
+  {
+    boost::archive::portable_binary_oarchive ar(oss);
+    ar << record;
+  }
+  const std::string record_data = oss.str();
+  wallet2::cache_file_data cache_file_data = boost::value_initialized<wallet2::cache_file_data>();
+  cache_file_data.cache_data.resize(record_data.size());
+  cache_file_data.iv = crypto::rand<crypto::chacha_iv>();
+  crypto::chacha20(record_data.data(), record_data.size(), m_cache_key, cache_file_data.iv, &cache_file_data.cache_data[0]);
+
+  std::ostringstream ostr;
+  binary_archive<true> oar(ostr);
+  if (!::serialization::serialize(oar, cache_file_data))
+    return false;
+  const std::string blob = ostr.str();
+
+  const uint64_t max_journal_size = std::max<uint64_t>(CACHE_JOURNAL_MIN_COMPACTION_SIZE, m_cache_journal.snapshot_size * CACHE_JOURNAL_COMPACTION_RATIO);
+  if (m_cache_journal.journal_size + blob.size() > max_journal_size)
+  {
+    MDEBUG("Cache journal would grow to " << m_cache_journal.journal_size + blob.size() << " bytes, rewriting the cache file");
+    return false;
+  }
+  // a failed append may leave a partial record behind, rewriting the cache file drops it
+  if (!epee::file_io_utils::append_string_to_file(m_wallet_file + ".journal", blob))
+  {
+    MWARNING("Failed to append to the cache journal, rewriting the cache file");
+    return false;
+  }
+
+  MDEBUG("Appended " << blob.size() << " bytes to the cache journal: " << record.hashchain_tail.size() << " blocks, " <<
+      record.transfers.size() << " transfers, " << record.payments.size() << " payments, " <<
+      record.confirmed_txs.size() << "/" << record.removed_confirmed_txs.size() << " confirmed txes added/removed, " <<
+      record.tx_keys.size() + record.additional_tx_keys.size() << " tx keys, " << record.tx_notes.size() << " tx notes, " <<
+      record.subaddresses.size() << " subaddresses, " << record.address_book.size() << " address book rows");
+  m_cache_journal.journal_size += blob.size();
+  m_cache_journal.hashchain_size = m_blockchain.size();
+  m_cache_journal.hashchain_offset = m_blockchain.offset();
+  m_cache_journal.hashchain_top = m_blockchain.is_in_bounds(m_blockchain.size() - 1) ? m_blockchain[m_blockchain.size() - 1] : crypto::null_hash;
+  m_cache_journal.transfers.swap(transfer_fingerprints);
+  m_cache_journal.confirmed_txs.swap(confirmed_tx_fingerprints);
+  m_cache_journal.payments_height = std::numeric_limits<uint64_t>::max();
+  m_cache_journal.tx_keys.swap(tx_key_fingerprints);
+  m_cache_journal.additional_tx_keys.swap(additional_tx_key_fingerprints);
+  m_cache_journal.tx_notes.swap(tx_note_fingerprints);
+  m_cache_journal.subaddresses_size = m_subaddresses.size();
+  m_cache_journal.subaddresses_top = m_subaddresses.empty() ? crypto::null_pkey : (m_subaddresses.end() - 1)->first;
+  m_cache_journal.address_book.swap(address_book_fingerprints);
+  return true;
+#endif
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::apply_cache_journal_record(cache_journal_record &record)
+{
+  THROW_WALLET_EXCEPTION_IF(record.hashchain_start != m_blockchain.size() || record.hashchain_offset < m_blockchain.offset(),
+      error::wallet_internal_error, "Cache journal record does not match the hashchain");
+  THROW_WALLET_EXCEPTION_IF(record.transfers.size() != record.transfer_indices.size(),
+      error::wallet_internal_error, "Invalid cache journal record");
+  for (uint64_t idx: record.transfer_indices)
+    THROW_WALLET_EXCEPTION_IF(idx >= record.transfers_size, error::wallet_internal_error, "Invalid cache journal record");
+  THROW_WALLET_EXCEPTION_IF(record.subaddresses_start != m_subaddresses.size(),
+      error::wallet_internal_error, "Cache journal record does not match the subaddresses");
+  THROW_WALLET_EXCEPTION_IF(record.address_book.size() != record.address_book_indices.size(),
+      error::wallet_internal_error, "Invalid cache journal record");
+  for (uint64_t idx: record.address_book_indices)
+    THROW_WALLET_EXCEPTION_IF(idx >= record.address_book_size, error::wallet_internal_error, "Invalid cache journal record");
+
+  {
+    cache_journal_containers containers;
+    swap_cache_journal_containers(containers);
+    auto containers_restorer = epee::misc_utils::create_scope_leave_handler([&, this]() {
+      swap_cache_journal_containers(containers);
+    });
+    std::stringstream iss;
+    iss << record.state;
+    boost::archive::portable_binary_iarchive ar(iss);
+    ar >> *this;
+  }
+
+  for (const crypto::hash &hash: record.hashchain_tail)
+    m_blockchain.push_back(hash);
+  m_blockchain.trim(record.hashchain_offset);
+
+  const size_t old_transfers_size = m_transfers.size();
+  if (record.transfers_size < old_transfers_size)
+  {
+    for (auto i = m_key_images.begin(); i != m_key_images.end(); )
+      i = i->second >= record.transfers_size ? m_key_images.erase(i) : std::next(i);
+    for (auto i = m_pub_keys.begin(); i != m_pub_keys.end(); )
+      i = i->second >= record.transfers_size ? m_pub_keys.erase(i) : std::next(i);
+  }
+  m_transfers.resize(record.transfers_size);
+  size_t key_image_index = 0;
+  for (size_t n = 0; n < record.transfer_indices.size(); ++n)
+  {
+    const size_t idx = record.transfer_indices[n];
+    if (idx < std::min<size_t>(old_transfers_size, record.transfers_size))
+    {
+      const transfer_details &td = m_transfers[idx];
+      const auto ki = m_key_images.find(td.m_key_image);
+      if (ki != m_key_images.end() && ki->second == idx)
+        m_key_images.erase(ki);
+      const auto pk = m_pub_keys.find(td.get_public_key());
+      if (pk != m_pub_keys.end() && pk->second == idx)
+        m_pub_keys.erase(pk);
+    }
+    m_transfers[idx] = std::move(record.transfers[n]);
+    const transfer_details &td = m_transfers[idx];
+    m_pub_keys[td.get_public_key()] = idx;
+    if (key_image_index < record.key_image_indices.size() && record.key_image_indices[key_image_index] == idx)
+    {
+      m_key_images[td.m_key_image] = idx;
+      ++key_image_index;
+    }
+  }
+
+  if (record.payments_height != std::numeric_limits<uint64_t>::max())
+  {
+    for (auto i = m_payments.begin(); i != m_payments.end(); )
+      i = i->second.m_block_height >= record.payments_height ? m_payments.erase(i) : std::next(i);
+    for (auto &payment: record.payments)
+      m_payments.emplace(std::move(payment));
+  }
+
+  apply_cache_journal_changes(m_confirmed_txs, record.confirmed_txs, record.removed_confirmed_txs);
+  apply_cache_journal_changes(m_tx_keys, record.tx_keys, record.removed_tx_keys);
+  apply_cache_journal_changes(m_additional_tx_keys, record.additional_tx_keys, record.removed_additional_tx_keys);
+  apply_cache_journal_changes(m_tx_notes, record.tx_notes, record.removed_tx_notes);
+
+  m_subaddresses.reserve(m_subaddresses.size() + record.subaddresses.size());
+  for (const auto &e: record.subaddresses)
+    m_subaddresses.emplace(e.first, e.second);
+
+  m_address_book.resize(record.address_book_size);
+  for (size_t n = 0; n < record.address_book_indices.size(); ++n)
+    m_address_book[record.address_book_indices[n]] = std::move(record.address_book[n]);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_journal()
+{
+  const std::string journal_file = m_wallet_file + ".journal";
+  std::string buf;
+  boost::system::error_code e;
+  if (boost::filesystem::exists(journal_file, e) && !e)
+  {
+    if (!epee::file_io_utils::load_file_to_string(journal_file, buf, std::numeric_limits<size_t>::max()))
+    {
+      MWARNING("Failed to read cache journal " << journal_file << ", ignoring it");
+      buf.clear();
+    }
+  }
+
+  // records are applied in order until one does not belong to the cache file, or was torn by a crash:
+  // the state is then as of the last good record, and the next store rewrites the cache file
+  bool clean = true;
+  size_t records = 0;
+  std::istringstream iss(buf);
+  binary_archive<false> ar(iss);
+  while (clean && ar.remaining_bytes() > 0)
+  {
+    wallet2::cache_file_data cache_file_data;
+    if (!::serialization::serialize_noeof(ar, cache_file_data))
+    {
+      MWARNING("Truncated record in cache journal " << journal_file << ", ignoring the rest");
+      clean = false;
+      break;
+    }
+    try
+    {
+      std::string record_data;
+      record_data.resize(cache_file_data.cache_data.size());
+      crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &record_data[0]);
+      cache_journal_record record;
+      {
+        std::stringstream rss;
+        rss << record_data;
+        boost::archive::portable_binary_iarchive rar(rss);
+        rar >> record;
+      }
+      if (record.snapshot_id != m_cache_journal.snapshot_id)
+      {
+        MINFO("Cache journal " << journal_file << " does not belong to the cache file, ignoring it");
+        clean = false;
+        break;
+      }
+      apply_cache_journal_record(record);
+      ++records;
+    }
+    catch (const std::exception &ex)
+    {
+      MWARNING("Failed to apply cache journal record: " << ex.what() << ", ignoring the rest");
+      clean = false;
+    }
+  }
+  if (records > 0)
+  {
+    LOG_PRINT_L1("Applied " << records << " cache journal records");
+    rebuild_history_index();
+    rebuild_unspent_index();
+  }
+
+  track_cache_journal(m_cache_journal.snapshot_id, buf.size());
+  if (!clean)
+    m_cache_journal.compact = true;
+}
+//----------------------------------------------------------------------------------------------------
+// TODO: implement till_block
+uint64_t wallet2::balance(uint32_t index_major/*, uint64_t till_block*/) const
+{
+  uint64_t amount = 0;
+  if(m_light_wallet)
+    return m_light_wallet_unlocked_balance;
+  for (const auto& i : balance_per_subaddress(index_major/*, till_block*/))
+    amount += i.second;
+  return amount;
+}
+//----------------------------------------------------------------------------------------------------
+//uint64_t wallet2::unlocked_balance(uint32_t index_major/*, uint64_t till_block (graft proposed)*/) const
+uint64_t wallet2::unlocked_balance(uint32_t index_major, uint64_t *blocks_to_unlock) const
+{
+  uint64_t amount = 0;
+  if (blocks_to_unlock)
+    *blocks_to_unlock = 0;
+  if(m_light_wallet)
+    return m_light_wallet_balance;
+  for (const auto& i : unlocked_balance_per_subaddress(index_major))
+  {
+    amount += i.second.first;
+    if (blocks_to_unlock && i.second.second > *blocks_to_unlock)
+      *blocks_to_unlock = i.second.second;
+  }
   return amount;
 }
 //----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major) const
 {
   std::map<uint32_t, uint64_t> amount_per_subaddr;
-  for (const auto& td: m_transfers)
+  const unspent_output_index::range_type outputs = m_unspent_index.account_range(index_major);
+  for (auto i = outputs.first; i != outputs.second; ++i)
   {
-    if (td.m_subaddr_index.major == index_major && !td.m_spent && !td.m_frozen)
+    const transfer_details &td = m_transfers[unspent_output_index::index_of(*i)];
+    if (!td.m_frozen)
     {
         // TODO:
 //      if (till_block > 0 && td.m_block_height > till_block)
@@ -5801,9 +6517,11 @@ std::map<uint32_t, std::pair<uint64_t, uint64_t>> wallet2::unlocked_balance_per_
 {
   std::map<uint32_t, std::pair<uint64_t, uint64_t>> amount_per_subaddr;
   const uint64_t blockchain_height = get_blockchain_current_height();
-  for(const transfer_details& td: m_transfers)
+  const unspent_output_index::range_type outputs = m_unspent_index.account_range(index_major);
+  for (auto i = outputs.first; i != outputs.second; ++i)
   {
-    if(td.m_subaddr_index.major == index_major && !td.m_spent && !td.m_frozen)
+    const transfer_details &td = m_transfers[unspent_output_index::index_of(*i)];
+    if (!td.m_frozen)
     {
         // TODO:
 //      if (till_block > 0 && td.m_block_height > till_block)
@@ -5835,6 +6553,15 @@ std::map<uint32_t, std::pair<uint64_t, uint64_t>> wallet2::unlocked_balance_per_
   return amount_per_subaddr;
 }
 //----------------------------------------------------------------------------------------------------
+std::map<uint32_t, uint64_t> wallet2::num_unspent_outputs_per_subaddress(uint32_t index_major) const
+{
+  std::map<uint32_t, uint64_t> outputs_per_subaddr;
+  const unspent_output_index::range_type outputs = m_unspent_index.account_range(index_major);
+  for (auto i = outputs.first; i != outputs.second; ++i)
+    ++outputs_per_subaddr[unspent_output_index::minor_of(*i)];
+  return outputs_per_subaddr;
+}
+//----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance_all() const
 {
   uint64_t r = 0;
@@ -5888,29 +6615,141 @@ void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::pa
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  auto range = std::make_pair(m_payments.begin(), m_payments.end());
-  std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height && max_height >= x.second.m_block_height &&
-      (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
-      (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
-    {
-      payments.push_back(x);
-    }
-  });
+  get_payments_paged(payments, min_height, max_height, subaddr_account, subaddr_indices, boost::none, 0);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
     uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  for (auto i = m_confirmed_txs.begin(); i != m_confirmed_txs.end(); ++i) {
-    if (i->second.m_block_height <= min_height || i->second.m_block_height > max_height)
-      continue;
-    if (subaddr_account && *subaddr_account != i->second.m_subaddr_account)
-      continue;
-    if (!subaddr_indices.empty() && std::count_if(i->second.m_subaddr_indices.begin(), i->second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
-      continue;
+  get_payments_out_paged(confirmed_payments, min_height, max_height, subaddr_account, subaddr_indices, boost::none, 0);
+}
+//----------------------------------------------------------------------------------------------------
+boost::optional<transfer_history_key> wallet2::get_payments_paged(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height,
+    const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, const boost::optional<transfer_history_key> &after, size_t limit) const
+{
+  if (min_height >= max_height)
+    return boost::none;
+  std::vector<const payment_container::value_type*> found;
+  const boost::optional<transfer_history_key> next = m_payments_index.query(found, min_height + 1, max_height, subaddr_account, subaddr_indices, after, limit);
+  for (const payment_container::value_type *payment: found)
+    payments.push_back(*payment);
+  return next;
+}
+//----------------------------------------------------------------------------------------------------
+boost::optional<transfer_history_key> wallet2::get_payments_out_paged(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments, uint64_t min_height, uint64_t max_height,
+    const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, const boost::optional<transfer_history_key> &after, size_t limit) const
+{
+  if (min_height >= max_height)
+    return boost::none;
+  std::vector<const std::pair<const crypto::hash, confirmed_transfer_details>*> found;
+  const boost::optional<transfer_history_key> next = m_confirmed_txs_index.query(found, min_height + 1, max_height, subaddr_account, subaddr_indices, after, limit);
+  for (const auto *ctd: found)
+    confirmed_payments.push_back(*ctd);
+  return next;
+}
+//----------------------------------------------------------------------------------------------------
+boost::optional<transfer_history_key> wallet2::get_transfers_paged(std::vector<size_t>& transfers, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices,
+    const std::function<bool(const transfer_details&)> &filter, const boost::optional<transfer_history_key> &after, size_t limit) const
+{
+  return m_transfers_index.query(transfers, 0, std::numeric_limits<uint64_t>::max(), subaddr_account, subaddr_indices, after, limit,
+      [this, &filter](size_t idx) { return !filter || filter(m_transfers[idx]); });
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::get_payments_by_txid(const crypto::hash &txid, std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments) const
+{
+  std::vector<const payment_container::value_type*> found;
+  m_payments_index.find(txid, found);
+  for (const payment_container::value_type *payment: found)
+    payments.push_back(*payment);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::get_payments_out_by_txid(const crypto::hash &txid, std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments) const
+{
+  auto i = m_confirmed_txs.find(txid);
+  if (i != m_confirmed_txs.end())
     confirmed_payments.push_back(*i);
-  }
+}
+//----------------------------------------------------------------------------------------------------
+transfer_history_key wallet2::get_history_key(const payment_details &pd)
+{
+  const uint64_t n = ((uint64_t)pd.m_subaddr_index.major << 32) | pd.m_subaddr_index.minor;
+  return {pd.m_block_height, pd.m_tx_hash, n};
+}
+//----------------------------------------------------------------------------------------------------
+transfer_history_key wallet2::get_history_key(const crypto::hash &txid, const confirmed_transfer_details &ctd)
+{
+  return {ctd.m_block_height, txid, 0};
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_to_history_index(const payment_container::value_type &payment)
+{
+  const payment_details &pd = payment.second;
+  m_payments_index.insert(get_history_key(pd), &payment, pd.m_subaddr_index.major, {pd.m_subaddr_index.minor});
+  ++m_history_version;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::remove_from_history_index(const payment_container::value_type &payment)
+{
+  m_payments_index.erase(get_history_key(payment.second), &payment);
+  ++m_history_version;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_to_history_index(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd)
+{
+  m_confirmed_txs_index.insert(get_history_key(ctd.first, ctd.second), &ctd, ctd.second.m_subaddr_account, ctd.second.m_subaddr_indices);
+  ++m_history_version;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::remove_from_history_index(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd)
+{
+  m_confirmed_txs_index.erase(get_history_key(ctd.first, ctd.second), &ctd);
+  ++m_history_version;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_to_history_index(size_t transfer_idx)
+{
+  const transfer_details &td = m_transfers[transfer_idx];
+  m_transfers_index.insert({td.m_block_height, td.m_txid, td.m_internal_output_index}, transfer_idx, td.m_subaddr_index.major, {td.m_subaddr_index.minor});
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::remove_from_history_index(size_t transfer_idx)
+{
+  const transfer_details &td = m_transfers[transfer_idx];
+  m_transfers_index.erase({td.m_block_height, td.m_txid, td.m_internal_output_index}, transfer_idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_history_index()
+{
+  ++m_history_version;
+  m_payments_index.clear();
+  for (const auto &payment: m_payments)
+    add_to_history_index(payment);
+  m_confirmed_txs_index.clear();
+  for (const auto &ctd: m_confirmed_txs)
+    add_to_history_index(ctd);
+  m_transfers_index.clear();
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+    add_to_history_index(i);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_to_unspent_index(size_t transfer_idx)
+{
+  const transfer_details &td = m_transfers[transfer_idx];
+  if (!td.m_spent)
+    m_unspent_index.insert(td.m_subaddr_index.major, td.m_subaddr_index.minor, td.amount(), transfer_idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::remove_from_unspent_index(size_t transfer_idx)
+{
+  const transfer_details &td = m_transfers[transfer_idx];
+  m_unspent_index.erase(td.m_subaddr_index.major, td.m_subaddr_index.minor, td.amount(), transfer_idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_unspent_index()
+{
+  m_unspent_index.clear();
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+    add_to_unspent_index(i);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
@@ -6188,6 +7027,29 @@ float wallet2::get_output_relatedness(const transfer_details &td0, const transfe
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::pop_best_value_from(const transfer_container &transfers, std::vector<size_t> &unused_indices, const std::vector<size_t>& selected_transfers, bool smallest) const
 {
+  // Nothing is less related than 0, so when picking at random, uniform draws which
+  // are unrelated to the selected transfers are uniform among the best candidates,
+  // and spare a scan of all the unused outputs. Fall back to the scan if unlucky.
+  if (!smallest && !unused_indices.empty())
+  {
+    for (size_t attempt = 0; attempt < POP_BEST_VALUE_SAMPLING_ATTEMPTS; ++attempt)
+    {
+      const size_t n = crypto::rand_idx(unused_indices.size());
+      const transfer_details &candidate = transfers[unused_indices[n]];
+      bool related = false;
+      for (size_t i: selected_transfers)
+      {
+        if (get_output_relatedness(candidate, transfers[i]) > 0.0f)
+        {
+          related = true;
+          break;
+        }
+      }
+      if (!related)
+        return pop_index (unused_indices, n);
+    }
+  }
+
   std::vector<size_t> candidates;
   float best_relatedness = 1.0f;
   for (size_t n = 0; n < unused_indices.size(); ++n)
@@ -7827,6 +8689,32 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     return;
   }
 
+  // reuse the rings already picked for inputs of the transactions being built,
+  // so only the rings of the new inputs are requested
+  std::vector<size_t> new_transfers;
+  for (size_t idx: selected_transfers)
+  {
+    const transfer_details &td = m_transfers[idx];
+    if (!m_decoy_cache.find_ring(td.is_rct() ? 0 : td.amount(), td.m_global_output_index, fake_outputs_count + 1))
+      new_transfers.push_back(idx);
+  }
+  if (new_transfers.size() < selected_transfers.size())
+  {
+    std::vector<std::vector<get_outs_entry>> new_outs;
+    if (!new_transfers.empty())
+      get_outs(new_outs, new_transfers, fake_outputs_count);
+    m_tx_construction_timings.rings_reused += selected_transfers.size() - new_transfers.size();
+    outs.reserve(selected_transfers.size());
+    for (size_t idx: selected_transfers)
+    {
+      const transfer_details &td = m_transfers[idx];
+      const std::vector<get_outs_entry> *ring = m_decoy_cache.find_ring(td.is_rct() ? 0 : td.amount(), td.m_global_output_index, fake_outputs_count + 1);
+      THROW_WALLET_EXCEPTION_IF(!ring, error::wallet_internal_error, "No ring picked for output " + std::to_string(td.m_global_output_index));
+      outs.push_back(*ring);
+    }
+    return;
+  }
+
   if (fake_outputs_count > 0)
   {
     uint64_t segregation_fork_height = get_segregation_fork_height();
@@ -7848,7 +8736,10 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
         has_rct = true;
         max_rct_index = std::max(max_rct_index, m_transfers[idx].m_global_output_index);
       }
+    TIME_MEASURE_NS_START(distribution_time);
     const bool has_rct_distribution = has_rct && get_rct_distribution(rct_start_height, rct_offsets);
+    TIME_MEASURE_NS_FINISH(distribution_time);
+    m_tx_construction_timings.distribution += distribution_time / 1000;
     if (has_rct_distribution)
     {
       // check we're clear enough of rct start, to avoid corner cases below
@@ -7859,6 +8750,7 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     }
 
     // get histogram for the amounts we need
+    TIME_MEASURE_NS_START(histogram_time);
     cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::request req_t = AUTO_VAL_INIT(req_t);
     cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::response resp_t = AUTO_VAL_INIT(resp_t);
     // request histogram for all outputs, except 0 if we have the rct distribution
@@ -7927,7 +8819,11 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
       }
     }
 
+    TIME_MEASURE_NS_FINISH(histogram_time);
+    m_tx_construction_timings.histogram += histogram_time / 1000;
+
     // we ask for more, to have spares if some outputs are still locked
+    TIME_MEASURE_NS_START(picking_time);
     size_t base_requested_outputs_count = (size_t)((fake_outputs_count + 1) * 1.5 + 1);
     LOG_PRINT_L2("base_requested_outputs_count: " << base_requested_outputs_count);
 
@@ -8244,11 +9140,18 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
             boost::join(o.second | boost::adaptors::transformed([](uint64_t out){return std::to_string(out);}), " "));
     }
 
+    TIME_MEASURE_NS_FINISH(picking_time);
+    m_tx_construction_timings.picking += picking_time / 1000;
+
     // get the keys for those
     req.get_txid = false;
+    TIME_MEASURE_NS_START(outs_time);
     m_daemon_rpc_mutex.lock();
     bool r = invoke_http_bin("/get_outs.bin", req, daemon_resp, rpc_timeout);
     m_daemon_rpc_mutex.unlock();
+    TIME_MEASURE_NS_FINISH(outs_time);
+    m_tx_construction_timings.outs += outs_time / 1000;
+    ++m_tx_construction_timings.get_outs_requests;
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::get_outs_error, get_rpc_status(daemon_resp.status));
@@ -8388,7 +9291,9 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
       ring.push_back(std::get<0>(e));
     if (!set_ring(td.m_key_image, ring, false))
       MERROR("Failed to set ring for " << td.m_key_image);
+    m_decoy_cache.add_ring(td.is_rct() ? 0 : td.amount(), td.m_global_output_index, outs[i]);
   }
+  m_tx_construction_timings.rings_fetched += selected_transfers.size();
 }
 
 template<typename T>
@@ -8505,7 +9410,10 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
   std::vector<crypto::secret_key> additional_tx_keys;
   rct::multisig_out msout;
   LOG_PRINT_L2("constructing tx");
+  TIME_MEASURE_NS_START(construction_time);
   bool r = cryptonote::construct_tx_and_get_tx_key(m_account.get_keys(), m_subaddresses, sources, splitted_dsts, change_dts.addr, extra, tx, unlock_time, tx_key, additional_tx_keys, false, {}, m_multisig ? &msout : NULL, tx_type);
+  TIME_MEASURE_NS_FINISH(construction_time);
+  m_tx_construction_timings.construction += construction_time / 1000;
   LOG_PRINT_L2("constructed tx, r="<<r);
   THROW_WALLET_EXCEPTION_IF(!r, error::tx_not_constructed, sources, splitted_dsts, unlock_time, m_nettype);
   THROW_WALLET_EXCEPTION_IF(upper_transaction_weight_limit <= get_transaction_weight(tx), error::tx_too_big, tx, upper_transaction_weight_limit);
@@ -8737,7 +9645,10 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
   rct::multisig_out msout;
   LOG_PRINT_L2("constructing tx");
   auto sources_copy = sources;
+  TIME_MEASURE_NS_START(construction_time);
   bool r = cryptonote::construct_tx_and_get_tx_key(m_account.get_keys(), m_subaddresses, sources, splitted_dsts, change_dts.addr, extra, tx, unlock_time, tx_key, additional_tx_keys, true, rct_config, m_multisig ? &msout : NULL, tx_type);
+  TIME_MEASURE_NS_FINISH(construction_time);
+  m_tx_construction_timings.construction += construction_time / 1000;
   LOG_PRINT_L2("constructed tx, r="<<r);
   THROW_WALLET_EXCEPTION_IF(!r, error::tx_not_constructed, sources, dsts, unlock_time, m_nettype);
   THROW_WALLET_EXCEPTION_IF(upper_transaction_weight_limit <= get_transaction_weight(tx), error::tx_too_big, tx, upper_transaction_weight_limit);
@@ -8842,51 +9753,71 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
 
   LOG_PRINT_L2("pick_preferred_rct_inputs: needed_money " << print_money(needed_money));
 
-  // try to find a rct input of enough size
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  // try to find a rct input of enough size, the smallest one of any of the subaddresses
+  for (uint32_t index_minor: subaddr_indices)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && !td.m_frozen && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    const unspent_output_index::range_type outputs = m_unspent_index.range(subaddr_account, index_minor, needed_money);
+    for (auto it = outputs.first; it != outputs.second; ++it)
     {
-      LOG_PRINT_L2("We can use " << i << " alone: " << print_money(td.amount()));
-      picks.push_back(i);
-      return picks;
+      const size_t i = unspent_output_index::index_of(*it);
+      const transfer_details& td = m_transfers[i];
+      if (!td.m_frozen && td.is_rct() && is_transfer_unlocked(td))
+      {
+        if (picks.empty() || td.amount() < m_transfers[picks[0]].amount())
+          picks.assign(1, i);
+        break;
+      }
     }
   }
+  if (!picks.empty())
+  {
+    LOG_PRINT_L2("We can use " << picks[0] << " alone: " << print_money(m_transfers[picks[0]].amount()));
+    return picks;
+  }
 
-  // then try to find two outputs
-  // this could be made better by picking one of the outputs to be a small one, since those
-  // are less useful since often below the needed money, so if one can be used in a pair,
-  // it gets rid of it for the future
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  // then try to find two outputs of the same subaddress
+  // small outputs are less useful since often below the needed money, so if one can be
+  // used in a pair, it gets rid of it for the future: outputs are tried from the smallest
+  // one which the largest output of the subaddress completes, with the smallest outputs
+  // which complete them
+  for (uint32_t index_minor: subaddr_indices)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && !td.m_frozen && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    const unspent_output_index::range_type outputs = m_unspent_index.range(subaddr_account, index_minor);
+    if (outputs.first == outputs.second)
+      continue;
+    const uint64_t largest = unspent_output_index::amount_of(*std::prev(outputs.second));
+    const auto first = needed_money > largest ? m_unspent_index.range(subaddr_account, index_minor, needed_money - largest).first : outputs.first;
+    for (auto it = first; it != outputs.second; ++it)
     {
+      const size_t i = unspent_output_index::index_of(*it);
+      const transfer_details& td = m_transfers[i];
+      if (td.m_frozen || td.m_key_image_partial || !td.is_rct() || !is_transfer_unlocked(td))
+        continue;
       LOG_PRINT_L2("Considering input " << i << ", " << print_money(td.amount()));
-      for (size_t j = i + 1; j < m_transfers.size(); ++j)
+      const unspent_output_index::range_type partners = m_unspent_index.range(subaddr_account, index_minor, needed_money > td.amount() ? needed_money - td.amount() : 0);
+      for (auto jt = partners.first; jt != partners.second; ++jt)
       {
+        const size_t j = unspent_output_index::index_of(*jt);
         const transfer_details& td2 = m_transfers[j];
-        if (!td2.m_spent && !td2.m_frozen && !td.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
+        if (j == i || td2.m_frozen || td2.m_key_image_partial || !td2.is_rct() || !is_transfer_unlocked(td2))
+          continue;
+        // update our picks if those outputs are less related than any we
+        // already found. If the same, don't update, and the smallest suitable
+        // outputs will be used in preference.
+        float relatedness = get_output_relatedness(td, td2);
+        LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
+        if (relatedness < current_output_relatdness)
         {
-          // update our picks if those outputs are less related than any we
-          // already found. If the same, don't update, and oldest suitable outputs
-          // will be used in preference.
-          float relatedness = get_output_relatedness(td, td2);
-          LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
-          if (relatedness < current_output_relatdness)
-          {
-            // reset the current picks with those, and return them directly
-            // if they're unrelated. If they are related, we'll end up returning
-            // them if we find nothing better
-            picks.clear();
-            picks.push_back(i);
-            picks.push_back(j);
-            LOG_PRINT_L0("we could use " << i << " and " << j);
-            if (relatedness == 0.0f)
-              return picks;
-            current_output_relatdness = relatedness;
-          }
+          // reset the current picks with those, and return them directly
+          // if they're unrelated. If they are related, we'll end up returning
+          // them if we find nothing better
+          picks.clear();
+          picks.push_back(i);
+          picks.push_back(j);
+          LOG_PRINT_L0("we could use " << i << " and " << j);
+          if (relatedness == 0.0f)
+            return picks;
+          current_output_relatdness = relatedness;
         }
       }
     }
@@ -9030,6 +9961,8 @@ void wallet2::light_wallet_get_unspent_outs()
   
   // Clear old outputs
   m_transfers.clear();
+  m_transfers_index.clear();
+  m_unspent_index.clear();
   
   for (const auto &o: ores.outputs) {
     bool spent = false;
@@ -9065,9 +9998,12 @@ void wallet2::light_wallet_get_unspent_outs()
     string_tools::hex_to_pod(o.public_key, public_key);
     string_tools::hex_to_pod(o.tx_pub_key, tx_pub_key);
     
-    for(auto &t: m_transfers){
+    for(size_t i = 0; i < m_transfers.size(); ++i){
+      transfer_details &t = m_transfers[i];
       if(t.get_public_key() == public_key) {
+        remove_from_unspent_index(i);
         t.m_spent = spent;
+        add_to_unspent_index(i);
         add_transfer = false;
         break;
       }
@@ -9144,6 +10080,7 @@ void wallet2::light_wallet_get_unspent_outs()
       set_unspent(m_transfers.size()-1);
     m_key_images[td.m_key_image] = m_transfers.size()-1;
     m_pub_keys[td.get_public_key()] = m_transfers.size()-1;
+    add_to_history_index(m_transfers.size() - 1);
   }
 }
 
@@ -9159,7 +10096,8 @@ bool wallet2::light_wallet_get_address_info(tools::COMMAND_RPC_GET_ADDRESS_INFO:
   bool r = invoke_http_json("/get_address_info", request, response, rpc_timeout, "POST");
   m_daemon_rpc_mutex.unlock();
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_address_info");
-  // TODO: Validate result
+  // servers which don't report a status only answer for valid accounts
+  THROW_WALLET_EXCEPTION_IF(!response.status.empty() && response.status != "success", error::wallet_internal_error, "get_address_info: " + response.reason);
   return true;
 }
 
@@ -9269,7 +10207,7 @@ void wallet2::light_wallet_get_address_txs()
         }
       } else {
         if (std::find(payments_txs.begin(), payments_txs.end(), tx_hash) == payments_txs.end()) {
-          m_payments.emplace(tx_hash, payment);
+          add_to_history_index(*m_payments.emplace(tx_hash, payment));
           if (0 != m_callback) {
             m_callback->on_lw_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -9317,7 +10255,7 @@ void wallet2::light_wallet_get_address_txs()
             ctd.m_payment_id = payment_id;
             ctd.m_block_height = t.height;
             ctd.m_timestamp = t.timestamp;
-            m_confirmed_txs.emplace(tx_hash,ctd);
+            add_to_history_index(*m_confirmed_txs.emplace(tx_hash,ctd).first);
           }
           if (0 != m_callback)
           {
@@ -9442,6 +10380,10 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
   hw::reset_mode rst(hwdev);
   const size_t tx_type = rta_tx_fee ? cryptonote::transaction::tx_type_rta : cryptonote::transaction::tx_type_generic;
 
+  m_tx_construction_timings = tx_construction_timings();
+  m_decoy_cache.clear_rings();
+  TIME_MEASURE_NS_START(total_time);
+
   auto original_dsts = dsts;
 
   if(m_light_wallet) {
@@ -9562,45 +10504,30 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
   // gather all dust and non-dust outputs belonging to specified subaddresses
   size_t num_nondust_outputs = 0;
   size_t num_dust_outputs = 0;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  if (m_ignore_fractional_outputs)
+    MDEBUG("Ignoring outputs below threshold " << print_money(fractional_threshold));
+  for (uint32_t index_minor : subaddr_indices)
   {
-    const transfer_details& td = m_transfers[i];
-    if (m_ignore_fractional_outputs && td.amount() < fractional_threshold)
+    const unspent_output_index::range_type outputs = m_unspent_index.range(subaddr_account, index_minor, m_ignore_fractional_outputs ? fractional_threshold : 0);
+    std::vector<size_t> transfers_indices, dust_indices;
+    for (auto it = outputs.first; it != outputs.second; ++it)
     {
-      MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is below threshold " << print_money(fractional_threshold));
-      continue;
-    }
-    if (!td.m_spent && !td.m_frozen && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
-    {
-      const uint32_t index_minor = td.m_subaddr_index.minor;
-      auto find_predicate = [&index_minor](const std::pair<uint32_t, std::vector<size_t>>& x) { return x.first == index_minor; };
-      if ((td.is_rct()) || is_valid_decomposed_amount(td.amount()))
+      const size_t i = unspent_output_index::index_of(*it);
+      const transfer_details& td = m_transfers[i];
+      if (!td.m_frozen && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td))
       {
-        auto found = std::find_if(unused_transfers_indices_per_subaddr.begin(), unused_transfers_indices_per_subaddr.end(), find_predicate);
-        if (found == unused_transfers_indices_per_subaddr.end())
-        {
-          unused_transfers_indices_per_subaddr.push_back({index_minor, {i}});
-        }
-        else
-        {
-          found->second.push_back(i);
-        }
-        ++num_nondust_outputs;
-      }
-      else
-      {
-        auto found = std::find_if(unused_dust_indices_per_subaddr.begin(), unused_dust_indices_per_subaddr.end(), find_predicate);
-        if (found == unused_dust_indices_per_subaddr.end())
-        {
-          unused_dust_indices_per_subaddr.push_back({index_minor, {i}});
-        }
+        if ((td.is_rct()) || is_valid_decomposed_amount(td.amount()))
+          transfers_indices.push_back(i);
         else
-        {
-          found->second.push_back(i);
-        }
-        ++num_dust_outputs;
+          dust_indices.push_back(i);
       }
     }
+    num_nondust_outputs += transfers_indices.size();
+    num_dust_outputs += dust_indices.size();
+    if (!transfers_indices.empty())
+      unused_transfers_indices_per_subaddr.push_back({index_minor, std::move(transfers_indices)});
+    if (!dust_indices.empty())
+      unused_dust_indices_per_subaddr.push_back({index_minor, std::move(dust_indices)});
   }
 
   // sort output indices
@@ -9975,9 +10902,211 @@ skip_tx:
 
   THROW_WALLET_EXCEPTION_IF(!sanity_check(ptx_vector, original_dsts), error::wallet_internal_error, "Created transaction(s) failed sanity check");
 
+  TIME_MEASURE_NS_FINISH(total_time);
+  m_tx_construction_timings.total = total_time / 1000;
+  log_tx_construction_timings();
+
   // if we made it this far, we're OK to actually send the transactions
   return ptx_vector;
 }
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_rta_input(size_t idx, uint32_t subaddr_account) const
+{
+  if (idx >= m_transfers.size())
+    return false;
+  const transfer_details &td = m_transfers[idx];
+  return td.m_subaddr_index.major == subaddr_account && !td.m_spent && !td.m_frozen && !td.m_key_image_partial && td.is_rct() &&
+      m_unspent_index.contains(td.m_subaddr_index.major, td.m_subaddr_index.minor, td.amount(), idx) && is_transfer_unlocked(td);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::clear_rta_inputs()
+{
+  m_rta_inputs.clear();
+  m_decoy_cache.unpin_rings();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::prepare_rta_inputs(uint32_t subaddr_account, size_t count, size_t fake_outs_count)
+{
+  THROW_WALLET_EXCEPTION_IF(m_light_wallet, error::wallet_internal_error, "Inputs can't be kept ready by a light wallet");
+  TIME_MEASURE_NS_START(prepare_time);
+
+  if (subaddr_account != m_rta_inputs_account || fake_outs_count != m_rta_inputs_fake_outs_count)
+    clear_rta_inputs();
+  m_rta_inputs_account = subaddr_account;
+  m_rta_inputs_fake_outs_count = fake_outs_count;
+
+  // the generators and multiexp caches would otherwise be built by the first proof
+  if (use_fork_rules(get_bulletproof_fork(), 0))
+    rct::bulletproof_init();
+
+  // drop the inputs spent, frozen or reorganized away since, and the ones whose ring was
+  // pinned too many blocks ago, so they are picked again with a ring from the current tip
+  const uint64_t height = get_blockchain_current_height();
+  m_decoy_cache.expire_pinned_rings(height);
+  std::vector<size_t> inputs;
+  for (size_t idx: m_rta_inputs)
+  {
+    if (is_rta_input(idx, subaddr_account) && m_decoy_cache.is_pinned(0, m_transfers[idx].m_global_output_index))
+      inputs.push_back(idx);
+    else if (idx < m_transfers.size())
+      m_decoy_cache.unpin_ring(0, m_transfers[idx].m_global_output_index);
+  }
+
+  // top up with the largest outputs, so few inputs cover a payment
+  std::vector<size_t> new_inputs;
+  if (inputs.size() < count)
+  {
+    const std::unordered_set<size_t> ready(inputs.begin(), inputs.end());
+    std::vector<size_t> candidates;
+    const unspent_output_index::range_type outputs = m_unspent_index.account_range(subaddr_account);
+    for (auto it = outputs.first; it != outputs.second; ++it)
+    {
+      const size_t idx = unspent_output_index::index_of(*it);
+      if (ready.count(idx) == 0 && is_rta_input(idx, subaddr_account))
+        candidates.push_back(idx);
+    }
+    const size_t n = std::min(count - inputs.size(), candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(),
+        [this](size_t a, size_t b) { return m_transfers[a].amount() > m_transfers[b].amount(); });
+    new_inputs.assign(candidates.begin(), candidates.begin() + n);
+  }
+
+  if (!new_inputs.empty())
+  {
+    m_decoy_cache.clear_rings();
+    std::vector<std::vector<get_outs_entry>> outs;
+    get_outs(outs, new_inputs, fake_outs_count);
+    for (size_t idx: new_inputs)
+    {
+      THROW_WALLET_EXCEPTION_IF(!m_decoy_cache.pin_ring(0, m_transfers[idx].m_global_output_index, height), error::wallet_internal_error,
+          "No ring picked for output " + std::to_string(m_transfers[idx].m_global_output_index));
+      inputs.push_back(idx);
+    }
+    m_decoy_cache.clear_rings();
+  }
+  m_rta_inputs = std::move(inputs);
+
+  TIME_MEASURE_NS_FINISH(prepare_time);
+  LOG_PRINT_L1(m_rta_inputs.size() << " inputs of account " << subaddr_account << " ready for rta transactions, " << new_inputs.size() <<
+    " new, in " << prepare_time / 1000 << " us");
+}
+//----------------------------------------------------------------------------------------------------
+std::vector<size_t> wallet2::select_rta_inputs(uint64_t needed_money, size_t fake_outs_count, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, uint64_t &found_money)
+{
+  // pick the inputs, from the ones kept ready first: when none covers what is left alone
+  // the largest is taken, else the smallest which does, to keep the change small
+  std::vector<size_t> selected_transfers;
+  found_money = 0;
+  const auto pick = [this, &selected_transfers, &found_money, needed_money](std::vector<size_t> candidates)
+  {
+    std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) { return m_transfers[a].amount() < m_transfers[b].amount(); });
+    while (found_money < needed_money && !candidates.empty())
+    {
+      auto it = std::lower_bound(candidates.begin(), candidates.end(), needed_money - found_money,
+          [this](size_t idx, uint64_t amount) { return m_transfers[idx].amount() < amount; });
+      if (it == candidates.end())
+        --it;
+      LOG_PRINT_L2("Picking output " << *it << ", amount " << print_money(m_transfers[*it].amount()));
+      selected_transfers.push_back(*it);
+      found_money += m_transfers[*it].amount();
+      candidates.erase(it);
+    }
+  };
+
+  std::unordered_set<size_t> ready;
+  if (subaddr_account == m_rta_inputs_account && fake_outs_count == m_rta_inputs_fake_outs_count)
+  {
+    for (size_t idx: m_rta_inputs)
+      if (is_rta_input(idx, subaddr_account) && (subaddr_indices.empty() || subaddr_indices.count(m_transfers[idx].m_subaddr_index.minor)))
+        ready.insert(idx);
+    pick(std::vector<size_t>(ready.begin(), ready.end()));
+  }
+  m_rta_tx_timings.ready_inputs = selected_transfers.size();
+  if (found_money < needed_money)
+  {
+    LOG_PRINT_L1("Inputs kept ready cover " << print_money(found_money) << " of " << print_money(needed_money) << ", picking other outputs");
+    std::vector<size_t> candidates;
+    const unspent_output_index::range_type outputs = m_unspent_index.account_range(subaddr_account);
+    for (auto it = outputs.first; it != outputs.second; ++it)
+    {
+      const size_t idx = unspent_output_index::index_of(*it);
+      if (ready.count(idx) == 0 && is_rta_input(idx, subaddr_account) && (subaddr_indices.empty() || subaddr_indices.count(m_transfers[idx].m_subaddr_index.minor)))
+        candidates.push_back(idx);
+    }
+    pick(std::move(candidates));
+  }
+  m_rta_tx_timings.other_inputs = selected_transfers.size() - m_rta_tx_timings.ready_inputs;
+  return selected_transfers;
+}
+//----------------------------------------------------------------------------------------------------
+wallet2::pending_tx wallet2::create_rta_transaction(const std::vector<cryptonote::tx_destination_entry> &dsts, const size_t fake_outs_count, const uint64_t unlock_time, const std::vector<uint8_t>& extra, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices)
+{
+  //ensure device is let in NONE mode in any case
+  hw::device &hwdev = m_account.get_device();
+  boost::unique_lock<hw::device> hwdev_lock (hwdev);
+  hw::reset_mode rst(hwdev);
+
+  THROW_WALLET_EXCEPTION_IF(m_light_wallet, error::wallet_internal_error, "RTA transactions can't be built by a light wallet");
+  THROW_WALLET_EXCEPTION_IF(!use_fork_rules(4, 0), error::wallet_internal_error, "RTA transactions need rct");
+
+  m_rta_tx_timings = rta_tx_timings();
+  m_tx_construction_timings = tx_construction_timings();
+  m_decoy_cache.clear_rings();
+  // the inputs kept ready whose ring got too old get a new one below
+  m_decoy_cache.expire_pinned_rings(get_blockchain_current_height());
+  TIME_MEASURE_NS_START(total_time);
+
+  // throw if attempting a transaction with no destinations
+  THROW_WALLET_EXCEPTION_IF(dsts.empty(), error::zero_destination);
+
+  // rta transactions pay a flat fee, so it is known before the inputs are picked and
+  // the transaction is built once, with the final fee
+  const uint64_t fee = RTA_TX_FEE;
+  uint64_t needed_money = fee;
+  for (const auto &dt: dsts)
+  {
+    THROW_WALLET_EXCEPTION_IF(0 == dt.amount, error::zero_destination);
+    needed_money += dt.amount;
+    THROW_WALLET_EXCEPTION_IF(needed_money < dt.amount, error::tx_sum_overflow, dsts, fee, m_nettype);
+  }
+
+  TIME_MEASURE_NS_START(selection_time);
+  uint64_t found_money = 0;
+  const std::vector<size_t> selected_transfers = select_rta_inputs(needed_money, fake_outs_count, subaddr_account, subaddr_indices, found_money);
+  TIME_MEASURE_NS_FINISH(selection_time);
+  m_rta_tx_timings.selection = selection_time / 1000;
+  THROW_WALLET_EXCEPTION_IF(found_money < needed_money, error::not_enough_unlocked_money, found_money, needed_money - fee, fee);
+
+  // rings of the inputs kept ready are pinned in the decoy cache, so only the others are requested
+  TIME_MEASURE_NS_START(rings_time);
+  std::vector<std::vector<get_outs_entry>> outs;
+  get_outs(outs, selected_transfers, fake_outs_count);
+  TIME_MEASURE_NS_FINISH(rings_time);
+  m_rta_tx_timings.rings = rings_time / 1000;
+
+  const bool bulletproof = use_fork_rules(get_bulletproof_fork(), 0);
+  const rct::RCTConfig rct_config {
+    bulletproof ? rct::RangeProofPaddedBulletproof : rct::RangeProofBorromean,
+    bulletproof ? (use_fork_rules(HF_VERSION_SMALLER_BP, -10) ? 2 : 1) : 0
+  };
+
+  hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
+  cryptonote::transaction tx;
+  pending_tx ptx;
+  TIME_MEASURE_NS_START(construction_time);
+  transfer_selected_rct(dsts, selected_transfers, fake_outs_count, outs, unlock_time, fee, extra, tx, ptx, rct_config, cryptonote::transaction::tx_type_rta);
+  TIME_MEASURE_NS_FINISH(construction_time);
+  m_rta_tx_timings.construction = construction_time / 1000;
+
+  THROW_WALLET_EXCEPTION_IF(!sanity_check(std::vector<pending_tx>(1, ptx), dsts), error::wallet_internal_error, "Created transaction(s) failed sanity check");
+
+  TIME_MEASURE_NS_FINISH(total_time);
+  m_rta_tx_timings.total = total_time / 1000;
+  const rta_tx_timings &t = m_rta_tx_timings;
+  LOG_PRINT_L1("RTA transaction " << get_transaction_hash(ptx.tx) << " built in " << t.total << " us: selection " << t.selection << " us (" <<
+    t.ready_inputs << " ready inputs, " << t.other_inputs << " others), rings " << t.rings << " us, construction " << t.construction << " us");
+  return ptx;
+}
 
 std::vector<wallet2::pending_tx> wallet2::create_transactions_graft(const string &recipient_address, const std::vector<std::string> &auth_sample, uint64_t amount,
                                                                     double fee_percent, const uint64_t unlock_time, uint32_t priority,
@@ -10105,10 +11234,12 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(uint64_t below
 
   // gather all dust and non-dust outputs of specified subaddress (if any) and below specified threshold (if any)
   bool fund_found = false;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  const unspent_output_index::range_type unspent = m_unspent_index.account_range(subaddr_account);
+  for (auto it = unspent.first; it != unspent.second; ++it)
   {
+    const size_t i = unspent_output_index::index_of(*it);
     const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && !td.m_frozen && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && (subaddr_indices.empty() || subaddr_indices.count(td.m_subaddr_index.minor) == 1))
+    if (!td.m_frozen && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && (subaddr_indices.empty() || subaddr_indices.count(td.m_subaddr_index.minor) == 1))
     {
       fund_found = true;
       if (below == 0 || td.amount() < below)
@@ -10175,6 +11306,10 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
   boost::unique_lock<hw::device> hwdev_lock (hwdev);
   hw::reset_mode rst(hwdev);  
 
+  m_tx_construction_timings = tx_construction_timings();
+  m_decoy_cache.clear_rings();
+  TIME_MEASURE_NS_START(total_time);
+
   uint64_t accumulated_fee, accumulated_outputs, accumulated_change;
   struct TX {
     std::vector<size_t> selected_transfers;
@@ -10388,10 +11523,22 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
   std::vector<cryptonote::tx_destination_entry> synthetic_dsts(1, cryptonote::tx_destination_entry("", a, address, is_subaddress));
   THROW_WALLET_EXCEPTION_IF(!sanity_check(ptx_vector, synthetic_dsts), error::wallet_internal_error, "Created transaction(s) failed sanity check");
 
+  TIME_MEASURE_NS_FINISH(total_time);
+  m_tx_construction_timings.total = total_time / 1000;
+  log_tx_construction_timings();
+
   // if we made it this far, we're OK to actually send the transactions
   return ptx_vector;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::log_tx_construction_timings() const
+{
+  const tx_construction_timings &t = m_tx_construction_timings;
+  LOG_PRINT_L1("Transactions built in " << t.total << " us: rct distribution " << t.distribution << " us, histogram " << t.histogram <<
+    " us, decoy picking " << t.picking << " us, get_outs " << t.outs << " us (" << t.get_outs_requests << " requests, " << t.rings_fetched <<
+    " rings fetched, " << t.rings_reused << " reused), construction " << t.construction << " us");
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::cold_tx_aux_import(const std::vector<pending_tx> & ptx, const std::vector<std::string> & tx_device_aux)
 {
   CHECK_AND_ASSERT_THROW_MES(ptx.size() == tx_device_aux.size(), "TX aux has invalid size");
@@ -11732,6 +12879,7 @@ uint64_t wallet2::get_approximate_blockchain_height() const
 void wallet2::set_tx_note(const crypto::hash &txid, const std::string &note)
 {
   m_tx_notes[txid] = note;
+  ++m_history_version;
 }
 
 std::string wallet2::get_tx_note(const crypto::hash &txid) const
@@ -12153,6 +13301,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       transfer_details &td = m_transfers[n + offset];
       td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
     }
+    rebuild_unspent_index();
   }
   spent = 0;
   unspent = 0;
@@ -12328,6 +13477,8 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       {
         if (j->second.m_tx_hash == *spent_txid)
         {
+          invalidate_journaled_payments(j->second.m_block_height);
+          remove_from_history_index(*j);
           m_payments.erase(j);
           break;
         }
@@ -12346,7 +13497,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       pd.m_amount_in = pd.m_amount_out = td.amount();         // fee is unknown
       pd.m_block_height = 0;  // spent block height is unknown
       const crypto::hash &spent_txid = crypto::null_hash; // spent txid is unknown
-      m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+      auto inserted = m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+      if (inserted.second)
+        add_to_history_index(*inserted.first);
     }
     PERF_TIMER_STOP(import_key_images_G);
   }
@@ -12409,10 +13562,12 @@ wallet2::payment_container wallet2::export_payments() const
 void wallet2::import_payments(const payment_container &payments)
 {
   m_payments.clear();
+  invalidate_journaled_payments(0);
   for (auto const &p : payments)
   {
     m_payments.emplace(p);
   }
+  rebuild_history_index();
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
@@ -12421,6 +13576,7 @@ void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2
   {
     m_confirmed_txs.emplace(p);
   }
+  rebuild_history_index();
 }
 
 std::tuple<size_t,crypto::hash,std::vector<crypto::hash>> wallet2::export_blockchain() const
@@ -12504,6 +13660,7 @@ size_t wallet2::import_outputs(const std::pair<size_t, std::vector<tools::wallet
 
   const size_t offset = outputs.first;
   const size_t original_size = m_transfers.size();
+  auto index_rebuilder = epee::misc_utils::create_scope_leave_handler([this]() { rebuild_history_index(); rebuild_unspent_index(); });
   m_transfers.resize(offset + outputs.second.size());
   for (size_t i = 0; i < offset; ++i)
     m_transfers[i].m_key_image_request = false;
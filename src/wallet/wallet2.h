@@ -32,6 +32,7 @@
 #pragma once
 
 #include <memory>
+#include <functional>
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -51,6 +52,7 @@
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_core/gamma_picker.h"
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/util.h"
 #include "crypto/chacha.h"
@@ -63,6 +65,9 @@
 #include "wallet_errors.h"
 #include "common/password.h"
 #include "node_rpc_proxy.h"
+#include "transfer_history_index.h"
+#include "decoy_cache.h"
+#include "unspent_output_index.h"
 #include "message_store.h"
 #include "wallet_light_rpc.h"
 
@@ -79,29 +84,7 @@ namespace tools
   class Notify;
   class GraftWallet;
 
-  class gamma_picker
-  {
-  public:
-    uint64_t pick();
-    gamma_picker(const std::vector<uint64_t> &rct_offsets);
-    gamma_picker(const std::vector<uint64_t> &rct_offsets, double shape, double scale);
-
-  private:
-    struct gamma_engine
-    {
-      typedef uint64_t result_type;
-      static constexpr result_type min() { return 0; }
-      static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
-      result_type operator()() { return crypto::rand<result_type>(); }
-    } engine;
-
-private:
-    std::gamma_distribution<double> gamma;
-    const std::vector<uint64_t> &rct_offsets;
-    const uint64_t *begin, *end;
-    uint64_t num_rct_outputs;
-    double average_output_time;
-  };
+  using cryptonote::gamma_picker;
 
   class wallet_keys_unlocker
   {
@@ -208,6 +191,7 @@ private:
     friend class ::wallet_accessor_test;
     friend class wallet_keys_unlocker;
     friend class wallet_device_callback;
+    friend class multi_wallet_scanner;
   public:
     static constexpr const std::chrono::seconds rpc_timeout = std::chrono::minutes(3) + std::chrono::seconds(30);
 
@@ -548,6 +532,31 @@ private:
 
     typedef std::tuple<uint64_t, crypto::public_key, rct::key> get_outs_entry;
 
+    // where the time went while building the last batch of transactions, in microseconds
+    struct tx_construction_timings
+    {
+      uint64_t total = 0;
+      uint64_t distribution = 0;  // rct output distribution request
+      uint64_t histogram = 0;     // output histogram and pre fork distribution requests
+      uint64_t picking = 0;       // drawing the decoys
+      uint64_t outs = 0;          // get_outs.bin requests
+      uint64_t construction = 0;  // building and signing the transactions
+      size_t get_outs_requests = 0;
+      size_t rings_fetched = 0;
+      size_t rings_reused = 0;
+    };
+
+    // where the time went while building the last rta transaction, in microseconds
+    struct rta_tx_timings
+    {
+      uint64_t total = 0;
+      uint64_t selection = 0;     // picking the inputs
+      uint64_t rings = 0;         // rings of the inputs which were not kept ready
+      uint64_t construction = 0;  // building, proving and signing the transaction
+      size_t ready_inputs = 0;
+      size_t other_inputs = 0;
+    };
+
     struct parsed_block
     {
       crypto::hash hash;
@@ -806,6 +815,9 @@ private:
 
     void set_refresh_type(RefreshType refresh_type) { m_refresh_type = refresh_type; }
     RefreshType get_refresh_type() const { return m_refresh_type; }
+    void set_refresh_pipeline_depth(size_t depth) { m_refresh_pipeline_depth = std::max<size_t>(depth, 1); }
+    size_t get_refresh_pipeline_depth() const { return m_refresh_pipeline_depth; }
+    const tx_construction_timings &get_last_tx_construction_timings() const { return m_tx_construction_timings; }
 
     cryptonote::network_type nettype() const { return m_nettype; }
     bool watch_only() const { return m_watch_only; }
@@ -829,6 +841,8 @@ private:
     // locked & unlocked balance per subaddress of given or current subaddress account
     std::map<uint32_t, uint64_t> balance_per_subaddress(uint32_t subaddr_index_major) const;
     std::map<uint32_t, std::pair<uint64_t, uint64_t>> unlocked_balance_per_subaddress(uint32_t subaddr_index_major) const;
+    // number of unspent outputs, frozen or not, per subaddress of given subaddress account
+    std::map<uint32_t, uint64_t> num_unspent_outputs_per_subaddress(uint32_t subaddr_index_major) const;
     // all locked & unlocked balances of all subaddress accounts
     uint64_t balance_all() const;
     uint64_t unlocked_balance_all(uint64_t *blocks_to_unlock = NULL) const;
@@ -868,6 +882,31 @@ private:
     std::vector<wallet2::pending_tx> create_transactions_2(std::vector<cryptonote::tx_destination_entry> dsts, const size_t fake_outs_count, const uint64_t unlock_time, uint32_t priority, const std::vector<uint8_t>& extra, uint32_t subaddr_account, std::set<uint32_t> subaddr_indices,     // pass subaddr_indices by value on purpose
        bool rta_tx_fee = false);
 
+    /*!
+     * \brief Keeps inputs of an account ready for create_rta_transaction
+     * \param subaddr_account  account the inputs are picked from
+     * \param count            number of inputs to keep ready
+     * \param fake_outs_count  mixin the rings of the inputs are picked for
+     *
+     * Picks the largest unlocked outputs of the account and fetches their rings, which are kept
+     * until the outputs are spent, the chain reorganizes or grows by more than a few blocks.
+     * Inputs already ready are kept, so calling it again after a transaction only fetches the
+     * rings of the new inputs and of the ones whose ring got too old.
+     */
+    void prepare_rta_inputs(uint32_t subaddr_account, size_t count, size_t fake_outs_count);
+    void clear_rta_inputs();
+    size_t rta_inputs_count() const { return m_rta_inputs.size(); }
+    /*!
+     * \brief Builds one rta transaction in a single pass
+     *
+     * Inputs are taken from the ones kept ready by prepare_rta_inputs first, so no ring has to be
+     * requested from the daemon, and the fee is known before the transaction is built, so it
+     * is only built once, unlike create_transactions_2 which rebuilds it until the fee settles.
+     * Falls back to other unlocked outputs of the account if the ready ones do not cover the amount.
+     */
+    pending_tx create_rta_transaction(const std::vector<cryptonote::tx_destination_entry> &dsts, const size_t fake_outs_count, const uint64_t unlock_time, const std::vector<uint8_t>& extra, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices);
+    const rta_tx_timings &get_last_rta_tx_timings() const { return m_rta_tx_timings; }
+
     /*!
      * \brief create_transactions_graft - creates graft transaction
      * \param recepient_address - address who receive the coins
@@ -905,6 +944,23 @@ private:
     void get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
     void get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
       uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
+    /*!
+     * \brief Paged queries over the history indices, in history order: at most limit (0 for all) entries after the given position
+     * \return the position to pass as after for the next page, or none if this was the last one
+     */
+    boost::optional<transfer_history_key> get_payments_paged(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height,
+      const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, const boost::optional<transfer_history_key> &after, size_t limit) const;
+    boost::optional<transfer_history_key> get_payments_out_paged(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments, uint64_t min_height, uint64_t max_height,
+      const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, const boost::optional<transfer_history_key> &after, size_t limit) const;
+    boost::optional<transfer_history_key> get_transfers_paged(std::vector<size_t>& transfers, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices,
+      const std::function<bool(const transfer_details&)> &filter, const boost::optional<transfer_history_key> &after, size_t limit) const;
+    void get_payments_by_txid(const crypto::hash &txid, std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments) const;
+    // position of an entry in the history, as used by the paged queries
+    static transfer_history_key get_history_key(const payment_details &pd);
+    static transfer_history_key get_history_key(const crypto::hash &txid, const confirmed_transfer_details &ctd);
+    // changes whenever the incoming or outgoing history, or a tx note, changes
+    uint64_t get_history_version() const { return m_history_version; }
+    void get_payments_out_by_txid(const crypto::hash &txid, std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments) const;
     void get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
     void get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2::pool_payment_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
 
@@ -1376,6 +1432,109 @@ private:
     void set_offline(bool offline = true);
 
   private:
+    /*!
+     * \brief One store's worth of changes to the cache, appended to the cache journal.
+     *        The hashchain, transfers, payments, confirmed txes, tx keys, tx notes,
+     *        subaddresses and the address book are recorded as deltas, the rest of the
+     *        wallet state is recorded whole.
+     */
+    struct cache_journal_record
+    {
+      uint64_t snapshot_id; // iv of the cache file the record applies on top of
+      uint64_t hashchain_offset;
+      uint64_t hashchain_start;
+      std::vector<crypto::hash> hashchain_tail;
+      uint64_t transfers_size;
+      std::vector<uint64_t> transfer_indices;
+      std::vector<transfer_details> transfers;
+      std::vector<uint64_t> key_image_indices; // transfers which have their key image in m_key_images
+      uint64_t payments_height; // payments at and above this height are replaced
+      std::vector<std::pair<crypto::hash, payment_details>> payments;
+      std::vector<std::pair<crypto::hash, confirmed_transfer_details>> confirmed_txs;
+      std::vector<crypto::hash> removed_confirmed_txs;
+      std::vector<std::pair<crypto::hash, crypto::secret_key>> tx_keys;
+      std::vector<crypto::hash> removed_tx_keys;
+      std::vector<std::pair<crypto::hash, std::vector<crypto::secret_key>>> additional_tx_keys;
+      std::vector<crypto::hash> removed_additional_tx_keys;
+      std::vector<std::pair<crypto::hash, std::string>> tx_notes;
+      std::vector<crypto::hash> removed_tx_notes;
+      uint64_t subaddresses_start; // subaddresses are only ever added, in order
+      std::vector<std::pair<crypto::public_key, cryptonote::subaddress_index>> subaddresses;
+      uint64_t address_book_size;
+      std::vector<uint64_t> address_book_indices;
+      std::vector<address_book_row> address_book;
+      std::string state; // the wallet archive, without the containers above
+
+      template <class t_archive>
+      inline void serialize(t_archive &a, const unsigned int ver)
+      {
+        a & snapshot_id;
+        a & hashchain_offset;
+        a & hashchain_start;
+        a & hashchain_tail;
+        a & transfers_size;
+        a & transfer_indices;
+        a & transfers;
+        a & key_image_indices;
+        a & payments_height;
+        a & payments;
+        a & confirmed_txs;
+        a & removed_confirmed_txs;
+        a & tx_keys;
+        a & removed_tx_keys;
+        a & additional_tx_keys;
+        a & removed_additional_tx_keys;
+        a & tx_notes;
+        a & removed_tx_notes;
+        a & subaddresses_start;
+        a & subaddresses;
+        a & address_book_size;
+        a & address_book_indices;
+        a & address_book;
+        a & state;
+      }
+    };
+
+    struct cache_journal_containers
+    {
+      hashchain blockchain;
+      transfer_container transfers;
+      payment_container payments;
+      std::unordered_map<crypto::key_image, size_t> key_images;
+      std::unordered_map<crypto::public_key, size_t> pub_keys;
+      std::unordered_map<crypto::hash, confirmed_transfer_details> confirmed_txs;
+      std::unordered_map<crypto::hash, crypto::secret_key> tx_keys;
+      std::unordered_map<crypto::hash, std::vector<crypto::secret_key>> additional_tx_keys;
+      std::unordered_map<crypto::hash, std::string> tx_notes;
+      cryptonote::subaddress_map subaddresses;
+      std::vector<address_book_row> address_book;
+    };
+
+    /*!
+     * \brief What the cache file and its journal on disk hold, to find what changed since
+     */
+    struct cache_journal_state
+    {
+      uint64_t snapshot_id;
+      uint64_t snapshot_size;
+      uint64_t journal_size;
+      bool compact; // next store rewrites the cache file and drops the journal
+      uint64_t hashchain_size;
+      uint64_t hashchain_offset;
+      crypto::hash hashchain_top;
+      std::vector<uint64_t> transfers; // fingerprints
+      std::unordered_map<crypto::hash, uint64_t> confirmed_txs; // fingerprints
+      uint64_t payments_height;
+      std::unordered_map<crypto::hash, uint64_t> tx_keys; // fingerprints
+      std::unordered_map<crypto::hash, uint64_t> additional_tx_keys; // fingerprints
+      std::unordered_map<crypto::hash, uint64_t> tx_notes; // fingerprints
+      uint64_t subaddresses_size;
+      crypto::public_key subaddresses_top; // tells a rebuilt table from a grown one
+      std::vector<uint64_t> address_book; // fingerprints
+
+      cache_journal_state(): snapshot_id(0), snapshot_size(0), journal_size(0), compact(true), hashchain_size(0), hashchain_offset(0), hashchain_top(crypto::null_hash), payments_height(std::numeric_limits<uint64_t>::max()), subaddresses_size(0), subaddresses_top(crypto::null_pkey) {}
+    };
+
     /*!
      * \brief  Stores wallet information to wallet file.
      * \param  keys_file_name Name of wallet file
@@ -1418,7 +1577,8 @@ private:
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
     void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &error);
-    void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    void prepare_tx_cache_data(uint64_t start_height, const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data, const crypto::secret_key &view_secret_key) const;
+    void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL, std::vector<tx_cache_data> *precomputed_tx_cache_data = NULL);
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::vector<size_t>& selected_transfers) const;
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height);
@@ -1451,6 +1611,24 @@ private:
 
     void scan_output(const cryptonote::transaction &tx, bool miner_tx, const crypto::public_key &tx_pub_key, size_t i, tx_scan_info_t &tx_scan_info, int &num_vouts_received, std::unordered_map<cryptonote::subaddress_index, uint64_t> &tx_money_got_in_outs, std::vector<size_t> &outs, bool pool);
     void trim_hashchain();
+    crypto::chacha_iv store_cache_snapshot(const std::string &filename);
+    bool append_cache_journal();
+    void load_cache_journal();
+    void apply_cache_journal_record(cache_journal_record &record);
+    void track_cache_journal(uint64_t snapshot_id, uint64_t journal_size);
+    uint64_t get_transfer_fingerprint(size_t idx) const;
+    void swap_cache_journal_containers(cache_journal_containers &containers);
+    void add_to_history_index(const payment_container::value_type &payment);
+    void remove_from_history_index(const payment_container::value_type &payment);
+    void add_to_history_index(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd);
+    void remove_from_history_index(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd);
+    void add_to_history_index(size_t transfer_idx);
+    void remove_from_history_index(size_t transfer_idx);
+    void rebuild_history_index();
+    void add_to_unspent_index(size_t transfer_idx);
+    void remove_from_unspent_index(size_t transfer_idx);
+    void rebuild_unspent_index();
+    void invalidate_journaled_payments(uint64_t height) { m_cache_journal.payments_height = std::min(m_cache_journal.payments_height, height); }
     crypto::key_image get_multisig_composite_key_image(size_t n) const;
     rct::multisig_kLRki get_multisig_composite_kLRki(size_t n,  const std::unordered_set<crypto::public_key> &ignore_set, std::unordered_set<rct::key> &used_L, std::unordered_set<rct::key> &new_used_L) const;
     rct::multisig_kLRki get_multisig_kLRki(size_t n, const rct::key &k) const;
@@ -1468,6 +1646,9 @@ private:
     hw::device& lookup_device(const std::string & device_descriptor);
 
     bool get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution);
+    void log_tx_construction_timings() const;
+    bool is_rta_input(size_t idx, uint32_t subaddr_account) const;
+    std::vector<size_t> select_rta_inputs(uint64_t needed_money, size_t fake_outs_count, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, uint64_t &found_money);
 
     uint64_t get_segregation_fork_height() const;
     void unpack_multisig_info(const std::vector<std::string>& info,
@@ -1513,8 +1694,15 @@ private:
     payment_container m_payments;
     std::unordered_map<crypto::key_image, size_t> m_key_images;
     std::unordered_map<crypto::public_key, size_t> m_pub_keys;
+    // secondary indices over the history, kept in sync with the containers above
+    transfer_history_index<const payment_container::value_type*> m_payments_index;
+    transfer_history_index<const std::pair<const crypto::hash, confirmed_transfer_details>*> m_confirmed_txs_index;
+    transfer_history_index<size_t> m_transfers_index;
+    // unspent entries of m_transfers by subaddress and amount, for input selection
+    unspent_output_index m_unspent_index;
+    uint64_t m_history_version;
     cryptonote::account_public_address m_account_public_address;
-    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+    cryptonote::subaddress_map m_subaddresses;
     std::vector<std::vector<std::string>> m_subaddress_labels;
     std::unordered_map<crypto::hash, std::string> m_tx_notes;
     std::unordered_map<std::string, std::string> m_attributes;
@@ -1549,6 +1737,15 @@ private:
     uint32_t m_default_mixin;
     uint32_t m_default_priority;
     RefreshType m_refresh_type;
+    size_t m_refresh_pipeline_depth;
+    decoy_cache m_decoy_cache;
+    tx_construction_timings m_tx_construction_timings;
+    std::vector<size_t> m_rta_inputs;
+    uint32_t m_rta_inputs_account;
+    size_t m_rta_inputs_fake_outs_count;
+    rta_tx_timings m_rta_tx_timings;
+    // replaces the daemon round trip in pull_blocks, only set by tests
+    std::function<void(uint64_t, uint64_t&, const std::list<crypto::hash>&, std::vector<cryptonote::block_complete_entry>&, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>&)> m_pull_blocks_override;
     bool m_auto_refresh;
     bool m_first_refresh_done;
     uint64_t m_refresh_from_block_height;
@@ -1612,6 +1809,7 @@ private:
     crypto::secret_key m_original_view_secret_key;
 
     crypto::chacha_key m_cache_key;
+    cache_journal_state m_cache_journal;
     boost::optional<epee::wipeable_string> m_encrypt_keys_after_refresh;
 
     bool m_unattended;
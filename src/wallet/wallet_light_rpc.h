@@ -164,6 +164,8 @@ namespace tools
         uint64_t transaction_height;
         uint64_t blockchain_height;
         std::list<spent_output> spent_outputs;
+        std::string status;
+        std::string reason;
         BEGIN_KV_SERIALIZE_MAP()
           KV_SERIALIZE(locked_funds)
           KV_SERIALIZE(total_received)
@@ -174,6 +176,8 @@ namespace tools
           KV_SERIALIZE(transaction_height)
           KV_SERIALIZE(blockchain_height)
           KV_SERIALIZE(spent_outputs)
+          KV_SERIALIZE(status)
+          KV_SERIALIZE(reason)
         END_KV_SERIALIZE_MAP()
       };
       typedef epee::misc_utils::struct_init<response_t> response;
@@ -46,6 +46,7 @@ using namespace epee;
 #include "multisig/multisig.h"
 #include "wallet_rpc_server_commands_defs.h"
 #include "misc_language.h"
+#include "misc_os_dependent.h"
 #include "string_coding.h"
 #include "string_tools.h"
 #include "crypto/hash.h"
@@ -61,6 +62,8 @@ using namespace epee;
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.rpc"
 
 #define DEFAULT_AUTO_REFRESH_PERIOD 20 // seconds
+#define DEFAULT_RPC_THREADS 4
+#define DEFAULT_RTA_READY_INPUTS 4
 
 namespace
 {
@@ -68,7 +71,10 @@ namespace
   const command_line::arg_descriptor<bool> arg_disable_rpc_login = {"disable-rpc-login", "Disable HTTP authentication for RPC connections served by this process"};
   const command_line::arg_descriptor<bool> arg_restricted = {"restricted-rpc", "Restricts to view-only commands", false};
   const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
+  const command_line::arg_descriptor<bool> arg_multi_wallet = {"multi-wallet", "Keep the wallets of --wallet-dir open once opened, and refresh all of them in a single pass over the blocks", false};
   const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
+  const command_line::arg_descriptor<uint32_t> arg_rpc_threads = {"rpc-threads", "Number of threads serving RPC requests: calls using the wallet are served one at a time, but read only calls answered from the published wallet snapshot do not wait for them", DEFAULT_RPC_THREADS};
+  const command_line::arg_descriptor<uint32_t> arg_rta_ready_inputs = {"rta-ready-inputs", "Number of inputs kept ready, with their rings, for transfer_rta, so building the transaction does not wait on the daemon (0 to disable)", DEFAULT_RTA_READY_INPUTS};
 
   constexpr const char default_rpc_username[] = "graft";
 
@@ -184,13 +190,18 @@ namespace tools
   }
 
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL)
+  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), m_multi_wallet(false), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL), m_rpc_threads(1), m_rta_ready_inputs(0), m_rta_account(0), m_rta_ring_size(0), m_rta_inputs_stale(false)
   {
   }
   //------------------------------------------------------------------------------------------------------------------------------
   wallet_rpc_server::~wallet_rpc_server()
   {
-    if (m_wallet)
+    if (m_multi_wallet)
+    {
+      for (const auto &e: m_open_wallets)
+        delete e.second;
+    }
+    else if (m_wallet)
       delete m_wallet;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -199,20 +210,198 @@ namespace tools
     m_wallet = cr;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::set_current_wallet(wallet2 *wal)
+  {
+    if (m_multi_wallet)
+    {
+      // the previous wallet stays open, and is refreshed along with the others
+      auto i = m_open_wallets.find(wal->get_wallet_file());
+      if (i != m_open_wallets.end())
+      {
+        m_scanner.remove_wallet(i->second);
+        delete i->second;
+      }
+      m_open_wallets[wal->get_wallet_file()] = wal;
+      m_scanner.add_wallet(wal);
+    }
+    else if (m_wallet)
+      delete m_wallet;
+    m_wallet = wal;
+    reset_snapshot();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::close_current_wallet()
+  {
+    if (m_multi_wallet)
+    {
+      m_scanner.remove_wallet(m_wallet);
+      m_open_wallets.erase(m_wallet->get_wallet_file());
+    }
+    delete m_wallet;
+    m_wallet = NULL;
+    reset_snapshot();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  wallet_rpc_server::wallet_call_scope::wallet_call_scope(wallet_rpc_server &server, const char *method, access_type access):
+    m_server(server), m_method(method), m_access(access), m_start(epee::misc_utils::get_ns_count())
+  {
+    if (m_access != snapshot)
+      m_lock = boost::unique_lock<boost::mutex>(m_server.m_wallet_mutex);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  wallet_rpc_server::wallet_call_scope::~wallet_call_scope()
+  {
+    if (m_access == write)
+    {
+      try { m_server.publish_snapshot(); }
+      catch (const std::exception &e) { MERROR("Failed to publish wallet snapshot after " << m_method << ": " << e.what()); }
+    }
+    if (m_lock.owns_lock())
+      m_lock.unlock();
+    m_server.m_latency_stats.add(m_method, (epee::misc_utils::get_ns_count() - m_start) / 1000);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<const wallet_snapshot> wallet_rpc_server::get_snapshot() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_snapshot_mutex);
+    return m_snapshot;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::prepare_rta_inputs()
+  {
+    m_rta_inputs_stale = false;
+    if (!m_wallet || m_rta_ready_inputs == 0 || m_wallet->light_wallet() || m_wallet->watch_only() || m_wallet->multisig())
+      return;
+    try
+    {
+      const uint64_t mixin = m_wallet->adjust_mixin(m_rta_ring_size ? m_rta_ring_size - 1 : 0);
+      m_wallet->prepare_rta_inputs(m_rta_account, m_rta_ready_inputs, mixin);
+    }
+    catch (const std::exception &e)
+    {
+      MWARNING("Failed to keep inputs ready for transfer_rta: " << e.what());
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::reset_snapshot()
+  {
+    // the snapshot is of the previous wallet, the read only calls wait for the next one
+    boost::lock_guard<boost::mutex> lock(m_snapshot_mutex);
+    m_snapshot.reset();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::publish_snapshot()
+  {
+    std::shared_ptr<wallet_snapshot> snapshot;
+    if (m_wallet)
+    {
+      const std::shared_ptr<const wallet_snapshot> previous = get_snapshot();
+      snapshot = std::make_shared<wallet_snapshot>();
+      snapshot->height = m_wallet->get_blockchain_current_height();
+      snapshot->last_block_reward = m_wallet->get_last_block_reward();
+      snapshot->multisig_import_needed = m_wallet->multisig() && m_wallet->has_multisig_partial_key_images();
+      snapshot->accounts.resize(m_wallet->get_num_subaddress_accounts());
+      for (uint32_t account_index = 0; account_index < snapshot->accounts.size(); ++account_index)
+      {
+        wallet_snapshot::account_balance &account = snapshot->accounts[account_index];
+        account.balance = m_wallet->balance(account_index);
+        account.unlocked_balance = m_wallet->unlocked_balance(account_index, &account.blocks_to_unlock);
+        const std::map<uint32_t, uint64_t> balance_per_subaddress = m_wallet->balance_per_subaddress(account_index);
+        std::map<uint32_t, std::pair<uint64_t, uint64_t>> unlocked_balance_per_subaddress = m_wallet->unlocked_balance_per_subaddress(account_index);
+        std::map<uint32_t, uint64_t> num_unspent_outputs = m_wallet->num_unspent_outputs_per_subaddress(account_index);
+        for (const auto &i: balance_per_subaddress)
+        {
+          wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info info;
+          info.account_index = account_index;
+          info.address_index = i.first;
+          cryptonote::subaddress_index index = {info.account_index, info.address_index};
+          info.address = m_wallet->get_subaddress_as_str(index);
+          info.balance = i.second;
+          info.unlocked_balance = unlocked_balance_per_subaddress[i.first].first;
+          info.blocks_to_unlock = unlocked_balance_per_subaddress[i.first].second;
+          info.label = m_wallet->get_subaddress_label(index);
+          info.num_unspent_outputs = num_unspent_outputs[i.first];
+          account.per_subaddress.emplace_back(std::move(info));
+        }
+      }
+      snapshot->transfers = make_snapshot_history(previous ? previous->transfers : nullptr);
+
+      std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments;
+      m_wallet->get_unconfirmed_payments_out(upayments, boost::none, {});
+      for (const auto &i: upayments)
+      {
+        snapshot->unconfirmed.push_back(wallet_snapshot::unconfirmed_entry());
+        wallet_snapshot::unconfirmed_entry &e = snapshot->unconfirmed.back();
+        e.account = i.second.m_subaddr_account;
+        e.subaddr_indices = i.second.m_subaddr_indices;
+        e.failed = i.second.m_state == tools::wallet2::unconfirmed_transfer_details::failed;
+        fill_transfer_entry(e.entry, i.first, i.second);
+      }
+      snapshot->published = time(NULL);
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_snapshot_mutex);
+    m_snapshot = snapshot;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<const wallet_snapshot::history> wallet_rpc_server::make_snapshot_history(const std::shared_ptr<const wallet_snapshot::history> &previous)
+  {
+    // the history is the bulk of the snapshot, and most calls do not change it
+    const uint64_t version = m_wallet->get_history_version();
+    if (previous && previous->is_current(*m_wallet))
+      return previous;
+
+    std::shared_ptr<wallet_snapshot::history> history = std::make_shared<wallet_snapshot::history>();
+    history->wallet = m_wallet;
+    history->version = version;
+
+    std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
+    m_wallet->get_payments_paged(payments, 0, CRYPTONOTE_MAX_BLOCK_NUMBER, boost::none, {}, boost::none, 0);
+    history->in.reserve(payments.size());
+    for (const auto &i: payments)
+    {
+      history->in.push_back(wallet_rpc::transfer_entry());
+      fill_transfer_entry(history->in.back(), i.second.m_tx_hash, i.first, i.second);
+      history->in_index.insert(wallet2::get_history_key(i.second), history->in.size() - 1, i.second.m_subaddr_index.major, {i.second.m_subaddr_index.minor});
+    }
+
+    std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments_out;
+    m_wallet->get_payments_out_paged(payments_out, 0, CRYPTONOTE_MAX_BLOCK_NUMBER, boost::none, {}, boost::none, 0);
+    history->out.reserve(payments_out.size());
+    for (const auto &i: payments_out)
+    {
+      history->out.push_back(wallet_rpc::transfer_entry());
+      fill_transfer_entry(history->out.back(), i.first, i.second);
+      history->out_index.insert(wallet2::get_history_key(i.first, i.second), history->out.size() - 1, i.second.m_subaddr_account, i.second.m_subaddr_indices);
+    }
+    return history;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::run()
   {
     m_stop = false;
+    publish_snapshot();
     m_net_server.add_idle_handler([this](){
-      if (m_auto_refresh_period == 0) // disabled
-        return true;
-      if (boost::posix_time::microsec_clock::universal_time() < m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period))
+      // skip this round rather than hold a server thread while a call uses the wallet
+      boost::unique_lock<boost::mutex> lock(m_wallet_mutex, boost::try_to_lock);
+      if (!lock.owns_lock())
         return true;
-      try {
-        if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
-      } catch (const std::exception& ex) {
-        LOG_ERROR("Exception at while refreshing, what=" << ex.what());
+      if (m_auto_refresh_period != 0 && // 0 disables it
+          boost::posix_time::microsec_clock::universal_time() >= m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period))
+      {
+        try {
+          if (m_multi_wallet) m_scanner.refresh();
+          else if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
+        } catch (const std::exception& ex) {
+          LOG_ERROR("Exception at while refreshing, what=" << ex.what());
+        }
+        m_last_auto_refresh_time = boost::posix_time::microsec_clock::universal_time();
+        m_rta_inputs_stale = true;
+        publish_snapshot();
       }
-      m_last_auto_refresh_time = boost::posix_time::microsec_clock::universal_time();
+      // outside of transfer_rta, so it does not wait for the rings of its inputs
+      if (m_rta_inputs_stale)
+        prepare_rta_inputs();
       return true;
     }, 1000);
     m_net_server.add_idle_handler([this](){
@@ -224,18 +413,30 @@ namespace tools
       return true;
     }, 500);
 
-    //DO NOT START THIS SERVER IN MORE THEN 1 THREADS WITHOUT REFACTORING
-    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(1, true);
+    // the calls using the wallet are serialized by wallet_call_scope
+    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(m_rpc_threads, true);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::stop()
   {
-    if (m_wallet)
+    m_scanner.stop();
+    if (m_multi_wallet)
+    {
+      for (const auto &e: m_open_wallets)
+      {
+        e.second->store();
+        delete e.second;
+      }
+      m_open_wallets.clear();
+      m_wallet = NULL;
+    }
+    else if (m_wallet)
     {
       m_wallet->store();
       delete m_wallet;
       m_wallet = NULL;
     }
+    publish_snapshot();
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::init(const boost::program_options::variables_map *vm)
@@ -250,6 +451,14 @@ namespace tools
     std::string bind_port = command_line::get_arg(*m_vm, arg_rpc_bind_port);
     const bool disable_auth = command_line::get_arg(*m_vm, arg_disable_rpc_login);
     m_restricted = command_line::get_arg(*m_vm, arg_restricted);
+    m_multi_wallet = command_line::get_arg(*m_vm, arg_multi_wallet);
+    m_rpc_threads = std::max<uint32_t>(command_line::get_arg(*m_vm, arg_rpc_threads), 1);
+    m_rta_ready_inputs = command_line::get_arg(*m_vm, arg_rta_ready_inputs);
+    if (m_multi_wallet && command_line::is_arg_defaulted(*m_vm, arg_wallet_dir))
+    {
+      MERROR(arg_multi_wallet.name << " needs " << arg_wallet_dir.name);
+      return false;
+    }
     if (!command_line::is_arg_defaulted(*m_vm, arg_wallet_dir))
     {
       if (!command_line::is_arg_defaulted(*m_vm, wallet_args::arg_wallet_file()))
@@ -496,6 +705,53 @@ namespace tools
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getbalance(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    const std::shared_ptr<const wallet_snapshot> snapshot = get_snapshot();
+    if (!snapshot) return not_open(er);
+
+    // the snapshot only has the subaddresses with a balance entry, the others are asked to the wallet
+    bool cached = req.all_accounts || req.account_index < snapshot->accounts.size();
+    if (cached && !req.all_accounts)
+    {
+      const std::vector<wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info> &per_subaddress = snapshot->accounts[req.account_index].per_subaddress;
+      for (uint32_t i: req.address_indices)
+      {
+        auto it = std::lower_bound(per_subaddress.begin(), per_subaddress.end(), i, [](const wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info &info, uint32_t index) { return info.address_index < index; });
+        if (it == per_subaddress.end() || it->address_index != i)
+        {
+          cached = false;
+          break;
+        }
+      }
+    }
+    if (!cached)
+    {
+      boost::lock_guard<boost::mutex> lock(m_wallet_mutex);
+      return get_balance_from_wallet(req, res, er);
+    }
+
+    res.balance = 0;
+    res.unlocked_balance = 0;
+    res.blocks_to_unlock = 0;
+    res.multisig_import_needed = snapshot->multisig_import_needed;
+    for (uint32_t account_index = 0; account_index < snapshot->accounts.size(); ++account_index)
+    {
+      if (!req.all_accounts && account_index != req.account_index)
+        continue;
+      const wallet_snapshot::account_balance &account = snapshot->accounts[account_index];
+      res.balance += account.balance;
+      res.unlocked_balance += account.unlocked_balance;
+      res.blocks_to_unlock = std::max(res.blocks_to_unlock, account.blocks_to_unlock);
+      for (const auto &info: account.per_subaddress)
+      {
+        if (req.all_accounts || req.address_indices.empty() || req.address_indices.count(info.address_index))
+          res.per_subaddress.push_back(info);
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::get_balance_from_wallet(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er)
   {
     if (!m_wallet) return not_open(er);
     try
@@ -518,13 +774,12 @@ namespace tools
         balance_per_subaddress_per_account[req.account_index] = m_wallet->balance_per_subaddress(req.account_index);
         unlocked_balance_per_subaddress_per_account[req.account_index] = m_wallet->unlocked_balance_per_subaddress(req.account_index);
       }
-      std::vector<tools::wallet2::transfer_details> transfers;
-      m_wallet->get_transfers(transfers);
       for (const auto& p : balance_per_subaddress_per_account)
       {
         uint32_t account_index = p.first;
         std::map<uint32_t, uint64_t> balance_per_subaddress = p.second;
         std::map<uint32_t, std::pair<uint64_t, uint64_t>> unlocked_balance_per_subaddress = unlocked_balance_per_subaddress_per_account[account_index];
+        std::map<uint32_t, uint64_t> num_unspent_outputs = m_wallet->num_unspent_outputs_per_subaddress(account_index);
         std::set<uint32_t> address_indices;
         if (!req.all_accounts && !req.address_indices.empty())
         {
@@ -546,7 +801,7 @@ namespace tools
           info.unlocked_balance = unlocked_balance_per_subaddress[i].first;
           info.blocks_to_unlock = unlocked_balance_per_subaddress[i].second;
           info.label = m_wallet->get_subaddress_label(index);
-          info.num_unspent_outputs = std::count_if(transfers.begin(), transfers.end(), [&](const tools::wallet2::transfer_details& td) { return !td.m_spent && td.m_subaddr_index == index; });
+          info.num_unspent_outputs = num_unspent_outputs[i];
           res.per_subaddress.emplace_back(std::move(info));
         }
       }
@@ -789,16 +1044,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getheight(const wallet_rpc::COMMAND_RPC_GET_HEIGHT::request& req, wallet_rpc::COMMAND_RPC_GET_HEIGHT::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
-    if (!m_wallet) return not_open(er);
-    try
-    {
-      res.height = m_wallet->get_blockchain_current_height();
-    }
-    catch (const std::exception& e)
-    {
-      handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
-      return false;
-    }
+    const std::shared_ptr<const wallet_snapshot> snapshot = get_snapshot();
+    if (!snapshot) return not_open(er);
+    res.height = snapshot->height;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -1127,7 +1375,16 @@ namespace tools
     {
       const bool rta_tx_fee = true;
       uint64_t mixin = m_wallet->adjust_mixin(req.ring_size ? req.ring_size - 1 : 0);
-      std::vector<wallet2::pending_tx> ptx_vector = m_wallet->create_transactions_2(dsts, mixin, req.unlock_time, req.priority, extra, req.account_index, req.subaddr_indices, rta_tx_fee);
+      std::vector<wallet2::pending_tx> ptx_vector;
+      if (m_wallet->light_wallet())
+        ptx_vector = m_wallet->create_transactions_2(dsts, mixin, req.unlock_time, req.priority, extra, req.account_index, req.subaddr_indices, rta_tx_fee);
+      else
+        ptx_vector.push_back(m_wallet->create_rta_transaction(dsts, mixin, req.unlock_time, extra, req.account_index, req.subaddr_indices));
+
+      // the inputs kept ready are picked for the account and ring size last used, and topped up once this call is done
+      m_rta_account = req.account_index;
+      m_rta_ring_size = req.ring_size;
+      m_rta_inputs_stale = true;
 
       // reject proposed transactions if there are more than one.  see on_transfer_split below.
       if (ptx_vector.size() != 1)
@@ -1167,6 +1424,17 @@ namespace tools
                                                       sizeof(crypto::secret_key)),
                                          rta_header.keys, encrypted_key_blob);
       res.encrypted_tx_key = epee::string_tools::buff_to_hex_nodelimer(encrypted_key_blob);
+
+      if (!m_wallet->light_wallet())
+      {
+        const wallet2::rta_tx_timings &timings = m_wallet->get_last_rta_tx_timings();
+        res.timings.total = timings.total;
+        res.timings.selection = timings.selection;
+        res.timings.rings = timings.rings;
+        res.timings.construction = timings.construction;
+        res.timings.ready_inputs = timings.ready_inputs;
+        res.timings.other_inputs = timings.other_inputs;
+      }
     }
     catch (const tools::error::daemon_busy& e)
     {
@@ -2036,31 +2304,40 @@ namespace tools
       available = false;
     }
 
-    wallet2::transfer_container transfers;
-    m_wallet->get_transfers(transfers);
-
-    bool transfers_found = false;
-    for (const auto& td : transfers)
+    boost::optional<transfer_history_key> cursor;
+    if (!req.cursor.empty())
     {
-      if (!filter || available != td.m_spent)
+      cursor = transfer_history_key();
+      if (!transfer_history_key::from_string(req.cursor, *cursor))
       {
-        if (req.account_index != td.m_subaddr_index.major || (!req.subaddr_indices.empty() && req.subaddr_indices.count(td.m_subaddr_index.minor) == 0))
-          continue;
-        transfers_found = true;
-        wallet_rpc::transfer_details rpc_transfers;
-        rpc_transfers.amount       = td.amount();
-        rpc_transfers.spent        = td.m_spent;
-        rpc_transfers.global_index = td.m_global_output_index;
-        rpc_transfers.tx_hash      = epee::string_tools::pod_to_hex(td.m_txid);
-        rpc_transfers.subaddr_index = {td.m_subaddr_index.major, td.m_subaddr_index.minor};
-        rpc_transfers.key_image    = td.m_key_image_known ? epee::string_tools::pod_to_hex(td.m_key_image) : "";
-        rpc_transfers.block_height = td.m_block_height;
-        rpc_transfers.frozen       = td.m_frozen;
-        rpc_transfers.unlocked     = m_wallet->is_transfer_unlocked(td);
-        res.transfers.push_back(rpc_transfers);
+        er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+        er.message = "Invalid cursor: " + req.cursor;
+        return false;
       }
     }
 
+    std::vector<size_t> transfers;
+    const boost::optional<transfer_history_key> next = m_wallet->get_transfers_paged(transfers, req.account_index, req.subaddr_indices,
+        [filter, available](const wallet2::transfer_details &td) { return !filter || available != td.m_spent; }, cursor, req.limit);
+    if (next)
+      res.next_cursor = next->to_string();
+
+    for (size_t idx : transfers)
+    {
+      const wallet2::transfer_details &td = m_wallet->get_transfer_details(idx);
+      wallet_rpc::transfer_details rpc_transfers;
+      rpc_transfers.amount       = td.amount();
+      rpc_transfers.spent        = td.m_spent;
+      rpc_transfers.global_index = td.m_global_output_index;
+      rpc_transfers.tx_hash      = epee::string_tools::pod_to_hex(td.m_txid);
+      rpc_transfers.subaddr_index = {td.m_subaddr_index.major, td.m_subaddr_index.minor};
+      rpc_transfers.key_image    = td.m_key_image_known ? epee::string_tools::pod_to_hex(td.m_key_image) : "";
+      rpc_transfers.block_height = td.m_block_height;
+      rpc_transfers.frozen       = td.m_frozen;
+      rpc_transfers.unlocked     = m_wallet->is_transfer_unlocked(td);
+      res.transfers.push_back(rpc_transfers);
+    }
+
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2604,7 +2881,6 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
-    if (!m_wallet) return not_open(er);
     if (m_restricted)
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
@@ -2612,6 +2888,19 @@ namespace tools
       return false;
     }
 
+    if (req.pool)
+    {
+      // the pool is asked to the daemon on each call, so is not part of the snapshot
+      boost::lock_guard<boost::mutex> lock(m_wallet_mutex);
+      if (!get_transfers_from_wallet(req, res, er))
+        return false;
+      publish_snapshot();
+      return true;
+    }
+
+    const std::shared_ptr<const wallet_snapshot> snapshot = get_snapshot();
+    if (!snapshot) return not_open(er);
+
     uint64_t min_height = 0, max_height = CRYPTONOTE_MAX_BLOCK_NUMBER;
     if (req.filter_by_height)
     {
@@ -2627,10 +2916,96 @@ namespace tools
       subaddr_indices.clear();
     }
 
+    boost::optional<transfer_history_key> in_cursor, out_cursor;
+    for (const auto &c: {std::make_pair(&req.in_cursor, &in_cursor), std::make_pair(&req.out_cursor, &out_cursor)})
+    {
+      if (c.first->empty())
+        continue;
+      *c.second = transfer_history_key();
+      if (!transfer_history_key::from_string(*c.first, **c.second))
+      {
+        er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+        er.message = "Invalid cursor: " + *c.first;
+        return false;
+      }
+    }
+
+    const wallet_snapshot::history &history = *snapshot->transfers;
+    for (const auto &q: {std::make_tuple(req.in, &history.in, &history.in_index, &in_cursor, &res.in, &res.next_in_cursor),
+        std::make_tuple(req.out, &history.out, &history.out_index, &out_cursor, &res.out, &res.next_out_cursor)})
+    {
+      // heights are exclusive of min_height, as in wallet2::get_payments
+      if (!std::get<0>(q) || min_height >= max_height)
+        continue;
+      std::vector<size_t> found;
+      const boost::optional<transfer_history_key> next = std::get<2>(q)->query(found, min_height + 1, max_height, account_index, subaddr_indices, *std::get<3>(q), req.limit);
+      if (next)
+        *std::get<5>(q) = next->to_string();
+      for (size_t i: found)
+      {
+        std::get<4>(q)->push_back((*std::get<1>(q))[i]);
+        set_confirmations(std::get<4>(q)->back(), snapshot->height, snapshot->last_block_reward);
+      }
+    }
+
+    if (req.pending || req.failed)
+    {
+      for (const auto &u: snapshot->unconfirmed)
+      {
+        if (account_index && *account_index != u.account)
+          continue;
+        if (!subaddr_indices.empty() && std::count_if(u.subaddr_indices.begin(), u.subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
+          continue;
+        if (!((req.failed && u.failed) || (!u.failed && req.pending)))
+          continue;
+        std::list<wallet_rpc::transfer_entry> &entries = u.failed ? res.failed : res.pending;
+        entries.push_back(u.entry);
+        set_confirmations(entries.back(), snapshot->height, snapshot->last_block_reward);
+      }
+    }
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::get_transfers_from_wallet(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res, epee::json_rpc::error& er)
+  {
+    if (!m_wallet) return not_open(er);
+
+    uint64_t min_height = 0, max_height = CRYPTONOTE_MAX_BLOCK_NUMBER;
+    if (req.filter_by_height)
+    {
+      min_height = req.min_height;
+      max_height = req.max_height <= max_height ? req.max_height : max_height;
+    }
+
+    boost::optional<uint32_t> account_index = req.account_index;
+    std::set<uint32_t> subaddr_indices = req.subaddr_indices;
+    if (req.all_accounts)
+    {
+      account_index = boost::none;
+      subaddr_indices.clear();
+    }
+
+    boost::optional<transfer_history_key> in_cursor, out_cursor;
+    for (const auto &c: {std::make_pair(&req.in_cursor, &in_cursor), std::make_pair(&req.out_cursor, &out_cursor)})
+    {
+      if (c.first->empty())
+        continue;
+      *c.second = transfer_history_key();
+      if (!transfer_history_key::from_string(*c.first, **c.second))
+      {
+        er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+        er.message = "Invalid cursor: " + *c.first;
+        return false;
+      }
+    }
+
     if (req.in)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-      m_wallet->get_payments(payments, min_height, max_height, account_index, subaddr_indices);
+      const boost::optional<transfer_history_key> next = m_wallet->get_payments_paged(payments, min_height, max_height, account_index, subaddr_indices, in_cursor, req.limit);
+      if (next)
+        res.next_in_cursor = next->to_string();
       for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.in.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.in.back(), i->second.m_tx_hash, i->first, i->second);
@@ -2640,7 +3015,9 @@ namespace tools
     if (req.out)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-      m_wallet->get_payments_out(payments, min_height, max_height, account_index, subaddr_indices);
+      const boost::optional<transfer_history_key> next = m_wallet->get_payments_out_paged(payments, min_height, max_height, account_index, subaddr_indices, out_cursor, req.limit);
+      if (next)
+        res.next_out_cursor = next->to_string();
       for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.out.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.out.back(), i->first, i->second);
@@ -2714,9 +3091,9 @@ namespace tools
     }
 
     std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-    m_wallet->get_payments(payments, 0, (uint64_t)-1, req.account_index);
+    m_wallet->get_payments_by_txid(txid, payments);
     for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
-      if (i->second.m_tx_hash == txid)
+      if (i->second.m_subaddr_index.major == req.account_index && i->second.m_block_height > 0)
       {
         res.transfers.resize(res.transfers.size() + 1);
         fill_transfer_entry(res.transfers.back(), i->second.m_tx_hash, i->first, i->second);
@@ -2724,9 +3101,9 @@ namespace tools
     }
 
     std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments_out;
-    m_wallet->get_payments_out(payments_out, 0, (uint64_t)-1, req.account_index);
+    m_wallet->get_payments_out_by_txid(txid, payments_out);
     for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments_out.begin(); i != payments_out.end(); ++i) {
-      if (i->first == txid)
+      if (i->second.m_subaddr_account == req.account_index && i->second.m_block_height > 0)
       {
         res.transfers.resize(res.transfers.size() + 1);
         fill_transfer_entry(res.transfers.back(), i->first, i->second);
@@ -3284,9 +3661,8 @@ namespace tools
         handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
         return false;
       }
-      delete m_wallet;
     }
-    m_wallet = wal.release();
+    set_current_wallet(wal.release());
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3327,6 +3703,22 @@ namespace tools
       }
     }
     std::string wallet_file = m_wallet_dir + "/" + req.filename;
+    if (m_multi_wallet)
+    {
+      auto i = m_open_wallets.find(wallet_file);
+      if (i != m_open_wallets.end())
+      {
+        if (!i->second->verify_password(req.password))
+        {
+          er.code = WALLET_RPC_ERROR_CODE_INVALID_PASSWORD;
+          er.message = "Invalid password";
+          return false;
+        }
+        m_wallet = i->second;
+        reset_snapshot();
+        return true;
+      }
+    }
     {
       po::options_description desc("dummy");
       const command_line::arg_descriptor<std::string, true> arg_password = {"password", "password"};
@@ -3355,9 +3747,7 @@ namespace tools
       return false;
     }
 
-    if (m_wallet)
-      delete m_wallet;
-    m_wallet = wal.release();
+    set_current_wallet(wal.release());
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3377,8 +3767,7 @@ namespace tools
         return false;
       }
     }
-    delete m_wallet;
-    m_wallet = NULL;
+    close_current_wallet();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3653,9 +4042,7 @@ namespace tools
       return false;
     }
 
-    if (m_wallet)
-      delete m_wallet;
-    m_wallet = wal.release();
+    set_current_wallet(wal.release());
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     return true;
   }
@@ -3841,9 +4228,7 @@ namespace tools
       return false;
     }
 
-    if (m_wallet)
-      delete m_wallet;
-    m_wallet = wal.release();
+    set_current_wallet(wal.release());
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     res.info = "Wallet has been restored successfully.";
     return true;
@@ -4415,6 +4800,26 @@ namespace tools
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_get_latency_stats(const wallet_rpc::COMMAND_RPC_GET_LATENCY_STATS::request& req, wallet_rpc::COMMAND_RPC_GET_LATENCY_STATS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    for (const rpc_latency_stats::method_stats &stats: m_latency_stats.get())
+    {
+      wallet_rpc::COMMAND_RPC_GET_LATENCY_STATS::method_latency latency;
+      latency.method = stats.method;
+      latency.count = stats.count;
+      latency.p50 = stats.p50;
+      latency.p90 = stats.p90;
+      latency.p99 = stats.p99;
+      latency.max = stats.max;
+      res.methods.push_back(latency);
+    }
+    const std::shared_ptr<const wallet_snapshot> snapshot = get_snapshot();
+    res.snapshot_height = snapshot ? snapshot->height : 0;
+    const time_t now = time(NULL);
+    res.snapshot_age = snapshot && now > snapshot->published ? now - snapshot->published : 0;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
 }
 
 class t_daemon
@@ -4604,7 +5009,10 @@ int main(int argc, char** argv) {
   command_line::add_arg(desc_params, arg_wallet_file);
   command_line::add_arg(desc_params, arg_from_json);
   command_line::add_arg(desc_params, arg_wallet_dir);
+  command_line::add_arg(desc_params, arg_multi_wallet);
   command_line::add_arg(desc_params, arg_prompt_for_password);
+  command_line::add_arg(desc_params, arg_rpc_threads);
+  command_line::add_arg(desc_params, arg_rta_ready_inputs);
 
   daemonizer::init_options(hidden_options, desc_params);
   desc_params.add(hidden_options);
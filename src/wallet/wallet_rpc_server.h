@@ -32,16 +32,46 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <memory>
 #include <string>
 #include "common/util.h"
 #include "net/http_server_impl_base.h"
 #include "math_helper.h"
 #include "wallet_rpc_server_commands_defs.h"
 #include "wallet2.h"
+#include "multi_wallet_scanner.h"
+#include "rpc_latency_stats.h"
+#include "wallet_rpc_snapshot.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.rpc"
 
+// Like MAP_JON_RPC_WE, but the call is made within a wallet_call_scope, which
+// serializes it with the other calls using the wallet unless it is answered from
+// the published snapshot, and records its latency
+#define MAP_WALLET_RPC(method_name, callback_f, command_type, access) \
+    else if(callback_name == method_name) \
+{ \
+  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
+  fail_resp.jsonrpc = "2.0"; \
+  fail_resp.id = req.id; \
+  MINFO(m_conn_context << "Calling RPC method " << method_name); \
+  bool call_res; \
+  { \
+    wallet_call_scope call_scope(*this, method_name, wallet_call_scope::access); \
+    call_res = callback_f(req.params, resp.result, fail_resp.error, &m_conn_context); \
+  } \
+  if(!call_res) \
+  { \
+    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    return true; \
+  } \
+  FINALIZE_OBJECTS_TO_JSON(method_name) \
+  return true;\
+}
+
 namespace tools
 {
   /************************************************************************/
@@ -68,93 +98,94 @@ namespace tools
 
     BEGIN_URI_MAP2()
       BEGIN_JSON_RPC_MAP("/json_rpc")
-        MAP_JON_RPC_WE("get_balance",        on_getbalance,         wallet_rpc::COMMAND_RPC_GET_BALANCE)
-        MAP_JON_RPC_WE("get_address",        on_getaddress,         wallet_rpc::COMMAND_RPC_GET_ADDRESS)
-        MAP_JON_RPC_WE("get_address_index",  on_getaddress_index,   wallet_rpc::COMMAND_RPC_GET_ADDRESS_INDEX)
-        MAP_JON_RPC_WE("getbalance",         on_getbalance,         wallet_rpc::COMMAND_RPC_GET_BALANCE)
-        MAP_JON_RPC_WE("getaddress",         on_getaddress,         wallet_rpc::COMMAND_RPC_GET_ADDRESS)
-        MAP_JON_RPC_WE("create_address",     on_create_address,     wallet_rpc::COMMAND_RPC_CREATE_ADDRESS)
-        MAP_JON_RPC_WE("label_address",      on_label_address,      wallet_rpc::COMMAND_RPC_LABEL_ADDRESS)
-        MAP_JON_RPC_WE("get_accounts",       on_get_accounts,       wallet_rpc::COMMAND_RPC_GET_ACCOUNTS)
-        MAP_JON_RPC_WE("create_account",     on_create_account,     wallet_rpc::COMMAND_RPC_CREATE_ACCOUNT)
-        MAP_JON_RPC_WE("label_account",      on_label_account,      wallet_rpc::COMMAND_RPC_LABEL_ACCOUNT)
-        MAP_JON_RPC_WE("get_account_tags",   on_get_account_tags,   wallet_rpc::COMMAND_RPC_GET_ACCOUNT_TAGS)
-        MAP_JON_RPC_WE("tag_accounts",       on_tag_accounts,       wallet_rpc::COMMAND_RPC_TAG_ACCOUNTS)
-        MAP_JON_RPC_WE("untag_accounts",     on_untag_accounts,     wallet_rpc::COMMAND_RPC_UNTAG_ACCOUNTS)
-        MAP_JON_RPC_WE("set_account_tag_description", on_set_account_tag_description, wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION)
-        MAP_JON_RPC_WE("get_height",         on_getheight,          wallet_rpc::COMMAND_RPC_GET_HEIGHT)
-        MAP_JON_RPC_WE("getheight",          on_getheight,          wallet_rpc::COMMAND_RPC_GET_HEIGHT)
-        MAP_JON_RPC_WE("transfer",           on_transfer,           wallet_rpc::COMMAND_RPC_TRANSFER)
-        MAP_JON_RPC_WE("transfer_split",     on_transfer_split,     wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT)
-        MAP_JON_RPC_WE("sign_transfer",      on_sign_transfer,      wallet_rpc::COMMAND_RPC_SIGN_TRANSFER)
-        MAP_JON_RPC_WE("describe_transfer",  on_describe_transfer,  wallet_rpc::COMMAND_RPC_DESCRIBE_TRANSFER)
-        MAP_JON_RPC_WE("submit_transfer",    on_submit_transfer,    wallet_rpc::COMMAND_RPC_SUBMIT_TRANSFER)
-        MAP_JON_RPC_WE("sweep_dust",         on_sweep_dust,         wallet_rpc::COMMAND_RPC_SWEEP_DUST)
-        MAP_JON_RPC_WE("sweep_unmixable",    on_sweep_dust,         wallet_rpc::COMMAND_RPC_SWEEP_DUST)
-        MAP_JON_RPC_WE("sweep_all",          on_sweep_all,          wallet_rpc::COMMAND_RPC_SWEEP_ALL)
-        MAP_JON_RPC_WE("sweep_single",       on_sweep_single,       wallet_rpc::COMMAND_RPC_SWEEP_SINGLE)
-        MAP_JON_RPC_WE("relay_tx",           on_relay_tx,           wallet_rpc::COMMAND_RPC_RELAY_TX)
-        MAP_JON_RPC_WE("store",              on_store,              wallet_rpc::COMMAND_RPC_STORE)
-        MAP_JON_RPC_WE("get_payments",       on_get_payments,       wallet_rpc::COMMAND_RPC_GET_PAYMENTS)
-        MAP_JON_RPC_WE("get_bulk_payments",  on_get_bulk_payments,  wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS)
-        MAP_JON_RPC_WE("incoming_transfers", on_incoming_transfers, wallet_rpc::COMMAND_RPC_INCOMING_TRANSFERS)
-        MAP_JON_RPC_WE("query_key",         on_query_key,         wallet_rpc::COMMAND_RPC_QUERY_KEY)
-        MAP_JON_RPC_WE("make_integrated_address", on_make_integrated_address, wallet_rpc::COMMAND_RPC_MAKE_INTEGRATED_ADDRESS)
-        MAP_JON_RPC_WE("split_integrated_address", on_split_integrated_address, wallet_rpc::COMMAND_RPC_SPLIT_INTEGRATED_ADDRESS)
-        MAP_JON_RPC_WE("stop_wallet",        on_stop_wallet,        wallet_rpc::COMMAND_RPC_STOP_WALLET)
-        MAP_JON_RPC_WE("rescan_blockchain",  on_rescan_blockchain,  wallet_rpc::COMMAND_RPC_RESCAN_BLOCKCHAIN)
-        MAP_JON_RPC_WE("set_tx_notes",       on_set_tx_notes,       wallet_rpc::COMMAND_RPC_SET_TX_NOTES)
-        MAP_JON_RPC_WE("get_tx_notes",       on_get_tx_notes,       wallet_rpc::COMMAND_RPC_GET_TX_NOTES)
-        MAP_JON_RPC_WE("set_attribute",      on_set_attribute,      wallet_rpc::COMMAND_RPC_SET_ATTRIBUTE)
-        MAP_JON_RPC_WE("get_attribute",      on_get_attribute,      wallet_rpc::COMMAND_RPC_GET_ATTRIBUTE)
-        MAP_JON_RPC_WE("get_tx_key",         on_get_tx_key,         wallet_rpc::COMMAND_RPC_GET_TX_KEY)
-        MAP_JON_RPC_WE("check_tx_key",       on_check_tx_key,       wallet_rpc::COMMAND_RPC_CHECK_TX_KEY)
-        MAP_JON_RPC_WE("get_tx_proof",       on_get_tx_proof,       wallet_rpc::COMMAND_RPC_GET_TX_PROOF)
-        MAP_JON_RPC_WE("check_tx_proof",     on_check_tx_proof,     wallet_rpc::COMMAND_RPC_CHECK_TX_PROOF)
-        MAP_JON_RPC_WE("get_spend_proof",    on_get_spend_proof,    wallet_rpc::COMMAND_RPC_GET_SPEND_PROOF)
-        MAP_JON_RPC_WE("check_spend_proof",  on_check_spend_proof,  wallet_rpc::COMMAND_RPC_CHECK_SPEND_PROOF)
-        MAP_JON_RPC_WE("get_reserve_proof",    on_get_reserve_proof,    wallet_rpc::COMMAND_RPC_GET_RESERVE_PROOF)
-        MAP_JON_RPC_WE("check_reserve_proof",  on_check_reserve_proof,  wallet_rpc::COMMAND_RPC_CHECK_RESERVE_PROOF)
-        MAP_JON_RPC_WE("get_transfers",      on_get_transfers,      wallet_rpc::COMMAND_RPC_GET_TRANSFERS)
-        MAP_JON_RPC_WE("get_transfer_by_txid", on_get_transfer_by_txid, wallet_rpc::COMMAND_RPC_GET_TRANSFER_BY_TXID)
-        MAP_JON_RPC_WE("sign",               on_sign,               wallet_rpc::COMMAND_RPC_SIGN)
-        MAP_JON_RPC_WE("verify",             on_verify,             wallet_rpc::COMMAND_RPC_VERIFY)
-        MAP_JON_RPC_WE("export_outputs",     on_export_outputs,     wallet_rpc::COMMAND_RPC_EXPORT_OUTPUTS)
-        MAP_JON_RPC_WE("import_outputs",     on_import_outputs,     wallet_rpc::COMMAND_RPC_IMPORT_OUTPUTS)
-        MAP_JON_RPC_WE("export_key_images",  on_export_key_images,  wallet_rpc::COMMAND_RPC_EXPORT_KEY_IMAGES)
-        MAP_JON_RPC_WE("import_key_images",  on_import_key_images,  wallet_rpc::COMMAND_RPC_IMPORT_KEY_IMAGES)
-        MAP_JON_RPC_WE("make_uri",           on_make_uri,           wallet_rpc::COMMAND_RPC_MAKE_URI)
-        MAP_JON_RPC_WE("parse_uri",          on_parse_uri,          wallet_rpc::COMMAND_RPC_PARSE_URI)
-        MAP_JON_RPC_WE("get_address_book",   on_get_address_book,   wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY)
-        MAP_JON_RPC_WE("add_address_book",   on_add_address_book,   wallet_rpc::COMMAND_RPC_ADD_ADDRESS_BOOK_ENTRY)
-        MAP_JON_RPC_WE("delete_address_book",on_delete_address_book,wallet_rpc::COMMAND_RPC_DELETE_ADDRESS_BOOK_ENTRY)
-        MAP_JON_RPC_WE("refresh",            on_refresh,            wallet_rpc::COMMAND_RPC_REFRESH)
-        MAP_JON_RPC_WE("auto_refresh",       on_auto_refresh,       wallet_rpc::COMMAND_RPC_AUTO_REFRESH)
-        MAP_JON_RPC_WE("rescan_spent",       on_rescan_spent,       wallet_rpc::COMMAND_RPC_RESCAN_SPENT)
-        MAP_JON_RPC_WE("start_mining",       on_start_mining,       wallet_rpc::COMMAND_RPC_START_MINING)
-        MAP_JON_RPC_WE("stop_mining",        on_stop_mining,        wallet_rpc::COMMAND_RPC_STOP_MINING)
-        MAP_JON_RPC_WE("get_languages",      on_get_languages,      wallet_rpc::COMMAND_RPC_GET_LANGUAGES)
-        MAP_JON_RPC_WE("create_wallet",      on_create_wallet,      wallet_rpc::COMMAND_RPC_CREATE_WALLET)
-        MAP_JON_RPC_WE("open_wallet",        on_open_wallet,        wallet_rpc::COMMAND_RPC_OPEN_WALLET)
-        MAP_JON_RPC_WE("close_wallet",       on_close_wallet,       wallet_rpc::COMMAND_RPC_CLOSE_WALLET)
-        MAP_JON_RPC_WE("change_wallet_password",        on_change_wallet_password,        wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD)
-        MAP_JON_RPC_WE("generate_from_keys", on_generate_from_keys, wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS)
-        MAP_JON_RPC_WE("restore_deterministic_wallet",      on_restore_deterministic_wallet,      wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET)
-        MAP_JON_RPC_WE("is_multisig",        on_is_multisig,        wallet_rpc::COMMAND_RPC_IS_MULTISIG)
-        MAP_JON_RPC_WE("prepare_multisig",   on_prepare_multisig,   wallet_rpc::COMMAND_RPC_PREPARE_MULTISIG)
-        MAP_JON_RPC_WE("make_multisig",      on_make_multisig,      wallet_rpc::COMMAND_RPC_MAKE_MULTISIG)
-        MAP_JON_RPC_WE("export_multisig_info", on_export_multisig,  wallet_rpc::COMMAND_RPC_EXPORT_MULTISIG)
-        MAP_JON_RPC_WE("import_multisig_info", on_import_multisig,  wallet_rpc::COMMAND_RPC_IMPORT_MULTISIG)
-        MAP_JON_RPC_WE("finalize_multisig",  on_finalize_multisig,  wallet_rpc::COMMAND_RPC_FINALIZE_MULTISIG)
-        MAP_JON_RPC_WE("exchange_multisig_keys",  on_exchange_multisig_keys,  wallet_rpc::COMMAND_RPC_EXCHANGE_MULTISIG_KEYS)
-        MAP_JON_RPC_WE("sign_multisig",      on_sign_multisig,      wallet_rpc::COMMAND_RPC_SIGN_MULTISIG)
-        MAP_JON_RPC_WE("submit_multisig",    on_submit_multisig,    wallet_rpc::COMMAND_RPC_SUBMIT_MULTISIG)
-        MAP_JON_RPC_WE("validate_address",   on_validate_address,   wallet_rpc::COMMAND_RPC_VALIDATE_ADDRESS)
-        MAP_JON_RPC_WE("set_daemon",         on_set_daemon,         wallet_rpc::COMMAND_RPC_SET_DAEMON)
-        MAP_JON_RPC_WE("set_log_level",      on_set_log_level,      wallet_rpc::COMMAND_RPC_SET_LOG_LEVEL)
-        MAP_JON_RPC_WE("set_log_categories", on_set_log_categories, wallet_rpc::COMMAND_RPC_SET_LOG_CATEGORIES)
-        MAP_JON_RPC_WE("get_version",        on_get_version,        wallet_rpc::COMMAND_RPC_GET_VERSION)
-        MAP_JON_RPC_WE("transfer_rta",       on_transfer_rta,      wallet_rpc::COMMAND_RPC_TRANSFER_RTA)
+        MAP_WALLET_RPC("get_balance",        on_getbalance,         wallet_rpc::COMMAND_RPC_GET_BALANCE, snapshot)
+        MAP_WALLET_RPC("get_address",        on_getaddress,         wallet_rpc::COMMAND_RPC_GET_ADDRESS, read)
+        MAP_WALLET_RPC("get_address_index",  on_getaddress_index,   wallet_rpc::COMMAND_RPC_GET_ADDRESS_INDEX, read)
+        MAP_WALLET_RPC("getbalance",         on_getbalance,         wallet_rpc::COMMAND_RPC_GET_BALANCE, snapshot)
+        MAP_WALLET_RPC("getaddress",         on_getaddress,         wallet_rpc::COMMAND_RPC_GET_ADDRESS, read)
+        MAP_WALLET_RPC("create_address",     on_create_address,     wallet_rpc::COMMAND_RPC_CREATE_ADDRESS, write)
+        MAP_WALLET_RPC("label_address",      on_label_address,      wallet_rpc::COMMAND_RPC_LABEL_ADDRESS, write)
+        MAP_WALLET_RPC("get_accounts",       on_get_accounts,       wallet_rpc::COMMAND_RPC_GET_ACCOUNTS, read)
+        MAP_WALLET_RPC("create_account",     on_create_account,     wallet_rpc::COMMAND_RPC_CREATE_ACCOUNT, write)
+        MAP_WALLET_RPC("label_account",      on_label_account,      wallet_rpc::COMMAND_RPC_LABEL_ACCOUNT, write)
+        MAP_WALLET_RPC("get_account_tags",   on_get_account_tags,   wallet_rpc::COMMAND_RPC_GET_ACCOUNT_TAGS, read)
+        MAP_WALLET_RPC("tag_accounts",       on_tag_accounts,       wallet_rpc::COMMAND_RPC_TAG_ACCOUNTS, write)
+        MAP_WALLET_RPC("untag_accounts",     on_untag_accounts,     wallet_rpc::COMMAND_RPC_UNTAG_ACCOUNTS, write)
+        MAP_WALLET_RPC("set_account_tag_description", on_set_account_tag_description, wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION, write)
+        MAP_WALLET_RPC("get_height",         on_getheight,          wallet_rpc::COMMAND_RPC_GET_HEIGHT, snapshot)
+        MAP_WALLET_RPC("getheight",          on_getheight,          wallet_rpc::COMMAND_RPC_GET_HEIGHT, snapshot)
+        MAP_WALLET_RPC("transfer",           on_transfer,           wallet_rpc::COMMAND_RPC_TRANSFER, write)
+        MAP_WALLET_RPC("transfer_split",     on_transfer_split,     wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT, write)
+        MAP_WALLET_RPC("sign_transfer",      on_sign_transfer,      wallet_rpc::COMMAND_RPC_SIGN_TRANSFER, write)
+        MAP_WALLET_RPC("describe_transfer",  on_describe_transfer,  wallet_rpc::COMMAND_RPC_DESCRIBE_TRANSFER, read)
+        MAP_WALLET_RPC("submit_transfer",    on_submit_transfer,    wallet_rpc::COMMAND_RPC_SUBMIT_TRANSFER, write)
+        MAP_WALLET_RPC("sweep_dust",         on_sweep_dust,         wallet_rpc::COMMAND_RPC_SWEEP_DUST, write)
+        MAP_WALLET_RPC("sweep_unmixable",    on_sweep_dust,         wallet_rpc::COMMAND_RPC_SWEEP_DUST, write)
+        MAP_WALLET_RPC("sweep_all",          on_sweep_all,          wallet_rpc::COMMAND_RPC_SWEEP_ALL, write)
+        MAP_WALLET_RPC("sweep_single",       on_sweep_single,       wallet_rpc::COMMAND_RPC_SWEEP_SINGLE, write)
+        MAP_WALLET_RPC("relay_tx",           on_relay_tx,           wallet_rpc::COMMAND_RPC_RELAY_TX, write)
+        MAP_WALLET_RPC("store",              on_store,              wallet_rpc::COMMAND_RPC_STORE, write)
+        MAP_WALLET_RPC("get_payments",       on_get_payments,       wallet_rpc::COMMAND_RPC_GET_PAYMENTS, read)
+        MAP_WALLET_RPC("get_bulk_payments",  on_get_bulk_payments,  wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS, read)
+        MAP_WALLET_RPC("incoming_transfers", on_incoming_transfers, wallet_rpc::COMMAND_RPC_INCOMING_TRANSFERS, read)
+        MAP_WALLET_RPC("query_key",         on_query_key,         wallet_rpc::COMMAND_RPC_QUERY_KEY, read)
+        MAP_WALLET_RPC("make_integrated_address", on_make_integrated_address, wallet_rpc::COMMAND_RPC_MAKE_INTEGRATED_ADDRESS, read)
+        MAP_WALLET_RPC("split_integrated_address", on_split_integrated_address, wallet_rpc::COMMAND_RPC_SPLIT_INTEGRATED_ADDRESS, read)
+        MAP_WALLET_RPC("stop_wallet",        on_stop_wallet,        wallet_rpc::COMMAND_RPC_STOP_WALLET, write)
+        MAP_WALLET_RPC("rescan_blockchain",  on_rescan_blockchain,  wallet_rpc::COMMAND_RPC_RESCAN_BLOCKCHAIN, write)
+        MAP_WALLET_RPC("set_tx_notes",       on_set_tx_notes,       wallet_rpc::COMMAND_RPC_SET_TX_NOTES, write)
+        MAP_WALLET_RPC("get_tx_notes",       on_get_tx_notes,       wallet_rpc::COMMAND_RPC_GET_TX_NOTES, read)
+        MAP_WALLET_RPC("set_attribute",      on_set_attribute,      wallet_rpc::COMMAND_RPC_SET_ATTRIBUTE, write)
+        MAP_WALLET_RPC("get_attribute",      on_get_attribute,      wallet_rpc::COMMAND_RPC_GET_ATTRIBUTE, read)
+        MAP_WALLET_RPC("get_tx_key",         on_get_tx_key,         wallet_rpc::COMMAND_RPC_GET_TX_KEY, read)
+        MAP_WALLET_RPC("check_tx_key",       on_check_tx_key,       wallet_rpc::COMMAND_RPC_CHECK_TX_KEY, read)
+        MAP_WALLET_RPC("get_tx_proof",       on_get_tx_proof,       wallet_rpc::COMMAND_RPC_GET_TX_PROOF, read)
+        MAP_WALLET_RPC("check_tx_proof",     on_check_tx_proof,     wallet_rpc::COMMAND_RPC_CHECK_TX_PROOF, read)
+        MAP_WALLET_RPC("get_spend_proof",    on_get_spend_proof,    wallet_rpc::COMMAND_RPC_GET_SPEND_PROOF, read)
+        MAP_WALLET_RPC("check_spend_proof",  on_check_spend_proof,  wallet_rpc::COMMAND_RPC_CHECK_SPEND_PROOF, read)
+        MAP_WALLET_RPC("get_reserve_proof",    on_get_reserve_proof,    wallet_rpc::COMMAND_RPC_GET_RESERVE_PROOF, read)
+        MAP_WALLET_RPC("check_reserve_proof",  on_check_reserve_proof,  wallet_rpc::COMMAND_RPC_CHECK_RESERVE_PROOF, read)
+        MAP_WALLET_RPC("get_transfers",      on_get_transfers,      wallet_rpc::COMMAND_RPC_GET_TRANSFERS, snapshot)
+        MAP_WALLET_RPC("get_transfer_by_txid", on_get_transfer_by_txid, wallet_rpc::COMMAND_RPC_GET_TRANSFER_BY_TXID, write)
+        MAP_WALLET_RPC("sign",               on_sign,               wallet_rpc::COMMAND_RPC_SIGN, read)
+        MAP_WALLET_RPC("verify",             on_verify,             wallet_rpc::COMMAND_RPC_VERIFY, read)
+        MAP_WALLET_RPC("export_outputs",     on_export_outputs,     wallet_rpc::COMMAND_RPC_EXPORT_OUTPUTS, read)
+        MAP_WALLET_RPC("import_outputs",     on_import_outputs,     wallet_rpc::COMMAND_RPC_IMPORT_OUTPUTS, write)
+        MAP_WALLET_RPC("export_key_images",  on_export_key_images,  wallet_rpc::COMMAND_RPC_EXPORT_KEY_IMAGES, read)
+        MAP_WALLET_RPC("import_key_images",  on_import_key_images,  wallet_rpc::COMMAND_RPC_IMPORT_KEY_IMAGES, write)
+        MAP_WALLET_RPC("make_uri",           on_make_uri,           wallet_rpc::COMMAND_RPC_MAKE_URI, read)
+        MAP_WALLET_RPC("parse_uri",          on_parse_uri,          wallet_rpc::COMMAND_RPC_PARSE_URI, read)
+        MAP_WALLET_RPC("get_address_book",   on_get_address_book,   wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY, read)
+        MAP_WALLET_RPC("add_address_book",   on_add_address_book,   wallet_rpc::COMMAND_RPC_ADD_ADDRESS_BOOK_ENTRY, write)
+        MAP_WALLET_RPC("delete_address_book",on_delete_address_book,wallet_rpc::COMMAND_RPC_DELETE_ADDRESS_BOOK_ENTRY, write)
+        MAP_WALLET_RPC("refresh",            on_refresh,            wallet_rpc::COMMAND_RPC_REFRESH, write)
+        MAP_WALLET_RPC("auto_refresh",       on_auto_refresh,       wallet_rpc::COMMAND_RPC_AUTO_REFRESH, write)
+        MAP_WALLET_RPC("rescan_spent",       on_rescan_spent,       wallet_rpc::COMMAND_RPC_RESCAN_SPENT, write)
+        MAP_WALLET_RPC("start_mining",       on_start_mining,       wallet_rpc::COMMAND_RPC_START_MINING, read)
+        MAP_WALLET_RPC("stop_mining",        on_stop_mining,        wallet_rpc::COMMAND_RPC_STOP_MINING, read)
+        MAP_WALLET_RPC("get_languages",      on_get_languages,      wallet_rpc::COMMAND_RPC_GET_LANGUAGES, snapshot)
+        MAP_WALLET_RPC("create_wallet",      on_create_wallet,      wallet_rpc::COMMAND_RPC_CREATE_WALLET, write)
+        MAP_WALLET_RPC("open_wallet",        on_open_wallet,        wallet_rpc::COMMAND_RPC_OPEN_WALLET, write)
+        MAP_WALLET_RPC("close_wallet",       on_close_wallet,       wallet_rpc::COMMAND_RPC_CLOSE_WALLET, write)
+        MAP_WALLET_RPC("change_wallet_password",        on_change_wallet_password,        wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD, write)
+        MAP_WALLET_RPC("generate_from_keys", on_generate_from_keys, wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS, write)
+        MAP_WALLET_RPC("restore_deterministic_wallet",      on_restore_deterministic_wallet,      wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET, write)
+        MAP_WALLET_RPC("is_multisig",        on_is_multisig,        wallet_rpc::COMMAND_RPC_IS_MULTISIG, read)
+        MAP_WALLET_RPC("prepare_multisig",   on_prepare_multisig,   wallet_rpc::COMMAND_RPC_PREPARE_MULTISIG, write)
+        MAP_WALLET_RPC("make_multisig",      on_make_multisig,      wallet_rpc::COMMAND_RPC_MAKE_MULTISIG, write)
+        MAP_WALLET_RPC("export_multisig_info", on_export_multisig,  wallet_rpc::COMMAND_RPC_EXPORT_MULTISIG, write)
+        MAP_WALLET_RPC("import_multisig_info", on_import_multisig,  wallet_rpc::COMMAND_RPC_IMPORT_MULTISIG, write)
+        MAP_WALLET_RPC("finalize_multisig",  on_finalize_multisig,  wallet_rpc::COMMAND_RPC_FINALIZE_MULTISIG, write)
+        MAP_WALLET_RPC("exchange_multisig_keys",  on_exchange_multisig_keys,  wallet_rpc::COMMAND_RPC_EXCHANGE_MULTISIG_KEYS, write)
+        MAP_WALLET_RPC("sign_multisig",      on_sign_multisig,      wallet_rpc::COMMAND_RPC_SIGN_MULTISIG, write)
+        MAP_WALLET_RPC("submit_multisig",    on_submit_multisig,    wallet_rpc::COMMAND_RPC_SUBMIT_MULTISIG, write)
+        MAP_WALLET_RPC("validate_address",   on_validate_address,   wallet_rpc::COMMAND_RPC_VALIDATE_ADDRESS, read)
+        MAP_WALLET_RPC("set_daemon",         on_set_daemon,         wallet_rpc::COMMAND_RPC_SET_DAEMON, write)
+        MAP_WALLET_RPC("set_log_level",      on_set_log_level,      wallet_rpc::COMMAND_RPC_SET_LOG_LEVEL, snapshot)
+        MAP_WALLET_RPC("set_log_categories", on_set_log_categories, wallet_rpc::COMMAND_RPC_SET_LOG_CATEGORIES, snapshot)
+        MAP_WALLET_RPC("get_version",        on_get_version,        wallet_rpc::COMMAND_RPC_GET_VERSION, snapshot)
+        MAP_WALLET_RPC("get_latency_stats",  on_get_latency_stats,  wallet_rpc::COMMAND_RPC_GET_LATENCY_STATS, snapshot)
+        MAP_WALLET_RPC("transfer_rta",       on_transfer_rta,      wallet_rpc::COMMAND_RPC_TRANSFER_RTA, write)
       END_JSON_RPC_MAP()
     END_URI_MAP2()
 
@@ -241,6 +272,7 @@ namespace tools
       bool on_set_log_level(const wallet_rpc::COMMAND_RPC_SET_LOG_LEVEL::request& req, wallet_rpc::COMMAND_RPC_SET_LOG_LEVEL::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_set_log_categories(const wallet_rpc::COMMAND_RPC_SET_LOG_CATEGORIES::request& req, wallet_rpc::COMMAND_RPC_SET_LOG_CATEGORIES::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_get_version(const wallet_rpc::COMMAND_RPC_GET_VERSION::request& req, wallet_rpc::COMMAND_RPC_GET_VERSION::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
+      bool on_get_latency_stats(const wallet_rpc::COMMAND_RPC_GET_LATENCY_STATS::request& req, wallet_rpc::COMMAND_RPC_GET_LATENCY_STATS::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       //json rpc v2
       bool on_query_key(const wallet_rpc::COMMAND_RPC_QUERY_KEY::request& req, wallet_rpc::COMMAND_RPC_QUERY_KEY::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
 
@@ -260,14 +292,57 @@ namespace tools
       bool validate_transfer(const std::list<wallet_rpc::transfer_destination>& destinations, const std::string& payment_id, std::vector<cryptonote::tx_destination_entry>& dsts, std::vector<uint8_t>& extra, bool at_least_one_destination, epee::json_rpc::error& er);
 
       void check_background_mining();
+      void set_current_wallet(wallet2 *wal);
+      void close_current_wallet();
+
+      /*!
+       * \brief Scope of an RPC call: holds the wallet lock, unless the call only needs the
+       *        snapshot, publishes a new snapshot after a call which may change the wallet,
+       *        and records the latency of the call
+       */
+      class wallet_call_scope
+      {
+      public:
+        enum access_type { snapshot, read, write };
+
+        wallet_call_scope(wallet_rpc_server &server, const char *method, access_type access);
+        ~wallet_call_scope();
+
+      private:
+        wallet_rpc_server &m_server;
+        const char *m_method;
+        access_type m_access;
+        uint64_t m_start;
+        boost::unique_lock<boost::mutex> m_lock;
+      };
+
+      std::shared_ptr<const wallet_snapshot> get_snapshot() const;
+      void publish_snapshot();
+      void reset_snapshot();
+      std::shared_ptr<const wallet_snapshot::history> make_snapshot_history(const std::shared_ptr<const wallet_snapshot::history> &previous);
+      bool get_balance_from_wallet(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er);
+      bool get_transfers_from_wallet(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res, epee::json_rpc::error& er);
+      void prepare_rta_inputs();
 
       wallet2 *m_wallet;
       std::string m_wallet_dir;
+      bool m_multi_wallet;
+      std::map<std::string, wallet2*> m_open_wallets;
+      multi_wallet_scanner m_scanner;
       tools::private_file rpc_login_file;
       std::atomic<bool> m_stop;
       bool m_restricted;
       const boost::program_options::variables_map *m_vm;
       uint32_t m_auto_refresh_period;
       boost::posix_time::ptime m_last_auto_refresh_time;
+      uint32_t m_rpc_threads;
+      uint32_t m_rta_ready_inputs;
+      uint32_t m_rta_account; // account and ring size of the last transfer_rta, the inputs kept ready are picked for them
+      uint64_t m_rta_ring_size;
+      bool m_rta_inputs_stale;
+      boost::mutex m_wallet_mutex; // held by the calls using the wallet, and the auto refresh
+      mutable boost::mutex m_snapshot_mutex;
+      std::shared_ptr<const wallet_snapshot> m_snapshot;
+      rpc_latency_stats m_latency_stats;
   };
 }
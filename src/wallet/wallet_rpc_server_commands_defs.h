@@ -47,7 +47,7 @@
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define WALLET_RPC_VERSION_MAJOR 1
-#define WALLET_RPC_VERSION_MINOR 13 // TODO: need to change for graft? previous was 4
+#define WALLET_RPC_VERSION_MINOR 16 // TODO: need to change for graft? previous was 4
 #define MAKE_WALLET_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define WALLET_RPC_VERSION MAKE_WALLET_RPC_VERSION(WALLET_RPC_VERSION_MAJOR, WALLET_RPC_VERSION_MINOR)
 namespace tools
@@ -735,15 +735,36 @@ namespace wallet_rpc
     };
     typedef epee::misc_utils::struct_init<request_t> request;
     
+    struct build_timings
+    {
+      uint64_t total; // microseconds
+      uint64_t selection;
+      uint64_t rings;
+      uint64_t construction;
+      uint64_t ready_inputs; // inputs whose ring was kept ready
+      uint64_t other_inputs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(total)
+        KV_SERIALIZE(selection)
+        KV_SERIALIZE(rings)
+        KV_SERIALIZE(construction)
+        KV_SERIALIZE(ready_inputs)
+        KV_SERIALIZE(other_inputs)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response_t : public COMMAND_RPC_TRANSFER::response_t
     {
       std::string encrypted_tx_key; // encrypted tx key using multiple key encryption
+      build_timings timings;
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(tx_hash)
         KV_SERIALIZE(tx_key)
         KV_SERIALIZE(fee)
         KV_SERIALIZE(tx_blob)
         KV_SERIALIZE(encrypted_tx_key)
+        KV_SERIALIZE(timings)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -1070,11 +1091,15 @@ namespace wallet_rpc
       std::string transfer_type;
       uint32_t account_index;
       std::set<uint32_t> subaddr_indices;
+      uint64_t limit; // 0 for all
+      std::string cursor; // next_cursor of the previous page
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(transfer_type)
         KV_SERIALIZE(account_index)
         KV_SERIALIZE(subaddr_indices)
+        KV_SERIALIZE_OPT(limit, (uint64_t)0)
+        KV_SERIALIZE(cursor)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -1082,9 +1107,11 @@ namespace wallet_rpc
     struct response_t
     {
       std::list<transfer_details> transfers;
+      std::string next_cursor; // empty if this was the last page
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(transfers)
+        KV_SERIALIZE(next_cursor)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -1579,6 +1606,9 @@ namespace wallet_rpc
       uint32_t account_index;
       std::set<uint32_t> subaddr_indices;
       bool all_accounts;
+      uint64_t limit; // per list of in and out, 0 for all
+      std::string in_cursor; // next_in_cursor of the previous page
+      std::string out_cursor; // next_out_cursor of the previous page
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(in);
@@ -1592,6 +1622,9 @@ namespace wallet_rpc
         KV_SERIALIZE(account_index);
         KV_SERIALIZE(subaddr_indices);
         KV_SERIALIZE_OPT(all_accounts, false);
+        KV_SERIALIZE_OPT(limit, (uint64_t)0);
+        KV_SERIALIZE(in_cursor);
+        KV_SERIALIZE(out_cursor);
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -1603,6 +1636,8 @@ namespace wallet_rpc
       std::list<transfer_entry> pending;
       std::list<transfer_entry> failed;
       std::list<transfer_entry> pool;
+      std::string next_in_cursor; // empty if in was the last page
+      std::string next_out_cursor; // empty if out was the last page
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(in);
@@ -1610,6 +1645,8 @@ namespace wallet_rpc
         KV_SERIALIZE(pending);
         KV_SERIALIZE(failed);
         KV_SERIALIZE(pool);
+        KV_SERIALIZE(next_in_cursor);
+        KV_SERIALIZE(next_out_cursor);
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -2490,6 +2527,49 @@ namespace wallet_rpc
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_LATENCY_STATS
+  {
+    struct request_t
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct method_latency
+    {
+      std::string method;
+      uint64_t count;
+      uint64_t p50; // microseconds, over the most recent calls
+      uint64_t p90;
+      uint64_t p99;
+      uint64_t max;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(method)
+        KV_SERIALIZE(count)
+        KV_SERIALIZE(p50)
+        KV_SERIALIZE(p90)
+        KV_SERIALIZE(p99)
+        KV_SERIALIZE(max)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t
+    {
+      std::vector<method_latency> methods;
+      uint64_t snapshot_height;
+      uint64_t snapshot_age; // seconds since the snapshot read only calls are answered from was published
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(methods)
+        KV_SERIALIZE(snapshot_height)
+        KV_SERIALIZE(snapshot_age)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_VALIDATE_ADDRESS
   {
     struct request_t
@@ -75,4 +75,5 @@
 #define WALLET_RPC_ERROR_CODE_SIGN_UNSIGNED          -42
 #define WALLET_RPC_ERROR_CODE_NON_DETERMINISTIC      -43
 #define WALLET_RPC_ERROR_CODE_INVALID_LOG_LEVEL      -44
+#define WALLET_RPC_ERROR_CODE_WRONG_CURSOR           -45
 #define WALLET_RPC_ERROR_CODE_WRONG_SUPERNODE_KEY    -50 // Graft: increase it to not overlap with Monero?
@@ -0,0 +1,88 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <ctime>
+#include <memory>
+#include <set>
+#include <vector>
+#include "wallet_rpc_server_commands_defs.h"
+#include "transfer_history_index.h"
+#include "wallet2.h"
+
+namespace tools
+{
+  /*!
+   * \brief Read only state of the current wallet, published after each call which may
+   *        change it and after each refresh, so the most frequent read only calls are
+   *        answered without waiting for the calls using the wallet
+   */
+  struct wallet_snapshot
+  {
+    struct account_balance
+    {
+      uint64_t balance;
+      uint64_t unlocked_balance;
+      uint64_t blocks_to_unlock;
+      // subaddresses with a balance entry, by index
+      std::vector<wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info> per_subaddress;
+    };
+
+    // incoming and outgoing history, indexed as in the wallet, shared by the
+    // snapshots published until it changes
+    struct history
+    {
+      const wallet2 *wallet;
+      uint64_t version;
+      std::vector<wallet_rpc::transfer_entry> in;
+      std::vector<wallet_rpc::transfer_entry> out;
+      transfer_history_index<size_t> in_index;
+      transfer_history_index<size_t> out_index;
+
+      // the versions of different wallets are unrelated, so both must match
+      bool is_current(const wallet2 &w) const { return wallet == &w && version == w.get_history_version(); }
+    };
+
+    struct unconfirmed_entry
+    {
+      uint32_t account;
+      std::set<uint32_t> subaddr_indices;
+      bool failed;
+      wallet_rpc::transfer_entry entry;
+    };
+
+    uint64_t height;
+    uint64_t last_block_reward;
+    bool multisig_import_needed;
+    std::vector<account_balance> accounts;
+    std::shared_ptr<const history> transfers;
+    std::vector<unconfirmed_entry> unconfirmed;
+    time_t published;
+  };
+}
@@ -197,6 +197,18 @@ bool tests::proxy_core::handle_incoming_txs(const std::vector<blobdata>& tx_blob
     return true;
 }
 
+bool tests::proxy_core::handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, std::vector<crypto::hash>& tx_hashes, bool keeped_by_block, bool relayed, bool do_not_relay)
+{
+    tx_hashes.assign(tx_blobs.size(), null_hash);
+    for (size_t i = 0; i < tx_blobs.size(); ++i)
+    {
+      transaction tx;
+      if (!parse_and_validate_tx_from_blob(tx_blobs[i], tx, tx_hashes[i]))
+        tx_hashes[i] = null_hash;
+    }
+    return handle_incoming_txs(tx_blobs, tvc, keeped_by_block, relayed, do_not_relay);
+}
+
 bool tests::proxy_core::handle_incoming_block(const cryptonote::blobdata& block_blob, const cryptonote::block *block_, cryptonote::block_verification_context& bvc, bool update_miner_blocktemplate) {
     block b = AUTO_VAL_INIT(b);
 
@@ -238,7 +238,7 @@ void wallet_tools::gen_block_data(block_tracker &bt, const cryptonote::block *bl
         }
 }
 
-void wallet_tools::compute_subaddresses(std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses, cryptonote::account_base & creds, size_t account, size_t minors)
+void wallet_tools::compute_subaddresses(cryptonote::subaddress_map &subaddresses, cryptonote::account_base & creds, size_t account, size_t minors)
 {
   auto &hwdev = hw::get_device("default");
   const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(creds.get_keys(), account, 0, minors);
@@ -34,6 +34,8 @@
 #include <ios>
 #include <string>
 #include <cfenv>
+#include <cstring>
+#include <vector>
 
 #include "misc_log_ex.h"
 #include "warnings.h"
@@ -52,6 +54,59 @@ struct V4_Data
   uint64_t height;
 };
 
+// hashes data in one lane of cn_slow_hash_multi next to other inputs, and checks
+// every lane against cn_slow_hash; a mismatch in another lane zeroes the result
+static void cn_slow_hash_multi_lanes(const void *data, size_t length, char *hash, int variant, int modifier) {
+  std::vector<std::string> inputs(CN_SLOW_HASH_MAX_LANES + 1, std::string((const char*)data, length));
+  for (size_t i = 1; i < inputs.size(); i += 2)
+    inputs[i] += "lane" + std::to_string(i);
+  std::vector<const void*> ptrs;
+  std::vector<size_t> lengths;
+  std::vector<chash> results(inputs.size());
+  std::vector<char*> outs;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ptrs.push_back(inputs[i].data());
+    lengths.push_back(inputs[i].size());
+    outs.push_back(results[i].data);
+  }
+  cn_slow_hash_multi(ptrs.data(), lengths.data(), outs.data(), inputs.size(), variant, 0/*prehashed*/, modifier);
+  memcpy(hash, &results[0], sizeof(chash));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    chash single;
+    if (i > 0 && inputs[i] == inputs[0])
+      single = results[0];
+    else
+      cn_slow_hash(inputs[i].data(), inputs[i].size(), single.data, variant, 0/*prehashed*/, modifier);
+    if (single != results[i])
+      memset(hash, 0, sizeof(chash));
+  }
+}
+
+// same as cn_slow_hash_multi_lanes, with inputs of assorted lengths in the other
+// lanes so that they finish absorbing at different blocks
+static void cn_fast_hash_multi_lanes(const void *data, size_t length, char *hash) {
+  std::vector<std::string> inputs(CN_FAST_HASH_MAX_LANES + 3, std::string((const char*)data, length));
+  for (size_t i = 1; i < inputs.size(); i += 2)
+    inputs[i] += std::string(i * 67, (char)i);
+  std::vector<const void*> ptrs;
+  std::vector<size_t> lengths;
+  std::vector<chash> results(inputs.size());
+  std::vector<char*> outs;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ptrs.push_back(inputs[i].data());
+    lengths.push_back(inputs[i].size());
+    outs.push_back(results[i].data);
+  }
+  cn_fast_hash_multi(ptrs.data(), lengths.data(), outs.data(), inputs.size());
+  memcpy(hash, &results[0], sizeof(chash));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    chash single;
+    cn_fast_hash(inputs[i].data(), inputs[i].size(), single.data);
+    if (single != results[i])
+      memset(hash, 0, sizeof(chash));
+  }
+}
+
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4297)
 extern "C" {
@@ -83,6 +138,18 @@ extern "C" {
     return cn_slow_hash(data, length, hash, 2/*variant*/, 0/*prehashed*/,
                         CN_MODIFIER_REVERSE_WALTZ/*modifier*/);
   }
+  static void cn_slow_hash_0_multi(const void *data, size_t length, char *hash) {
+    return cn_slow_hash_multi_lanes(data, length, hash, 0/*variant*/, 0/*modifier*/);
+  }
+  static void cn_slow_hash_1_multi(const void *data, size_t length, char *hash) {
+    return cn_slow_hash_multi_lanes(data, length, hash, 1/*variant*/, 0/*modifier*/);
+  }
+  static void cn_slow_hash_2_multi(const void *data, size_t length, char *hash) {
+    return cn_slow_hash_multi_lanes(data, length, hash, 2/*variant*/, 0/*modifier*/);
+  }
+  static void cn_slow_hash_2_reverse_waltz_multi(const void *data, size_t length, char *hash) {
+    return cn_slow_hash_multi_lanes(data, length, hash, 2/*variant*/, CN_MODIFIER_REVERSE_WALTZ/*modifier*/);
+  }
 }
 POP_WARNINGS
 
@@ -90,12 +157,14 @@ extern "C" typedef void hash_f(const void *, size_t, char *);
 struct hash_func {
   const string name;
   hash_f &f;
-} hashes[] = {{"fast", cn_fast_hash}, {"slow", cn_slow_hash_0}, {"tree", hash_tree},
+} hashes[] = {{"fast", cn_fast_hash}, {"fast-multi", cn_fast_hash_multi_lanes}, {"slow", cn_slow_hash_0}, {"tree", hash_tree},
   {"extra-blake", hash_extra_blake}, {"extra-groestl", hash_extra_groestl},
   {"extra-jh", hash_extra_jh}, {"extra-skein", hash_extra_skein},
   {"slow-1", cn_slow_hash_1}, {"slow-2", cn_slow_hash_2},
   {"slow-0-waltz", cn_slow_hash_0_waltz}, {"slow-1-waltz", cn_slow_hash_1_waltz},
-  {"slow-2-waltz", cn_slow_hash_2_waltz}, {"slow-2-reverse-waltz", cn_slow_hash_2_reverse_waltz}};
+  {"slow-2-waltz", cn_slow_hash_2_waltz}, {"slow-2-reverse-waltz", cn_slow_hash_2_reverse_waltz},
+  {"slow-multi", cn_slow_hash_0_multi}, {"slow-1-multi", cn_slow_hash_1_multi},
+  {"slow-2-multi", cn_slow_hash_2_multi}, {"slow-2-reverse-waltz-multi", cn_slow_hash_2_reverse_waltz_multi}};
 
 int test_variant2_int_sqrt();
 int test_variant2_int_sqrt_ref();
@@ -55,3 +55,35 @@ public:
 private:
   std::array<uint8_t, bytes> m_data;
 };
+
+template<size_t bytes, size_t count>
+class test_cn_fast_hash_multi
+{
+public:
+  static const size_t loop_count = test_cn_fast_hash<bytes>::loop_count / count;
+
+  bool init()
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      crypto::rand(bytes, m_data[i].data());
+      m_data_ptrs[i] = m_data[i].data();
+      m_lengths[i] = bytes;
+      m_hash_ptrs[i] = m_hashes[i].data;
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    crypto::cn_fast_hash_multi(m_data_ptrs, m_lengths, m_hash_ptrs, count);
+    return true;
+  }
+
+private:
+  std::array<uint8_t, bytes> m_data[count];
+  const void *m_data_ptrs[count];
+  size_t m_lengths[count];
+  char *m_hash_ptrs[count];
+  crypto::hash m_hashes[count];
+};
@@ -65,7 +65,41 @@ public:
     return hash == m_expected_hash;
   }
 
-private:
+protected:
   data_t m_data;
   crypto::hash m_expected_hash;
 };
+
+// hashes the same input in each of the lanes, so a test() is lanes hashes
+template<size_t lanes>
+class test_cn_slow_hash_reverse_waltz_multi: public test_cn_slow_hash_reverse_waltz
+{
+public:
+  bool init()
+  {
+    if (!test_cn_slow_hash_reverse_waltz::init())
+      return false;
+    for (size_t i = 0; i < lanes; ++i)
+    {
+      m_data_ptrs[i] = &m_data;
+      m_lengths[i] = sizeof(m_data);
+      m_hash_ptrs[i] = m_hashes[i].data;
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    crypto::cn_slow_hash_multi(m_data_ptrs, m_lengths, m_hash_ptrs, lanes, 2, 0, CN_MODIFIER_REVERSE_WALTZ);
+    for (size_t i = 0; i < lanes; ++i)
+      if (m_hashes[i] != m_expected_hash)
+        return false;
+    return true;
+  }
+
+private:
+  const void *m_data_ptrs[lanes];
+  size_t m_lengths[lanes];
+  char *m_hash_ptrs[lanes];
+  crypto::hash m_hashes[lanes];
+};
@@ -53,6 +53,8 @@ enum test_op
   op_ge_double_scalarmult_precomp_vartime,
   op_ge_double_scalarmult_precomp_vartime2,
   op_addKeys2,
+  op_addKeys2_H,
+  op_commit,
   op_addKeys3,
   op_addKeys3_2,
   op_isInMainSubgroup,
@@ -110,6 +112,8 @@ public:
       case op_ge_double_scalarmult_precomp_vartime: ge_double_scalarmult_precomp_vartime(&tmp_p2, scalar0.bytes, &p3_0, scalar1.bytes, precomp0); break;
       case op_ge_double_scalarmult_precomp_vartime2: ge_double_scalarmult_precomp_vartime2(&tmp_p2, scalar0.bytes, precomp0, scalar1.bytes, precomp1); break;
       case op_addKeys2: rct::addKeys2(key, scalar0, scalar1, point0); break;
+      case op_addKeys2_H: rct::addKeys2(key, scalar0, scalar1, rct::H); break;
+      case op_commit: rct::commit(9001, scalar0); break;
       case op_addKeys3: rct::addKeys3(key, scalar0, point0, scalar1, precomp1); break;
       case op_addKeys3_2: rct::addKeys3(key, scalar0, precomp0, scalar1, precomp1); break;
       case op_isInMainSubgroup: rct::isInMainSubgroup(point0); break;
@@ -127,3 +131,28 @@ private:
   ge_cached cached;
   ge_dsmp precomp0, precomp1;
 };
+
+// runs T with the given field arithmetic backend, leaving the process default alone
+template<typename T, crypto_ops_backend backend>
+class test_crypto_ops_backend: public T
+{
+public:
+  bool init()
+  {
+    const crypto_ops_backend saved = crypto_ops_get_backend();
+    if (crypto_ops_set_backend(backend) != 0)
+      return false;
+    const bool r = T::init();
+    crypto_ops_set_backend(saved);
+    return r;
+  }
+
+  bool test()
+  {
+    const crypto_ops_backend saved = crypto_ops_get_backend();
+    crypto_ops_set_backend(backend);
+    const bool r = T::test();
+    crypto_ops_set_backend(saved);
+    return r;
+  }
+};
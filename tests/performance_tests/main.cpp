@@ -63,6 +63,9 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "multi_wallet_scan.h"
+#include "parse_tx.h"
+#include "select_outputs.h"
 
 namespace po = boost::program_options;
 
@@ -184,6 +187,11 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 2, 2, 56, 16);
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 10, 2, 56, 16);
 
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 11, 2, false);
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 11, 2, true);
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 11, 16, false);
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 11, 16, true);
+
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc);
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc_precomp);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image_helper);
@@ -200,13 +208,31 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_signature, true);
 
   TEST_PERFORMANCE2(filter, p, test_wallet2_expand_subaddresses, 50, 200);
+  TEST_PERFORMANCE1(filter, p, test_wallet2_expand_subaddress_minor, 1000000);
+
+  TEST_PERFORMANCE2(filter, p, test_multi_wallet_scan, 1, false);
+  TEST_PERFORMANCE2(filter, p, test_multi_wallet_scan, 1, true);
+  TEST_PERFORMANCE2(filter, p, test_multi_wallet_scan, 16, false);
+  TEST_PERFORMANCE2(filter, p, test_multi_wallet_scan, 16, true);
+  TEST_PERFORMANCE2(filter, p, test_multi_wallet_scan, 64, false);
+  TEST_PERFORMANCE2(filter, p, test_multi_wallet_scan, 64, true);
+
+  TEST_PERFORMANCE1(filter, p, test_smallest_sufficient_output, false);
+  TEST_PERFORMANCE1(filter, p, test_smallest_sufficient_output, true);
+  TEST_PERFORMANCE0(filter, p, test_pop_best_value_from);
 
   TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, 0);
   TEST_PERFORMANCE0(filter, p, test_cn_slow_hash_2);
   TEST_PERFORMANCE0(filter, p, test_cn_slow_hash_waltz);
   TEST_PERFORMANCE0(filter, p, test_cn_slow_hash_reverse_waltz);
+  TEST_PERFORMANCE1(filter, p, test_cn_slow_hash_reverse_waltz_multi, 1);
+  TEST_PERFORMANCE1(filter, p, test_cn_slow_hash_reverse_waltz_multi, 2);
+  TEST_PERFORMANCE1(filter, p, test_cn_slow_hash_reverse_waltz_multi, 4);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
+  TEST_PERFORMANCE2(filter, p, test_cn_fast_hash_multi, 32, 8);
+  TEST_PERFORMANCE2(filter, p, test_cn_fast_hash_multi, 64, 8);
+  TEST_PERFORMANCE2(filter, p, test_cn_fast_hash_multi, 16384, 8);
 
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 3, false);
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 5, false);
@@ -217,6 +243,15 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 10, true);
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 100, true);
 
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 1, 11, false);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 1, 11, true);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 2, 11, false);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 2, 11, true);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 16, 11, false);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 16, 11, true);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 64, 11, false);
+  TEST_PERFORMANCE3(filter, p, test_ringct_mlsag_simple, 64, 11, true);
+
   TEST_PERFORMANCE2(filter, p, test_equality, memcmp32, true);
   TEST_PERFORMANCE2(filter, p, test_equality, memcmp32, false);
   TEST_PERFORMANCE2(filter, p, test_equality, verify32, false);
@@ -269,12 +304,31 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_double_scalarmult_precomp_vartime);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_double_scalarmult_precomp_vartime2);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_addKeys2);
+  TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_addKeys2_H);
+  TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_commit);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_addKeys3);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_addKeys3_2);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_isInMainSubgroup);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_zeroCommitUncached);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_zeroCommitCached);
 
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_scalarmultBase>, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_scalarmultBase>, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_scalarmultKey>, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_scalarmultKey>, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_scalarmultH>, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_scalarmultH>, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_ge_double_scalarmult_base_vartime>, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_crypto_ops<op_ge_double_scalarmult_base_vartime>, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_ge_frombytes_vartime, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_ge_frombytes_vartime, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_ge_tobytes, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_ge_tobytes, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_generate_key_derivation, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_generate_key_derivation, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_derive_public_key, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, test_derive_public_key, CRYPTO_OPS_BACKEND_FE51);
+
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 2);
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 4);
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 8);
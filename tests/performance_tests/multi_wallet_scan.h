@@ -0,0 +1,154 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/multi_wallet_scanner.h"
+#include "ringct/rctOps.h"
+
+#include "multi_tx_test_base.h"
+
+// Scans the same blocks for a number of wallets, either in one shared pass,
+// or parsing the blocks and scanning them for each wallet on its own, as
+// separate wallet2 refreshes do. Time per call covers n_blocks blocks.
+template<size_t a_wallets, bool a_shared>
+class test_multi_wallet_scan : private multi_tx_test_base<2>
+{
+public:
+  static const size_t loop_count = 5;
+  static const size_t n_wallets = a_wallets;
+  static const bool shared = a_shared;
+  static const size_t n_blocks = 10;
+  static const size_t txes_per_block = 20;
+
+  typedef multi_tx_test_base<2> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    account_base alice;
+    alice.generate();
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount - 1, alice.get_keys().m_account_address, false));
+    destinations.push_back(tx_destination_entry(1, alice.get_keys().m_account_address, false));
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    subaddress_map subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+    transaction tx;
+    if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, account_public_address{}, std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys, true, {rct::RangeProofPaddedBulletproof, 2}))
+      return false;
+    const blobdata tx_blob = tx_to_blob(tx);
+
+    for (size_t i = 0; i < n_blocks; ++i)
+    {
+      block b;
+      b.major_version = 1;
+      b.minor_version = 0;
+      b.timestamp = time(NULL);
+      b.nonce = i;
+      if (!construct_miner_tx(i + 1, 0, 0, 2, 0, alice.get_keys().m_account_address, b.miner_tx))
+        return false;
+      b.tx_hashes.assign(txes_per_block, get_transaction_hash(tx));
+
+      block_complete_entry bce;
+      bce.block = block_to_blob(b);
+      bce.txs.assign(txes_per_block, tx_blob);
+      m_blocks.push_back(bce);
+
+      COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices o_indices;
+      o_indices.indices.resize(1 + txes_per_block);
+      o_indices.indices[0].indices.resize(b.miner_tx.vout.size());
+      for (size_t j = 0; j < txes_per_block; ++j)
+        o_indices.indices[1 + j].indices.resize(tx.vout.size());
+      m_o_indices.push_back(o_indices);
+    }
+    m_parsed_blocks = parse_blocks();
+
+    for (size_t w = 0; w < n_wallets; ++w)
+    {
+      m_wallets.emplace_back(new tools::wallet2());
+      m_wallets.back()->set_subaddress_lookahead(1, 1);
+      m_wallets.back()->generate("", "", rct::rct2sk(rct::skGen()), true, false);
+      if (shared)
+      {
+        if (m_scanners.empty())
+          m_scanners.emplace_back(new tools::multi_wallet_scanner());
+        m_scanners.front()->add_wallet(m_wallets.back().get());
+      }
+      else
+      {
+        m_scanners.emplace_back(new tools::multi_wallet_scanner());
+        m_scanners.back()->add_wallet(m_wallets.back().get());
+      }
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    for (auto &wallet: m_wallets)
+      wallet->rescan_blockchain(true, false);
+    if (shared)
+      return m_scanners.front()->scan(1, m_blocks, m_parsed_blocks) == n_blocks * n_wallets;
+    uint64_t blocks_added = 0;
+    for (auto &scanner: m_scanners)
+      blocks_added += scanner->scan(1, m_blocks, parse_blocks());
+    return blocks_added == n_blocks * n_wallets;
+  }
+
+private:
+  std::vector<tools::wallet2::parsed_block> parse_blocks() const
+  {
+    std::vector<tools::wallet2::parsed_block> parsed_blocks(m_blocks.size());
+    for (size_t i = 0; i < m_blocks.size(); ++i)
+    {
+      tools::wallet2::parsed_block &pb = parsed_blocks[i];
+      pb.error = !cryptonote::parse_and_validate_block_from_blob(m_blocks[i].block, pb.block, pb.hash);
+      pb.o_indices = m_o_indices[i];
+      pb.txes.resize(m_blocks[i].txs.size());
+      for (size_t j = 0; j < m_blocks[i].txs.size(); ++j)
+        pb.error |= !cryptonote::parse_and_validate_tx_base_from_blob(m_blocks[i].txs[j], pb.txes[j]);
+    }
+    return parsed_blocks;
+  }
+
+  std::vector<cryptonote::block_complete_entry> m_blocks;
+  std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> m_o_indices;
+  std::vector<tools::wallet2::parsed_block> m_parsed_blocks;
+  std::vector<std::unique_ptr<tools::wallet2>> m_wallets;
+  std::vector<std::unique_ptr<tools::multi_wallet_scanner>> m_scanners;
+};
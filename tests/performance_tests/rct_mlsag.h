@@ -85,3 +85,69 @@ private:
   size_t ind;
   rct::mgSig IIccss;
 };
+
+template<size_t inputs, size_t ring_size, bool batch>
+class test_ringct_mlsag_simple
+{
+public:
+  static const size_t loop_count = 100 / inputs + 1;
+
+  bool init()
+  {
+    // half the ring members are shared with other rings, as decoys of a block often are
+    rct::ctkeyV shared(ring_size);
+    for (rct::ctkey &member: shared)
+    {
+      member.dest = rct::pkGen();
+      member.mask = rct::pkGen();
+    }
+
+    messages.resize(inputs);
+    C.resize(inputs);
+    pubs.resize(inputs);
+    mgs.resize(inputs);
+    for (size_t n = 0; n < inputs; ++n)
+    {
+      rct::ctkey sk, pk;
+      std::tie(sk, pk) = rct::ctskpkGen(1000);
+      const unsigned int index = n % ring_size;
+      for (size_t i = 0; i < ring_size; ++i)
+      {
+        if (i == index)
+          pubs[n].push_back(pk);
+        else if (i % 2)
+          pubs[n].push_back(shared[i]);
+        else
+          pubs[n].push_back({rct::pkGen(), rct::pkGen()});
+      }
+      const rct::key a = rct::skGen();
+      C[n] = rct::commit(1000, a);
+      messages[n] = rct::skGen();
+      mgs[n] = rct::proveRctMGSimple(messages[n], pubs[n], sk, a, C[n], NULL, NULL, index, hw::get_device("default"));
+    }
+    for (size_t n = 0; n < inputs; ++n)
+      batch_inputs.push_back({&messages[n], &mgs[n], &pubs[n], &C[n]});
+
+    return true;
+  }
+
+  bool test()
+  {
+    if (batch)
+    {
+      std::deque<bool> results;
+      return rct::verRctMGSimple(batch_inputs, results);
+    }
+    for (size_t n = 0; n < inputs; ++n)
+      if (!rct::verRctMGSimple(messages[n], mgs[n], pubs[n], C[n]))
+        return false;
+    return true;
+  }
+
+private:
+  rct::keyV messages;
+  rct::keyV C;
+  std::vector<rct::ctkeyV> pubs;
+  std::vector<rct::mgSig> mgs;
+  std::vector<rct::mgSimpleInput> batch_inputs;
+};
@@ -0,0 +1,115 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+
+#include "wallet/wallet2.h"
+
+// An exchange like wallet: lots of outputs received over many blocks by a few subaddresses
+class select_outputs_base
+{
+public:
+  static const size_t n_outputs = 200000;
+  static const uint32_t n_subaddresses = 20;
+
+  bool init()
+  {
+    for (size_t n = 0; n < n_outputs; ++n)
+    {
+      m_transfers.push_back(AUTO_VAL_INIT(tools::wallet2::transfer_details()));
+      tools::wallet2::transfer_details &td = m_transfers.back();
+      td.m_block_height = 1000 + n / 4;
+      td.m_spent = false;
+      td.m_txid = crypto::null_hash;
+      memcpy(td.m_txid.data, &n, sizeof(n));
+      td.m_amount = 1 + crypto::rand<uint64_t>() % 1000000000000;
+      td.m_subaddr_index.minor = crypto::rand<uint32_t>() % n_subaddresses;
+      m_index.insert(td.m_subaddr_index.major, td.m_subaddr_index.minor, td.amount(), n);
+      m_unused_indices.push_back(n);
+    }
+    return true;
+  }
+
+protected:
+  tools::wallet2::transfer_container m_transfers;
+  tools::unspent_output_index m_index;
+  std::vector<size_t> m_unused_indices;
+};
+
+// Finds the smallest output of a subaddress which covers an amount,
+// with the unspent output index or by scanning all the outputs
+template<bool a_indexed>
+class test_smallest_sufficient_output : public select_outputs_base
+{
+public:
+  static const size_t loop_count = a_indexed ? 100000 : 100;
+  static const bool indexed = a_indexed;
+
+  bool test()
+  {
+    const uint32_t minor = crypto::rand<uint32_t>() % n_subaddresses;
+    const uint64_t needed = crypto::rand<uint64_t>() % 1000000000000;
+
+    if (indexed)
+    {
+      const tools::unspent_output_index::range_type range = m_index.range(0, minor, needed);
+      return range.first == range.second || tools::unspent_output_index::index_of(*range.first) < n_outputs;
+    }
+
+    size_t found = n_outputs;
+    for (size_t n = 0; n < n_outputs; ++n)
+    {
+      const tools::wallet2::transfer_details &td = m_transfers[n];
+      if (td.m_subaddr_index.minor == minor && td.amount() >= needed && (found == n_outputs || td.amount() < m_transfers[found].amount()))
+        found = n;
+    }
+    return found <= n_outputs;
+  }
+};
+
+// Picks the inputs of a tx among all the unused outputs
+class test_pop_best_value_from : public select_outputs_base
+{
+public:
+  static const size_t loop_count = 1000;
+  static const size_t n_inputs = 16;
+
+  bool test()
+  {
+    std::vector<size_t> selected;
+    for (size_t n = 0; n < n_inputs; ++n)
+      selected.push_back(m_wallet.pop_best_value_from(m_transfers, m_unused_indices, selected));
+    m_unused_indices.insert(m_unused_indices.end(), selected.begin(), selected.end());
+    return m_unused_indices.size() == n_outputs;
+  }
+
+private:
+  tools::wallet2 m_wallet;
+};
@@ -63,3 +63,34 @@ public:
 private:
   tools::wallet2 wallet;
 };
+
+// derives Minor more subaddresses of the main account on each call, as a merchant
+// creating one per invoice would
+template<size_t Minor>
+class test_wallet2_expand_subaddress_minor : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 1;
+  static const size_t minor = Minor;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+    wallet.set_subaddress_lookahead(1, 1);
+    crypto::secret_key spendkey = rct::rct2sk(rct::skGen());
+    wallet.generate("", "", spendkey, true, false);
+    wallet.set_subaddress_lookahead(1, minor);
+    return true;
+  }
+
+  bool test()
+  {
+    const uint32_t n = wallet.get_num_subaddresses(0);
+    wallet.expand_subaddresses({0, n});
+    return wallet.get_num_subaddresses(0) == n + 1;
+  }
+
+private:
+  tools::wallet2 wallet;
+};
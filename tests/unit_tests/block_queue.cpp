@@ -85,3 +85,50 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, span_size_unknown_peer)
+{
+  cryptonote::block_queue bq;
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 80), 20);
+  ASSERT_LT(bq.get_expected_span_time(uuid1(), 20), 0.0f);
+  bq.add_rtt_sample(uuid1(), 0.1f);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 80), 20);
+}
+
+TEST(block_queue, span_size_by_throughput)
+{
+  cryptonote::block_queue bq;
+
+  // 10 kB blocks: the slow peer moves 2 kB/s, the fast one 10 MB/s
+  bq.add_throughput_sample(uuid1(), 20 * 10000, 20, 100.0f);
+  bq.add_throughput_sample(uuid2(), 20 * 10000, 20, 0.02f);
+  ASSERT_EQ(bq.get_avg_block_size(), 10000.0f);
+
+  const uint64_t slow = bq.get_span_size(uuid1(), 20, 80);
+  const uint64_t fast = bq.get_span_size(uuid2(), 20, 80);
+  ASSERT_GE(slow, 1);
+  ASSERT_LT(slow, 20);
+  ASSERT_EQ(fast, 80);
+  ASSERT_GT(bq.get_expected_span_time(uuid1(), 20), bq.get_expected_span_time(uuid2(), 20));
+
+  cryptonote::block_queue::peer_throughput throughput;
+  ASSERT_TRUE(bq.get_peer_throughput(uuid1(), throughput));
+  ASSERT_EQ(throughput.nspans, 1);
+  ASSERT_EQ(throughput.bytes, 200000);
+  ASSERT_EQ(bq.get_peer_throughputs().size(), 2);
+
+  bq.flush_peer_throughput(uuid1());
+  ASSERT_FALSE(bq.get_peer_throughput(uuid1(), throughput));
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 80), 20);
+}
+
+TEST(block_queue, rtt_excluded_from_bandwidth)
+{
+  cryptonote::block_queue bq;
+  bq.add_rtt_sample(uuid1(), 1.0f);
+  bq.add_throughput_sample(uuid1(), 100000, 10, 2.0f);
+  cryptonote::block_queue::peer_throughput throughput;
+  ASSERT_TRUE(bq.get_peer_throughput(uuid1(), throughput));
+  ASSERT_FLOAT_EQ(throughput.bandwidth, 100000.0f);
+  ASSERT_FLOAT_EQ(bq.get_expected_span_time(uuid1(), 10), 2.0f);
+}
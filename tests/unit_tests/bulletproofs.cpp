@@ -30,10 +30,13 @@
 
 #include "gtest/gtest.h"
 
+#include <boost/thread/thread.hpp>
+
 #include "string_tools.h"
 #include "ringct/rctOps.h"
 #include "ringct/rctSigs.h"
 #include "ringct/bulletproofs.h"
+#include "ringct/bulletproof_batcher.h"
 #include "cryptonote_basic/blobdatatype.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "device/device.hpp"
@@ -143,6 +146,114 @@ TEST(bulletproofs, multi_splitting)
   }
 }
 
+static rct::rctSig make_bulletproof_rct(size_t n_outputs)
+{
+  rct::ctkeyV sc, pc;
+  rct::ctkey sctmp, pctmp;
+  std::tie(sctmp, pctmp) = rct::ctskpkGen(6000);
+  sc.push_back(sctmp);
+  pc.push_back(pctmp);
+  std::vector<uint64_t> inamounts{6000}, outamounts;
+  std::vector<unsigned int> index{1};
+
+  rct::keyV amount_keys, destinations;
+  uint64_t available = 6000;
+  for (size_t i = 0; i < n_outputs; ++i)
+  {
+    const uint64_t amount = rct::randXmrAmount(available);
+    outamounts.push_back(amount);
+    amount_keys.push_back(rct::hash_to_scalar(rct::zero()));
+    destinations.push_back(rct::pkGen());
+    available -= amount;
+  }
+
+  rct::ctkeyM mixRing(1);
+  for (size_t j = 0; j < 3; ++j)
+    mixRing[0].push_back(j == 1 ? pc[0] : rct::ctkey{rct::pkGen(), rct::pkGen()});
+
+  rct::ctkeyV outSk;
+  rct::RCTConfig rct_config { rct::RangeProofPaddedBulletproof, 0 };
+  return rct::genRctSimple(rct::zero(), sc, destinations, inamounts, outamounts, available, mixRing, amount_keys, NULL, NULL, index, outSk, rct_config, hw::get_device("default"));
+}
+
+TEST(bulletproofs, batcher_bisects_failures)
+{
+  std::vector<rct::rctSig> sigs;
+  for (size_t i = 0; i < 7; ++i)
+    sigs.push_back(make_bulletproof_rct(1 + i % 3));
+  sigs[2].p.bulletproofs[0].taux = rct::skGen();
+  sigs[6].p.bulletproofs[0].t = rct::skGen();
+
+  std::vector<const rct::rctSig*> rvv;
+  for (const rct::rctSig &s: sigs)
+    rvv.push_back(&s);
+
+  std::deque<bool> results;
+  ASSERT_FALSE(rct::bulletproof_batcher::verify_bisect(rvv, results));
+  ASSERT_EQ(rvv.size(), results.size());
+  for (size_t i = 0; i < rvv.size(); ++i)
+    ASSERT_EQ(i != 2 && i != 6, results[i]);
+
+  rvv.erase(rvv.begin() + 6);
+  rvv.erase(rvv.begin() + 2);
+  ASSERT_TRUE(rct::bulletproof_batcher::verify_bisect(rvv, results));
+  ASSERT_EQ(5, std::count(results.begin(), results.end(), true));
+
+  ASSERT_TRUE(rct::bulletproof_batcher::verify_bisect({}, results));
+  ASSERT_TRUE(results.empty());
+}
+
+TEST(bulletproofs, batcher_concurrent_callers)
+{
+  static const size_t threads = 4;
+  std::vector<rct::rctSig> sigs;
+  for (size_t i = 0; i < threads * 2; ++i)
+    sigs.push_back(make_bulletproof_rct(2));
+  sigs[5].p.bulletproofs[0].taux = rct::skGen();
+
+  // a long window, so the callers end up in the same batch
+  rct::bulletproof_batcher batcher(500000, threads * 2);
+  std::vector<std::deque<bool>> results(threads);
+  std::deque<bool> verified(threads);
+  boost::thread_group group;
+  for (size_t t = 0; t < threads; ++t)
+  {
+    group.create_thread([&, t]() {
+      const std::vector<const rct::rctSig*> rvv{&sigs[t * 2], &sigs[t * 2 + 1]};
+      verified[t] = batcher.verify(rvv, results[t]);
+    });
+  }
+  group.join_all();
+
+  for (size_t t = 0; t < threads; ++t)
+  {
+    ASSERT_EQ(t != 2, verified[t]);
+    ASSERT_EQ(2, results[t].size());
+    ASSERT_TRUE(results[t][0]);
+    ASSERT_EQ(t != 2, results[t][1]);
+  }
+
+  // no window verifies each call on its own
+  rct::bulletproof_batcher unbatched(0, 0);
+  std::deque<bool> single;
+  ASSERT_TRUE(unbatched.verify({&sigs[0]}, single));
+  ASSERT_FALSE(unbatched.verify({&sigs[5]}, single));
+}
+
+TEST(bulletproofs, batcher_lone_caller_does_not_wait)
+{
+  const rct::rctSig sig = make_bulletproof_rct(2);
+
+  // with no other caller pending, the window is not waited for
+  rct::bulletproof_batcher batcher(5000000, 64);
+  std::deque<bool> results;
+  const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  ASSERT_TRUE(batcher.verify({&sig}, results, false));
+  ASSERT_LT((boost::posix_time::microsec_clock::universal_time() - start).total_seconds(), 5);
+  ASSERT_EQ(1, results.size());
+  ASSERT_TRUE(results[0]);
+}
+
 TEST(bulletproofs, valid_aggregated)
 {
   static const size_t N_PROOFS = 8;
@@ -33,6 +33,8 @@
 #include <string>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
 
 namespace
 {
@@ -64,6 +66,31 @@ namespace
     out << "BEGIN" << value << "END";  
     return out.str() == "BEGIN<" + std::string{expected, sizeof(T) * 2} + ">END";
   }
+
+  struct crypto_ops_backend_scope
+  {
+    crypto_ops_backend saved;
+    explicit crypto_ops_backend_scope(crypto_ops_backend backend): saved(crypto_ops_get_backend()) { crypto_ops_set_backend(backend); }
+    ~crypto_ops_backend_scope() { crypto_ops_set_backend(saved); }
+  };
+
+  // runs f under both backends and checks the encodings it returns are identical
+  template<typename F>
+  void expect_same_encoding(F f)
+  {
+    std::string ref10, fe51;
+    int ref10_res, fe51_res;
+    {
+      crypto_ops_backend_scope scope(CRYPTO_OPS_BACKEND_REF10);
+      ref10_res = f(ref10);
+    }
+    {
+      crypto_ops_backend_scope scope(CRYPTO_OPS_BACKEND_FE51);
+      fe51_res = f(fe51);
+    }
+    ASSERT_EQ(ref10_res, fe51_res);
+    ASSERT_EQ(ref10, fe51);
+  }
 }
 
 TEST(Crypto, Ostream)
@@ -99,3 +126,144 @@ TEST(Crypto, verify_32)
     }
   }
 }
+
+TEST(Crypto, fe51_matches_ref10)
+{
+  {
+    crypto_ops_backend_scope probe(CRYPTO_OPS_BACKEND_FE51);
+    if (crypto_ops_get_backend() != CRYPTO_OPS_BACKEND_FE51)
+      return; // not compiled in on this platform
+  }
+
+  const auto encode_p2 = [](std::string &out, const ge_p2 &p) { rct::key k; ge_tobytes(k.bytes, &p); out += std::string((const char*)k.bytes, 32); };
+  const auto encode_p3 = [](std::string &out, const ge_p3 &p) { rct::key k; ge_p3_tobytes(k.bytes, &p); out += std::string((const char*)k.bytes, 32); };
+
+  for (int i = 0; i < 256; ++i)
+  {
+    const rct::key a = rct::skGen(), b = rct::skGen();
+    const rct::key P = rct::scalarmultBase(rct::skGen());
+    rct::key unreduced = rct::skGen();
+    unreduced.bytes[31] |= 0x70;
+    expect_same_encoding([&](std::string &out) {
+      ge_p3 A, R3;
+      ge_p2 R2;
+      if (ge_frombytes_vartime(&A, P.bytes) != 0)
+        return -1;
+      ge_scalarmult_base(&R3, a.bytes); encode_p3(out, R3);
+      ge_scalarmult_base(&R3, unreduced.bytes); encode_p3(out, R3);
+      ge_scalarmult(&R2, b.bytes, &A); encode_p2(out, R2);
+      ge_scalarmult(&R2, unreduced.bytes, &A); encode_p2(out, R2);
+      ge_scalarmult_p3(&R3, b.bytes, &A); encode_p3(out, R3);
+      ge_double_scalarmult_base_vartime(&R2, a.bytes, &A, b.bytes); encode_p2(out, R2);
+      ge_double_scalarmult_base_vartime_p3(&R3, a.bytes, &A, b.bytes); encode_p3(out, R3);
+      return 0;
+    });
+  }
+
+  // random strings, non canonical y and the x = 0 points with either sign
+  std::vector<rct::key> encodings;
+  for (int i = 0; i < 256; ++i)
+    encodings.push_back(rct::skGen());
+  for (int i = 0; i < 20; ++i)
+  {
+    rct::key k;
+    memset(k.bytes, 0xff, 32);
+    k.bytes[0] = 0xff - i;
+    encodings.push_back(k);
+    k.bytes[31] = 0x7f;
+    encodings.push_back(k);
+  }
+  for (int i = 0; i < 2; ++i)
+  {
+    rct::key k = rct::zero();
+    k.bytes[0] = i;
+    encodings.push_back(k);
+    k.bytes[31] = 0x80;
+    encodings.push_back(k);
+  }
+  for (const rct::key &k: encodings)
+  {
+    expect_same_encoding([&](std::string &out) {
+      ge_p3 A;
+      if (ge_frombytes_vartime(&A, k.bytes) != 0)
+        return -1;
+      encode_p3(out, A);
+      // feed the result of one backend into the other
+      crypto_ops_backend_scope scope(crypto_ops_get_backend() == CRYPTO_OPS_BACKEND_REF10 ? CRYPTO_OPS_BACKEND_FE51 : CRYPTO_OPS_BACKEND_REF10);
+      ge_p2 R;
+      ge_scalarmult(&R, rct::identity().bytes, &A);
+      encode_p2(out, R);
+      return 0;
+    });
+  }
+}
+
+TEST(Crypto, fixed_base_table)
+{
+  for (crypto_ops_backend backend: {CRYPTO_OPS_BACKEND_REF10, CRYPTO_OPS_BACKEND_FE51})
+  {
+    crypto_ops_backend_scope scope(backend);
+    for (int i = 0; i < 16; ++i)
+    {
+      ge_p3 P;
+      const rct::key Pk = i == 0 ? rct::G : rct::scalarmultBase(rct::skGen());
+      ASSERT_EQ(ge_frombytes_vartime(&P, Pk.bytes), 0);
+      std::unique_ptr<ge_fixed_base_table> table(new ge_fixed_base_table[1]);
+      ge_fixed_base_precomp(*table, &P);
+
+      rct::key a = rct::skGen();
+      for (int j = 0; j < 2; ++j)
+      {
+        ge_p3 R, expected;
+        rct::key Rk, expected_k;
+        ge_scalarmult_fixed_base(&R, a.bytes, *table);
+        ge_scalarmult_p3(&expected, a.bytes, &P);
+        ge_p3_tobytes(Rk.bytes, &R);
+        ge_p3_tobytes(expected_k.bytes, &expected);
+        ASSERT_EQ(Rk, expected_k);
+        if (i == 0)
+        {
+          ge_scalarmult_base(&expected, a.bytes);
+          ge_p3_tobytes(expected_k.bytes, &expected);
+          ASSERT_EQ(Rk, expected_k);
+        }
+        a.bytes[31] |= 0x70;
+      }
+    }
+  }
+}
+
+TEST(Crypto, tx_tree_hash_parallel)
+{
+  // counts around powers of two, where the unhashed first level leaves run out
+  for (size_t count: {TX_TREE_HASH_PARALLEL_MIN_HASHES, TX_TREE_HASH_PARALLEL_MIN_HASHES + 1, TX_TREE_HASH_PARALLEL_MIN_HASHES * 2 - 1,
+      TX_TREE_HASH_PARALLEL_MIN_HASHES * 2, TX_TREE_HASH_PARALLEL_MIN_HASHES * 3 + 5})
+  {
+    std::vector<crypto::hash> hashes(count);
+    for (size_t i = 0; i < count; ++i)
+      hashes[i] = crypto::cn_fast_hash(&i, sizeof(i));
+    crypto::hash serial;
+    crypto::tree_hash(hashes.data(), hashes.size(), serial);
+    ASSERT_EQ(cryptonote::get_tx_tree_hash(hashes), serial);
+  }
+}
+
+TEST(Crypto, generate_key_derivations)
+{
+  const crypto::public_key tx_pub_key = rct::rct2pk(rct::pkGen());
+  std::vector<crypto::secret_key> view_keys(9);
+  for (auto &k: view_keys)
+    k = rct::rct2sk(rct::skGen());
+  std::vector<crypto::key_derivation> derivations(view_keys.size());
+  ASSERT_TRUE(crypto::generate_key_derivations(tx_pub_key, view_keys.data(), view_keys.size(), derivations.data()));
+  for (size_t n = 0; n < view_keys.size(); ++n)
+  {
+    crypto::key_derivation derivation;
+    ASSERT_TRUE(crypto::generate_key_derivation(tx_pub_key, view_keys[n], derivation));
+    ASSERT_TRUE(!memcmp(&derivation, &derivations[n], sizeof(derivation)));
+  }
+
+  crypto::public_key bad_key;
+  memset(&bad_key, 0xff, sizeof(bad_key));
+  ASSERT_FALSE(crypto::generate_key_derivations(bad_key, view_keys.data(), view_keys.size(), derivations.data()));
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/decoy_cache.h"
+
+TEST(decoy_cache, empty)
+{
+  tools::decoy_cache cache;
+  ASSERT_FALSE(cache.has_rct_distribution());
+  ASSERT_EQ(cache.rct_distribution_request_height(), 0);
+  ASSERT_EQ(cache.find_ring(0, 0, 11), nullptr);
+}
+
+TEST(decoy_cache, whole_distribution)
+{
+  tools::decoy_cache cache(2);
+  ASSERT_TRUE(cache.update_rct_distribution(5, {1, 2, 3, 4}));
+  ASSERT_TRUE(cache.has_rct_distribution());
+  ASSERT_EQ(cache.rct_start_height(), 5);
+  ASSERT_EQ(cache.rct_distribution(), std::vector<uint64_t>({1, 3, 6, 10}));
+  ASSERT_EQ(cache.rct_distribution_request_height(), 7);
+}
+
+TEST(decoy_cache, incremental_distribution)
+{
+  tools::decoy_cache cache(2);
+  ASSERT_TRUE(cache.update_rct_distribution(0, {1, 1, 1, 1}));
+  ASSERT_EQ(cache.rct_distribution_request_height(), 2);
+
+  // the last two blocks are replaced, eg after a reorg, and new ones added
+  ASSERT_TRUE(cache.update_rct_distribution(2, {5, 5, 5}));
+  ASSERT_EQ(cache.rct_distribution(), std::vector<uint64_t>({1, 2, 7, 12, 17}));
+  ASSERT_EQ(cache.rct_distribution_request_height(), 3);
+
+  // nothing new
+  ASSERT_TRUE(cache.update_rct_distribution(3, {5, 5}));
+  ASSERT_EQ(cache.rct_distribution(), std::vector<uint64_t>({1, 2, 7, 12, 17}));
+}
+
+TEST(decoy_cache, unmergeable_distribution)
+{
+  tools::decoy_cache cache(2);
+  ASSERT_TRUE(cache.update_rct_distribution(10, {1, 1, 1, 1}));
+
+  // gap after the cached distribution
+  ASSERT_FALSE(cache.update_rct_distribution(20, {1}));
+  ASSERT_FALSE(cache.has_rct_distribution());
+  ASSERT_EQ(cache.rct_distribution_request_height(), 0);
+
+  ASSERT_TRUE(cache.update_rct_distribution(10, {1, 1, 1, 1}));
+  // before the cached distribution
+  ASSERT_FALSE(cache.update_rct_distribution(5, {1}));
+  ASSERT_FALSE(cache.has_rct_distribution());
+}
+
+TEST(decoy_cache, rings)
+{
+  tools::decoy_cache cache;
+  std::vector<tools::decoy_cache::ring_entry> ring(3);
+  for (size_t i = 0; i < ring.size(); ++i)
+    std::get<0>(ring[i]) = 100 + i;
+
+  cache.add_ring(0, 101, ring);
+  ASSERT_EQ(cache.find_ring(0, 100, 3), nullptr);
+  ASSERT_EQ(cache.find_ring(5, 101, 3), nullptr);
+  // a ring is only reused for the same ring size
+  ASSERT_EQ(cache.find_ring(0, 101, 11), nullptr);
+
+  const std::vector<tools::decoy_cache::ring_entry> *found = cache.find_ring(0, 101, 3);
+  ASSERT_NE(found, nullptr);
+  ASSERT_EQ(std::get<0>((*found)[0]), 100);
+  ASSERT_EQ(std::get<0>((*found)[2]), 102);
+
+  ASSERT_TRUE(cache.update_rct_distribution(0, {1}));
+  cache.clear_rings();
+  ASSERT_EQ(cache.find_ring(0, 101, 3), nullptr);
+  ASSERT_TRUE(cache.has_rct_distribution());
+
+  cache.add_ring(0, 101, ring);
+  cache.clear();
+  ASSERT_EQ(cache.find_ring(0, 101, 3), nullptr);
+  ASSERT_FALSE(cache.has_rct_distribution());
+}
+
+TEST(decoy_cache, pinned_rings)
+{
+  tools::decoy_cache cache;
+  std::vector<tools::decoy_cache::ring_entry> ring(3);
+  for (size_t i = 0; i < ring.size(); ++i)
+    std::get<0>(ring[i]) = 100 + i;
+
+  ASSERT_FALSE(cache.pin_ring(0, 101, 1000));
+  cache.add_ring(0, 101, ring);
+  cache.add_ring(0, 102, ring);
+  ASSERT_TRUE(cache.pin_ring(0, 101, 1000));
+  ASSERT_EQ(cache.pinned_rings(), 1);
+
+  // pinned rings outlive the batch
+  cache.clear_rings();
+  ASSERT_NE(cache.find_ring(0, 101, 3), nullptr);
+  ASSERT_EQ(cache.find_ring(0, 102, 3), nullptr);
+  ASSERT_TRUE(cache.pin_ring(0, 101, 1000));
+
+  // a ring of another size picked in the batch does not hide the pinned one
+  cache.add_ring(0, 101, std::vector<tools::decoy_cache::ring_entry>(11));
+  ASSERT_NE(cache.find_ring(0, 101, 11), nullptr);
+  ASSERT_NE(cache.find_ring(0, 101, 3), nullptr);
+
+  cache.unpin_ring(0, 101);
+  ASSERT_EQ(cache.find_ring(0, 101, 3), nullptr);
+  ASSERT_NE(cache.find_ring(0, 101, 11), nullptr);
+
+  cache.add_ring(0, 103, ring);
+  cache.add_ring(0, 104, ring);
+  ASSERT_TRUE(cache.pin_ring(0, 103, 1000));
+  ASSERT_TRUE(cache.pin_ring(0, 104, 1000));
+  cache.unpin_rings();
+  ASSERT_EQ(cache.pinned_rings(), 0);
+  ASSERT_TRUE(cache.pin_ring(0, 103, 1000));
+  cache.clear();
+  ASSERT_EQ(cache.find_ring(0, 103, 3), nullptr);
+  ASSERT_EQ(cache.pinned_rings(), 0);
+}
+
+TEST(decoy_cache, pinned_rings_expire)
+{
+  tools::decoy_cache cache(10, 5);
+  std::vector<tools::decoy_cache::ring_entry> ring(3);
+
+  cache.add_ring(0, 101, ring);
+  cache.add_ring(0, 102, ring);
+  ASSERT_TRUE(cache.pin_ring(0, 101, 1000));
+  ASSERT_TRUE(cache.pin_ring(0, 102, 1003));
+  cache.clear_rings();
+
+  // pinning again does not make a ring younger
+  ASSERT_TRUE(cache.pin_ring(0, 101, 1004));
+
+  ASSERT_EQ(cache.expire_pinned_rings(1005), 0);
+  ASSERT_TRUE(cache.is_pinned(0, 101));
+  ASSERT_EQ(cache.expire_pinned_rings(1006), 1);
+  ASSERT_FALSE(cache.is_pinned(0, 101));
+  ASSERT_EQ(cache.find_ring(0, 101, 3), nullptr);
+  ASSERT_TRUE(cache.is_pinned(0, 102));
+  ASSERT_NE(cache.find_ring(0, 102, 3), nullptr);
+
+  // a reorg below the height it was pinned at drops it too
+  ASSERT_EQ(cache.expire_pinned_rings(1002), 1);
+  ASSERT_EQ(cache.pinned_rings(), 0);
+}
@@ -35,6 +35,7 @@
 
 #include "include_base_utils.h"
 #include "string_tools.h"
+#include "net/connection_basic.hpp"
 #include "net/levin_protocol_handler_async.h"
 #include "net/net_utils_base.h"
 #include "unit_tests_utils.h"
@@ -414,6 +415,28 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, notify_sends_shared_message)
+{
+  const int expected_command = 5615871;
+  const epee::byte_slice message{std::string(1024, 'n')};
+
+  test_connection_ptr conn = create_connection();
+
+  ASSERT_EQ(1, m_handler_config.notify(expected_command, message.clone(), conn->m_protocol_handler.get_connection_id()));
+  EXPECT_EQ(1, message.use_count());
+
+  const std::string send_data = conn->last_send_data();
+  ASSERT_EQ(sizeof(epee::levin::bucket_head2) + message.size(), send_data.size());
+  const epee::levin::bucket_head2 head = *reinterpret_cast<const epee::levin::bucket_head2*>(send_data.data());
+  EXPECT_EQ(LEVIN_SIGNATURE, head.m_signature);
+  EXPECT_EQ(message.size(), head.m_cb);
+  EXPECT_FALSE(head.m_have_to_return_data);
+  EXPECT_EQ(expected_command, head.m_command);
+  EXPECT_EQ(LEVIN_PACKET_REQUEST, head.m_flags);
+  EXPECT_EQ(LEVIN_PROTOCOL_VER_1, head.m_protocol_version);
+  EXPECT_EQ(std::string(1024, 'n'), send_data.substr(sizeof(head)));
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
@@ -527,6 +550,21 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_re
   ASSERT_EQ(2, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_request_followed_by_partial_request)
+{
+  prepare_buf();
+  const std::string request = m_buf;
+  m_buf.append(request.substr(0, sizeof(m_req_head) + 10));
+
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+
+  const std::string rest = request.substr(sizeof(m_req_head) + 10);
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(rest.data(), rest.size()));
+  ASSERT_EQ(2, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpected_response)
 {
   m_req_head.m_flags = LEVIN_PACKET_RESPONSE;
@@ -534,3 +572,109 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpe
 
   ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
 }
+
+namespace
+{
+  std::string wire_string(const epee::net_utils::send_queue& queue)
+  {
+    std::string out;
+    for (const epee::byte_slice& slice: queue.wire())
+      out.append(reinterpret_cast<const char*>(slice.data()), slice.size());
+    return out;
+  }
+}
+
+TEST(send_queue, high_priority_goes_first)
+{
+  using epee::net_utils::send_priority;
+  epee::net_utils::send_queue queue;
+  EXPECT_TRUE(queue.empty());
+
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"B"}}, epee::byte_slice{std::string{"bbb"}}, send_priority::bulk));
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"N"}}, epee::byte_slice{std::string{"nnn"}}, send_priority::normal));
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"H"}}, epee::byte_slice{std::string{"hhh"}}, send_priority::high));
+  EXPECT_FALSE(queue.empty());
+  EXPECT_EQ(4u, queue.pending_bytes(send_priority::high));
+  EXPECT_EQ(12u, queue.pending_bytes());
+  EXPECT_EQ(12u, queue.queued_bytes());
+
+  ASSERT_TRUE(queue.fill(1024, 0));
+  EXPECT_EQ("HhhhNnnnBbbb", wire_string(queue));
+  EXPECT_EQ(0u, queue.pending_bytes());
+  EXPECT_EQ(12u, queue.queued_bytes());
+
+  queue.pop_written(queue.wire().size());
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(0u, queue.queued_bytes());
+  EXPECT_FALSE(queue.fill(1024, 0));
+}
+
+TEST(send_queue, preempts_only_between_messages)
+{
+  using epee::net_utils::send_priority;
+  epee::net_utils::send_queue queue;
+
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"B"}}, epee::byte_slice{std::string(10, 'b')}, send_priority::bulk));
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"C"}}, epee::byte_slice{std::string(10, 'c')}, send_priority::bulk));
+
+  // a single byte of low water commits exactly one whole message, split in chunks
+  ASSERT_TRUE(queue.fill(1, 4));
+  EXPECT_EQ(4u, queue.wire().size());
+  EXPECT_EQ("B" + std::string(10, 'b'), wire_string(queue));
+
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"H"}}, epee::byte_slice{std::string{"hh"}}, send_priority::high));
+  queue.pop_written(2);
+  ASSERT_TRUE(queue.fill(1, 4));
+  EXPECT_EQ(std::string(6, 'b'), wire_string(queue));
+
+  queue.pop_written(queue.wire().size());
+  ASSERT_TRUE(queue.fill(1, 4));
+  EXPECT_EQ("Hhh", wire_string(queue));
+
+  queue.pop_written(queue.wire().size());
+  ASSERT_TRUE(queue.fill(1, 0));
+  EXPECT_EQ("C" + std::string(10, 'c'), wire_string(queue));
+  EXPECT_EQ(2u, queue.wire().size());
+}
+
+TEST(send_queue, limits_are_per_class)
+{
+  using epee::net_utils::send_priority;
+  epee::net_utils::send_queue queue;
+  queue.set_limit(send_priority::bulk, 8);
+
+  const uint64_t dropped = epee::net_utils::send_queue::get_stats()[size_t(send_priority::bulk)].dropped;
+
+  // a lone message is accepted even when it is over the limit
+  EXPECT_TRUE(queue.push(epee::byte_slice{std::string{"B"}}, epee::byte_slice{std::string(20, 'b')}, send_priority::bulk));
+  EXPECT_FALSE(queue.push(epee::byte_slice{std::string{"B"}}, epee::byte_slice{std::string{"b"}}, send_priority::bulk));
+  EXPECT_TRUE(queue.push(epee::byte_slice{std::string{"N"}}, epee::byte_slice{std::string(20, 'n')}, send_priority::normal));
+  EXPECT_EQ(21u, queue.pending_bytes(send_priority::bulk));
+  EXPECT_EQ(dropped + 1, epee::net_utils::send_queue::get_stats()[size_t(send_priority::bulk)].dropped);
+
+  // committed bytes no longer count against the class
+  ASSERT_TRUE(queue.fill(1024, 0));
+  EXPECT_TRUE(queue.push(epee::byte_slice{std::string{"B"}}, epee::byte_slice{std::string{"b"}}, send_priority::bulk));
+  EXPECT_TRUE(queue.push({}, {}, send_priority::bulk));
+  EXPECT_EQ(2u, queue.pending_bytes(send_priority::bulk));
+}
+
+TEST(send_queue, stats)
+{
+  using epee::net_utils::send_priority;
+  epee::net_utils::send_queue queue;
+
+  const epee::net_utils::send_queue::stats before = epee::net_utils::send_queue::get_stats();
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"H"}}, epee::byte_slice{std::string(9, 'h')}, send_priority::high));
+  ASSERT_TRUE(queue.push(epee::byte_slice{std::string{"H"}}, {}, send_priority::high));
+  ASSERT_TRUE(queue.fill(1024, 0));
+  const epee::net_utils::send_queue::stats after = epee::net_utils::send_queue::get_stats();
+
+  const size_t high = size_t(send_priority::high);
+  EXPECT_EQ(before[high].messages + 2, after[high].messages);
+  EXPECT_EQ(before[high].bytes + 11, after[high].bytes);
+  EXPECT_EQ(before[high].dropped, after[high].dropped);
+  EXPECT_LE(before[high].wait_us_max, after[high].wait_us_max);
+  EXPECT_EQ(before[size_t(send_priority::normal)].messages, after[size_t(send_priority::normal)].messages);
+  EXPECT_STREQ("bulk", epee::net_utils::to_string(send_priority::bulk));
+}
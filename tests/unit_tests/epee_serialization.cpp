@@ -0,0 +1,290 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage.h"
+#include "storages/portable_storage_stream.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  struct inner
+  {
+    uint32_t a;
+    std::string b;
+    std::vector<uint64_t> c;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a)
+      KV_SERIALIZE(b)
+      KV_SERIALIZE(c)
+    END_KV_SERIALIZE_MAP()
+
+    bool operator==(const inner& rhs) const { return a == rhs.a && b == rhs.b && c == rhs.c; }
+  };
+
+  // fields deliberately not in name order
+  struct outer
+  {
+    uint64_t u64;
+    int8_t i8;
+    double d;
+    bool flag;
+    std::string blob;
+    inner nested;
+    std::list<inner> items;
+    std::vector<std::string> strs;
+    std::vector<uint32_t> pods;
+    std::list<int16_t> shorts;
+    epee::serialization::storage_entry id;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(u64)
+      KV_SERIALIZE(i8)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(nested)
+      KV_SERIALIZE(items)
+      KV_SERIALIZE(strs)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(pods)
+      KV_SERIALIZE(shorts)
+      KV_SERIALIZE(id)
+    END_KV_SERIALIZE_MAP()
+
+    bool operator==(const outer& rhs) const
+    {
+      return u64 == rhs.u64 && i8 == rhs.i8 && d == rhs.d && flag == rhs.flag && blob == rhs.blob &&
+        nested == rhs.nested && items == rhs.items && strs == rhs.strs && pods == rhs.pods &&
+        shorts == rhs.shorts && boost::get<std::string>(id) == boost::get<std::string>(rhs.id);
+    }
+  };
+
+  // every level declared in name order, so both writers produce the same bytes
+  struct sorted
+  {
+    std::vector<uint64_t> a;
+    inner b;
+    std::list<inner> c;
+    std::string d;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a)
+      KV_SERIALIZE(b)
+      KV_SERIALIZE(c)
+      KV_SERIALIZE(d)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  std::string random_string(std::mt19937& rng, size_t max_size)
+  {
+    std::string s(rng() % (max_size + 1), 0);
+    for (char& c: s)
+      c = static_cast<char>(rng());
+    return s;
+  }
+
+  inner random_inner(std::mt19937& rng)
+  {
+    inner out{};
+    out.a = rng();
+    out.b = random_string(rng, 80);
+    out.c.resize(rng() % 100);
+    for (uint64_t& v: out.c)
+      v = (uint64_t(rng()) << 32) | rng();
+    return out;
+  }
+
+  outer random_outer(std::mt19937& rng)
+  {
+    outer out{};
+    out.u64 = (uint64_t(rng()) << 32) | rng();
+    out.i8 = static_cast<int8_t>(rng());
+    out.d = double(rng()) / 7;
+    out.flag = rng() & 1;
+    out.blob = random_string(rng, 300);
+    out.nested = random_inner(rng);
+    for (size_t n = rng() % 80; n; --n)
+      out.items.push_back(random_inner(rng));
+    for (size_t n = rng() % 70; n; --n)
+      out.strs.push_back(random_string(rng, 20));
+    for (size_t n = rng() % 40; n; --n)
+      out.pods.push_back(rng());
+    for (size_t n = rng() % 5; n; --n)
+      out.shorts.push_back(static_cast<int16_t>(rng()));
+    out.id = random_string(rng, 10);
+    return out;
+  }
+
+  template<typename T>
+  std::string store_legacy(T& value)
+  {
+    epee::serialization::portable_storage ps;
+    value.store(ps);
+    std::string out;
+    EXPECT_TRUE(ps.store_to_binary(out));
+    return out;
+  }
+
+  template<typename T>
+  bool load_legacy(T& value, const std::string& blob)
+  {
+    epee::serialization::portable_storage ps;
+    return ps.load_from_binary(blob) && value.load(ps);
+  }
+}
+
+TEST(portable_binary_writer, matches_tree_writer_in_name_order)
+{
+  std::mt19937 rng(1);
+  sorted value{};
+  value.a = {1, 2, 3};
+  value.b = random_inner(rng);
+  for (size_t i = 0; i < 100; ++i)
+    value.c.push_back(random_inner(rng));
+  value.d = "foo";
+
+  std::string streamed;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(value, streamed));
+  EXPECT_EQ(store_legacy(value), streamed);
+}
+
+TEST(portable_binary_writer, empty_object)
+{
+  sorted value{};
+  std::string streamed;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(value, streamed));
+  EXPECT_EQ(store_legacy(value), streamed);
+}
+
+TEST(portable_binary_writer, large_counts)
+{
+  for (const size_t count: {63, 64, 16383, 16384, 70000})
+  {
+    inner value{};
+    value.c.resize(count, 7);
+    std::string streamed;
+    ASSERT_TRUE(epee::serialization::store_t_to_binary(value, streamed));
+    EXPECT_EQ(store_legacy(value), streamed);
+
+    inner loaded{};
+    ASSERT_TRUE(epee::serialization::load_t_from_binary(loaded, streamed));
+    EXPECT_EQ(value, loaded);
+  }
+}
+
+TEST(portable_binary_writer, handle_after_close)
+{
+  epee::serialization::portable_binary_writer writer;
+  auto child = writer.open_section("child", nullptr, true);
+  ASSERT_NE(nullptr, child);
+  EXPECT_TRUE(writer.set_value("x", uint64_t(1), nullptr));
+  EXPECT_FALSE(writer.set_value("y", uint64_t(2), child));
+
+  std::string out;
+  EXPECT_TRUE(writer.store_to_binary(out));
+  EXPECT_FALSE(writer.store_to_binary(out));
+}
+
+TEST(portable_binary_reader, rejects_bad_header)
+{
+  epee::serialization::portable_binary_reader reader;
+  EXPECT_FALSE(reader.load_from_binary(std::string{}));
+  EXPECT_FALSE(reader.load_from_binary(std::string(9, 'x')));
+
+  inner value{};
+  std::string blob = epee::serialization::store_t_to_binary(value);
+  blob.resize(9);
+  EXPECT_FALSE(reader.load_from_binary(blob));
+}
+
+TEST(portable_binary, equivalent_to_portable_storage)
+{
+  std::mt19937 rng(2);
+  for (size_t i = 0; i < 200; ++i)
+  {
+    outer value = random_outer(rng);
+
+    const std::string streamed = epee::serialization::store_t_to_binary(value);
+    const std::string legacy = store_legacy(value);
+    EXPECT_EQ(legacy.size(), streamed.size());
+
+    outer from_streamed{};
+    ASSERT_TRUE(load_legacy(from_streamed, streamed));
+    EXPECT_EQ(value, from_streamed);
+
+    outer from_legacy{};
+    ASSERT_TRUE(epee::serialization::load_t_from_binary(from_legacy, legacy));
+    EXPECT_EQ(value, from_legacy);
+
+    outer round_trip{};
+    ASSERT_TRUE(epee::serialization::load_t_from_binary(round_trip, streamed));
+    EXPECT_EQ(value, round_trip);
+  }
+}
+
+TEST(portable_binary, corrupted_input_matches_portable_storage)
+{
+  std::mt19937 rng(3);
+  for (size_t i = 0; i < 2000; ++i)
+  {
+    outer value = random_outer(rng);
+    std::string blob = store_legacy(value);
+    for (size_t n = 1 + rng() % 3; n; --n)
+    {
+      switch (rng() % 3)
+      {
+        case 0: blob[9 + rng() % (blob.size() - 9)] = static_cast<char>(rng()); break;
+        case 1: blob.resize(9 + rng() % (blob.size() - 9)); break;
+        default: blob.erase(9 + rng() % (blob.size() - 9), 1 + rng() % 4); break;
+      }
+      if (blob.size() <= 9)
+        break;
+    }
+
+    epee::serialization::portable_storage legacy;
+    epee::serialization::portable_binary_reader streamed;
+    const bool legacy_ok = legacy.load_from_binary(blob);
+    ASSERT_EQ(legacy_ok, streamed.load_from_binary(blob));
+    if (!legacy_ok)
+      continue;
+
+    outer from_legacy{};
+    outer from_streamed{};
+    const bool loaded = from_legacy.load(legacy);
+    ASSERT_EQ(loaded, from_streamed.load(streamed));
+    if (loaded)
+      EXPECT_EQ(store_legacy(from_legacy), store_legacy(from_streamed));
+  }
+}
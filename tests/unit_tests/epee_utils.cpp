@@ -43,6 +43,7 @@
 
 #include "boost/archive/portable_binary_iarchive.hpp"
 #include "boost/archive/portable_binary_oarchive.hpp"
+#include "byte_slice.h"
 #include "hex.h"
 #include "net/net_utils_base.h"
 #include "net/local_ip.h"
@@ -374,6 +375,105 @@ TEST(Span, ToMutSpan)
   EXPECT_EQ((std::vector<unsigned>{1, 2, 3, 4}), mut);
 }
 
+TEST(ByteSlice, Construction)
+{
+  EXPECT_FALSE((can_construct<epee::byte_slice, const epee::byte_slice&>()));
+  EXPECT_TRUE(std::is_move_constructible<epee::byte_slice>());
+  EXPECT_TRUE(std::is_move_assignable<epee::byte_slice>());
+  EXPECT_TRUE(std::is_nothrow_move_constructible<epee::byte_slice>());
+  EXPECT_TRUE(std::is_nothrow_move_assignable<epee::byte_slice>());
+}
+
+TEST(ByteSlice, Empty)
+{
+  epee::byte_slice slice{};
+
+  EXPECT_TRUE(slice.empty());
+  EXPECT_EQ(0u, slice.size());
+  EXPECT_EQ(0, slice.use_count());
+  EXPECT_TRUE(slice.take_slice(10).empty());
+  EXPECT_TRUE(epee::byte_slice{std::string{}}.empty());
+  EXPECT_TRUE((epee::byte_slice{{epee::span<const std::uint8_t>{}}}.empty()));
+}
+
+TEST(ByteSlice, Concatenation)
+{
+  const std::string first = "abc";
+  const std::string second = "defgh";
+  const epee::byte_slice slice{{epee::strspan<std::uint8_t>(first), epee::strspan<std::uint8_t>(second)}};
+
+  ASSERT_EQ(8u, slice.size());
+  EXPECT_TRUE(boost::range::equal(std::string{"abcdefgh"}, slice));
+}
+
+TEST(ByteSlice, TakesOwnership)
+{
+  std::string source(1000, 'x');
+  const void* const data = source.data();
+
+  const epee::byte_slice slice{std::move(source)};
+  ASSERT_EQ(1000u, slice.size());
+  EXPECT_EQ(data, static_cast<const void*>(slice.data()));
+}
+
+TEST(ByteSlice, CloneShares)
+{
+  epee::byte_slice original{std::string{"shared"}};
+  EXPECT_EQ(1, original.use_count());
+  {
+    const epee::byte_slice clone = original.clone();
+    EXPECT_EQ(2, original.use_count());
+    EXPECT_EQ(original.data(), clone.data());
+    EXPECT_EQ(original.size(), clone.size());
+  }
+  EXPECT_EQ(1, original.use_count());
+
+  epee::byte_slice moved{std::move(original)};
+  EXPECT_TRUE(original.empty());
+  EXPECT_EQ(1, moved.use_count());
+  EXPECT_TRUE(boost::range::equal(std::string{"shared"}, moved));
+}
+
+TEST(ByteSlice, TakeSlice)
+{
+  epee::byte_slice slice{std::string{"0123456789"}};
+  const std::uint8_t* const data = slice.data();
+
+  epee::byte_slice head = slice.take_slice(4);
+  EXPECT_EQ(data, head.data());
+  EXPECT_TRUE(boost::range::equal(std::string{"0123"}, head));
+  EXPECT_TRUE(boost::range::equal(std::string{"456789"}, slice));
+  EXPECT_EQ(2, slice.use_count());
+
+  epee::byte_slice tail = slice.take_slice(100);
+  EXPECT_TRUE(slice.empty());
+  EXPECT_EQ(0, slice.use_count());
+  EXPECT_EQ(data + 4, tail.data());
+  EXPECT_TRUE(boost::range::equal(std::string{"456789"}, tail));
+  EXPECT_EQ(2, tail.use_count());
+
+  EXPECT_EQ(2u, tail.remove_prefix(2));
+  EXPECT_TRUE(boost::range::equal(std::string{"6789"}, tail));
+  EXPECT_EQ(4u, tail.remove_prefix(10));
+  EXPECT_TRUE(tail.empty());
+  EXPECT_EQ(1, head.use_count());
+}
+
+TEST(ByteSlice, GetSlice)
+{
+  const epee::byte_slice slice{std::string{"0123456789"}};
+
+  const epee::byte_slice middle = slice.get_slice(3, 7);
+  EXPECT_EQ(slice.data() + 3, middle.data());
+  EXPECT_TRUE(boost::range::equal(std::string{"3456"}, middle));
+  EXPECT_EQ(2, slice.use_count());
+
+  EXPECT_TRUE(slice.get_slice(5, 5).empty());
+  EXPECT_TRUE(boost::range::equal(std::string{"0123456789"}, slice.get_slice(0, 10)));
+  EXPECT_THROW(slice.get_slice(7, 3), std::out_of_range);
+  EXPECT_THROW(slice.get_slice(0, 11), std::out_of_range);
+}
+
 TEST(ToHex, String)
 {
   EXPECT_TRUE(epee::to_hex::string(nullptr).empty());
@@ -0,0 +1,419 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "file_io_utils.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/light_wallet_scanner.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  TestDB() { m_open = true; }
+
+  /// Returns the global index of the first output of the miner tx
+  uint64_t push_block(const cryptonote::block& blk, const std::vector<cryptonote::transaction>& txs)
+  {
+    const uint64_t global_index = add_tx(blk.miner_tx).front();
+    for (const cryptonote::transaction& tx : txs)
+      add_tx(tx);
+    blocks.push_back(blk);
+    hashes.push_back(cryptonote::get_block_hash(blk));
+    return global_index;
+  }
+
+  void pop_blocks(size_t n)
+  {
+    blocks.resize(blocks.size() - n);
+    hashes.resize(hashes.size() - n);
+  }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override {
+    if (height >= hashes.size())
+      throw cryptonote::BLOCK_DNE("no such block");
+    return hashes[height];
+  }
+  virtual cryptonote::blobdata get_block_blob(const crypto::hash& h) const override {
+    for (size_t i = 0; i < hashes.size(); ++i)
+      if (hashes[i] == h)
+        return cryptonote::block_to_blob(blocks[i]);
+    throw cryptonote::BLOCK_DNE("no such block");
+  }
+  virtual cryptonote::block get_block_from_height(const uint64_t& height) const override { return blocks.at(height); }
+  virtual cryptonote::block get_top_block() const override { return blocks.back(); }
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+    if (block_height)
+      *block_height = blocks.size() - 1;
+    return hashes.back();
+  }
+  virtual uint64_t get_top_block_timestamp() const override { return blocks.back().timestamp; }
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const override {
+    return std::vector<uint64_t>(std::min<uint64_t>(count, blocks.size() - start_height), 128);
+  }
+  virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override {
+    uint64_t tx_index;
+    if (!tx_exists(h, tx_index))
+      return false;
+    tx = tx_blobs[tx_index];
+    return true;
+  }
+  virtual bool tx_exists(const crypto::hash& h, uint64_t& tx_index) const override {
+    auto it = std::find(tx_hashes.begin(), tx_hashes.end(), h);
+    tx_index = std::distance(tx_hashes.begin(), it);
+    return it != tx_hashes.end();
+  }
+  virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_index, size_t n_txes) const override {
+    return std::vector<std::vector<uint64_t>>(tx_output_indices.begin() + tx_index, tx_output_indices.begin() + tx_index + n_txes);
+  }
+
+private:
+  std::vector<uint64_t> add_tx(const cryptonote::transaction& tx)
+  {
+    std::vector<uint64_t> indices;
+    for (const cryptonote::tx_out& out : tx.vout)
+      indices.push_back(num_outputs[tx.version > 1 ? 0 : out.amount]++);
+    tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+    tx_blobs.push_back(cryptonote::tx_to_blob(tx));
+    tx_output_indices.push_back(indices);
+    return indices;
+  }
+
+  std::vector<cryptonote::block> blocks;
+  std::vector<crypto::hash> hashes;
+  std::vector<crypto::hash> tx_hashes;
+  std::vector<cryptonote::blobdata> tx_blobs;
+  std::vector<std::vector<uint64_t>> tx_output_indices;
+  std::map<uint64_t, uint64_t> num_outputs;
+};
+
+const std::pair<uint8_t, uint64_t> hard_forks[] = {std::make_pair(1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)};
+const cryptonote::test_options test_options = {hard_forks, 5000};
+
+const uint64_t MINER_AMOUNT = 1000;
+
+cryptonote::tx_out make_output(const cryptonote::account_public_address& to, const cryptonote::keypair& tx_key, size_t index, uint64_t amount)
+{
+  crypto::key_derivation derivation;
+  crypto::generate_key_derivation(to.m_view_public_key, tx_key.sec, derivation);
+  crypto::public_key out_key;
+  crypto::derive_public_key(derivation, index, to.m_spend_public_key, out_key);
+
+  cryptonote::tx_out out;
+  out.amount = amount;
+  out.target = cryptonote::txout_to_key(out_key);
+  return out;
+}
+
+class LightWalletScannerTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("light-wallet-scanner-%%%%-%%%%");
+    boost::filesystem::create_directories(dir);
+
+    account.generate();
+    other.generate();
+
+    db = new TestDB();
+    push_block(other.get_keys().m_account_address);
+    txpool.reset(new cryptonote::tx_memory_pool(*blockchain));
+    blockchain.reset(new cryptonote::Blockchain(*txpool));
+    ASSERT_TRUE(blockchain->init(db, cryptonote::FAKECHAIN, true, &test_options, 1));
+
+    open_scanner();
+  }
+
+  virtual void TearDown()
+  {
+    scanner.reset();
+    blockchain.reset();
+    txpool.reset();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(dir, ec);
+  }
+
+  void open_scanner(size_t max_derivations_per_sync = cryptonote::LightWalletScanner::DEFAULT_MAX_DERIVATIONS_PER_SYNC)
+  {
+    scanner.reset();
+    scanner.reset(new cryptonote::LightWalletScanner(*blockchain, max_derivations_per_sync));
+    scanner->set_enabled(true);
+    scanner->init_storages(dir.string());
+  }
+
+  /// Adds a block whose miner tx pays \p to, and returns the global index of that output
+  uint64_t push_block(const cryptonote::account_public_address& to, const std::vector<cryptonote::transaction>& txs = {})
+  {
+    const uint64_t height = db->height();
+
+    cryptonote::block b;
+    b.major_version = 1;
+    b.minor_version = 0;
+    b.timestamp = 1000000 + height * DIFFICULTY_TARGET_V2;
+    b.prev_id = height ? db->top_block_hash() : crypto::null_hash;
+    b.nonce = crypto::rand<uint32_t>();
+    b.miner_tx.version = 1;
+    b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    cryptonote::txin_gen in;
+    in.height = height;
+    b.miner_tx.vin.push_back(in);
+    const cryptonote::keypair tx_key = cryptonote::keypair::generate(hw::get_device("default"));
+    cryptonote::add_tx_pub_key_to_extra(b.miner_tx, tx_key.pub);
+    b.miner_tx.vout.push_back(make_output(to, tx_key, 0, MINER_AMOUNT));
+    for (const cryptonote::transaction& tx : txs)
+      b.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+
+    return db->push_block(b, txs);
+  }
+
+  /// A pre-rct tx spending the given output, with key image \p key_image
+  cryptonote::transaction make_spend(uint64_t global_index, const crypto::key_image& key_image)
+  {
+    cryptonote::transaction tx;
+    tx.version = 1;
+    tx.unlock_time = 0;
+    cryptonote::txin_to_key in;
+    in.amount = MINER_AMOUNT;
+    in.key_offsets.push_back(global_index);
+    in.k_image = key_image;
+    tx.vin.push_back(in);
+    const cryptonote::keypair tx_key = cryptonote::keypair::generate(hw::get_device("default"));
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_key.pub);
+    tx.vout.push_back(make_output(other.get_keys().m_account_address, tx_key, 0, MINER_AMOUNT));
+    tx.signatures.push_back(std::vector<crypto::signature>(1));
+    return tx;
+  }
+
+  bool login(bool create_account, bool& new_address)
+  {
+    return scanner->login(account.get_keys().m_account_address, account.get_keys().m_view_secret_key, create_account, new_address);
+  }
+
+  cryptonote::LightWalletScanner::account_data get_data()
+  {
+    cryptonote::LightWalletScanner::account_data data;
+    EXPECT_TRUE(scanner->get_account_data(account.get_keys().m_account_address, account.get_keys().m_view_secret_key, data));
+    return data;
+  }
+
+  boost::filesystem::path dir;
+  cryptonote::account_base account, other;
+  TestDB *db;
+  std::unique_ptr<cryptonote::Blockchain> blockchain;
+  std::unique_ptr<cryptonote::tx_memory_pool> txpool;
+  std::unique_ptr<cryptonote::LightWalletScanner> scanner;
+};
+
+}
+
+TEST_F(LightWalletScannerTest, login_and_create)
+{
+  bool new_address = true;
+
+  // the view key must be the address' one
+  ASSERT_FALSE(scanner->login(account.get_keys().m_account_address, other.get_keys().m_view_secret_key, true, new_address));
+  ASSERT_FALSE(new_address);
+
+  ASSERT_FALSE(login(false, new_address));
+  ASSERT_FALSE(new_address);
+
+  ASSERT_TRUE(login(true, new_address));
+  ASSERT_TRUE(new_address);
+
+  ASSERT_TRUE(login(false, new_address));
+  ASSERT_FALSE(new_address);
+
+  const cryptonote::LightWalletScanner::account_data data = get_data();
+  ASSERT_EQ(db->height(), data.start_height);
+  ASSERT_EQ(db->height(), data.scanned_height);
+  ASSERT_TRUE(data.outputs.empty());
+  ASSERT_TRUE(data.spends.empty());
+}
+
+TEST_F(LightWalletScannerTest, outputs_spends_and_rescan)
+{
+  const cryptonote::account_public_address& address = account.get_keys().m_account_address;
+
+  const uint64_t early_output = push_block(address);
+  push_block(other.get_keys().m_account_address);
+
+  bool new_address;
+  ASSERT_TRUE(login(true, new_address));
+
+  const uint64_t start_height = db->height();
+  const uint64_t output = push_block(address);
+  push_block(address);
+  const crypto::key_image key_image = crypto::rand<crypto::key_image>();
+  push_block(other.get_keys().m_account_address, {make_spend(output, key_image)});
+
+  scanner->synchronize();
+
+  // only what came after the registration
+  cryptonote::LightWalletScanner::account_data data = get_data();
+  ASSERT_EQ(start_height, data.start_height);
+  ASSERT_EQ(db->height(), data.scanned_height);
+  ASSERT_EQ(2, data.outputs.size());
+  ASSERT_EQ(output, data.outputs[0].global_index);
+  ASSERT_EQ(MINER_AMOUNT, data.outputs[0].amount);
+  ASSERT_EQ(start_height, data.outputs[0].height);
+  ASSERT_TRUE(data.outputs[0].coinbase);
+  ASSERT_EQ(1, data.spends.size());
+  ASSERT_EQ(output, data.spends[0].global_index);
+  ASSERT_EQ(key_image, data.spends[0].key_image);
+  ASSERT_EQ(MINER_AMOUNT, data.spends[0].amount);
+  ASSERT_EQ(0, data.spends[0].mixin);
+
+  // everything is found again, with the earlier output
+  ASSERT_TRUE(scanner->rescan(address, account.get_keys().m_view_secret_key, 0));
+  data = get_data();
+  ASSERT_EQ(0, data.scanned_height);
+  ASSERT_TRUE(data.outputs.empty());
+
+  scanner->synchronize();
+
+  data = get_data();
+  ASSERT_EQ(db->height(), data.scanned_height);
+  ASSERT_EQ(3, data.outputs.size());
+  ASSERT_EQ(early_output, data.outputs[0].global_index);
+  ASSERT_EQ(1, data.spends.size());
+}
+
+TEST_F(LightWalletScannerTest, reorg)
+{
+  const cryptonote::account_public_address& address = account.get_keys().m_account_address;
+
+  bool new_address;
+  ASSERT_TRUE(login(true, new_address));
+
+  push_block(address);
+  push_block(address);
+  push_block(address);
+  scanner->synchronize();
+  ASSERT_EQ(3, get_data().outputs.size());
+
+  // the last two blocks are replaced by blocks paying someone else
+  db->pop_blocks(2);
+  push_block(other.get_keys().m_account_address);
+  push_block(other.get_keys().m_account_address);
+  push_block(other.get_keys().m_account_address);
+  scanner->synchronize();
+
+  const cryptonote::LightWalletScanner::account_data data = get_data();
+  ASSERT_EQ(db->height(), data.scanned_height);
+  ASSERT_EQ(1, data.outputs.size());
+  ASSERT_EQ(db->height() - 4, data.outputs[0].height);
+}
+
+TEST_F(LightWalletScannerTest, view_key_is_not_stored)
+{
+  const cryptonote::account_public_address& address = account.get_keys().m_account_address;
+
+  bool new_address;
+  ASSERT_TRUE(login(true, new_address));
+  push_block(address);
+  scanner->synchronize();
+  ASSERT_EQ(1, get_data().outputs.size());
+
+  // nothing in the database but its owner can read it, and the view key isn't in there
+  scanner.reset();
+  const boost::filesystem::path db_dir = dir / "lightwallet";
+#ifndef _WIN32
+  ASSERT_EQ(boost::filesystem::owner_all, boost::filesystem::status(db_dir).permissions());
+  ASSERT_EQ(boost::filesystem::owner_read | boost::filesystem::owner_write, boost::filesystem::status(db_dir / "data.mdb").permissions());
+#endif
+  std::string contents;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string((db_dir / "data.mdb").string(), contents));
+  const crypto::secret_key& view_secret_key = account.get_keys().m_view_secret_key;
+  ASSERT_EQ(std::string::npos, contents.find(std::string((const char*)&view_secret_key, sizeof(view_secret_key))));
+
+  // after a restart, the account is only scanned again once its wallet has called in
+  open_scanner();
+  push_block(address);
+  scanner->synchronize();
+  cryptonote::LightWalletScanner::account_data data = get_data();
+  ASSERT_EQ(db->height() - 1, data.scanned_height);
+  ASSERT_EQ(1, data.outputs.size());
+
+  scanner->synchronize();
+  data = get_data();
+  ASSERT_EQ(db->height(), data.scanned_height);
+  ASSERT_EQ(2, data.outputs.size());
+}
+
+TEST_F(LightWalletScannerTest, bounded_derivations)
+{
+  const cryptonote::account_public_address& address = account.get_keys().m_account_address;
+  const cryptonote::account_public_address& other_address = other.get_keys().m_account_address;
+
+  // one derivation per call: one block, for one account
+  open_scanner(1);
+
+  bool new_address;
+  ASSERT_TRUE(login(true, new_address));
+  const uint64_t start_height = db->height();
+  push_block(address);
+  push_block(address);
+  push_block(address);
+  scanner->synchronize();
+  ASSERT_EQ(start_height + 1, get_data().scanned_height);
+  ASSERT_EQ(1, get_data().outputs.size());
+
+  ASSERT_TRUE(scanner->login(other_address, other.get_keys().m_view_secret_key, true, new_address));
+  push_block(other_address);
+
+  // the lagging account goes first
+  scanner->synchronize();
+  scanner->synchronize();
+  ASSERT_EQ(start_height + 3, get_data().scanned_height);
+  ASSERT_EQ(3, get_data().outputs.size());
+  cryptonote::LightWalletScanner::account_data other_data;
+  ASSERT_TRUE(scanner->get_account_data(other_address, other.get_keys().m_view_secret_key, other_data));
+  ASSERT_EQ(start_height + 3, other_data.scanned_height);
+
+  // then both scan the last block, over two calls
+  scanner->synchronize();
+  ASSERT_TRUE(scanner->get_account_data(other_address, other.get_keys().m_view_secret_key, other_data));
+  ASSERT_EQ(2 * db->height() - 1, get_data().scanned_height + other_data.scanned_height);
+  scanner->synchronize();
+  ASSERT_TRUE(scanner->get_account_data(other_address, other.get_keys().m_view_secret_key, other_data));
+  ASSERT_EQ(db->height(), get_data().scanned_height);
+  ASSERT_EQ(db->height(), other_data.scanned_height);
+  ASSERT_EQ(1, other_data.outputs.size());
+  ASSERT_EQ(3, get_data().outputs.size());
+}
@@ -30,8 +30,11 @@
 
 #include "gtest/gtest.h"
 
+#include "misc_os_dependent.h"
 #include "wallet/wallet2.h"
+#include "wallet_accessor_test.h"
 #include <string>
+#include <unordered_set>
 
 static tools::wallet2::transfer_container make_transfers_container(size_t N)
 {
@@ -218,3 +221,245 @@ TEST(select_outputs, same_distribution)
   MDEBUG("avg_dev: " << avg_dev);
   ASSERT_LT(avg_dev, 0.015);
 }
+
+TEST(select_outputs, decoys_by_age)
+{
+  static const size_t NPICKS = 1000;
+  std::vector<uint64_t> offsets;
+
+  MKOFFSETS(300000, 20);
+  cryptonote::gamma_picker picker(offsets);
+
+  // distinct picks, with the gamma median age rather than the uniform one (over 200 days)
+  std::unordered_set<uint64_t> picked;
+  const std::vector<uint64_t> outputs = cryptonote::pick_decoy_outputs(&picker, n_outs, NPICKS, picked);
+  ASSERT_EQ(NPICKS, outputs.size());
+  ASSERT_EQ(NPICKS, picked.size());
+  std::vector<double> ages;
+  for (uint64_t o: outputs)
+  {
+    ASSERT_LT(o, n_outs);
+    ages.push_back((n_outs - 1 - o) * 120. / 20);
+  }
+  double median = epee::misc_utils::median(ages);
+  MDEBUG("median age: " << median / 86400. << " days");
+  ASSERT_GE(median, 1 * 86400);
+  ASSERT_LE(median, 2 * 86400);
+
+  ages.clear();
+  picked.clear();
+  for (uint64_t o: cryptonote::pick_decoy_outputs(nullptr, n_outs, NPICKS, picked))
+    ages.push_back((n_outs - 1 - o) * 120. / 20);
+  ASSERT_GE(epee::misc_utils::median(ages), 100 * 86400);
+}
+
+TEST(select_outputs, decoys_fall_back_to_uniform)
+{
+  std::vector<uint64_t> offsets;
+
+  // only the outputs of the first few blocks are old enough for the gamma picker
+  MKOFFSETS(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE + 5, 1);
+  cryptonote::gamma_picker picker(offsets);
+
+  std::unordered_set<uint64_t> picked({0});
+  const std::vector<uint64_t> outputs = cryptonote::pick_decoy_outputs(&picker, n_outs, n_outs - 1, picked);
+  ASSERT_EQ(n_outs - 1, outputs.size());
+  ASSERT_EQ(n_outs, picked.size());
+  ASSERT_EQ(outputs.end(), std::find(outputs.begin(), outputs.end(), 0));
+}
+
+TEST(select_outputs, uniform_among_unrelated)
+{
+  static const size_t NPICKS = 30000;
+  tools::wallet2 w;
+
+  // outputs 1, 3 and 5 are the only ones unrelated to the selected output 0,
+  // and must all be picked equally often
+  tools::wallet2::transfer_container transfers = make_transfers_container(6);
+  transfers[1].m_block_height = 800;
+  transfers[3].m_block_height = 850;
+  transfers[5].m_block_height = 900;
+  std::vector<int> picks(transfers.size(), 0);
+  for (size_t n = 0; n < NPICKS; ++n)
+  {
+    std::vector<size_t> unused_indices({1, 2, 3, 4, 5});
+    std::vector<size_t> selected({0});
+    ++picks[w.pop_best_value_from(transfers, unused_indices, selected)];
+  }
+  ASSERT_EQ(0, picks[0] + picks[2] + picks[4]);
+  for (size_t idx: {1, 3, 5})
+  {
+    MDEBUG("output " << idx << " picked " << picks[idx] << "/" << NPICKS);
+    ASSERT_LT(fabs(picks[idx] / (double)NPICKS - 1 / 3.), 0.02);
+  }
+}
+
+TEST(select_outputs, unspent_index)
+{
+  tools::unspent_output_index index;
+  index.insert(0, 0, 50, 3);
+  index.insert(0, 1, 20, 0);
+  index.insert(0, 1, 10, 1);
+  index.insert(0, 1, 30, 2);
+  index.insert(0, 1, 20, 4);
+  index.insert(1, 1, 40, 5);
+  index.insert(0, 1, 10, 1);
+  ASSERT_EQ(6, index.size());
+
+  // by amount then transfer index, within the subaddress only
+  std::vector<size_t> found;
+  tools::unspent_output_index::range_type range = index.range(0, 1, 15);
+  for (auto i = range.first; i != range.second; ++i)
+    found.push_back(tools::unspent_output_index::index_of(*i));
+  ASSERT_EQ(std::vector<size_t>({0, 4, 2}), found);
+
+  range = index.range(0, 1, 31);
+  ASSERT_TRUE(range.first == range.second);
+
+  found.clear();
+  range = index.account_range(0);
+  for (auto i = range.first; i != range.second; ++i)
+    found.push_back(tools::unspent_output_index::index_of(*i));
+  ASSERT_EQ(std::vector<size_t>({3, 1, 0, 4, 2}), found);
+
+  index.erase(0, 1, 20, 0);
+  index.erase(0, 1, 20, 7);
+  ASSERT_EQ(5, index.size());
+  ASSERT_FALSE(index.contains(0, 1, 20, 0));
+  ASSERT_TRUE(index.contains(0, 1, 20, 4));
+  range = index.range(0, 1, 15);
+  ASSERT_EQ(4, tools::unspent_output_index::index_of(*range.first));
+}
+
+TEST(select_outputs, unspent_index_matches_scan)
+{
+  static const size_t N_OUTPUTS = 2000;
+  static const uint32_t N_SUBADDRESSES = 5;
+  tools::wallet2 w;
+
+  // outputs received over many blocks by a few subaddresses, with spread out amounts
+  tools::wallet2::transfer_container transfers = make_transfers_container(N_OUTPUTS);
+  tools::unspent_output_index index;
+  std::vector<size_t> unused_indices;
+  for (size_t n = 0; n < N_OUTPUTS; ++n)
+  {
+    tools::wallet2::transfer_details &td = transfers[n];
+    td.m_block_height = 1000 + n / 4;
+    td.m_amount = 1 + n * 7919 % 100003;
+    td.m_subaddr_index.minor = n % N_SUBADDRESSES;
+    index.insert(td.m_subaddr_index.major, td.m_subaddr_index.minor, td.amount(), n);
+    unused_indices.push_back(n);
+  }
+
+  // the index finds the smallest output of enough size, as a scan would
+  for (uint32_t minor = 0; minor < N_SUBADDRESSES; ++minor)
+  {
+    for (uint64_t needed = 0; needed <= 100010; needed += 997)
+    {
+      const tools::unspent_output_index::range_type range = index.range(0, minor, needed);
+      const size_t found = range.first == range.second ? N_OUTPUTS : tools::unspent_output_index::index_of(*range.first);
+      size_t expected = N_OUTPUTS;
+      for (size_t n = 0; n < N_OUTPUTS; ++n)
+      {
+        const tools::wallet2::transfer_details &td = transfers[n];
+        if (td.m_subaddr_index.minor == minor && td.amount() >= needed && (expected == N_OUTPUTS || td.amount() < transfers[expected].amount()))
+          expected = n;
+      }
+      ASSERT_EQ(expected, found);
+    }
+  }
+
+  // the inputs picked for a tx are unrelated to each other
+  std::vector<size_t> selected;
+  for (size_t n = 0; n < 16; ++n)
+    selected.push_back(w.pop_best_value_from(transfers, unused_indices, selected));
+  ASSERT_EQ(N_OUTPUTS - selected.size(), unused_indices.size());
+  for (size_t n = 0; n < selected.size(); ++n)
+    for (size_t m = n + 1; m < selected.size(); ++m)
+    {
+      const uint64_t h0 = transfers[selected[n]].m_block_height, h1 = transfers[selected[m]].m_block_height;
+      ASSERT_GE(h0 > h1 ? h0 - h1 : h1 - h0, 10);
+    }
+}
+
+// outputs 2 and 3 are kept ready for rta transactions with 10 decoys, output 5 would fit
+// 250 better than any ready one
+static void make_rta_wallet(tools::wallet2 &w)
+{
+  static const uint64_t amounts[] = {100, 200, 300, 500, 1000, 260};
+  static const uint32_t minors[] = {0, 1, 0, 1, 1, 0};
+  tools::hashchain &blockchain = wallet_accessor_test::get_blockchain(w);
+  while (blockchain.size() < 1100)
+    blockchain.push_back(crypto::null_hash);
+  tools::wallet2::transfer_container &transfers = wallet_accessor_test::get_transfers(w);
+  transfers = make_transfers_container(6);
+  for (size_t n = 0; n < transfers.size(); ++n)
+  {
+    transfers[n].m_amount = amounts[n];
+    transfers[n].m_subaddr_index.minor = minors[n];
+    transfers[n].m_global_output_index = n;
+    transfers[n].m_rct = true;
+  }
+  wallet_accessor_test::rebuild_unspent_index(w);
+  wallet_accessor_test::set_rta_inputs(w, {2, 3}, 0, 10);
+}
+
+TEST(select_outputs, rta_inputs_ready_first)
+{
+  tools::wallet2 w;
+  make_rta_wallet(w);
+
+  // the smallest ready input which covers the amount, though output 5 is closer
+  uint64_t found_money;
+  ASSERT_EQ(std::vector<size_t>({2}), wallet_accessor_test::select_rta_inputs(w, 250, 10, 0, {}, found_money));
+  ASSERT_EQ(300, found_money);
+  ASSERT_EQ(1, w.get_last_rta_tx_timings().ready_inputs);
+  ASSERT_EQ(0, w.get_last_rta_tx_timings().other_inputs);
+
+  // the largest ready inputs first when none covers it alone
+  ASSERT_EQ(std::vector<size_t>({3, 2}), wallet_accessor_test::select_rta_inputs(w, 700, 10, 0, {}, found_money));
+  ASSERT_EQ(800, found_money);
+}
+
+TEST(select_outputs, rta_inputs_fallback)
+{
+  tools::wallet2 w;
+  make_rta_wallet(w);
+
+  // the ready inputs, then the smallest other output which covers what is left
+  uint64_t found_money;
+  ASSERT_EQ(std::vector<size_t>({3, 2, 4}), wallet_accessor_test::select_rta_inputs(w, 1200, 10, 0, {}, found_money));
+  ASSERT_EQ(1800, found_money);
+  ASSERT_EQ(2, w.get_last_rta_tx_timings().ready_inputs);
+  ASSERT_EQ(1, w.get_last_rta_tx_timings().other_inputs);
+
+  // inputs kept ready for another ring size are not preferred
+  ASSERT_EQ(std::vector<size_t>({5}), wallet_accessor_test::select_rta_inputs(w, 250, 15, 0, {}, found_money));
+  ASSERT_EQ(0, w.get_last_rta_tx_timings().ready_inputs);
+
+  // nor spent ones
+  wallet_accessor_test::get_transfers(w)[2].m_spent = true;
+  ASSERT_EQ(std::vector<size_t>({3}), wallet_accessor_test::select_rta_inputs(w, 250, 10, 0, {}, found_money));
+
+  // not enough
+  ASSERT_EQ(5, wallet_accessor_test::select_rta_inputs(w, 5000, 10, 0, {}, found_money).size());
+  ASSERT_EQ(2060, found_money);
+}
+
+TEST(select_outputs, rta_inputs_subaddr_indices)
+{
+  tools::wallet2 w;
+  make_rta_wallet(w);
+
+  // only the ready input of subaddress 1
+  uint64_t found_money;
+  ASSERT_EQ(std::vector<size_t>({3}), wallet_accessor_test::select_rta_inputs(w, 250, 10, 0, {1}, found_money));
+
+  // the ready input of subaddress 0, then its other outputs, largest first as none covers the rest
+  ASSERT_EQ(std::vector<size_t>({2, 5, 0}), wallet_accessor_test::select_rta_inputs(w, 600, 10, 0, {0}, found_money));
+  ASSERT_EQ(660, found_money);
+
+  // no output of the account in another subaddress
+  ASSERT_TRUE(wallet_accessor_test::select_rta_inputs(w, 250, 10, 0, {7}, found_money).empty());
+  ASSERT_EQ(0, found_money);
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/rct_ver_cache.h"
+
+static crypto::hash make_key(unsigned char n)
+{
+  crypto::hash key = crypto::null_hash;
+  key.data[0] = n;
+  return key;
+}
+
+TEST(rct_ver_cache, evicts_oldest)
+{
+  cryptonote::rct_ver_cache cache(3);
+  for (unsigned char n = 0; n < 5; ++n)
+    cache.add(make_key(n));
+  ASSERT_EQ(cache.size(), 3);
+  ASSERT_FALSE(cache.contains(make_key(0)));
+  ASSERT_FALSE(cache.contains(make_key(1)));
+  ASSERT_TRUE(cache.contains(make_key(2)));
+  ASSERT_TRUE(cache.contains(make_key(4)));
+}
+
+TEST(rct_ver_cache, add_twice)
+{
+  cryptonote::rct_ver_cache cache(2);
+  cache.add(make_key(0));
+  cache.add(make_key(1));
+  cache.add(make_key(0));
+  ASSERT_EQ(cache.size(), 2);
+  cache.add(make_key(2));
+  ASSERT_FALSE(cache.contains(make_key(0)));
+  ASSERT_TRUE(cache.contains(make_key(1)));
+  ASSERT_TRUE(cache.contains(make_key(2)));
+}
+
+TEST(rct_ver_cache, erase)
+{
+  cryptonote::rct_ver_cache cache(2);
+  ASSERT_FALSE(cache.erase(make_key(0)));
+  cache.add(make_key(0));
+  ASSERT_TRUE(cache.erase(make_key(0)));
+  ASSERT_FALSE(cache.contains(make_key(0)));
+  ASSERT_EQ(cache.size(), 0);
+  ASSERT_FALSE(cache.erase(make_key(0)));
+}
+
+TEST(rct_ver_cache, erased_then_added_again_is_not_evicted_early)
+{
+  cryptonote::rct_ver_cache cache(2);
+  cache.add(make_key(0));
+  cache.add(make_key(1));
+  ASSERT_TRUE(cache.erase(make_key(0)));
+  cache.add(make_key(0));
+
+  // 1 is now the oldest, the re-added 0 must survive its eviction
+  cache.add(make_key(2));
+  ASSERT_FALSE(cache.contains(make_key(1)));
+  ASSERT_TRUE(cache.contains(make_key(0)));
+  ASSERT_TRUE(cache.contains(make_key(2)));
+  ASSERT_EQ(cache.size(), 2);
+
+  cache.add(make_key(3));
+  ASSERT_FALSE(cache.contains(make_key(0)));
+  ASSERT_TRUE(cache.contains(make_key(2)));
+  ASSERT_TRUE(cache.contains(make_key(3)));
+}
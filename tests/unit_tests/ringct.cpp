@@ -37,6 +37,7 @@
 #include "ringct/rctTypes.h"
 #include "ringct/rctSigs.h"
 #include "ringct/rctOps.h"
+#include "ringct/point_cache.h"
 #include "device/device.hpp"
 
 using namespace std;
@@ -137,6 +138,71 @@ TEST(ringct, MG_sigs)
         ASSERT_FALSE(MLSAG_Ver(message, P, IIccss, R));
 }
 
+TEST(ringct, MG_sigs_simple_batch)
+{
+    // rings share decoys, so ring members are looked up more than once per batch
+    const size_t n_inputs = 5, ring_size = 4;
+    ctkeyV decoys(7);
+    for (ctkey &decoy: decoys)
+    {
+        decoy.dest = pkGen();
+        decoy.mask = pkGen();
+    }
+
+    keyV messages(n_inputs), C(n_inputs);
+    std::vector<ctkeyV> pubs(n_inputs);
+    std::vector<mgSig> mgs(n_inputs);
+    for (size_t k = 0; k < n_inputs; ++k)
+    {
+        ctkey sk, pk;
+        std::tie(sk, pk) = ctskpkGen(1000 + k);
+        const unsigned int ind = k % ring_size;
+        for (size_t j = 0; j < ring_size; ++j)
+            pubs[k].push_back(j == ind ? pk : decoys[(k + j) % decoys.size()]);
+        const key a = skGen();
+        C[k] = commit(1000 + k, a);
+        messages[k] = skGen();
+        mgs[k] = proveRctMGSimple(messages[k], pubs[k], sk, a, C[k], NULL, NULL, ind, hw::get_device("default"));
+    }
+
+    const auto make_inputs = [&]() {
+        std::vector<mgSimpleInput> inputs;
+        for (size_t k = 0; k < n_inputs; ++k)
+            inputs.push_back({&messages[k], &mgs[k], &pubs[k], &C[k]});
+        return inputs;
+    };
+
+    std::deque<bool> results;
+    ASSERT_TRUE(verRctMGSimple(make_inputs(), results));
+    ASSERT_EQ(n_inputs, results.size());
+    for (size_t k = 0; k < n_inputs; ++k)
+    {
+        ASSERT_TRUE(results[k]);
+        ASSERT_TRUE(verRctMGSimple(messages[k], mgs[k], pubs[k], C[k]));
+    }
+
+    // a bad signature only fails its own input
+    const key saved = mgs[2].ss[1][0];
+    mgs[2].ss[1][0] = skGen();
+    ASSERT_FALSE(verRctMGSimple(make_inputs(), results));
+    for (size_t k = 0; k < n_inputs; ++k)
+        ASSERT_EQ(k != 2, results[k]);
+    ASSERT_FALSE(verRctMGSimple(messages[2], mgs[2], pubs[2], C[2]));
+    mgs[2].ss[1][0] = saved;
+
+    // so does a ring member that is not a point
+    key bad;
+    ge_p3 p3;
+    do bad = skGen(); while (ge_frombytes_vartime(&p3, bad.bytes) == 0);
+    pubs[3][1].dest = bad;
+    ASSERT_FALSE(verRctMGSimple(make_inputs(), results));
+    for (size_t k = 0; k < n_inputs; ++k)
+        ASSERT_EQ(k != 3, results[k]);
+
+    ASSERT_TRUE(verRctMGSimple(std::vector<mgSimpleInput>(), results));
+    ASSERT_TRUE(results.empty());
+}
+
 TEST(ringct, range_proofs)
 {
         //Ring CT Stuff
@@ -1062,6 +1128,71 @@ TEST(ringct, H)
   ASSERT_EQ(memcmp(&p3, &ge_p3_H, sizeof(ge_p3)), 0);
 }
 
+TEST(ringct, scalarmultH_table)
+{
+  for (int i = 0; i < 64; ++i)
+  {
+    rct::key a = rct::skGen(), b = rct::skGen();
+    if (i & 1)
+      a.bytes[31] |= 0x70;
+    ASSERT_EQ(rct::scalarmultH(a), rct::scalarmultKey(rct::H, a));
+    rct::key aGbH;
+    rct::addKeys2(aGbH, b, a, rct::H);
+    ASSERT_EQ(aGbH, rct::addKeys(rct::scalarmultBase(b), rct::scalarmultKey(rct::H, a)));
+  }
+  ASSERT_EQ(rct::scalarmultH(rct::zero()), rct::identity());
+  ASSERT_EQ(rct::scalarmultH(rct::identity()), rct::H);
+}
+
+TEST(ringct, point_cache)
+{
+  rct::point_cache cache(1024);
+  rct::keyV keys;
+  for (int i = 0; i < 32; ++i)
+    keys.push_back(rct::pkGen());
+  rct::key bad;
+  memset(bad.bytes, 0xff, sizeof(bad.bytes));
+  bad.bytes[31] = 0x7f;
+  keys.push_back(bad);
+
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    for (const rct::key &k: keys)
+    {
+      ge_p3 p3, expected;
+      const bool valid = ge_frombytes_vartime(&expected, k.bytes) == 0;
+      ASSERT_EQ(cache.point(k, p3), valid);
+      if (valid)
+      {
+        rct::key enc;
+        ge_p3_tobytes(enc.bytes, &p3);
+        ASSERT_EQ(enc, k);
+      }
+      ASSERT_TRUE(cache.hash_point(k, p3));
+      rct::key hp;
+      ge_p3_tobytes(hp.bytes, &p3);
+      ASSERT_EQ(hp, rct::hashToPoint(k));
+    }
+  }
+  rct::point_cache::stats st = cache.get_stats();
+  ASSERT_EQ(st.point_misses, keys.size());
+  ASSERT_EQ(st.point_hits, keys.size());
+  ASSERT_EQ(st.hash_point_misses, keys.size());
+  ASSERT_EQ(st.hash_point_hits, keys.size());
+  ASSERT_EQ(st.entries, keys.size());
+
+  // bounded, least recently used entries go first
+  for (int i = 0; i < 4096; ++i)
+  {
+    ge_p3 p3;
+    ASSERT_TRUE(cache.point(rct::pkGen(), p3));
+  }
+  st = cache.get_stats();
+  ASSERT_LE(st.entries, 1024);
+  cache.clear();
+  ASSERT_EQ(cache.get_stats().entries, 0);
+}
+
 TEST(ringct, mul8)
 {
   ASSERT_EQ(rct::scalarmult8(rct::identity()), rct::identity());
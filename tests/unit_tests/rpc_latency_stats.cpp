@@ -0,0 +1,86 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/rpc_latency_stats.h"
+
+TEST(rpc_latency_stats, percentile)
+{
+  ASSERT_EQ(tools::rpc_latency_stats::percentile({}, 50), 0);
+  std::vector<uint64_t> sorted;
+  for (uint64_t n = 1; n <= 100; ++n)
+    sorted.push_back(n);
+  ASSERT_EQ(tools::rpc_latency_stats::percentile(sorted, 0), 1);
+  ASSERT_EQ(tools::rpc_latency_stats::percentile(sorted, 50), 50);
+  ASSERT_EQ(tools::rpc_latency_stats::percentile(sorted, 90), 90);
+  ASSERT_EQ(tools::rpc_latency_stats::percentile(sorted, 99), 99);
+  ASSERT_EQ(tools::rpc_latency_stats::percentile(sorted, 100), 100);
+  ASSERT_EQ(tools::rpc_latency_stats::percentile({7}, 99), 7);
+}
+
+TEST(rpc_latency_stats, per_method)
+{
+  tools::rpc_latency_stats stats;
+  ASSERT_TRUE(stats.get().empty());
+  for (uint64_t n = 1; n <= 10; ++n)
+    stats.add("get_balance", n);
+  stats.add("transfer", 1000);
+
+  const std::vector<tools::rpc_latency_stats::method_stats> s = stats.get();
+  ASSERT_EQ(s.size(), 2);
+  ASSERT_EQ(s[0].method, "get_balance");
+  ASSERT_EQ(s[0].count, 10);
+  ASSERT_EQ(s[0].p50, 5);
+  ASSERT_EQ(s[0].p90, 9);
+  ASSERT_EQ(s[0].p99, 10);
+  ASSERT_EQ(s[0].max, 10);
+  ASSERT_EQ(s[1].method, "transfer");
+  ASSERT_EQ(s[1].count, 1);
+  ASSERT_EQ(s[1].p50, 1000);
+  ASSERT_EQ(s[1].max, 1000);
+
+  stats.clear();
+  ASSERT_TRUE(stats.get().empty());
+}
+
+TEST(rpc_latency_stats, window)
+{
+  tools::rpc_latency_stats stats(4);
+  for (uint64_t n = 0; n < 100; ++n)
+    stats.add("get_transfers", 1000);
+  // only the last 4 calls count towards the percentiles, but all towards the count
+  for (uint64_t n = 1; n <= 4; ++n)
+    stats.add("get_transfers", n);
+
+  const std::vector<tools::rpc_latency_stats::method_stats> s = stats.get();
+  ASSERT_EQ(s.size(), 1);
+  ASSERT_EQ(s[0].count, 104);
+  ASSERT_EQ(s[0].p50, 2);
+  ASSERT_EQ(s[0].max, 4);
+}
@@ -679,6 +679,108 @@ TEST(Serialization, serializes_rta_transaction_correctly)
   ASSERT_EQ(rta_hdr_in, rta_hdr_out);
 }
 
+TEST(Serialization, tx_sub_hashes_cached)
+{
+  string blob;
+  cryptonote::transaction tx, tx1;
+  tx.version = 2;
+  cryptonote::txin_gen txin_gen1;
+  txin_gen1.height = 0;
+  tx.vin.push_back(txin_gen1);
+  tx.extra.resize(40, 7);
+
+  const crypto::hash prefix_hash = cryptonote::get_transaction_prefix_hash(static_cast<const cryptonote::transaction_prefix&>(tx));
+  ASSERT_FALSE(tx.is_prefix_hash_valid());
+  crypto::hash tx_hash;
+  ASSERT_TRUE(cryptonote::get_transaction_hash(tx, tx_hash));
+  ASSERT_TRUE(tx.is_prefix_hash_valid());
+  ASSERT_EQ(tx.prefix_hash, prefix_hash);
+  ASSERT_EQ(cryptonote::get_transaction_prefix_hash(tx), prefix_hash);
+
+  // copies keep the sub-hashes, reloading and invalidating drop them
+  tx1 = tx;
+  ASSERT_TRUE(tx1.is_prefix_hash_valid());
+  ASSERT_EQ(cryptonote::get_transaction_prefix_hash(tx1), prefix_hash);
+  ASSERT_TRUE(serialization::dump_binary(tx, blob));
+  ASSERT_TRUE(serialization::parse_binary(blob, tx1));
+  ASSERT_FALSE(tx1.is_prefix_hash_valid());
+  tx.invalidate_hashes();
+  ASSERT_FALSE(tx.is_prefix_hash_valid());
+  tx.extra.resize(41, 7);
+  ASSERT_NE(cryptonote::get_transaction_prefix_hash(tx), prefix_hash);
+}
+
+TEST(Serialization, tx_reparse_in_place)
+{
+  cryptonote::transaction simple;
+  simple.version = 2;
+  for (size_t n = 0; n < 2; ++n)
+  {
+    cryptonote::txin_to_key txin;
+    txin.amount = 0;
+    txin.key_offsets = {1, 2, 3};
+    txin.k_image = crypto::key_image(rct::rct2ki(rct::skGen()));
+    simple.vin.push_back(txin);
+    simple.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_key(rct::rct2pk(rct::pkGen()))});
+  }
+  simple.extra.resize(33, 1);
+  rct::rctSig &rv = simple.rct_signatures;
+  rv.type = rct::RCTTypeSimple;
+  rv.txnFee = 1000;
+  rv.pseudoOuts = {rct::pkGen(), rct::pkGen()};
+  rv.ecdhInfo.resize(2, rct::ecdhTuple{rct::skGen(), rct::skGen()});
+  rv.outPk.resize(2, rct::ctkey{rct::zero(), rct::pkGen()});
+  rv.p.rangeSigs.resize(2);
+  rv.p.MGs.resize(2);
+  for (rct::mgSig &mg: rv.p.MGs)
+  {
+    mg.ss.resize(3, rct::keyV(2, rct::skGen()));
+    mg.cc = rct::skGen();
+  }
+
+  cryptonote::transaction coinbase;
+  coinbase.version = 2;
+  coinbase.vin.push_back(cryptonote::txin_gen{7});
+  coinbase.vout.push_back(cryptonote::tx_out{1000, cryptonote::txout_to_key(rct::rct2pk(rct::pkGen()))});
+
+  const cryptonote::blobdata simple_blob = cryptonote::tx_to_blob(simple);
+  const cryptonote::blobdata coinbase_blob = cryptonote::tx_to_blob(coinbase);
+  cryptonote::transaction fresh_simple, fresh_coinbase;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(simple_blob, fresh_simple));
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(coinbase_blob, fresh_coinbase));
+
+  // what parsing does not read must not leak from one tx into the next
+  cryptonote::transaction tx;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(simple_blob, tx));
+  tx.rct_signatures.message = rct::skGen();
+  tx.rct_signatures.mixRing.resize(2);
+  tx.rct_signatures.p.MGs[0].II.push_back(rct::pkGen());
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(coinbase_blob, tx));
+  ASSERT_EQ(cryptonote::tx_to_blob(tx), coinbase_blob);
+  ASSERT_EQ(tx.rct_signatures.type, rct::RCTTypeNull);
+  ASSERT_TRUE(tx.rct_signatures.ecdhInfo.empty());
+  ASSERT_TRUE(tx.rct_signatures.outPk.empty());
+  ASSERT_TRUE(tx.rct_signatures.mixRing.empty());
+  ASSERT_TRUE(tx.rct_signatures.p.MGs.empty());
+  ASSERT_EQ(tx.rct_signatures.message, fresh_coinbase.rct_signatures.message);
+
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(simple_blob, tx));
+  tx.rct_signatures.message = rct::skGen();
+  tx.rct_signatures.mixRing.resize(2);
+  tx.rct_signatures.p.MGs[0].II.push_back(rct::pkGen());
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(simple_blob, tx));
+  ASSERT_EQ(cryptonote::tx_to_blob(tx), simple_blob);
+  ASSERT_EQ(cryptonote::get_transaction_hash(tx), cryptonote::get_transaction_hash(fresh_simple));
+  ASSERT_EQ(tx.rct_signatures.message, fresh_simple.rct_signatures.message);
+  ASSERT_TRUE(tx.rct_signatures.mixRing.empty());
+  for (size_t n = 0; n < 2; ++n)
+  {
+    ASSERT_EQ(tx.rct_signatures.outPk[n].dest, fresh_simple.rct_signatures.outPk[n].dest);
+    ASSERT_EQ(tx.rct_signatures.outPk[n].mask, fresh_simple.rct_signatures.outPk[n].mask);
+    ASSERT_TRUE(tx.rct_signatures.p.MGs[n].II.empty());
+  }
+}
+
 TEST(Serialization, empty_rta_signatures)
 {
   string blob;
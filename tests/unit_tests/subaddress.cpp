@@ -101,3 +101,33 @@ TEST_F(WalletSubaddress, OutOfBoundsIndexes)
     EXPECT_STREQ("index.minor is out of bound", e.what());  
   }   
 }
+
+TEST_F(WalletSubaddress, BatchedSpendPublicKeys)
+{
+  // large enough to be split across threads
+  const uint32_t n = 5000;
+  const std::vector<crypto::public_key> pkeys = w1.get_subaddress_spend_public_keys(0, 0, n);
+  ASSERT_EQ(n, pkeys.size());
+  EXPECT_EQ(w1.get_account().get_keys().m_account_address.m_spend_public_key, pkeys[0]);
+  for (uint32_t i = 0; i < n; i += 97)
+    EXPECT_EQ(w1.get_subaddress_spend_public_key({0, i}), pkeys[i]);
+  EXPECT_EQ(w1.get_subaddress_spend_public_key({0, n - 1}), pkeys[n - 1]);
+
+  const std::vector<crypto::public_key> tail = w1.get_subaddress_spend_public_keys(1, 255, 259);
+  ASSERT_EQ(4, tail.size());
+  for (uint32_t i = 0; i < tail.size(); ++i)
+    EXPECT_EQ(w1.get_subaddress_spend_public_key({1, 255 + i}), tail[i]);
+}
+
+TEST_F(WalletSubaddress, ExpandedSubaddressesAreFound)
+{
+  w1.set_subaddress_lookahead(1, 3000);
+  w1.expand_subaddresses({0, 10});
+  for (uint32_t i = 0; i < 3010; i += 101)
+  {
+    const cryptonote::subaddress_index index = {0, i};
+    const boost::optional<cryptonote::subaddress_index> found = w1.get_subaddress_index(w1.get_subaddress(index));
+    ASSERT_TRUE(found);
+    EXPECT_EQ(index, *found);
+  }
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <unordered_map>
+#include <boost/archive/portable_binary_iarchive.hpp>
+#include <boost/archive/portable_binary_oarchive.hpp>
+#include "common/unordered_containers_boost_serialization.h"
+#include "cryptonote_basic/cryptonote_boost_serialization.h"
+#include "cryptonote_basic/subaddress_map.h"
+
+namespace
+{
+  std::vector<crypto::public_key> make_keys(size_t n)
+  {
+    std::vector<crypto::public_key> keys(n);
+    for (auto &k: keys)
+      k = crypto::rand<crypto::public_key>();
+    return keys;
+  }
+}
+
+TEST(subaddress_map, empty)
+{
+  cryptonote::subaddress_map m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.size(), 0);
+  ASSERT_TRUE(m.find(crypto::rand<crypto::public_key>()) == m.end());
+  ASSERT_EQ(m.count(crypto::null_pkey), 0);
+}
+
+TEST(subaddress_map, insert_find)
+{
+  const std::vector<crypto::public_key> keys = make_keys(10000);
+  cryptonote::subaddress_map m;
+  for (uint32_t i = 0; i < keys.size(); ++i)
+    m[keys[i]] = {i / 100, i % 100};
+  ASSERT_EQ(m.size(), keys.size());
+  for (uint32_t i = 0; i < keys.size(); ++i)
+  {
+    auto it = m.find(keys[i]);
+    ASSERT_TRUE(it != m.end());
+    ASSERT_EQ(it->first, keys[i]);
+    ASSERT_EQ(it->second, cryptonote::subaddress_index({i / 100, i % 100}));
+  }
+  for (const auto &k: make_keys(1000))
+    ASSERT_EQ(m.count(k), 0);
+
+  // entries are iterated in insertion order
+  uint32_t i = 0;
+  for (const auto &e: m)
+    ASSERT_EQ(e.first, keys[i++]);
+}
+
+TEST(subaddress_map, duplicates)
+{
+  const crypto::public_key k = crypto::rand<crypto::public_key>();
+  cryptonote::subaddress_map m;
+  ASSERT_TRUE(m.emplace(k, {1, 2}).second);
+  const auto r = m.emplace(k, {3, 4});
+  ASSERT_FALSE(r.second);
+  ASSERT_EQ(r.first->second, cryptonote::subaddress_index({1, 2}));
+  m[k] = {5, 6};
+  ASSERT_EQ(m.size(), 1);
+  ASSERT_EQ(m.find(k)->second, cryptonote::subaddress_index({5, 6}));
+
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.count(k), 0);
+  m[k] = {7, 8};
+  ASSERT_EQ(m.find(k)->second, cryptonote::subaddress_index({7, 8}));
+}
+
+TEST(subaddress_map, shared_prefix)
+{
+  // keys only differing after the part kept in the slots
+  std::vector<crypto::public_key> keys(64, crypto::rand<crypto::public_key>());
+  cryptonote::subaddress_map m;
+  for (uint32_t i = 0; i < keys.size(); ++i)
+  {
+    keys[i].data[31] = i;
+    m[keys[i]] = {0, i};
+  }
+  ASSERT_EQ(m.size(), keys.size());
+  for (uint32_t i = 0; i < keys.size(); ++i)
+    ASSERT_EQ(m.find(keys[i])->second.minor, i);
+}
+
+TEST(subaddress_map, serialization)
+{
+  // stored as the std::unordered_map it replaces, so existing wallet caches load
+  const std::vector<crypto::public_key> keys = make_keys(500);
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> legacy;
+  for (uint32_t i = 0; i < keys.size(); ++i)
+    legacy[keys[i]] = {i, i + 1};
+
+  std::stringstream ss;
+  {
+    boost::archive::portable_binary_oarchive ar(ss);
+    ar << legacy;
+  }
+  cryptonote::subaddress_map m;
+  {
+    boost::archive::portable_binary_iarchive ar(ss);
+    ar >> m;
+  }
+  ASSERT_EQ(m.size(), legacy.size());
+  for (const auto &e: legacy)
+    ASSERT_EQ(m.find(e.first)->second, e.second);
+
+  std::stringstream ss2;
+  {
+    boost::archive::portable_binary_oarchive ar(ss2);
+    ar << m;
+  }
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> loaded;
+  {
+    boost::archive::portable_binary_iarchive ar(ss2);
+    ar >> loaded;
+  }
+  ASSERT_EQ(loaded, legacy);
+}
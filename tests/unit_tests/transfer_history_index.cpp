@@ -0,0 +1,213 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/transfer_history_index.h"
+
+static crypto::hash make_hash(uint64_t n)
+{
+  union
+  {
+    crypto::hash hash;
+    uint64_t n;
+  } hash;
+  hash.hash = crypto::null_hash;
+  hash.n = n;
+  return hash.hash;
+}
+
+TEST(transfer_history_index, empty)
+{
+  tools::transfer_history_index<size_t> index;
+  std::vector<size_t> values;
+  ASSERT_EQ(index.size(), 0);
+  ASSERT_FALSE(index.query(values, 0, 100, boost::none, {}, boost::none, 0));
+  ASSERT_TRUE(values.empty());
+}
+
+TEST(transfer_history_index, height_range)
+{
+  tools::transfer_history_index<size_t> index;
+  for (size_t i = 0; i < 10; ++i)
+    index.insert({10 + i, make_hash(i), 0}, i, 0, {0});
+  ASSERT_EQ(index.size(), 10);
+
+  std::vector<size_t> values;
+  ASSERT_FALSE(index.query(values, 12, 14, boost::none, {}, boost::none, 0));
+  ASSERT_EQ(values, std::vector<size_t>({2, 3, 4}));
+
+  values.clear();
+  ASSERT_FALSE(index.query(values, 14, 12, boost::none, {}, boost::none, 0));
+  ASSERT_TRUE(values.empty());
+}
+
+TEST(transfer_history_index, subaddress)
+{
+  tools::transfer_history_index<size_t> index;
+  index.insert({1, make_hash(1), 0}, 1, 0, {0});
+  index.insert({2, make_hash(2), 0}, 2, 1, {0});
+  index.insert({3, make_hash(3), 0}, 3, 1, {1, 2});
+  index.insert({4, make_hash(4), 0}, 4, 1, {2});
+
+  std::vector<size_t> values;
+  index.query(values, 0, 10, 1, {}, boost::none, 0);
+  ASSERT_EQ(values, std::vector<size_t>({2, 3, 4}));
+
+  // an entry in several of the requested subaddresses is only returned once
+  values.clear();
+  index.query(values, 0, 10, 1, {1, 2}, boost::none, 0);
+  ASSERT_EQ(values, std::vector<size_t>({3, 4}));
+
+  values.clear();
+  index.query(values, 0, 10, 0, {1}, boost::none, 0);
+  ASSERT_TRUE(values.empty());
+}
+
+TEST(transfer_history_index, pagination)
+{
+  tools::transfer_history_index<size_t> index;
+  for (size_t i = 0; i < 10; ++i)
+    index.insert({i / 2, make_hash(i), i}, i, 0, {(uint32_t)(i % 2)});
+
+  for (const std::set<uint32_t> &minors: {std::set<uint32_t>(), std::set<uint32_t>({0, 1})})
+  {
+    std::vector<size_t> values;
+    boost::optional<tools::transfer_history_key> cursor;
+    size_t pages = 0;
+    do
+    {
+      cursor = index.query(values, 0, 100, 0, minors, cursor, 3);
+      ++pages;
+    } while (cursor);
+    ASSERT_EQ(pages, 4);
+    ASSERT_EQ(values, std::vector<size_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  }
+}
+
+TEST(transfer_history_index, filter)
+{
+  tools::transfer_history_index<size_t> index;
+  for (size_t i = 0; i < 10; ++i)
+    index.insert({i, make_hash(i), 0}, i, 0, {0});
+
+  std::vector<size_t> values;
+  const auto next = index.query(values, 0, 100, boost::none, {}, boost::none, 2, [](size_t v) { return v % 3 == 0; });
+  ASSERT_EQ(values, std::vector<size_t>({0, 3}));
+  ASSERT_TRUE(next);
+  values.clear();
+  ASSERT_FALSE(index.query(values, 0, 100, boost::none, {}, next, 2, [](size_t v) { return v % 3 == 0; }));
+  ASSERT_EQ(values, std::vector<size_t>({6, 9}));
+}
+
+TEST(transfer_history_index, erase)
+{
+  tools::transfer_history_index<size_t> index;
+  index.insert({1, make_hash(1), 0}, 1, 0, {0});
+  index.insert({1, make_hash(1), 1}, 2, 0, {0});
+
+  std::vector<size_t> values;
+  index.find(make_hash(1), values);
+  ASSERT_EQ(values.size(), 2);
+
+  // erasing with a stale value leaves the entry alone
+  index.erase({1, make_hash(1), 0}, 7);
+  ASSERT_EQ(index.size(), 2);
+
+  index.erase({1, make_hash(1), 0}, 1);
+  ASSERT_EQ(index.size(), 1);
+  values.clear();
+  index.find(make_hash(1), values);
+  ASSERT_EQ(values, std::vector<size_t>({2}));
+  values.clear();
+  index.query(values, 0, 10, 0, {0}, boost::none, 0);
+  ASSERT_EQ(values, std::vector<size_t>({2}));
+}
+
+TEST(transfer_history_index, same_position)
+{
+  // distinct elements at the same position are all listed, like duplicate payments
+  tools::transfer_history_index<size_t> index;
+  index.insert({1, make_hash(1), 0}, 1, 0, {0});
+  index.insert({1, make_hash(1), 0}, 2, 0, {0});
+  index.insert({1, make_hash(1), 0}, 3, 0, {0});
+  ASSERT_EQ(index.size(), 3);
+
+  std::vector<size_t> values;
+  index.find(make_hash(1), values);
+  std::sort(values.begin(), values.end());
+  ASSERT_EQ(values, std::vector<size_t>({1, 2, 3}));
+
+  for (const boost::optional<uint32_t> &account: {boost::optional<uint32_t>(), boost::optional<uint32_t>(0)})
+  {
+    values.clear();
+    boost::optional<tools::transfer_history_key> cursor;
+    size_t pages = 0;
+    do
+    {
+      cursor = index.query(values, 0, 10, account, {}, cursor, 1);
+      ++pages;
+    } while (cursor);
+    ASSERT_EQ(pages, 3);
+    ASSERT_EQ(values, std::vector<size_t>({1, 2, 3}));
+  }
+
+  // inserting an element again replaces its entry
+  index.insert({1, make_hash(1), 0}, 2, 0, {0});
+  ASSERT_EQ(index.size(), 3);
+
+  index.erase({1, make_hash(1), 0}, 1);
+  ASSERT_EQ(index.size(), 2);
+  values.clear();
+  index.query(values, 0, 10, 0, {0}, boost::none, 0);
+  ASSERT_EQ(values, std::vector<size_t>({3, 2}));
+  index.erase({1, make_hash(1), 0}, 3);
+  index.erase({1, make_hash(1), 0}, 2);
+  ASSERT_EQ(index.size(), 0);
+  values.clear();
+  index.find(make_hash(1), values);
+  ASSERT_TRUE(values.empty());
+}
+
+TEST(transfer_history_index, cursor_string)
+{
+  const tools::transfer_history_key key{1234, make_hash(42), 7};
+  tools::transfer_history_key parsed;
+  ASSERT_TRUE(tools::transfer_history_key::from_string(key.to_string(), parsed));
+  ASSERT_EQ(parsed, key);
+
+  const tools::transfer_history_key dup{1234, make_hash(42), 7, 2};
+  ASSERT_TRUE(tools::transfer_history_key::from_string(dup.to_string(), parsed));
+  ASSERT_EQ(parsed, dup);
+  ASSERT_TRUE(tools::transfer_history_key::from_string(key.to_string(), parsed));
+  ASSERT_EQ(parsed, key);
+
+  ASSERT_FALSE(tools::transfer_history_key::from_string("", parsed));
+  ASSERT_FALSE(tools::transfer_history_key::from_string("1234", parsed));
+  ASSERT_FALSE(tools::transfer_history_key::from_string("1234-nothex-7", parsed));
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/uuid/uuid.hpp>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_config.h"
+#include "cryptonote_protocol/tx_relay.h"
+
+namespace
+{
+  // deterministic, so decoding never hits the small chance of an unpeelable sketch
+  std::vector<crypto::hash> make_txids(size_t n, uint64_t first = 0)
+  {
+    std::vector<crypto::hash> txids(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      const uint64_t seed = first + i;
+      txids[i] = crypto::cn_fast_hash(&seed, sizeof(seed));
+    }
+    return txids;
+  }
+
+  std::vector<uint64_t> get_short_ids(const std::vector<crypto::hash> &txids, uint64_t salt)
+  {
+    std::vector<uint64_t> short_ids;
+    for (const auto &txid: txids)
+      short_ids.push_back(cryptonote::tx_pool_sketch::get_short_id(txid, salt));
+    std::sort(short_ids.begin(), short_ids.end());
+    return short_ids;
+  }
+}
+
+TEST(tx_pool_sketch, invalid_size)
+{
+  ASSERT_THROW(cryptonote::tx_pool_sketch(0, 0), std::exception);
+  ASSERT_THROW(cryptonote::tx_pool_sketch(100, 0), std::exception);
+  ASSERT_NO_THROW(cryptonote::tx_pool_sketch(P2P_TX_SKETCH_CELLS, 0));
+}
+
+TEST(tx_pool_sketch, short_id_salted)
+{
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_EQ(cryptonote::tx_pool_sketch::get_short_id(txid, 1), cryptonote::tx_pool_sketch::get_short_id(txid, 1));
+  ASSERT_NE(cryptonote::tx_pool_sketch::get_short_id(txid, 1), cryptonote::tx_pool_sketch::get_short_id(txid, 2));
+}
+
+TEST(tx_pool_sketch, identical)
+{
+  const std::vector<crypto::hash> txids = make_txids(1000);
+  cryptonote::tx_pool_sketch ours(P2P_TX_SKETCH_CELLS, 42), theirs(P2P_TX_SKETCH_CELLS, 42);
+  for (const auto &txid: txids)
+  {
+    ours.add_tx(txid);
+    theirs.add_tx(txid);
+  }
+  ASSERT_TRUE(ours.subtract(theirs));
+  std::vector<uint64_t> only_ours, only_theirs;
+  ASSERT_TRUE(ours.decode(only_ours, only_theirs));
+  ASSERT_TRUE(only_ours.empty());
+  ASSERT_TRUE(only_theirs.empty());
+}
+
+TEST(tx_pool_sketch, difference)
+{
+  const uint64_t salt = 0x5a17;
+  const std::vector<crypto::hash> common = make_txids(2000), mine = make_txids(15, 10000), other = make_txids(20, 20000);
+  cryptonote::tx_pool_sketch ours(P2P_TX_SKETCH_CELLS, salt), theirs(P2P_TX_SKETCH_CELLS, salt);
+  for (const auto &txid: common)
+  {
+    ours.add_tx(txid);
+    theirs.add_tx(txid);
+  }
+  for (const auto &txid: mine)
+    ours.add_tx(txid);
+  for (const auto &txid: other)
+    theirs.add_tx(txid);
+
+  ASSERT_TRUE(ours.subtract(theirs));
+  std::vector<uint64_t> only_ours, only_theirs;
+  ASSERT_TRUE(ours.decode(only_ours, only_theirs));
+  std::sort(only_ours.begin(), only_ours.end());
+  std::sort(only_theirs.begin(), only_theirs.end());
+  ASSERT_EQ(only_ours, get_short_ids(mine, salt));
+  ASSERT_EQ(only_theirs, get_short_ids(other, salt));
+}
+
+TEST(tx_pool_sketch, difference_too_large)
+{
+  cryptonote::tx_pool_sketch ours(P2P_TX_SKETCH_CELLS, 0), theirs(P2P_TX_SKETCH_CELLS, 0);
+  for (const auto &txid: make_txids(P2P_TX_SKETCH_CELLS * 2, 10000))
+    ours.add_tx(txid);
+  ASSERT_TRUE(ours.subtract(theirs));
+  std::vector<uint64_t> only_ours, only_theirs;
+  ASSERT_FALSE(ours.decode(only_ours, only_theirs));
+}
+
+TEST(tx_pool_sketch, mismatch)
+{
+  cryptonote::tx_pool_sketch ours(P2P_TX_SKETCH_CELLS, 0);
+  ASSERT_FALSE(ours.subtract(cryptonote::tx_pool_sketch(P2P_TX_SKETCH_CELLS, 1)));
+  ASSERT_FALSE(ours.subtract(cryptonote::tx_pool_sketch(P2P_TX_SKETCH_CELLS * 2, 0)));
+}
+
+TEST(tx_pool_sketch, store_load)
+{
+  const std::vector<crypto::hash> txids = make_txids(30);
+  cryptonote::tx_pool_sketch sketch(P2P_TX_SKETCH_CELLS, 7), empty(P2P_TX_SKETCH_CELLS, 7);
+  for (const auto &txid: txids)
+    sketch.add_tx(txid);
+
+  cryptonote::NOTIFY_TX_POOL_SKETCH::request req;
+  sketch.store(req);
+  cryptonote::tx_pool_sketch loaded(3, 0);
+  ASSERT_TRUE(cryptonote::tx_pool_sketch::load(req, loaded));
+  ASSERT_EQ(loaded.get_salt(), 7);
+  ASSERT_EQ(loaded.get_cells(), P2P_TX_SKETCH_CELLS);
+
+  ASSERT_TRUE(loaded.subtract(empty));
+  std::vector<uint64_t> only_ours, only_theirs;
+  ASSERT_TRUE(loaded.decode(only_ours, only_theirs));
+  std::sort(only_ours.begin(), only_ours.end());
+  ASSERT_EQ(only_ours, get_short_ids(txids, 7));
+  ASSERT_TRUE(only_theirs.empty());
+
+  req.check_sums.pop_back();
+  ASSERT_FALSE(cryptonote::tx_pool_sketch::load(req, loaded));
+}
+
+TEST(tx_relay_inventory, known)
+{
+  const boost::uuids::uuid peer1 = crypto::rand<boost::uuids::uuid>(), peer2 = crypto::rand<boost::uuids::uuid>();
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  cryptonote::tx_relay_inventory inventory;
+  ASSERT_FALSE(inventory.is_known(peer1, txid));
+  ASSERT_TRUE(inventory.add_known(peer1, txid));
+  ASSERT_FALSE(inventory.add_known(peer1, txid));
+  ASSERT_TRUE(inventory.is_known(peer1, txid));
+  ASSERT_FALSE(inventory.is_known(peer2, txid));
+  inventory.flush(peer1);
+  ASSERT_FALSE(inventory.is_known(peer1, txid));
+  ASSERT_EQ(inventory.get_known_count(peer1), 0);
+}
+
+TEST(tx_relay_inventory, request)
+{
+  const boost::uuids::uuid peer1 = crypto::rand<boost::uuids::uuid>(), peer2 = crypto::rand<boost::uuids::uuid>();
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+  cryptonote::tx_relay_inventory inventory;
+  ASSERT_TRUE(inventory.request(peer1, txid, now));
+  ASSERT_FALSE(inventory.request(peer2, txid, now));
+  ASSERT_TRUE(inventory.request(peer2, txid, now + boost::posix_time::seconds(P2P_TX_REQUEST_TIMEOUT)));
+  ASSERT_EQ(inventory.get_requested_count(), 1);
+
+  // dropping the peer we asked lets another one be asked straight away
+  inventory.flush(peer2);
+  ASSERT_EQ(inventory.get_requested_count(), 0);
+  ASSERT_TRUE(inventory.request(peer1, txid, now));
+
+  inventory.prune(now + boost::posix_time::seconds(P2P_TX_REQUEST_TIMEOUT));
+  ASSERT_EQ(inventory.get_requested_count(), 0);
+}
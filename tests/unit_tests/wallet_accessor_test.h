@@ -0,0 +1,60 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "wallet/wallet2.h"
+
+// the wallet lets this class reach its state, for the tests which need to set it up directly
+class wallet_accessor_test
+{
+public:
+  static tools::hashchain &get_blockchain(tools::wallet2 &wallet) { return wallet.m_blockchain; }
+  static std::unordered_map<crypto::hash, crypto::secret_key> &get_tx_keys(tools::wallet2 &wallet) { return wallet.m_tx_keys; }
+  static std::unordered_map<crypto::hash, std::vector<crypto::secret_key>> &get_additional_tx_keys(tools::wallet2 &wallet) { return wallet.m_additional_tx_keys; }
+  static const cryptonote::subaddress_map &get_subaddresses(tools::wallet2 &wallet) { return wallet.m_subaddresses; }
+  static tools::wallet2::transfer_container &get_transfers(tools::wallet2 &wallet) { return wallet.m_transfers; }
+  static void rebuild_unspent_index(tools::wallet2 &wallet) { wallet.rebuild_unspent_index(); }
+  static void set_rta_inputs(tools::wallet2 &wallet, const std::vector<size_t> &inputs, uint32_t subaddr_account, size_t fake_outs_count)
+  {
+    wallet.m_rta_inputs = inputs;
+    wallet.m_rta_inputs_account = subaddr_account;
+    wallet.m_rta_inputs_fake_outs_count = fake_outs_count;
+  }
+  static std::vector<size_t> select_rta_inputs(tools::wallet2 &wallet, uint64_t needed_money, size_t fake_outs_count, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, uint64_t &found_money)
+  {
+    return wallet.select_rta_inputs(needed_money, fake_outs_count, subaddr_account, subaddr_indices, found_money);
+  }
+  static void set_pull_blocks(tools::wallet2 &wallet, const decltype(tools::wallet2::m_pull_blocks_override) &pull_blocks) { wallet.m_pull_blocks_override = pull_blocks; }
+  static cryptonote::block generate_genesis(const tools::wallet2 &wallet)
+  {
+    cryptonote::block b;
+    wallet.generate_genesis(b);
+    return b;
+  }
+};
@@ -0,0 +1,199 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "file_io_utils.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+#include "wallet_accessor_test.h"
+
+namespace
+{
+  const char *password = "journal test";
+
+  class WalletCacheJournal : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet-cache-journal-%%%%-%%%%");
+      boost::filesystem::create_directories(dir);
+      wallet_file = (dir / "wallet").string();
+      recovery_key = wallet.generate(wallet_file, password);
+      add_blocks(wallet, 5);
+      wallet.store();
+    }
+
+    virtual void TearDown()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(dir, ec);
+    }
+
+    static void add_blocks(tools::wallet2 &w, size_t n)
+    {
+      tools::hashchain &blockchain = wallet_accessor_test::get_blockchain(w);
+      for (size_t i = 0; i < n; ++i)
+        blockchain.push_back(crypto::rand<crypto::hash>());
+    }
+
+    uint64_t journal_size() const
+    {
+      boost::system::error_code ec;
+      const uint64_t size = boost::filesystem::file_size(wallet_file + ".journal", ec);
+      return ec ? 0 : size;
+    }
+
+    boost::filesystem::path dir;
+    std::string wallet_file;
+    crypto::secret_key recovery_key;
+    tools::wallet2 wallet;
+  };
+
+  cryptonote::account_public_address make_address()
+  {
+    cryptonote::account_base account;
+    account.generate();
+    return account.get_keys().m_account_address;
+  }
+}
+
+TEST_F(WalletCacheJournal, round_trip)
+{
+  const crypto::hash txid0 = crypto::rand<crypto::hash>(), txid1 = crypto::rand<crypto::hash>();
+  wallet.set_tx_note(txid0, "first");
+  wallet_accessor_test::get_tx_keys(wallet)[txid0] = rct::rct2sk(rct::skGen());
+  const crypto::secret_key additional_tx_key = rct::rct2sk(rct::skGen());
+  wallet_accessor_test::get_additional_tx_keys(wallet)[txid0] = {rct::rct2sk(rct::skGen()), additional_tx_key};
+  ASSERT_TRUE(wallet.add_address_book_row(make_address(), crypto::null_hash, "alice", false));
+  ASSERT_TRUE(wallet.add_address_book_row(make_address(), crypto::null_hash, "bob", false));
+  wallet.add_subaddress(0, "sub");
+  add_blocks(wallet, 3);
+  wallet.store();
+  const uint64_t size0 = journal_size();
+  ASSERT_GT(size0, 0);
+
+  wallet.set_tx_note(txid0, "changed");
+  wallet.set_tx_note(txid1, "second");
+  wallet_accessor_test::get_tx_keys(wallet).erase(txid0);
+  ASSERT_TRUE(wallet.delete_address_book_row(0));
+  add_blocks(wallet, 2);
+  wallet.store();
+  ASSERT_GT(journal_size(), size0);
+
+  tools::wallet2 loaded;
+  loaded.load(wallet_file, password);
+  ASSERT_EQ(wallet_accessor_test::get_blockchain(loaded).size(), wallet_accessor_test::get_blockchain(wallet).size());
+  ASSERT_EQ(wallet_accessor_test::get_blockchain(loaded)[9], wallet_accessor_test::get_blockchain(wallet)[9]);
+  ASSERT_EQ(loaded.get_tx_note(txid0), "changed");
+  ASSERT_EQ(loaded.get_tx_note(txid1), "second");
+  ASSERT_TRUE(wallet_accessor_test::get_tx_keys(loaded).empty());
+  ASSERT_EQ(wallet_accessor_test::get_additional_tx_keys(loaded).size(), 1);
+  ASSERT_EQ(wallet_accessor_test::get_additional_tx_keys(loaded)[txid0].size(), 2);
+  ASSERT_EQ(memcmp(wallet_accessor_test::get_additional_tx_keys(loaded)[txid0][1].data, additional_tx_key.data, sizeof(additional_tx_key.data)), 0);
+  ASSERT_EQ(loaded.get_address_book().size(), 1);
+  ASSERT_EQ(loaded.get_address_book()[0].m_description, "bob");
+  ASSERT_EQ(loaded.get_subaddress_label({0, 1}), "sub");
+  ASSERT_EQ(wallet_accessor_test::get_subaddresses(loaded).size(), wallet_accessor_test::get_subaddresses(wallet).size());
+  for (const auto &e: wallet_accessor_test::get_subaddresses(wallet))
+    ASSERT_EQ(wallet_accessor_test::get_subaddresses(loaded).count(e.first), 1);
+}
+
+TEST_F(WalletCacheJournal, torn_last_record)
+{
+  const crypto::hash txid0 = crypto::rand<crypto::hash>(), txid1 = crypto::rand<crypto::hash>();
+  wallet.set_tx_note(txid0, "kept");
+  wallet.store();
+  const uint64_t size0 = journal_size();
+  wallet.set_tx_note(txid1, "torn");
+  wallet.store();
+  ASSERT_GT(journal_size(), size0);
+
+  // a crash while appending leaves part of the last record behind
+  std::string journal;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(wallet_file + ".journal", journal));
+  journal.resize(journal.size() - (journal.size() - size0) / 2);
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(wallet_file + ".journal", journal));
+
+  tools::wallet2 loaded;
+  loaded.load(wallet_file, password);
+  ASSERT_EQ(loaded.get_tx_note(txid0), "kept");
+  ASSERT_EQ(loaded.get_tx_note(txid1), "");
+
+  // the next store rewrites the cache file and drops the torn journal
+  loaded.store();
+  ASSERT_EQ(journal_size(), 0);
+  tools::wallet2 reloaded;
+  reloaded.load(wallet_file, password);
+  ASSERT_EQ(reloaded.get_tx_note(txid0), "kept");
+}
+
+TEST_F(WalletCacheJournal, journal_of_another_cache_file)
+{
+  // same keys, so the same cache key, but another cache file
+  const std::string other_file = (dir / "other").string();
+  tools::wallet2 other;
+  other.generate(other_file, password, recovery_key, true);
+  other.store();
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  other.set_tx_note(txid, "other");
+  other.store();
+  ASSERT_TRUE(boost::filesystem::exists(other_file + ".journal"));
+
+  std::string journal;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(other_file + ".journal", journal));
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(wallet_file + ".journal", journal));
+  tools::wallet2 loaded;
+  loaded.load(wallet_file, password);
+  ASSERT_EQ(loaded.get_tx_note(txid), "");
+  loaded.store();
+  ASSERT_EQ(journal_size(), 0);
+}
+
+TEST_F(WalletCacheJournal, reorg_rewrites_cache_file)
+{
+  add_blocks(wallet, 4);
+  wallet.store();
+  ASSERT_GT(journal_size(), 0);
+
+  // blocks below the stored top replaced
+  tools::hashchain &blockchain = wallet_accessor_test::get_blockchain(wallet);
+  blockchain.crop(blockchain.size() - 2);
+  add_blocks(wallet, 3);
+  const crypto::hash top = blockchain[blockchain.size() - 1];
+  wallet.store();
+  ASSERT_EQ(journal_size(), 0);
+
+  tools::wallet2 loaded;
+  loaded.load(wallet_file, password);
+  ASSERT_EQ(wallet_accessor_test::get_blockchain(loaded).size(), blockchain.size());
+  ASSERT_EQ(wallet_accessor_test::get_blockchain(loaded)[blockchain.size() - 1], top);
+}
@@ -0,0 +1,263 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <limits>
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+#include "wallet_accessor_test.h"
+
+namespace
+{
+  const char *password = "refresh test";
+  const uint64_t MINER_AMOUNT = 1000000;
+  const size_t BLOCKS_PER_PULL = 4;
+
+  /// Serves pull_blocks from an in-memory chain whose miner txes pay the given addresses
+  class fake_daemon
+  {
+  public:
+    fake_daemon(const cryptonote::block &genesis): calls(0), fail_call(std::numeric_limits<size_t>::max())
+    {
+      push_block(genesis);
+    }
+
+    void add_blocks(const cryptonote::account_public_address &to, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        const uint64_t height = chain.size();
+
+        cryptonote::block b;
+        b.major_version = 1;
+        b.minor_version = 0;
+        b.timestamp = time(NULL);
+        b.prev_id = hashes.back();
+        b.nonce = crypto::rand<uint32_t>();
+        b.miner_tx.version = 1;
+        b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+        cryptonote::txin_gen in;
+        in.height = height;
+        b.miner_tx.vin.push_back(in);
+        const cryptonote::keypair tx_key = cryptonote::keypair::generate(hw::get_device("default"));
+        cryptonote::add_tx_pub_key_to_extra(b.miner_tx, tx_key.pub);
+
+        crypto::key_derivation derivation;
+        crypto::generate_key_derivation(to.m_view_public_key, tx_key.sec, derivation);
+        crypto::public_key out_key;
+        crypto::derive_public_key(derivation, 0, to.m_spend_public_key, out_key);
+        cryptonote::tx_out out;
+        out.amount = MINER_AMOUNT;
+        out.target = cryptonote::txout_to_key(out_key);
+        b.miner_tx.vout.push_back(out);
+
+        push_block(b);
+      }
+    }
+
+    void pop_blocks(size_t n)
+    {
+      chain.resize(chain.size() - n);
+      hashes.resize(hashes.size() - n);
+    }
+
+    void pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices)
+    {
+      if (calls++ == fail_call)
+        throw std::runtime_error("daemon unreachable");
+
+      // like the daemon, start from the newest block of the history which is on our chain
+      blocks_start_height = start_height;
+      for (const crypto::hash &h: short_chain_history)
+      {
+        const auto i = std::find(hashes.begin(), hashes.end(), h);
+        if (i != hashes.end())
+        {
+          blocks_start_height = std::max<uint64_t>(start_height, i - hashes.begin());
+          break;
+        }
+      }
+
+      blocks.clear();
+      o_indices.clear();
+      for (uint64_t height = blocks_start_height; height < chain.size() && height < blocks_start_height + BLOCKS_PER_PULL; ++height)
+      {
+        cryptonote::block_complete_entry bce;
+        bce.block = cryptonote::block_to_blob(chain[height]);
+        blocks.push_back(bce);
+
+        cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices miner_tx_indices;
+        for (size_t i = 0; i < chain[height].miner_tx.vout.size(); ++i)
+          miner_tx_indices.indices.push_back(height);
+        cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices block_indices;
+        block_indices.indices.push_back(miner_tx_indices);
+        o_indices.push_back(block_indices);
+      }
+    }
+
+    std::vector<cryptonote::block> chain;
+    std::vector<crypto::hash> hashes;
+    size_t calls;
+    size_t fail_call;
+
+  private:
+    void push_block(const cryptonote::block &b)
+    {
+      chain.push_back(b);
+      hashes.push_back(cryptonote::get_block_hash(b));
+    }
+  };
+
+  /// Hands out the password, so the keys get decrypted while the next blocks are prepared
+  class password_callback: public tools::i_wallet2_callback
+  {
+  public:
+    password_callback(): asked(0) {}
+    virtual boost::optional<epee::wipeable_string> on_get_password(const char *reason) override
+    {
+      ++asked;
+      return epee::wipeable_string(password);
+    }
+
+    size_t asked;
+  };
+
+  class WalletRefresh : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet-refresh-%%%%-%%%%");
+      boost::filesystem::create_directories(dir);
+      const cryptonote::keypair recovery_key = cryptonote::keypair::generate(hw::get_device("default"));
+      wallet.generate((dir / "wallet").string(), password, recovery_key.sec, true);
+      wallet.callback(&callback);
+
+      daemon.reset(new fake_daemon(wallet_accessor_test::generate_genesis(wallet)));
+      fake_daemon *d = daemon.get();
+      wallet_accessor_test::set_pull_blocks(wallet, [d](uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices) {
+        d->pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices);
+      });
+    }
+
+    virtual void TearDown()
+    {
+      wallet.callback(NULL);
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(dir, ec);
+    }
+
+    uint64_t refresh()
+    {
+      uint64_t blocks_fetched = 0;
+      bool received_money = false;
+      wallet.refresh(false, 0, blocks_fetched, received_money, false);
+      return blocks_fetched;
+    }
+
+    void expect_synced()
+    {
+      const tools::hashchain &blockchain = wallet_accessor_test::get_blockchain(wallet);
+      ASSERT_EQ(daemon->hashes.size(), blockchain.size());
+      for (size_t i = 0; i < daemon->hashes.size(); ++i)
+        ASSERT_EQ(daemon->hashes[i], blockchain[i]);
+    }
+
+    cryptonote::account_public_address address() const { return wallet.get_account().get_keys().m_account_address; }
+
+    boost::filesystem::path dir;
+    password_callback callback;
+    tools::wallet2 wallet;
+    std::unique_ptr<fake_daemon> daemon;
+  };
+
+  cryptonote::account_public_address make_address()
+  {
+    cryptonote::account_base account;
+    account.generate();
+    return account.get_keys().m_account_address;
+  }
+}
+
+TEST_F(WalletRefresh, finds_outputs_across_batches)
+{
+  daemon->add_blocks(address(), 20);
+
+  ASSERT_EQ(20, refresh());
+  expect_synced();
+  // the keys are decrypted while the fetching thread is still deriving for the next batches
+  ASSERT_EQ(1, callback.asked);
+  const tools::wallet2::transfer_container &transfers = wallet_accessor_test::get_transfers(wallet);
+  ASSERT_EQ(20, transfers.size());
+  for (size_t i = 0; i < transfers.size(); ++i)
+  {
+    ASSERT_EQ(i + 1, transfers[i].m_block_height);
+    ASSERT_TRUE(transfers[i].m_key_image_known);
+  }
+  ASSERT_EQ(20 * MINER_AMOUNT, wallet.balance_all());
+
+  // nothing new
+  ASSERT_EQ(0, refresh());
+  ASSERT_EQ(20, transfers.size());
+}
+
+TEST_F(WalletRefresh, retries_after_daemon_error)
+{
+  daemon->add_blocks(address(), 20);
+  daemon->fail_call = 2;
+
+  ASSERT_EQ(20, refresh());
+  expect_synced();
+  ASSERT_GT(daemon->calls, daemon->fail_call);
+  ASSERT_EQ(20, wallet_accessor_test::get_transfers(wallet).size());
+  ASSERT_EQ(20 * MINER_AMOUNT, wallet.balance_all());
+}
+
+TEST_F(WalletRefresh, follows_reorg)
+{
+  daemon->add_blocks(address(), 20);
+  ASSERT_EQ(20, refresh());
+
+  // blocks 15 to 20 are replaced by a longer chain paying someone else
+  daemon->pop_blocks(6);
+  daemon->add_blocks(make_address(), 8);
+
+  refresh();
+  expect_synced();
+  const tools::wallet2::transfer_container &transfers = wallet_accessor_test::get_transfers(wallet);
+  ASSERT_EQ(14, transfers.size());
+  for (size_t i = 0; i < transfers.size(); ++i)
+  {
+    ASSERT_EQ(i + 1, transfers[i].m_block_height);
+    ASSERT_EQ(cryptonote::get_transaction_hash(daemon->chain[i + 1].miner_tx), transfers[i].m_txid);
+  }
+  ASSERT_EQ(14 * MINER_AMOUNT, wallet.balance_all());
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2019, The Graft Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet_rpc_snapshot.h"
+
+namespace
+{
+  std::shared_ptr<const tools::wallet_snapshot::history> make_history(const tools::wallet2 &w)
+  {
+    std::shared_ptr<tools::wallet_snapshot::history> history = std::make_shared<tools::wallet_snapshot::history>();
+    history->wallet = &w;
+    history->version = w.get_history_version();
+    return history;
+  }
+}
+
+TEST(wallet_rpc_snapshot, history_is_current_until_changed)
+{
+  tools::wallet2 w;
+  const std::shared_ptr<const tools::wallet_snapshot::history> history = make_history(w);
+  ASSERT_TRUE(history->is_current(w));
+  w.set_tx_note(crypto::null_hash, "note");
+  ASSERT_FALSE(history->is_current(w));
+  ASSERT_TRUE(make_history(w)->is_current(w));
+}
+
+TEST(wallet_rpc_snapshot, history_is_not_shared_between_wallets)
+{
+  tools::wallet2 w0, w1;
+  ASSERT_EQ(w0.get_history_version(), w1.get_history_version());
+  const std::shared_ptr<const tools::wallet_snapshot::history> history = make_history(w0);
+  ASSERT_TRUE(history->is_current(w0));
+  ASSERT_FALSE(history->is_current(w1));
+}